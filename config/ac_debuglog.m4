@@ -0,0 +1,15 @@
+#
+# Add --disable-debug-log configure option (enabled by default).
+# If disabled, define WITHOUT_DEBUG_LOG=1 in config.h so powermand debug
+# logging compiles to nothing.
+#
+AC_DEFUN([AC_DEBUGLOG],
+[
+  AC_ARG_ENABLE([debug-log],
+    AS_HELP_STRING([--disable-debug-log],
+                   [Compile out powermand debug logging (powermand -d)]))
+  AS_IF([test "x$enable_debug_log" = "xno"], [
+    AC_DEFINE(WITHOUT_DEBUG_LOG, 1,
+              [Define if powermand debug logging is compiled out])
+  ])
+])
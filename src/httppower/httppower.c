@@ -21,10 +21,66 @@
 #include <getopt.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/select.h>
+#include <errno.h>
 
 #include "xmalloc.h"
 #include "error.h"
 #include "argv.h"
+#include "hostlist.h"
+#include "hash.h"
+#include "sessions.h"
+
+/* multi-host commands substitute each host for this in the url */
+#define HOST_TEMPLATE           "{{host}}"
+#define HOSTCONNS_HASH_SIZE     1024
+/* wait in ms if curl has no timeout for us */
+#define INCREMENTAL_WAIT        100
+#define OUTPUT_BUFSIZE_MIN      4096
+#define TCP_KEEPIDLE_SEC        30L
+#define TCP_KEEPINTVL_SEC       15L
+#define HTTP_UNAUTHORIZED       401
+
+struct put_cb_data {
+  char *data;
+  int offset;
+};
+
+/* Redfish session login in progress */
+struct login {
+    char *url;
+    char *body;
+    struct curl_slist *headers;
+    char *token;                /* from X-Auth-Token header */
+    char *location;             /* from Location header */
+};
+
+enum {
+    HOSTCONN_LOGIN,
+    HOSTCONN_REQUEST,
+};
+
+/* per host state for multi-host commands, the curl handle is kept so
+ * connections and cookies persist across commands.
+ */
+struct hostconn {
+    char *host;
+    CURL *eh;
+    char errbuf[CURL_ERROR_SIZE];
+    int cookies;                /* cookie engine enabled on eh */
+    int state;                  /* HOSTCONN_LOGIN or HOSTCONN_REQUEST */
+    int retried;                /* request retried after new login */
+    const char *method;
+    char *base;                 /* base url for host */
+    char *url;
+    char *data;
+    struct login login;
+    struct curl_slist *token_headers;
+    struct put_cb_data pcd;
+    char *output;
+    size_t output_len;
+    size_t output_alloc;
+};
 
 static char *url = NULL;
 static char *header = NULL;
@@ -32,11 +88,27 @@ static struct curl_slist *header_list = NULL;
 static int cookies = 0;
 static int verbose = 0;
 static char *userpwd = NULL;
+static char *username = NULL;
 static char errbuf[CURL_ERROR_SIZE];
+static hostlist_t hosts = NULL;
+static hash_t hostconns = NULL;
+static CURLM *mh = NULL;
 
-#define OPTIONS "u:H:cv"
+/* Redfish session auth, see setsession */
+static char *sessionpath = NULL;
+static char *tokencache = NULL;
+static sessions_t *sessions = NULL;
+static int sessions_dirty = 0;
+static CURL *login_h = NULL;
+static char login_errbuf[CURL_ERROR_SIZE];
+static struct curl_slist *token_headers = NULL;
+
+#define OPTIONS "u:H:h:s:t:cv"
 static struct option longopts[] = {
         {"url", required_argument, 0, 'u' },
+        {"hosts", required_argument, 0, 'h' },
+        {"session", required_argument, 0, 's' },
+        {"token-cache", required_argument, 0, 't' },
         {"header", required_argument, 0, 'H' },
         {"cookies", no_argument, 0, 'c' },
         {"verbose", no_argument, 0, 'v' },
@@ -53,6 +125,12 @@ void help(void)
     printf("  get [url]\n");
     printf("  post [url] <string data>\n");
     printf("  put [url] <string data>\n");
+    printf("  setsession [path]\n");
+    printf("  settokencache [file]\n");
+    printf("  sethosts hosts\n");
+    printf("  mget <hosts|all> [url]\n");
+    printf("  mpost <hosts|all> [url] <string data>\n");
+    printf("  mput <hosts|all> [url] <string data>\n");
 }
 
 char *
@@ -71,6 +149,264 @@ _make_url(char *str)
     return myurl;
 }
 
+/* options common to all curl handles */
+static void handle_init(CURL *h, char *eb)
+{
+    curl_easy_setopt(h, CURLOPT_TIMEOUT, 5);
+    curl_easy_setopt(h, CURLOPT_ERRORBUFFER, eb);
+    curl_easy_setopt(h, CURLOPT_FAILONERROR, 1);
+
+    /* for time being */
+    curl_easy_setopt(h, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(h, CURLOPT_SSL_VERIFYHOST, 0L);
+
+    /* keep idle connections to the BMC from being dropped between
+     * commands, so they can be reused
+     */
+    curl_easy_setopt(h, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(h, CURLOPT_TCP_KEEPIDLE, TCP_KEEPIDLE_SEC);
+    curl_easy_setopt(h, CURLOPT_TCP_KEEPINTVL, TCP_KEEPINTVL_SEC);
+
+    if (verbose)
+        curl_easy_setopt(h, CURLOPT_VERBOSE, 1L);
+}
+
+static size_t discard_cb(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    return size * nmemb;
+}
+
+static int session_enabled(void)
+{
+    return sessionpath && userpwd;
+}
+
+/* save token cache if sessions changed */
+static void sessions_flush(void)
+{
+    if (tokencache && sessions_dirty) {
+        if (sessions_save(sessions, tokencache) < 0)
+            printf("Error: %s: %s\n", tokencache, strerror(errno));
+    }
+    sessions_dirty = 0;
+}
+
+static void sessions_forget(const char *base)
+{
+    sessions_clear(sessions, username, base);
+    sessions_dirty = 1;
+}
+
+/* set *valp to value of header name if buf is that header */
+static void header_value(const char *buf,
+                         size_t len,
+                         const char *name,
+                         char **valp)
+{
+    size_t namelen = strlen(name);
+
+    if (len > namelen
+        && strncasecmp(buf, name, namelen) == 0
+        && buf[namelen] == ':') {
+        const char *p = buf + namelen + 1;
+        const char *end = buf + len;
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        while (end > p && (end[-1] == '\r' || end[-1] == '\n'))
+            end--;
+        if (*valp)
+            xfree(*valp);
+        *valp = xmalloc(end - p + 1);
+        memcpy(*valp, p, end - p);
+    }
+}
+
+static size_t login_header_cb(char *buf,
+                              size_t size,
+                              size_t nitems,
+                              void *userdata)
+{
+    struct login *l = userdata;
+    size_t len = size * nitems;
+
+    header_value(buf, len, "X-Auth-Token", &l->token);
+    header_value(buf, len, "Location", &l->location);
+    return len;
+}
+
+/* return str as a quoted JSON string */
+static char *json_quote(const char *str)
+{
+    char *q = xmalloc(strlen(str) * 2 + 3);
+    char *p = q;
+
+    *p++ = '"';
+    while (*str) {
+        if (*str == '"' || *str == '\\')
+            *p++ = '\\';
+        *p++ = *str++;
+    }
+    *p++ = '"';
+    return q;
+}
+
+/* setup eh to create a session at base, see login_finish() */
+static void login_setup(CURL *eh, struct login *l, const char *base)
+{
+    const char *pass = strchr(userpwd, ':');
+    char *juser = json_quote(username);
+    char *jpass = json_quote(pass ? pass + 1 : "");
+
+    l->url = xmalloc(strlen(base) + strlen(sessionpath) + 2);
+    sprintf(l->url, "%s/%s", base, sessionpath);
+    l->body = xmalloc(strlen(juser) + strlen(jpass) + 32);
+    sprintf(l->body, "{\"UserName\":%s,\"Password\":%s}", juser, jpass);
+    l->headers = curl_slist_append(NULL, "Content-Type: application/json");
+    xfree(juser);
+    xfree(jpass);
+
+    curl_easy_setopt(eh, CURLOPT_HTTPGET, 1);
+    curl_easy_setopt(eh, CURLOPT_POST, 1);
+    curl_easy_setopt(eh, CURLOPT_URL, l->url);
+    curl_easy_setopt(eh, CURLOPT_POSTFIELDS, l->body);
+    curl_easy_setopt(eh, CURLOPT_POSTFIELDSIZE, strlen(l->body));
+    curl_easy_setopt(eh, CURLOPT_HTTPHEADER, l->headers);
+    curl_easy_setopt(eh, CURLOPT_USERPWD, NULL);
+    curl_easy_setopt(eh, CURLOPT_HEADERFUNCTION, login_header_cb);
+    curl_easy_setopt(eh, CURLOPT_HEADERDATA, l);
+    curl_easy_setopt(eh, CURLOPT_WRITEFUNCTION, discard_cb);
+}
+
+/* cache the token from a completed login, returns -1 and sets eb on
+ * failure
+ */
+static int login_finish(CURL *eh,
+                        struct login *l,
+                        const char *base,
+                        CURLcode result,
+                        char *eb)
+{
+    int rc = -1;
+
+    curl_easy_setopt(eh, CURLOPT_HEADERFUNCTION, NULL);
+    curl_easy_setopt(eh, CURLOPT_HEADERDATA, NULL);
+    curl_easy_setopt(eh, CURLOPT_POSTFIELDS, "");
+    curl_easy_setopt(eh, CURLOPT_POSTFIELDSIZE, 0);
+
+    if (result != CURLE_OK) {
+        if (!eb[0])
+            snprintf(eb, CURL_ERROR_SIZE, "%s", curl_easy_strerror(result));
+    }
+    else if (!l->token)
+        snprintf(eb, CURL_ERROR_SIZE, "no X-Auth-Token in response");
+    else {
+        sessions_set(sessions, username, base, l->token, l->location);
+        sessions_dirty = 1;
+        rc = 0;
+    }
+
+    xfree(l->url);
+    xfree(l->body);
+    curl_slist_free_all(l->headers);
+    if (l->token)
+        xfree(l->token);
+    if (l->location)
+        xfree(l->location);
+    memset(l, 0, sizeof(*l));
+    return rc;
+}
+
+/* create a session at base with the login handle, returns token */
+static const char *login_sync(const char *base)
+{
+    struct login l = { 0 };
+    CURLcode result;
+
+    if (!login_h) {
+        if (!(login_h = curl_easy_init()))
+            err_exit(false, "curl_easy_init failed");
+        handle_init(login_h, login_errbuf);
+    }
+    login_errbuf[0] = '\0';
+    login_setup(login_h, &l, base);
+    result = curl_easy_perform(login_h);
+    if (login_finish(login_h, &l, base, result, login_errbuf) < 0)
+        return NULL;
+    return sessions_token(sessions, username, base);
+}
+
+/* send token instead of basic auth on eh, *slp holds the headers */
+static void token_apply(CURL *eh, const char *token, struct curl_slist **slp)
+{
+    struct curl_slist *sl = NULL;
+    struct curl_slist *p;
+    char *hdr = xmalloc(strlen(token) + 16);
+
+    for (p = header_list; p; p = p->next)
+        sl = curl_slist_append(sl, p->data);
+    sprintf(hdr, "X-Auth-Token: %s", token);
+    sl = curl_slist_append(sl, hdr);
+    xfree(hdr);
+
+    curl_easy_setopt(eh, CURLOPT_HTTPHEADER, sl);
+    curl_easy_setopt(eh, CURLOPT_USERPWD, NULL);
+    curl_slist_free_all(*slp);
+    *slp = sl;
+}
+
+static long response_code(CURL *eh)
+{
+    long code = 0;
+
+    curl_easy_getinfo(eh, CURLINFO_RESPONSE_CODE, &code);
+    return code;
+}
+
+static void login_failed(void)
+{
+    snprintf(errbuf, sizeof(errbuf), "session login failed: %.*s",
+             (int)sizeof(errbuf) - 32, login_errbuf);
+}
+
+/* curl_easy_perform() with session auth if enabled.  A session is
+ * created if there is none, and recreated once if the token is
+ * rejected.
+ */
+static CURLcode perform(CURL *h)
+{
+    const char *token;
+    CURLcode rc;
+
+    if (!session_enabled() || !url)
+        return curl_easy_perform(h);
+
+    if (!(token = sessions_token(sessions, username, url))
+        && !(token = login_sync(url))) {
+        login_failed();
+        rc = CURLE_LOGIN_DENIED;
+        goto done;
+    }
+    token_apply(h, token, &token_headers);
+    rc = curl_easy_perform(h);
+    if (rc == CURLE_HTTP_RETURNED_ERROR
+        && response_code(h) == HTTP_UNAUTHORIZED) {
+        sessions_forget(url);
+        if (!(token = login_sync(url))) {
+            login_failed();
+            rc = CURLE_LOGIN_DENIED;
+            goto done;
+        }
+        token_apply(h, token, &token_headers);
+        rc = curl_easy_perform(h);
+    }
+done:
+    curl_easy_setopt(h, CURLOPT_HTTPHEADER, header_list);
+    if (userpwd)
+        curl_easy_setopt(h, CURLOPT_USERPWD, userpwd);
+    sessions_flush();
+    return rc;
+}
+
 void post(CURL *h, char **av)
 {
     char *myurl = NULL;
@@ -92,7 +428,7 @@ void post(CURL *h, char **av)
         curl_easy_setopt(h, CURLOPT_URL, url_ptr);
         curl_easy_setopt(h, CURLOPT_POSTFIELDS, postdata);
         curl_easy_setopt(h, CURLOPT_POSTFIELDSIZE, strlen (postdata));
-        if (curl_easy_perform(h) != 0)
+        if (perform(h) != 0)
             printf("Error: %s\n", errbuf);
         curl_easy_setopt(h, CURLOPT_URL, "");
         curl_easy_setopt(h, CURLOPT_POSTFIELDS, "");
@@ -106,11 +442,6 @@ void post(CURL *h, char **av)
         xfree(postdata);
 }
 
-struct put_cb_data {
-  char *data;
-  int offset;
-};
-
 size_t put_read_cb(char *buffer, size_t size, size_t nitems, void *userdata) {
     struct put_cb_data *pcd = userdata;
 
@@ -144,7 +475,7 @@ void put(CURL *h, char **av)
         pcd.offset = 0;
         curl_easy_setopt(h, CURLOPT_READDATA, &pcd);
         curl_easy_setopt(h, CURLOPT_INFILESIZE, strlen (putdata));
-        if (curl_easy_perform(h) != 0)
+        if (perform(h) != 0)
             printf("Error: %s\n", errbuf);
         curl_easy_setopt(h, CURLOPT_URL, "");
         curl_easy_setopt(h, CURLOPT_UPLOAD, 0);
@@ -164,7 +495,7 @@ void get(CURL *h, char **av)
     if (myurl) {
         curl_easy_setopt(h, CURLOPT_HTTPGET, 1);
         curl_easy_setopt(h, CURLOPT_URL, myurl);
-        if (curl_easy_perform(h) != 0)
+        if (perform(h) != 0)
             printf("Error: %s\n", errbuf);
         curl_easy_setopt(h, CURLOPT_URL, "");
     } else
@@ -215,10 +546,12 @@ void cookies_enable(CURL *h, char **av)
         /* enable cookie engine with empty string, no need to read from
            a real file */
         curl_easy_setopt(h, CURLOPT_COOKIEFILE, "");
+        cookies = 1;
     }
     else {
 	curl_easy_setopt(h, CURLOPT_COOKIELIST, "ALL");
         curl_easy_setopt(h, CURLOPT_COOKIEFILE, NULL);
+        cookies = 0;
     }
 }
 
@@ -233,6 +566,508 @@ void auth(CURL *h, char **av)
     userpwd = xstrdup(av[0]);
     curl_easy_setopt(h, CURLOPT_USERPWD, userpwd);
     curl_easy_setopt(h, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+    if (username)
+        xfree(username);
+    username = xstrdup(userpwd);
+    if (strchr(username, ':'))
+        *strchr(username, ':') = '\0';
+}
+
+void setsession(CURL *h, char **av)
+{
+    if (sessionpath) {
+        xfree(sessionpath);
+        sessionpath = NULL;
+    }
+    if (av[0])
+        sessionpath = xstrdup(av[0]);
+}
+
+void settokencache(CURL *h, char **av)
+{
+    if (tokencache) {
+        xfree(tokencache);
+        tokencache = NULL;
+    }
+    if (av[0]) {
+        if (sessions_load(sessions, av[0]) < 0) {
+            printf("Error: %s: %s\n", av[0], strerror(errno));
+            return;
+        }
+        tokencache = xstrdup(av[0]);
+    }
+}
+
+void sethosts(CURL *h, char **av)
+{
+    hostlist_t hl;
+
+    if (av[0] == NULL) {
+        printf("Usage: sethosts hosts\n");
+        return;
+    }
+    if (!(hl = hostlist_create(av[0]))) {
+        printf("Error: invalid hostlist %s\n", av[0]);
+        return;
+    }
+    hostlist_uniq(hl);
+    if (hosts)
+        hostlist_destroy(hosts);
+    hosts = hl;
+}
+
+static size_t hostconn_output_cb(void *contents,
+                                 size_t size,
+                                 size_t nmemb,
+                                 void *userp)
+{
+    size_t realsize = size * nmemb;
+    struct hostconn *hc = userp;
+
+    if (hc->output_len + realsize + 1 > hc->output_alloc) {
+        size_t alloc = hc->output_alloc ? hc->output_alloc : OUTPUT_BUFSIZE_MIN;
+        while (alloc < hc->output_len + realsize + 1)
+            alloc *= 2;
+        hc->output = xrealloc(hc->output, alloc);
+        hc->output_alloc = alloc;
+    }
+    memcpy(hc->output + hc->output_len, contents, realsize);
+    hc->output_len += realsize;
+    hc->output[hc->output_len] = '\0';
+    return realsize;
+}
+
+static void hostconn_destroy(void *data)
+{
+    struct hostconn *hc = data;
+
+    if (hc) {
+        if (hc->eh)
+            curl_easy_cleanup(hc->eh);
+        xfree(hc->host);
+        if (hc->base)
+            xfree(hc->base);
+        if (hc->url)
+            xfree(hc->url);
+        if (hc->data)
+            xfree(hc->data);
+        if (hc->output)
+            xfree(hc->output);
+        curl_slist_free_all(hc->token_headers);
+        xfree(hc);
+    }
+}
+
+static struct hostconn *hostconn_get(const char *host)
+{
+    struct hostconn *hc;
+
+    if ((hc = hash_find(hostconns, host)))
+        return hc;
+
+    hc = (struct hostconn *)xmalloc(sizeof(*hc));
+    hc->host = xstrdup(host);
+    if (!(hc->eh = curl_easy_init()))
+        err_exit(false, "curl_easy_init failed");
+    handle_init(hc->eh, hc->errbuf);
+    curl_easy_setopt(hc->eh, CURLOPT_WRITEFUNCTION, hostconn_output_cb);
+    curl_easy_setopt(hc->eh, CURLOPT_WRITEDATA, hc);
+    curl_easy_setopt(hc->eh, CURLOPT_PRIVATE, hc);
+    if (!hash_insert(hostconns, hc->host, hc))
+        err_exit(true, "hash_insert");
+    return hc;
+}
+
+/* bring per host handle up to date with current auth, header, and
+ * cookie settings, which may have changed since it was last used
+ */
+static void hostconn_sync(struct hostconn *hc)
+{
+    const char *token;
+
+    if (session_enabled()
+        && (token = sessions_token(sessions, username, hc->base)))
+        token_apply(hc->eh, token, &hc->token_headers);
+    else {
+        if (userpwd) {
+            curl_easy_setopt(hc->eh, CURLOPT_USERPWD, userpwd);
+            curl_easy_setopt(hc->eh, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+        }
+        curl_easy_setopt(hc->eh, CURLOPT_HTTPHEADER, header_list);
+    }
+    if (cookies && !hc->cookies)
+        curl_easy_setopt(hc->eh, CURLOPT_COOKIEFILE, "");
+    else if (!cookies && hc->cookies) {
+        curl_easy_setopt(hc->eh, CURLOPT_COOKIELIST, "ALL");
+        curl_easy_setopt(hc->eh, CURLOPT_COOKIEFILE, NULL);
+    }
+    hc->cookies = cookies;
+}
+
+/* substitute host into base url, then append str like _make_url() */
+static char *_make_host_url(const char *host, const char *str)
+{
+    const char *p = strstr(url, HOST_TEMPLATE);
+    size_t len = strlen(url) - strlen(HOST_TEMPLATE) + strlen(host)
+                 + (str ? strlen(str) + 1 : 0) + 1;
+    char *myurl = xmalloc(len);
+
+    sprintf(myurl, "%.*s%s%s%s%s",
+            (int)(p - url),
+            url,
+            host,
+            p + strlen(HOST_TEMPLATE),
+            str ? "/" : "",
+            str ? str : "");
+    return myurl;
+}
+
+/* print result tagged with host, one line per line of output */
+static void hostconn_result(struct hostconn *hc, CURLcode result)
+{
+    const char *p = hc->output;
+    const char *end = hc->output + hc->output_len;
+
+    if (result != CURLE_OK) {
+        printf("%s: Error: %s\n",
+               hc->host,
+               hc->errbuf[0] ? hc->errbuf : curl_easy_strerror(result));
+        return;
+    }
+    if (hc->output_len == 0) {
+        printf("%s: \n", hc->host);
+        return;
+    }
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        int len = nl ? nl - p : end - p;
+        if (len > 0 && p[len - 1] == '\r')
+            len--;
+        printf("%s: %.*s\n", hc->host, len, p);
+        p = nl ? nl + 1 : end;
+    }
+}
+
+static void hostconn_add(struct hostconn *hc)
+{
+    CURLMcode mc;
+
+    if ((mc = curl_multi_add_handle(mh, hc->eh)) != CURLM_OK)
+        err_exit(false, "curl_multi_add_handle: %s",
+                 curl_multi_strerror(mc));
+}
+
+static void hostconn_login(struct hostconn *hc)
+{
+    hc->state = HOSTCONN_LOGIN;
+    hc->errbuf[0] = '\0';
+    login_setup(hc->eh, &hc->login, hc->base);
+}
+
+static void hostconn_request(struct hostconn *hc)
+{
+    hc->state = HOSTCONN_REQUEST;
+    hostconn_sync(hc);
+    hc->output_len = 0;
+    hc->errbuf[0] = '\0';
+    curl_easy_setopt(hc->eh, CURLOPT_WRITEFUNCTION, hostconn_output_cb);
+    curl_easy_setopt(hc->eh, CURLOPT_HTTPGET, 1);
+    curl_easy_setopt(hc->eh, CURLOPT_URL, hc->url);
+    if (strcmp(hc->method, "post") == 0) {
+        curl_easy_setopt(hc->eh, CURLOPT_POST, 1);
+        curl_easy_setopt(hc->eh, CURLOPT_POSTFIELDS, hc->data);
+        curl_easy_setopt(hc->eh, CURLOPT_POSTFIELDSIZE, strlen(hc->data));
+    }
+    else if (strcmp(hc->method, "put") == 0) {
+        hc->pcd.data = hc->data;
+        hc->pcd.offset = 0;
+        curl_easy_setopt(hc->eh, CURLOPT_UPLOAD, 1);
+        curl_easy_setopt(hc->eh, CURLOPT_READFUNCTION, put_read_cb);
+        curl_easy_setopt(hc->eh, CURLOPT_READDATA, &hc->pcd);
+        curl_easy_setopt(hc->eh, CURLOPT_INFILESIZE, strlen(hc->data));
+    }
+}
+
+/* handle completed login or request, returns 1 if hc was restarted */
+static int hostconn_complete(struct hostconn *hc, CURLcode result)
+{
+    if (hc->state == HOSTCONN_LOGIN) {
+        if (login_finish(hc->eh, &hc->login, hc->base, result, hc->errbuf) < 0) {
+            printf("%s: Error: session login failed: %s\n",
+                   hc->host,
+                   hc->errbuf);
+            return 0;
+        }
+        hostconn_request(hc);
+        hostconn_add(hc);
+        return 1;
+    }
+    if (session_enabled()
+        && !hc->retried
+        && result == CURLE_HTTP_RETURNED_ERROR
+        && response_code(hc->eh) == HTTP_UNAUTHORIZED) {
+        sessions_forget(hc->base);
+        hc->retried = 1;
+        hostconn_login(hc);
+        hostconn_add(hc);
+        return 1;
+    }
+    hostconn_result(hc, result);
+    return 0;
+}
+
+static void hostconn_done(struct hostconn *hc)
+{
+    curl_easy_setopt(hc->eh, CURLOPT_URL, "");
+    curl_easy_setopt(hc->eh, CURLOPT_POSTFIELDS, "");
+    curl_easy_setopt(hc->eh, CURLOPT_POSTFIELDSIZE, 0);
+    curl_easy_setopt(hc->eh, CURLOPT_UPLOAD, 0);
+    xfree(hc->url);
+    hc->url = NULL;
+    xfree(hc->base);
+    hc->base = NULL;
+    if (hc->data) {
+        xfree(hc->data);
+        hc->data = NULL;
+    }
+}
+
+/* wait for activity on mh, at most INCREMENTAL_WAIT ms */
+static void multi_wait(void)
+{
+    fd_set fdread;
+    fd_set fdwrite;
+    fd_set fderror;
+    struct timeval timeout;
+    long timeout_ms;
+    int maxfd = -1;
+    CURLMcode mc;
+
+    if ((mc = curl_multi_timeout(mh, &timeout_ms)) != CURLM_OK)
+        err_exit(false, "curl_multi_timeout: %s",
+                 curl_multi_strerror(mc));
+    if (timeout_ms == 0)
+        return;
+    if (timeout_ms < 0 || timeout_ms > INCREMENTAL_WAIT)
+        timeout_ms = INCREMENTAL_WAIT;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    FD_ZERO(&fdread);
+    FD_ZERO(&fdwrite);
+    FD_ZERO(&fderror);
+    if ((mc = curl_multi_fdset(mh,
+                               &fdread,
+                               &fdwrite,
+                               &fderror,
+                               &maxfd)) != CURLM_OK)
+        err_exit(false, "curl_multi_fdset: %s",
+                 curl_multi_strerror(mc));
+    /* if maxfd == -1, select() just sleeps for the timeout */
+    if (select(maxfd + 1, &fdread, &fdwrite, &fderror, &timeout) < 0)
+        err_exit(true, "select");
+}
+
+/* run all requests on the multi handle to completion, printing each
+ * result as it completes
+ */
+static void mperform(void)
+{
+    int running = 1;
+
+    while (running) {
+        CURLMcode mc;
+        CURLMsg *cmsg;
+        int msgq;
+
+        if ((mc = curl_multi_perform(mh, &running)) != CURLM_OK)
+            err_exit(false, "curl_multi_perform: %s",
+                     curl_multi_strerror(mc));
+
+        while ((cmsg = curl_multi_info_read(mh, &msgq))) {
+            struct hostconn *hc;
+            CURLcode result;
+            if (cmsg->msg != CURLMSG_DONE)
+                continue;
+            /* cmsg is invalid once the handle is removed */
+            result = cmsg->data.result;
+            curl_easy_getinfo(cmsg->easy_handle, CURLINFO_PRIVATE, &hc);
+            if ((mc = curl_multi_remove_handle(mh, hc->eh)) != CURLM_OK)
+                err_exit(false, "curl_multi_remove_handle: %s",
+                         curl_multi_strerror(mc));
+            if (hostconn_complete(hc, result))
+                running = 1;
+            else
+                hostconn_done(hc);
+        }
+
+        if (running)
+            multi_wait();
+    }
+    sessions_flush();
+}
+
+/* mget, mpost, mput - send the request to each host concurrently */
+void mrequest(const char *method, char **av)
+{
+    hostlist_t targets;
+    hostlist_iterator_t itr;
+    char *suffix = NULL;
+    char *data = NULL;
+    char *host;
+
+    if (av[0] == NULL) {
+        printf("Usage: m%s <hosts|all> [url]%s\n",
+               method,
+               strcmp(method, "get") ? " <string data>" : "");
+        return;
+    }
+    if (!url || !strstr(url, HOST_TEMPLATE)) {
+        printf("Error: url must contain %s\n", HOST_TEMPLATE);
+        return;
+    }
+    if (strcmp(method, "get") == 0)
+        suffix = av[1];
+    else if (av[1] && av[2]) {
+        suffix = av[1];
+        data = av[2];
+    }
+    else if (av[1])
+        data = av[1];
+    else {
+        printf("Nothing to %s!\n", method);
+        return;
+    }
+
+    if (strcmp(av[0], "all") == 0) {
+        if (!hosts || hostlist_count(hosts) == 0) {
+            printf("Error: no hosts set\n");
+            return;
+        }
+        targets = hostlist_copy(hosts);
+    }
+    else if (!(targets = hostlist_create(av[0]))) {
+        printf("Error: invalid hostlist %s\n", av[0]);
+        return;
+    }
+    hostlist_uniq(targets);
+
+    if (!(itr = hostlist_iterator_create(targets)))
+        err_exit(true, "hostlist_iterator_create");
+    while ((host = hostlist_next(itr))) {
+        struct hostconn *hc = hostconn_get(host);
+
+        hc->method = method;
+        hc->retried = 0;
+        hc->base = _make_host_url(host, NULL);
+        hc->url = _make_host_url(host, suffix);
+        if (data)
+            hc->data = xstrdup(data);
+        /* create a session first if needed */
+        if (session_enabled()
+            && !sessions_token(sessions, username, hc->base))
+            hostconn_login(hc);
+        else
+            hostconn_request(hc);
+        hostconn_add(hc);
+        free(host);
+    }
+    hostlist_iterator_destroy(itr);
+    hostlist_destroy(targets);
+
+    mperform();
+}
+
+struct logout {
+    char *url;
+    struct curl_slist *headers;
+};
+
+/* url of session at location, which may be relative to base's origin */
+static char *session_url(const char *base, const char *location)
+{
+    const char *p;
+    size_t originlen;
+    char *s;
+
+    if (strstr(location, "://"))
+        return xstrdup(location);
+    if ((p = strstr(base, "://")) && (p = strchr(p + 3, '/')))
+        originlen = p - base;
+    else
+        originlen = strlen(base);
+    s = xmalloc(originlen + strlen(location) + 2);
+    sprintf(s, "%.*s%s%s",
+            (int)originlen,
+            base,
+            location[0] == '/' ? "" : "/",
+            location);
+    return s;
+}
+
+static void logout_cb(const char *user,
+                      const char *base,
+                      const char *token,
+                      const char *location,
+                      void *arg)
+{
+    struct logout *lo;
+    char *hdr;
+    CURL *eh;
+    CURLMcode mc;
+
+    if (!location)
+        return;
+    if (!(eh = curl_easy_init()))
+        err_exit(false, "curl_easy_init failed");
+    handle_init(eh, login_errbuf);
+    lo = (struct logout *)xmalloc(sizeof(*lo));
+    lo->url = session_url(base, location);
+    hdr = xmalloc(strlen(token) + 16);
+    sprintf(hdr, "X-Auth-Token: %s", token);
+    lo->headers = curl_slist_append(NULL, hdr);
+    xfree(hdr);
+    curl_easy_setopt(eh, CURLOPT_CUSTOMREQUEST, "DELETE");
+    curl_easy_setopt(eh, CURLOPT_URL, lo->url);
+    curl_easy_setopt(eh, CURLOPT_HTTPHEADER, lo->headers);
+    curl_easy_setopt(eh, CURLOPT_WRITEFUNCTION, discard_cb);
+    curl_easy_setopt(eh, CURLOPT_PRIVATE, lo);
+    if ((mc = curl_multi_add_handle(mh, eh)) != CURLM_OK)
+        err_exit(false, "curl_multi_add_handle: %s",
+                 curl_multi_strerror(mc));
+}
+
+/* delete all sessions on the BMCs so they don't linger until they time
+ * out, errors are ignored
+ */
+static void sessions_logout(void)
+{
+    int running = 1;
+
+    sessions_for_each(sessions, logout_cb, NULL);
+    while (running) {
+        CURLMcode mc;
+        CURLMsg *cmsg;
+        int msgq;
+
+        if ((mc = curl_multi_perform(mh, &running)) != CURLM_OK)
+            err_exit(false, "curl_multi_perform: %s",
+                     curl_multi_strerror(mc));
+        while ((cmsg = curl_multi_info_read(mh, &msgq))) {
+            CURL *eh = cmsg->easy_handle;
+            struct logout *lo;
+            if (cmsg->msg != CURLMSG_DONE)
+                continue;
+            curl_easy_getinfo(eh, CURLINFO_PRIVATE, &lo);
+            curl_multi_remove_handle(mh, eh);
+            curl_easy_cleanup(eh);
+            xfree(lo->url);
+            curl_slist_free_all(lo->headers);
+            xfree(lo);
+        }
+        if (running)
+            multi_wait();
+    }
 }
 
 int docmd(CURL *h, char **av)
@@ -258,6 +1093,18 @@ int docmd(CURL *h, char **av)
             post(h, av + 1);
         else if (strcmp(av[0], "put") == 0)
             put(h, av + 1);
+        else if (strcmp(av[0], "setsession") == 0)
+            setsession(h, av + 1);
+        else if (strcmp(av[0], "settokencache") == 0)
+            settokencache(h, av + 1);
+        else if (strcmp(av[0], "sethosts") == 0)
+            sethosts(h, av + 1);
+        else if (strcmp(av[0], "mget") == 0)
+            mrequest("get", av + 1);
+        else if (strcmp(av[0], "mpost") == 0)
+            mrequest("post", av + 1);
+        else if (strcmp(av[0], "mput") == 0)
+            mrequest("put", av + 1);
         else
             printf("type \"help\" for a list of commands\n");
     }
@@ -285,7 +1132,8 @@ void shell(CURL *h)
 void
 usage(void)
 {
-    fprintf(stderr, "Usage: httppower [--url URL] [--header string] [--cookies]\n");
+    fprintf(stderr, "Usage: httppower [--url URL] [--header string] [--cookies] [--hosts hosts]\n"
+                    "                 [--session path] [--token-cache file]\n");
     exit(1);
 }
 
@@ -305,6 +1153,17 @@ main(int argc, char *argv[])
             case 'H': /* --header */
                 header = xstrdup(optarg);
                 break;
+            case 'h': /* --hosts */
+                if (!(hosts = hostlist_create(optarg)))
+                    err_exit(false, "invalid hostlist %s", optarg);
+                hostlist_uniq(hosts);
+                break;
+            case 's': /* --session */
+                sessionpath = xstrdup(optarg);
+                break;
+            case 't': /* --token-cache */
+                tokencache = xstrdup(optarg);
+                break;
 	    case 'c': /* --cookies */
 	        cookies = 1;
 	        break;
@@ -324,16 +1183,19 @@ main(int argc, char *argv[])
     if ((h = curl_easy_init()) == NULL)
         err_exit(false, "curl_easy_init failed");
 
-    curl_easy_setopt(h, CURLOPT_TIMEOUT, 5);
-    curl_easy_setopt(h, CURLOPT_ERRORBUFFER, errbuf);
-    curl_easy_setopt(h, CURLOPT_FAILONERROR, 1);
-
-    /* for time being */
-    curl_easy_setopt(h, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(h, CURLOPT_SSL_VERIFYHOST, 0L);
+    handle_init(h, errbuf);
 
-    if (verbose)
-        curl_easy_setopt(h, CURLOPT_VERBOSE, 1L);
+    if ((mh = curl_multi_init()) == NULL)
+        err_exit(false, "curl_multi_init failed");
+    if (!(hostconns = hash_create(HOSTCONNS_HASH_SIZE,
+                                  (hash_key_f)hash_key_string,
+                                  (hash_cmp_f)strcmp,
+                                  hostconn_destroy)))
+        err_exit(true, "hash_create");
+    if (!(sessions = sessions_create()))
+        err_exit(true, "sessions_create");
+    if (tokencache && sessions_load(sessions, tokencache) < 0)
+        err_exit(true, "%s", tokencache);
 
     if (header) {
         header_list = curl_slist_append(header_list, header);
@@ -347,9 +1209,27 @@ main(int argc, char *argv[])
 
     shell(h);
 
+    /* with a token cache, sessions are left open for the next run */
+    if (!tokencache)
+        sessions_logout();
+
     curl_easy_cleanup(h);
+    if (login_h)
+        curl_easy_cleanup(login_h);
+    curl_slist_free_all(token_headers);
+    hash_destroy(hostconns);
+    curl_multi_cleanup(mh);
+    sessions_destroy(sessions);
+    if (hosts)
+        hostlist_destroy(hosts);
     if (userpwd)
         xfree(userpwd);
+    if (username)
+        xfree(username);
+    if (sessionpath)
+        xfree(sessionpath);
+    if (tokencache)
+        xfree(tokencache);
     if (url)
         xfree(url);
     exit(0);
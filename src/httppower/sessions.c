@@ -0,0 +1,241 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sessions.h"
+
+#include "xmalloc.h"
+#include "error.h"
+#include "hash.h"
+
+#define SESSIONS_HASH_SIZE 1024
+
+/* cache file has one session per line:
+ *   user base token location
+ * location is "-" if not known
+ */
+#define SESSIONS_NO_LOCATION "-"
+
+struct session {
+    char *key;                  /* "user base" */
+    char *user;
+    char *base;
+    char *token;
+    char *location;
+};
+
+struct sessions {
+    hash_t h;
+};
+
+struct for_each_arg {
+    sessions_for_each_f fn;
+    void *arg;
+};
+
+static char *make_key(const char *user, const char *base)
+{
+    char *key = xmalloc(strlen(user) + strlen(base) + 2);
+    sprintf(key, "%s %s", user, base);
+    return key;
+}
+
+static void session_destroy(void *data)
+{
+    struct session *s = data;
+
+    if (s) {
+        xfree(s->key);
+        xfree(s->user);
+        xfree(s->base);
+        xfree(s->token);
+        if (s->location)
+            xfree(s->location);
+        xfree(s);
+    }
+}
+
+sessions_t *sessions_create(void)
+{
+    sessions_t *ss = (sessions_t *)xmalloc(sizeof(*ss));
+
+    if (!(ss->h = hash_create(SESSIONS_HASH_SIZE,
+                              (hash_key_f)hash_key_string,
+                              (hash_cmp_f)strcmp,
+                              session_destroy))) {
+        xfree(ss);
+        return NULL;
+    }
+    return ss;
+}
+
+void sessions_destroy(sessions_t *ss)
+{
+    if (ss) {
+        hash_destroy(ss->h);
+        xfree(ss);
+    }
+}
+
+static struct session *lookup(sessions_t *ss,
+                              const char *user,
+                              const char *base)
+{
+    char *key = make_key(user, base);
+    struct session *s = hash_find(ss->h, key);
+
+    xfree(key);
+    return s;
+}
+
+const char *sessions_token(sessions_t *ss, const char *user, const char *base)
+{
+    struct session *s = lookup(ss, user, base);
+
+    return s ? s->token : NULL;
+}
+
+void sessions_clear(sessions_t *ss, const char *user, const char *base)
+{
+    char *key = make_key(user, base);
+
+    session_destroy(hash_remove(ss->h, key));
+    xfree(key);
+}
+
+void sessions_set(sessions_t *ss,
+                  const char *user,
+                  const char *base,
+                  const char *token,
+                  const char *location)
+{
+    struct session *s = (struct session *)xmalloc(sizeof(*s));
+
+    /* copy first, args may point into the session being replaced */
+    s->key = make_key(user, base);
+    s->user = xstrdup(user);
+    s->base = xstrdup(base);
+    s->token = xstrdup(token);
+    if (location)
+        s->location = xstrdup(location);
+
+    sessions_clear(ss, user, base);
+    if (!hash_insert(ss->h, s->key, s))
+        err_exit(true, "hash_insert");
+}
+
+static int for_each_cb(void *data, void *arg)
+{
+    struct session *s = data;
+    struct for_each_arg *fa = arg;
+
+    fa->fn(s->user, s->base, s->token, s->location, fa->arg);
+    return 1;
+}
+
+void sessions_for_each(sessions_t *ss, sessions_for_each_f fn, void *arg)
+{
+    struct for_each_arg fa = { .fn = fn, .arg = arg };
+
+    hash_for_each(ss->h, for_each_cb, &fa);
+}
+
+int sessions_load(sessions_t *ss, const char *path)
+{
+    FILE *fp;
+    char buf[4096];
+
+    if (!(fp = fopen(path, "r"))) {
+        if (errno == ENOENT)
+            return 0;
+        return -1;
+    }
+    while (fgets(buf, sizeof(buf), fp)) {
+        char *user, *base, *token, *location;
+        char *saveptr;
+
+        if (!(user = strtok_r(buf, " \t\r\n", &saveptr))
+            || !(base = strtok_r(NULL, " \t\r\n", &saveptr))
+            || !(token = strtok_r(NULL, " \t\r\n", &saveptr)))
+            continue;
+        location = strtok_r(NULL, " \t\r\n", &saveptr);
+        if (location && strcmp(location, SESSIONS_NO_LOCATION) == 0)
+            location = NULL;
+        sessions_set(ss, user, base, token, location);
+    }
+    if (ferror(fp)) {
+        int saved_errno = errno;
+        fclose(fp);
+        errno = saved_errno;
+        return -1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int save_cb(void *data, void *arg)
+{
+    struct session *s = data;
+    FILE *fp = arg;
+
+    fprintf(fp, "%s %s %s %s\n",
+            s->user,
+            s->base,
+            s->token,
+            s->location ? s->location : SESSIONS_NO_LOCATION);
+    return 1;
+}
+
+int sessions_save(sessions_t *ss, const char *path)
+{
+    char *tmp = xmalloc(strlen(path) + 5);
+    FILE *fp;
+    int fd;
+    int saved_errno;
+
+    /* write new file and rename, so a crash can't leave it truncated */
+    sprintf(tmp, "%s.tmp", path);
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+        goto error;
+    if (!(fp = fdopen(fd, "w"))) {
+        close(fd);
+        goto error_unlink;
+    }
+    hash_for_each(ss->h, save_cb, fp);
+    if (fclose(fp) != 0)
+        goto error_unlink;
+    if (rename(tmp, path) < 0)
+        goto error_unlink;
+    xfree(tmp);
+    return 0;
+
+error_unlink:
+    saved_errno = errno;
+    (void)unlink(tmp);
+    errno = saved_errno;
+error:
+    saved_errno = errno;
+    xfree(tmp);
+    errno = saved_errno;
+    return -1;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
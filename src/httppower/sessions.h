@@ -0,0 +1,60 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef HTTPPOWER_SESSIONS_H
+#define HTTPPOWER_SESSIONS_H
+
+/* Cache of Redfish session tokens (X-Auth-Token) keyed by user and
+ * base url, optionally saved to / loaded from a file so they survive
+ * a restart.
+ */
+
+typedef struct sessions sessions_t;
+
+typedef void (*sessions_for_each_f)(const char *user,
+                                    const char *base,
+                                    const char *token,
+                                    const char *location,
+                                    void *arg);
+
+sessions_t *sessions_create(void);
+
+void sessions_destroy(sessions_t *ss);
+
+/* token for user at base, NULL if none */
+const char *sessions_token(sessions_t *ss, const char *user, const char *base);
+
+/* set token (and session location, may be NULL) for user at base */
+void sessions_set(sessions_t *ss,
+                  const char *user,
+                  const char *base,
+                  const char *token,
+                  const char *location);
+
+/* forget token for user at base */
+void sessions_clear(sessions_t *ss, const char *user, const char *base);
+
+void sessions_for_each(sessions_t *ss, sessions_for_each_f fn, void *arg);
+
+/* load tokens from path, adding to those already cached.  A missing
+ * file is not an error.  Returns -1 with errno set on error.
+ */
+int sessions_load(sessions_t *ss, const char *path);
+
+/* save all tokens to path, readable only by the owner.  Returns -1
+ * with errno set on error.
+ */
+int sessions_save(sessions_t *ss, const char *path);
+
+#endif /* HTTPPOWER_SESSIONS_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
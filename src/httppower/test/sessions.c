@@ -0,0 +1,189 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/*
+ * Test driver for sessions
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tap.h"
+#include "sessions.h"
+
+static int count;
+
+static void count_cb(const char *user,
+                     const char *base,
+                     const char *token,
+                     const char *location,
+                     void *arg)
+{
+    count++;
+}
+
+static void basic_tests(void)
+{
+    sessions_t *ss;
+    const char *token;
+
+    if (!(ss = sessions_create()))
+        BAIL_OUT("sessions_create failed");
+
+    ok(sessions_token(ss, "root", "https://n0/redfish/v1") == NULL,
+       "sessions_token returns NULL on empty cache");
+
+    sessions_set(ss, "root", "https://n0/redfish/v1", "abc", NULL);
+    sessions_set(ss, "root", "https://n1/redfish/v1", "def",
+                 "/redfish/v1/SessionService/Sessions/1");
+    sessions_set(ss, "admin", "https://n0/redfish/v1", "ghi", NULL);
+
+    token = sessions_token(ss, "root", "https://n0/redfish/v1");
+    ok(token != NULL && strcmp(token, "abc") == 0,
+       "sessions_token returns token for user and base");
+    token = sessions_token(ss, "admin", "https://n0/redfish/v1");
+    ok(token != NULL && strcmp(token, "ghi") == 0,
+       "sessions_token keys on user too");
+
+    token = sessions_token(ss, "root", "https://n0/redfish/v1");
+    sessions_set(ss, "root", "https://n0/redfish/v1", token, NULL);
+    token = sessions_token(ss, "root", "https://n0/redfish/v1");
+    ok(token != NULL && strcmp(token, "abc") == 0,
+       "sessions_set works with args from the entry being replaced");
+
+    sessions_set(ss, "root", "https://n0/redfish/v1", "xyz", NULL);
+    token = sessions_token(ss, "root", "https://n0/redfish/v1");
+    ok(token != NULL && strcmp(token, "xyz") == 0,
+       "sessions_set replaces token");
+
+    count = 0;
+    sessions_for_each(ss, count_cb, NULL);
+    ok(count == 3, "sessions_for_each visits each session");
+
+    sessions_clear(ss, "root", "https://n0/redfish/v1");
+    ok(sessions_token(ss, "root", "https://n0/redfish/v1") == NULL,
+       "sessions_clear removes token");
+    sessions_clear(ss, "root", "https://n0/redfish/v1");
+    ok(sessions_token(ss, "admin", "https://n0/redfish/v1") != NULL,
+       "sessions_clear of missing token is harmless");
+
+    sessions_destroy(ss);
+}
+
+struct location_arg {
+    const char *base;
+    const char *location;
+    int found;
+};
+
+static void location_cb(const char *user,
+                        const char *base,
+                        const char *token,
+                        const char *location,
+                        void *arg)
+{
+    struct location_arg *la = arg;
+
+    if (strcmp(base, la->base) == 0) {
+        la->location = location;
+        la->found = 1;
+    }
+}
+
+static int check_location(sessions_t *ss, const char *base, const char *exp)
+{
+    struct location_arg la = { .base = base };
+
+    sessions_for_each(ss, location_cb, &la);
+    if (!la.found)
+        return 0;
+    if (!exp || !la.location)
+        return exp == la.location;
+    return strcmp(exp, la.location) == 0;
+}
+
+static void file_tests(void)
+{
+    char path[] = "/tmp/sessions-test.XXXXXX";
+    sessions_t *ss;
+    struct stat sb;
+    const char *token;
+    FILE *fp;
+    int fd;
+
+    if ((fd = mkstemp(path)) < 0)
+        BAIL_OUT("mkstemp failed");
+    close(fd);
+    unlink(path);
+
+    if (!(ss = sessions_create()))
+        BAIL_OUT("sessions_create failed");
+    ok(sessions_load(ss, path) == 0,
+       "sessions_load of missing file works");
+
+    sessions_set(ss, "root", "https://n0/redfish/v1", "abc", NULL);
+    sessions_set(ss, "root", "https://n1/redfish/v1", "def",
+                 "/redfish/v1/SessionService/Sessions/1");
+    ok(sessions_save(ss, path) == 0,
+       "sessions_save works");
+    ok(stat(path, &sb) == 0 && (sb.st_mode & 0777) == 0600,
+       "saved file is only readable by owner");
+    sessions_destroy(ss);
+
+    if (!(ss = sessions_create()))
+        BAIL_OUT("sessions_create failed");
+    ok(sessions_load(ss, path) == 0,
+       "sessions_load works");
+    token = sessions_token(ss, "root", "https://n0/redfish/v1");
+    ok(token != NULL && strcmp(token, "abc") == 0,
+       "loaded first token");
+    token = sessions_token(ss, "root", "https://n1/redfish/v1");
+    ok(token != NULL && strcmp(token, "def") == 0,
+       "loaded second token");
+    ok(check_location(ss, "https://n0/redfish/v1", NULL),
+       "missing location is loaded as NULL");
+    ok(check_location(ss, "https://n1/redfish/v1",
+                      "/redfish/v1/SessionService/Sessions/1"),
+       "location is loaded");
+    sessions_destroy(ss);
+
+    if (!(fp = fopen(path, "w")))
+        BAIL_OUT("fopen failed");
+    fprintf(fp, "root https://n0/redfish/v1\n");
+    fprintf(fp, "\n");
+    fprintf(fp, "root https://n1/redfish/v1 def -\n");
+    fclose(fp);
+    if (!(ss = sessions_create()))
+        BAIL_OUT("sessions_create failed");
+    ok(sessions_load(ss, path) == 0
+       && sessions_token(ss, "root", "https://n0/redfish/v1") == NULL
+       && sessions_token(ss, "root", "https://n1/redfish/v1") != NULL,
+       "sessions_load skips malformed lines");
+    sessions_destroy(ss);
+
+    unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+    plan(NO_PLAN);
+
+    basic_tests();
+    file_tests();
+
+    done_testing();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,110 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <string.h>
+#include <assert.h>
+#include <stddef.h>
+
+#include "xmalloc.h"
+#include "arena.h"
+
+/* same alignment as malloc */
+#define ARENA_ALIGN         (2 * sizeof(size_t))
+#define ARENA_ROUND(n)      (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_MAX_CHUNK     (1024*1024)
+
+struct chunk {
+    struct chunk *next;
+    int size;                   /* bytes available after the header */
+    int used;
+};
+
+struct arena {
+    struct chunk *chunks;       /* chunk being filled is first */
+    int next_size;              /* size of the next chunk */
+    struct chunk *first;        /* allocated along with the arena */
+};
+
+#define CHUNK_HDR           ARENA_ROUND(sizeof(struct chunk))
+#define ARENA_HDR           ARENA_ROUND(sizeof(struct arena))
+#define CHUNK_DATA(c)       ((char *)(c) + CHUNK_HDR)
+
+arena_t arena_create(int size)
+{
+    arena_t a;
+
+    assert(size > 0);
+    size = ARENA_ROUND(size);
+    a = (arena_t)xmalloc(ARENA_HDR + CHUNK_HDR + size);
+    a->first = (struct chunk *)((char *)a + ARENA_HDR);
+    a->first->size = size;
+    a->chunks = a->first;
+    a->next_size = size < ARENA_MAX_CHUNK / 2 ? size * 2 : ARENA_MAX_CHUNK;
+    return a;
+}
+
+void arena_destroy(arena_t a)
+{
+    struct chunk *c;
+
+    while ((c = a->chunks)) {
+        a->chunks = c->next;
+        if (c != a->first)
+            xfree(c);
+    }
+    xfree(a);
+}
+
+static struct chunk *_chunk_create(int size)
+{
+    struct chunk *c = (struct chunk *)xmalloc(CHUNK_HDR + size);
+
+    c->size = size;
+    return c;
+}
+
+void *arena_alloc(arena_t a, int size)
+{
+    struct chunk *c = a->chunks;
+    void *p;
+
+    size = ARENA_ROUND(size);
+    if (c->size - c->used < size) {
+        if (size > a->next_size / 4) {
+            /* give a big object its own chunk, and keep filling this one */
+            c = _chunk_create(size);
+            c->next = a->chunks->next;
+            a->chunks->next = c;
+        } else {
+            c = _chunk_create(a->next_size);
+            c->next = a->chunks;
+            a->chunks = c;
+            if (a->next_size < ARENA_MAX_CHUNK)
+                a->next_size *= 2;
+        }
+    }
+    p = CHUNK_DATA(c) + c->used;
+    c->used += size;
+    return p;
+}
+
+char *arena_strdup(arena_t a, const char *str)
+{
+    int len = strlen(str) + 1;
+
+    return memcpy(arena_alloc(a, len), str, len);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
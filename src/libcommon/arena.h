@@ -0,0 +1,36 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/*
+ * An arena hands out memory for a group of objects that are freed
+ * together.  Memory comes from chunks obtained with xmalloc(), the first
+ * of 'size' bytes and each later one twice as big (up to a limit), so
+ * building an object graph costs a few allocations rather than one per
+ * object.  Individual objects cannot be freed.
+ */
+
+#ifndef PM_ARENA_H
+#define PM_ARENA_H
+
+typedef struct arena *arena_t;
+
+arena_t     arena_create(int size);
+void        arena_destroy(arena_t a);
+
+/* Return 'size' bytes of zeroed memory, aligned for any type.
+ */
+void       *arena_alloc(arena_t a, int size);
+char       *arena_strdup(arena_t a, const char *str);
+
+#endif /* PM_ARENA_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
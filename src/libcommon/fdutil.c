@@ -40,6 +40,17 @@ void nonblock_clr(int fd)
         err_exit(true, "fcntl F_SETFL");
 }
 
+void cloexec_set(int fd)
+{
+    int flags;
+
+    flags = fcntl(fd, F_GETFD, 0);
+    if (flags < 0)
+        err_exit(true, "fcntl F_GETFD");
+    if (fcntl(fd, F_SETFD, flags | FD_CLOEXEC) < 0)
+        err_exit(true, "fcntl F_SETFD");
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
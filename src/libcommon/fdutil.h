@@ -13,6 +13,7 @@
 
 void nonblock_set(int fd);
 void nonblock_clr(int fd);
+void cloexec_set(int fd);
 
 #endif /* PM_FDUTIL_H */
 
@@ -0,0 +1,110 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tap.h"
+#include "xmalloc.h"
+#include "arena.h"
+
+static void
+get_counts(long *bytes, long *objs, unsigned long *allocs)
+{
+    xmem_get(XMEM_OTHER, bytes, objs, allocs);
+}
+
+int
+main(int argc, char *argv[])
+{
+    arena_t a;
+    long bytes, objs;
+    unsigned long allocs, allocs0;
+    char *s, *p[1000];
+    int i, aligned, zeroed, intact;
+
+    xmem_enable();
+    plan(NO_PLAN);
+
+    a = arena_create(64);
+    ok (a != NULL,
+        "arena_create works");
+    get_counts(&bytes, &objs, &allocs0);
+    ok (objs == 1,
+        "the arena and its first chunk are one allocation");
+
+    s = arena_strdup(a, "foo");
+    is (s, "foo",
+        "arena_strdup copies the string");
+    p[0] = arena_alloc(a, 24);
+    ok (p[0] != NULL && (uintptr_t)p[0] % sizeof(void *) == 0,
+        "arena_alloc returns aligned memory");
+    get_counts(&bytes, &objs, &allocs);
+    ok (allocs == allocs0,
+        "small objects fit in the first chunk");
+    arena_destroy(a);
+    get_counts(&bytes, &objs, &allocs);
+    ok (bytes == 0 && objs == 0,
+        "arena_destroy frees everything");
+
+    a = arena_create(64);
+    get_counts(&bytes, &objs, &allocs0);
+    aligned = zeroed = 1;
+    for (i = 0; i < 1000; i++) {
+        int j;
+
+        p[i] = arena_alloc(a, 1 + i % 40);
+        if ((uintptr_t)p[i] % (2 * sizeof(size_t)) != 0)
+            aligned = 0;
+        for (j = 0; j < 1 + i % 40; j++) {
+            if (p[i][j] != 0)
+                zeroed = 0;
+        }
+        memset(p[i], i & 0xff, 1 + i % 40);
+    }
+    ok (aligned,
+        "1000 objects are aligned");
+    ok (zeroed,
+        "1000 objects are zeroed");
+    intact = 1;
+    for (i = 0; i < 1000; i++) {
+        int j;
+
+        for (j = 0; j < 1 + i % 40; j++) {
+            if (p[i][j] != (char)(i & 0xff))
+                intact = 0;
+        }
+    }
+    ok (intact,
+        "objects do not overlap");
+    get_counts(&bytes, &objs, &allocs);
+    diag ("1000 objects took %lu allocations", allocs - allocs0);
+    ok (allocs - allocs0 < 20,
+        "chunks grow so 1000 objects take few allocations");
+
+    s = arena_alloc(a, 100000);
+    memset(s, 1, 100000);
+    p[0] = arena_alloc(a, 8);
+    ok (p[0] != NULL,
+        "a big object gets its own chunk");
+    arena_destroy(a);
+    get_counts(&bytes, &objs, &allocs);
+    ok (bytes == 0 && objs == 0,
+        "arena_destroy frees every chunk");
+
+    done_testing();
+    exit(0);
+}
+
+// vi:ts=4 sw=4 expandtab
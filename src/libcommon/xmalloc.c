@@ -15,39 +15,174 @@
 #include <errno.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "xmalloc.h"
 #include "error.h"
 
+#define XMEM_MAGIC      0xf00fbaa5
+
+/* Header prepended to each block when accounting is enabled.
+ * Its size keeps the caller's memory 16-byte aligned.
+ */
+typedef struct {
+    uint64_t size;
+    unsigned int magic;
+    unsigned int tag;
+} xmem_hdr_t;
+
+typedef struct {
+    long bytes;
+    long objs;
+    unsigned long allocs;
+} xmem_count_t;
+
+static bool xmem_on = false;
+static xmem_tag_t xmem_tag = XMEM_OTHER;
+static xmem_count_t xmem_counts[XMEM_NTAGS];
+
+static const char *xmem_names[XMEM_NTAGS] = {
+    "other", "client", "device", "action", "arglist",
+    "hostlist", "cbuf", "regex",
+};
+
+void xmem_enable(void)
+{
+    xmem_on = true;
+}
+
+bool xmem_enabled(void)
+{
+    return xmem_on;
+}
+
+xmem_tag_t xmem_tag_set(xmem_tag_t tag)
+{
+    xmem_tag_t old = xmem_tag;
+
+    assert(tag < XMEM_NTAGS);
+    xmem_tag = tag;
+    return old;
+}
+
+void xmem_account(xmem_tag_t tag, long bytes, int objs)
+{
+    assert(tag < XMEM_NTAGS);
+    xmem_counts[tag].bytes += bytes;
+    xmem_counts[tag].objs += objs;
+}
+
+void xmem_get(xmem_tag_t tag, long *bytes, long *objs, unsigned long *allocs)
+{
+    assert(tag < XMEM_NTAGS);
+    *bytes = xmem_counts[tag].bytes;
+    *objs = xmem_counts[tag].objs;
+    *allocs = xmem_counts[tag].allocs;
+}
+
+const char *xmem_tag_name(xmem_tag_t tag)
+{
+    assert(tag < XMEM_NTAGS);
+    return xmem_names[tag];
+}
+
+int xmemory(void)
+{
+    long total = 0;
+    int i;
+
+    for (i = 0; i < XMEM_NTAGS; i++)
+        total += xmem_counts[i].bytes;
+    return total;
+}
+
+/* Called by liblsd (built with WITH_LSD_MEM_ACCOUNT_FUNC) as hostlists
+ * and cbufs are allocated and freed.
+ */
+void lsd_mem_account(char *type, long bytes, int objs)
+{
+    xmem_tag_t tag = type[0] == 'c' ? XMEM_CBUF : XMEM_HOSTLIST;
+
+    xmem_account(tag, bytes, objs);
+    if (bytes > 0)
+        xmem_counts[tag].allocs++;
+}
+
+static xmem_hdr_t *_hdr(void *ptr)
+{
+    xmem_hdr_t *hdr = (xmem_hdr_t *)ptr - 1;
+
+    if (hdr->magic != XMEM_MAGIC)
+        err_exit(false, "xmalloc: freeing unknown block %p", ptr);
+    return hdr;
+}
+
 char *xmalloc(int size)
 {
     char *new;
+    xmem_hdr_t *hdr;
 
-    if (!(new = calloc(1, size)))
+    if (!xmem_on) {
+        if (!(new = calloc(1, size)))
+            err_exit(false, "out of memory");
+        return new;
+    }
+    if (!(hdr = calloc(1, sizeof(*hdr) + size)))
         err_exit(false, "out of memory");
-    return new;
+    hdr->size = size;
+    hdr->magic = XMEM_MAGIC;
+    hdr->tag = xmem_tag;
+    xmem_account(xmem_tag, size, 1);
+    xmem_counts[xmem_tag].allocs++;
+    return (char *)(hdr + 1);
 }
 
 char *xrealloc(char *item , int newsize)
 {
     char *new;
+    xmem_hdr_t *hdr;
 
-    if (!(new = realloc(item, newsize)))
+    if (!xmem_on) {
+        if (!(new = realloc(item, newsize)))
+            err_exit(false, "out of memory");
+        return new;
+    }
+    if (!item)
+        return xmalloc(newsize);
+    hdr = _hdr(item);
+    if (!(hdr = realloc(hdr, sizeof(*hdr) + newsize)))
         err_exit(false, "out of memory");
-    return new;
+    xmem_account(hdr->tag, (long)newsize - (long)hdr->size, 0);
+    xmem_counts[hdr->tag].allocs++;
+    hdr->size = newsize;
+    return (char *)(hdr + 1);
 }
 
 void xfree(void *ptr)
 {
-    free(ptr);
+    xmem_hdr_t *hdr;
+
+    if (!xmem_on || !ptr) {
+        free(ptr);
+        return;
+    }
+    hdr = _hdr(ptr);
+    xmem_account(hdr->tag, -(long)hdr->size, -1);
+    hdr->magic = 0;
+    free(hdr);
 }
 
 char *xstrdup(const char *str)
 {
     char *cpy;
 
-    if (!(cpy = strdup(str)))
-        err_exit(false, "out of memory");
+    if (!xmem_on) {
+        if (!(cpy = strdup(str)))
+            err_exit(false, "out of memory");
+        return cpy;
+    }
+    cpy = xmalloc(strlen(str) + 1);
+    strcpy(cpy, str);
     return cpy;
 }
 
@@ -11,10 +11,51 @@
 #ifndef PM_XMALLOC_H
 #define PM_XMALLOC_H
 
+#include <stdbool.h>
+
+/* Subsystems that allocations are charged to.
+ */
+typedef enum {
+    XMEM_OTHER,
+    XMEM_CLIENT,
+    XMEM_DEVICE,
+    XMEM_ACTION,
+    XMEM_ARGLIST,
+    XMEM_HOSTLIST,
+    XMEM_CBUF,
+    XMEM_REGEX,
+    XMEM_NTAGS,
+} xmem_tag_t;
+
 char *xmalloc(int size);
 char *xrealloc(char *item, int newsize);
 void xfree(void *ptr);
 char *xstrdup(const char *str);
+
+/* Turn on per-subsystem accounting of xmalloc'd memory.  Each block gets a
+ * small header recording its size and tag, so this must be called before
+ * the first allocation, and memory from xmalloc() must not be passed to
+ * free() or vice versa.
+ */
+void xmem_enable(void);
+bool xmem_enabled(void);
+
+/* Set the tag charged for subsequent allocations, returning the old one.
+ */
+xmem_tag_t xmem_tag_set(xmem_tag_t tag);
+
+/* Adjust counts for memory allocated outside of xmalloc().
+ */
+void xmem_account(xmem_tag_t tag, long bytes, int objs);
+
+/* Get live bytes and objects for 'tag', and the number of allocations
+ * charged to it so far.
+ */
+void xmem_get(xmem_tag_t tag, long *bytes, long *objs, unsigned long *allocs);
+const char *xmem_tag_name(xmem_tag_t tag);
+
+/* Return total live bytes over all tags.
+ */
 int xmemory(void);
 
 #endif /* PM_XMALLOC_H */
@@ -37,9 +37,11 @@ struct xregex_match_struct {
 xregex_t
 xregex_create(void)
 {
+    xmem_tag_t tag = xmem_tag_set(XMEM_REGEX);
     xregex_t xrp = (xregex_t)xmalloc(sizeof(struct xregex_struct));
 
     xrp->xr_regex = NULL;
+    xmem_tag_set(tag);
 
     return xrp;
 }
@@ -77,6 +79,7 @@ xregex_compile(xregex_t xrp, const char *regex, bool withsub)
     char tmpstr[256];
     char *cpy;
     int n;
+    xmem_tag_t tag;
 
     assert(regex != NULL);
     assert(xrp->xr_regex == NULL);
@@ -89,6 +92,7 @@ xregex_compile(xregex_t xrp, const char *regex, bool withsub)
     if (strlen(regex) > 256)
         err_exit(false, "refusing to compile regex > 256 bytes");
 
+    tag = xmem_tag_set(XMEM_REGEX);
     xrp->xr_regex = (regex_t *)xmalloc(sizeof(regex_t));
     xrp->xr_cflags = REG_EXTENDED;
     if (!withsub)
@@ -99,6 +103,7 @@ xregex_compile(xregex_t xrp, const char *regex, bool withsub)
     _str_subst(cpy, strlen(cpy) + 1, "\\n", "\n");
     n = regcomp(xrp->xr_regex, cpy, xrp->xr_cflags);
     xfree(cpy);
+    xmem_tag_set(tag);
 
     if (n != 0) {
         regerror(n, xrp->xr_regex, tmpstr, sizeof(tmpstr));
@@ -123,9 +128,12 @@ xregex_exec(xregex_t xrp, const char *s, xregex_match_t xm)
         xm->xm_result = res;
         xm->xm_used = true;
         if (res == 0) {
+            xmem_tag_t tag = xmem_tag_set(XMEM_REGEX);
+
             if (xm->xm_str)
                 xfree(xm->xm_str);
             xm->xm_str = xstrdup(s);
+            xmem_tag_set(tag);
         }
     }
     return res == 0 ? true : false;
@@ -135,6 +143,7 @@ xregex_match_t
 xregex_match_create(int nmatch)
 {
     xregex_match_t xm;
+    xmem_tag_t tag = xmem_tag_set(XMEM_REGEX);
 
     xm = (xregex_match_t)xmalloc(sizeof(struct xregex_match_struct));
     xm->xm_nmatch = nmatch + 1;
@@ -142,6 +151,7 @@ xregex_match_create(int nmatch)
     xm->xm_str = NULL;
     xm->xm_result = -1;
     xm->xm_used = false;
+    xmem_tag_set(tag);
     return xm;
 }
 
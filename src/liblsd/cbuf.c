@@ -74,6 +74,20 @@
 #endif /* !WITH_LSD_NOMEM_ERROR_FUNC */
 
 
+/*****************************************************************************
+ *  lsd_mem_account
+ *****************************************************************************/
+
+#ifdef WITH_LSD_MEM_ACCOUNT_FUNC
+#  undef lsd_mem_account
+   extern void lsd_mem_account (char *type, long bytes, int objs);
+#else /* !WITH_LSD_MEM_ACCOUNT_FUNC */
+#  ifndef lsd_mem_account
+#    define lsd_mem_account(type, bytes, objs)
+#  endif /* !lsd_mem_account */
+#endif /* !WITH_LSD_MEM_ACCOUNT_FUNC */
+
+
 /*****************************************************************************
  *  Constants
  *****************************************************************************/
@@ -242,6 +256,7 @@ cbuf_create (int minsize, int maxsize)
         errno = ENOMEM;
         return (lsd_nomem_error (__FILE__, __LINE__, "cbuf data"));
     }
+    lsd_mem_account ("cbuf", sizeof (struct cbuf) + cb->alloc, 1);
     cbuf_mutex_init (cb);
     cb->minsize = minsize;
     cb->maxsize = (maxsize > minsize) ? maxsize : minsize;
@@ -293,6 +308,7 @@ cbuf_destroy (cbuf_t cb)
 #endif /* !NDEBUG */
 
     free (cb->data);
+    lsd_mem_account ("cbuf", -(long) (sizeof (struct cbuf) + cb->alloc), -1);
     cbuf_mutex_unlock (cb);
     cbuf_mutex_destroy (cb);
     free (cb);
@@ -306,12 +322,32 @@ cbuf_flush (cbuf_t cb)
     assert (cb != NULL);
     cbuf_mutex_lock (cb);
     assert (cbuf_is_valid (cb));
-    /*
-     *  FIXME: Shrink buffer back to minimum size.
-     */
     cb->used = 0;
     cb->got_wrap = 0;
     cb->i_in = cb->i_out = cb->i_rep = 0;
+    /*
+     *  Shrink buffer back to minimum size.  There is no data to preserve,
+     *    so this is just a realloc.  If that fails, keep the bigger buffer.
+     */
+    if (cb->size > cb->minsize) {
+        unsigned char *data = cb->data;
+        int size_meta = cb->alloc - cb->size;
+        int m = cb->minsize + size_meta;
+#ifndef NDEBUG
+        data -= CBUF_MAGIC_LEN;
+#endif /* !NDEBUG */
+        if ((data = realloc (data, m))) {
+            lsd_mem_account ("cbuf", m - cb->alloc, 0);
+            cb->data = data;
+            cb->alloc = m;
+            cb->size = cb->minsize;
+#ifndef NDEBUG
+            cb->data += CBUF_MAGIC_LEN;
+            memcpy (cb->data + cb->size + 1, (void *) &cb->magic,
+                CBUF_MAGIC_LEN);
+#endif /* !NDEBUG */
+        }
+    }
     assert (cbuf_is_valid (cb));
     cbuf_mutex_unlock (cb);
     return;
@@ -1688,6 +1724,7 @@ cbuf_grow (cbuf_t cb, int n)
          */
         return (0);                     /* unable to grow data buffer */
     }
+    lsd_mem_account ("cbuf", m - cb->alloc, 0);
     cb->data = data;
     cb->alloc = m;
     cb->size = m - size_meta;
@@ -98,6 +98,7 @@ void cbuf_destroy (cbuf_t cb);
 void cbuf_flush (cbuf_t cb);
 /*
  *  Flushes all data (including replay data) in [cb].
+ *  A buffer that has grown is shrunk back to its minimum size.
  */
 
 int cbuf_size (cbuf_t cb);
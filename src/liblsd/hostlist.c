@@ -76,6 +76,19 @@
 #  endif /* !lsd_nomem_error */
 #endif /* !WITH_LSD_NOMEM_ERROR_FUNC */
 
+/*
+ * lsd_mem_account : report bytes and objects allocated (or freed, if
+ * negative) so the caller can keep per-type usage counts
+ */
+#ifdef WITH_LSD_MEM_ACCOUNT_FUNC
+#  undef lsd_mem_account
+   extern void lsd_mem_account(char *type, long bytes, int objs);
+#else /* !WITH_LSD_MEM_ACCOUNT_FUNC */
+#  ifndef lsd_mem_account
+#    define lsd_mem_account(type, bytes, objs)
+#  endif /* !lsd_mem_account */
+#endif /* !WITH_LSD_MEM_ACCOUNT_FUNC */
+
 /*
  * OOM helper function
  *  Automatically call lsd_nomem_error with appropriate args
@@ -578,6 +591,7 @@ static hostrange_t hostrange_create_single(const char *prefix)
 
     if ((new->prefix = strdup(prefix)) == NULL)
         goto error2;
+    lsd_mem_account("hostlist", sizeof(*new) + strlen(prefix) + 1, 0);
 
     new->singlehost = 1;
     new->lo = 0L;
@@ -607,6 +621,7 @@ hostrange_create(char *prefix, unsigned long lo, unsigned long hi, int width)
 
     if ((new->prefix = strdup(prefix)) == NULL)
         goto error2;
+    lsd_mem_account("hostlist", sizeof(*new) + strlen(prefix) + 1, 0);
 
     new->lo = lo;
     new->hi = hi;
@@ -654,8 +669,9 @@ static void hostrange_destroy(hostrange_t hr)
 {
     if (hr == NULL)
         return;
-    if (hr->prefix)
-        free(hr->prefix);
+    lsd_mem_account("hostlist", -(long)(sizeof(*hr) + strlen(hr->prefix) + 1),
+                    0);
+    free(hr->prefix);
     free(hr);
 }
 
@@ -1075,6 +1091,8 @@ static hostlist_t hostlist_new(void)
         new->hr[i] = NULL;
 
     new->size = HOSTLIST_CHUNK;
+    lsd_mem_account("hostlist",
+                    sizeof(*new) + HOSTLIST_CHUNK * sizeof(hostrange_t), 1);
     new->nranges = 0;
     new->nhosts = 0;
     new->ilist = NULL;
@@ -1105,6 +1123,8 @@ static int hostlist_resize(hostlist_t hl, size_t newsize)
     hl->hr = realloc((void *) hl->hr, hl->size*sizeof(hostrange_t));
     if (!(hl->hr))
         return 0;
+    lsd_mem_account("hostlist",
+                    ((long)newsize - (long)oldsize) * (long)sizeof(hostrange_t), 0);
 
     for (i = oldsize; i < newsize; i++)
         hl->hr[i] = NULL;
@@ -1598,6 +1618,8 @@ void hostlist_destroy(hostlist_t hl)
     for (i = 0; i < hl->nranges; i++)
         hostrange_destroy(hl->hr[i]);
     free(hl->hr);
+    lsd_mem_account("hostlist",
+                    -(long)(sizeof(*hl) + hl->size * sizeof(hostrange_t)), -1);
     assert((hl->magic = 0x1));
     UNLOCK_HOSTLIST(hl);
     mutex_destroy(&hl->mutex);
@@ -35,7 +35,10 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <ctype.h>
+#include <time.h>
 #include <sys/time.h>
+#include <errno.h>
+#include <limits.h>
 
 #include "xmalloc.h"
 #include "error.h"
@@ -88,6 +91,20 @@
 
 #define IM_MAX_RECVLEN              28 /* response to send extended msg */
 
+/* Insteon message flags, message type bits */
+#define MSG_TYPE_MASK               0xE0
+#define MSG_TYPE_DIRECT             0x00
+#define MSG_TYPE_DIRECT_ACK         0x20
+#define MSG_TYPE_CLEANUP            0x40
+#define MSG_TYPE_CLEANUP_ACK        0x60
+#define MSG_TYPE_BROADCAST          0x80
+#define MSG_TYPE_DIRECT_NAK         0xA0
+#define MSG_TYPE_ALL_LINK_BROADCAST 0xC0
+#define MSG_TYPE_CLEANUP_NAK        0xE0
+
+/* max Insteon devices in the status cache */
+#define CACHE_SIZE                  256
+
 /* Insteon commands (incomplete) */
 #define CMD_GRP_ASSIGN              0x01
 #define CMD_GRP_DELETE              0x02
@@ -137,6 +154,17 @@ typedef struct {
     char unit;
 } x10addr_t;
 
+/* Last known status of an Insteon device, learned from responses to
+ * our commands and from messages the devices send on their own, e.g.
+ * when switched locally or acking all-link cleanup.
+ */
+typedef struct {
+    insaddr_t addr;
+    char level;                 /* 00 = off */
+    time_t updated;
+    int valid;
+} cache_ent_t;
+
 static void     usage(void);
 static int      open_serial(char *dev);
 static int      run_cmd(int fd, char *cmd);
@@ -149,11 +177,22 @@ static void     plm_on(int fd, char *addrstr);
 static void     plm_off(int fd, char *addrstr);
 static void     plm_status(int fd, char *addrstr);
 static void     plm_ping(int fd, char *addrstr);
+static void     plm_group(int fd, char *groupstr, char cmd1);
+static void     plm_listen(int fd);
+static void     cache_set(insaddr_t *ip, char level);
+static void     cache_forget(insaddr_t *ip);
+static void     cache_flush(void);
+static int      cache_get(insaddr_t *ip, char *levelp);
+static void     cache_update(char *msg);
+static void     cache_list(void);
 
 static int      str2insaddr(char *s, insaddr_t *ip);
 static char    *insaddr2str(insaddr_t *ip);
 static int      str2x10addr(char *s, x10addr_t *xp);
 static int      wait_until_ready(int fd, int timeout_msec);
+static int      plm_msglen(char cmd);
+static void     plm_recv_rest(int fd, char *b);
+static int      plm_recv_msg(int fd, char *b);
 static int      plm_recv(int fd, char cmd, char *recv, int recvlen);
 static void     plm_docmd(int fd, char *send, int sendlen,
                           char *recv, int recvlen);
@@ -166,14 +205,17 @@ static int              testmode = 0;
 static char             test_plug = 0;
 static unsigned long    x10_attempts = 3;
 static int              insteon_tmout = 1000; /* (msec) */
+static int              cache_ttl = 0; /* (sec) */
+static cache_ent_t      cache[CACHE_SIZE];
 
-#define OPTIONS "d:Tx:t:S:"
+#define OPTIONS "d:Tx:t:S:c:"
 static struct option longopts[] = {
     { "device",         required_argument, 0, 'd' },
     { "testmode",       no_argument,       0, 'T' },
     { "x10-attempts",   required_argument, 0, 'x' },
     { "timeout",        required_argument, 0, 't' },
     { "single-cmd",     required_argument, 0, 'S' },
+    { "cache-ttl",      required_argument, 0, 'c' },
     {0,0,0,0},
 };
 
@@ -184,6 +226,8 @@ main(int argc, char *argv[])
     int c;
     int fd = -1;
     char *single_cmd = NULL;
+    unsigned long ttl;
+    char *end;
 
     err_init(basename(argv[0]));
 
@@ -208,6 +252,14 @@ main(int argc, char *argv[])
             case 'S':   /* --single-cmd */
                 single_cmd = strdup(optarg);
                 break;
+            case 'c':   /* --cache-ttl */
+                errno = 0;
+                ttl = strtoul(optarg, &end, 10);
+                if (errno != 0 || end == optarg || *end != '\0'
+                        || *optarg == '-' || ttl > INT_MAX)
+                    err_exit(false, "cache TTL must be 0-%d seconds", INT_MAX);
+                cache_ttl = ttl;
+                break;
             default:
                 usage();
                 break;
@@ -229,7 +281,7 @@ main(int argc, char *argv[])
         shell(fd);
 
 
-    if (close(fd) < 0)
+    if (fd >= 0 && close(fd) < 0)
         err_exit(true, "error closing %s", device);
     exit(0);
 }
@@ -290,9 +342,16 @@ static void shell(int fd)
     char buf[128];
     int quit = 0;
 
+    /* Unbuffered, so polling stdin in plm_listen() can't miss a command
+     * already read into the stdio buffer.
+     */
+    if (!testmode)
+        setvbuf(stdin, NULL, _IONBF, 0);
     while (!quit) {
         printf("plmpower> ");
         fflush(stdout);
+        if (!testmode)
+            plm_listen(fd);
         if (fgets(buf, sizeof(buf), stdin)) {
             quit = run_cmd(fd, buf);
         } else
@@ -336,6 +395,22 @@ docmd(int fd, char **av, int *quitp)
                 printf("Usage: status addr\n");
             else
                 plm_status(fd, av[1]);
+        } else if (strcmp(av[0], "groupon") == 0) {
+            if (testmode)
+                printf("Unavailable in test mode\n");
+            else if (argv_length(av) != 2)
+                printf("Usage: groupon group\n");
+            else
+                plm_group(fd, av[1], CMD_ON_FAST);
+        } else if (strcmp(av[0], "groupoff") == 0) {
+            if (testmode)
+                printf("Unavailable in test mode\n");
+            else if (argv_length(av) != 2)
+                printf("Usage: groupoff group\n");
+            else
+                plm_group(fd, av[1], CMD_OFF_FAST);
+        } else if (strcmp(av[0], "cache") == 0) {
+            cache_list();
         } else if (strcmp(av[0], "ping") == 0) {
             if (testmode)
                 printf("Unavailable in test mode\n");
@@ -360,6 +435,9 @@ help(void)
     printf("  off    addr      turn on device\n");
     printf("  status addr      query status of device\n");
     printf("  ping   addr      time round trip request/response to device\n");
+    printf("  groupon  group   turn on all-link group (0-255)\n");
+    printf("  groupoff group   turn off all-link group (0-255)\n");
+    printf("  cache            list cached device status\n");
     printf("Where addr is Insteon (e.g. 1A.2B.3C) or X10 (e.g. G12)\n");
 }
 
@@ -383,6 +461,7 @@ plm_on(int fd, char *addrstr)
             } while (!plm_recv_insteon(fd, &i, NULL, &cmd2, insteon_tmout));
             if (cmd2 == 0)
                 err_exit(false, "on command failed");
+            cache_set(&i, cmd2);
         }
     } else if (str2x10addr(addrstr, &x)) {
         if (!testmode)
@@ -411,6 +490,7 @@ plm_off(int fd, char *addrstr)
             } while (!plm_recv_insteon(fd, &i, NULL, &cmd2, insteon_tmout));
             if (cmd2 != 0)
                 err_exit(false, "off command failed");
+            cache_set(&i, cmd2);
         }
     } else if (str2x10addr(addrstr, &x)) {
         if (!testmode)
@@ -421,6 +501,8 @@ plm_off(int fd, char *addrstr)
 
 /* Send the Insteon STATUS command to [addrstr] via PLM on [fd] and print
  * the result on stdout.  Retry the command until a response is received.
+ * If the status cache is enabled and has a fresh entry for the device,
+ * print that instead.
  * X10 addresses are accepted here, but we always report status as "unknown".
  */
 static void
@@ -433,10 +515,11 @@ plm_status(int fd, char *addrstr)
     if (str2insaddr(addrstr, &i)) {
         if (testmode) {
             cmd2 = test_plug;
-        } else {
+        } else if (!cache_get(&i, &cmd2)) {
             do {
                 plm_send_insteon(fd, &i, CMD_STATUS, 0);
             } while (!plm_recv_insteon(fd, &i, NULL, &cmd2, insteon_tmout));
+            cache_set(&i, cmd2);
         }
         printf("%s: %.2hhX\n", addrstr, cmd2);
     } else if (str2x10addr(addrstr, &x))
@@ -477,6 +560,223 @@ plm_ping(int fd, char *addrstr)
         err(false, "could not parse address");
 }
 
+/* Send all-link command [cmd1] to all-link [group] (given as string
+ * [groupstr]) via PLM on [fd], which broadcasts it to the whole group at
+ * once, then follows up with a cleanup message to each member.  Wait for
+ * the PLM to report the cleanup finished, printing any members that
+ * did not respond.  We do not know who the members are, so the whole
+ * status cache is flushed.  Members that ack the cleanup update it again.
+ */
+static void
+plm_group(int fd, char *groupstr, char cmd1)
+{
+    char send[5] = { IM_STX, IM_SEND_ALL_LINK, 0, cmd1, 0 };
+    char recv[6];
+    char b[IM_MAX_RECVLEN];
+    unsigned long group;
+    insaddr_t i;
+    char *end;
+
+    group = strtoul(groupstr, &end, 10);
+    if (end == groupstr || *end != '\0' || group > 255) {
+        err(false, "could not parse group");
+        return;
+    }
+    send[2] = group;
+    cache_flush();
+    plm_docmd(fd, send, sizeof(send), recv, sizeof(recv));
+    for (;;) {
+        if (!wait_until_ready(fd, insteon_tmout)) {
+            printf("group %lu: timeout\n", group);
+            return;
+        }
+        if (plm_recv_msg(fd, b))
+            err_exit(false, "unexpected NAK while waiting for all-link cleanup");
+        switch (b[1]) {
+            case IM_RECV_ALL_LINK_FAIL:   /* 02 56 01 group addr */
+                i.h = b[4];
+                i.m = b[5];
+                i.l = b[6];
+                cache_forget(&i);
+                printf("%s: cleanup failed\n", insaddr2str(&i));
+                break;
+            case IM_RECV_ALL_LINK_STAT:   /* 02 58 ACK/NAK */
+                printf("group %lu: %s\n", group,
+                       b[2] == IM_ACK ? "complete" : "failed");
+                return;
+        }
+    }
+}
+
+/* Read messages sent by devices on their own to keep the status cache
+ * up to date, until a command is ready on stdin.
+ */
+static void
+plm_listen(int fd)
+{
+    xpollfd_t pfd = xpollfd_create();
+    char b[IM_MAX_RECVLEN];
+
+    for (;;) {
+        xpollfd_zero(pfd);
+        xpollfd_set(pfd, STDIN_FILENO, XPOLLIN);
+        xpollfd_set(pfd, fd, XPOLLIN);
+        if (xpoll(pfd, NULL) < 0)
+            err_exit(true, "poll");
+        if (xpollfd_revents(pfd, fd))
+            (void)plm_recv_msg(fd, b);
+        else if (xpollfd_revents(pfd, STDIN_FILENO))
+            break;
+    }
+    xpollfd_destroy(pfd);
+}
+
+/* Find the status cache entry for [ip], or NULL if none.
+ */
+static cache_ent_t *
+cache_find(insaddr_t *ip)
+{
+    int n;
+
+    for (n = 0; n < CACHE_SIZE; n++) {
+        if (cache[n].valid
+                && cache[n].addr.h == ip->h
+                && cache[n].addr.m == ip->m
+                && cache[n].addr.l == ip->l)
+            return &cache[n];
+    }
+    return NULL;
+}
+
+/* Set the cached status of [ip] to [level], replacing the least
+ * recently updated entry if the cache is full.
+ */
+static void
+cache_set(insaddr_t *ip, char level)
+{
+    cache_ent_t *e;
+    int n;
+
+    if (!(e = cache_find(ip))) {
+        e = &cache[0];
+        for (n = 0; n < CACHE_SIZE; n++) {
+            if (!cache[n].valid) {
+                e = &cache[n];
+                break;
+            }
+            if (cache[n].updated < e->updated)
+                e = &cache[n];
+        }
+        e->addr = *ip;
+        e->valid = 1;
+    }
+    e->level = level;
+    e->updated = time(NULL);
+}
+
+/* Forget the cached status of [ip].
+ */
+static void
+cache_forget(insaddr_t *ip)
+{
+    cache_ent_t *e;
+
+    if ((e = cache_find(ip)))
+        e->valid = 0;
+}
+
+/* Forget the cached status of all devices.
+ */
+static void
+cache_flush(void)
+{
+    int n;
+
+    for (n = 0; n < CACHE_SIZE; n++)
+        cache[n].valid = 0;
+}
+
+/* If the cache is enabled and the status of [ip] was updated within
+ * cache_ttl seconds, set [*levelp] to it and return 1, else return 0.
+ */
+static int
+cache_get(insaddr_t *ip, char *levelp)
+{
+    cache_ent_t *e;
+
+    if (cache_ttl == 0 || !(e = cache_find(ip)))
+        return 0;
+    if (time(NULL) - e->updated > cache_ttl)
+        return 0;
+    *levelp = e->level;
+    return 1;
+}
+
+/* Update the status cache from Insteon standard message [msg] (as
+ * received from the PLM), if it says a device was turned on or off.
+ * That is, if it is an all-link broadcast or cleanup from a controller
+ * switched locally, or a responder's ack of one of our all-link cleanups.
+ * A controller's group members switch too, but only the controller is
+ * named in the message, so the rest of the cache is flushed.
+ */
+static void
+cache_update(char *msg)
+{
+    insaddr_t i = { msg[2], msg[3], msg[4] };
+    char flags = msg[8];
+    char cmd1 = msg[9];
+    int controller = 0;
+
+    switch (flags & MSG_TYPE_MASK) {
+        case MSG_TYPE_ALL_LINK_BROADCAST:
+        case MSG_TYPE_CLEANUP:
+            controller = 1;
+            break;
+        case MSG_TYPE_CLEANUP_ACK:
+            break;
+        default:
+            return;
+    }
+    switch (cmd1) {
+        case CMD_ON:
+        case CMD_ON_FAST:
+            if (controller)
+                cache_flush();
+            cache_set(&i, 0xff);
+            break;
+        case CMD_OFF:
+        case CMD_OFF_FAST:
+            if (controller)
+                cache_flush();
+            cache_set(&i, 0);
+            break;
+        case CMD_BRIGHT:
+        case CMD_DIM:
+        case CMD_MAN_START:
+        case CMD_MAN_STOP:
+            if (controller)
+                cache_flush();
+            else
+                cache_forget(&i); /* level unknown */
+            break;
+    }
+}
+
+/* List the status cache on stdout.
+ */
+static void
+cache_list(void)
+{
+    time_t now = time(NULL);
+    int n;
+
+    for (n = 0; n < CACHE_SIZE; n++) {
+        if (cache[n].valid)
+            printf("%s: %.2hhX age=%lds\n", insaddr2str(&cache[n].addr),
+                   cache[n].level, (long)(now - cache[n].updated));
+    }
+}
+
 /* Convert a string [s] to Insteon address [ip].
  * Return 1 on success, 0 on failure.
  */
@@ -538,9 +838,72 @@ wait_until_ready(int fd, int timeout_msec)
     return res;
 }
 
+/* Return the length of a message of type [cmd] sent by the PLM
+ * on its own, or -1 if unknown.
+ */
+static int
+plm_msglen(char cmd)
+{
+    switch (cmd) {
+        case IM_RECV_STD:
+            return 11;
+        case IM_RECV_EXT:
+            return 25;
+        case IM_RECV_X10:
+            return 4;
+        case IM_RECV_ALL_LINK_COMPLETE:
+            return 10;
+        case IM_RECV_BUTTON:
+            return 3;
+        case IM_RECV_RESET:
+            return 2;
+        case IM_RECV_ALL_LINK_FAIL:
+            return 7;
+        case IM_RECV_ALL_LINK_REC:
+            return 10;
+        case IM_RECV_ALL_LINK_STAT:
+            return 3;
+    }
+    return -1;
+}
+
+/* Read the rest of a message sent by the PLM on its own into [b],
+ * where the STX and command are already in b[0] and b[1].
+ * Standard Insteon messages are passed to the status cache.
+ */
+static void
+plm_recv_rest(int fd, char *b)
+{
+    int len = plm_msglen(b[1]);
+
+    if (len < 0)
+        err_exit(false, "unexpected command: %.2hhX", b[1]);
+    xread_all(fd, &b[2], len - 2);
+    if (b[1] == IM_RECV_STD)
+        cache_update(b);
+}
+
+/* Receive a message sent by the PLM on [fd] on its own into [b] which
+ * must be IM_MAX_RECVLEN long.  If a NAK is received instead, return 1,
+ * otherwise return 0.
+ */
+static int
+plm_recv_msg(int fd, char *b)
+{
+    xread_all(fd, &b[0], 1);
+    if (b[0] == IM_NAK)
+        return 1;
+    else if (b[0] != IM_STX)
+        err_exit(false, "expected IM_STX or IM_NAK, got %.2hhX", b[0]);
+    xread_all(fd, &b[1], 1);
+    plm_recv_rest(fd, b);
+    return 0;
+}
+
 /* Receive a command or a response from the PLM on [fd] and return it
  * in [recv] of length [recvlen].  If the a command is received which does
- * not match [cmd], silently discard it.  If a NAK is received instead of STX
+ * not match [cmd], discard it after updating the status cache from it.
+ * If a NAK is received instead of STX
  * indicating the PLM was busy when the last command was sent, return 1,
  * otherwise return 0.
  */
@@ -556,37 +919,7 @@ retry:
         err_exit(false, "expected IM_STX or IM_NAK, got %.2hhX", b[0]);
     xread_all(fd, &b[1], 1);
     if (b[1] != cmd) {
-        switch (b[1]) {
-            case IM_RECV_STD:
-                xread_all(fd, &b[2], 9);
-                break;
-            case IM_RECV_EXT:
-                xread_all(fd, &b[2], 23);
-                break;
-            case IM_RECV_X10:
-                xread_all(fd, &b[2], 2);
-                break;
-            case IM_RECV_ALL_LINK_COMPLETE:
-                xread_all(fd, &b[2], 8);
-                break;
-            case IM_RECV_BUTTON:
-                xread_all(fd, &b[2], 1);
-                break;
-            case IM_RECV_RESET:
-                break;
-            case IM_RECV_ALL_LINK_FAIL:
-                xread_all(fd, &b[2], 5);
-                break;
-            case IM_RECV_ALL_LINK_REC:
-                xread_all(fd, &b[2], 8);
-                break;
-            case IM_RECV_ALL_LINK_STAT:
-                xread_all(fd, &b[2], 1);
-                break;
-            default:
-                err_exit(false, "unexpected command: %.2hhX", b[1]);
-                break;
-        }
+        plm_recv_rest(fd, b);
         goto retry;
     }
     xread_all(fd, &b[2], recvlen - 2);
@@ -672,6 +1005,7 @@ plm_recv_insteon(int fd, insaddr_t *ip, char *cmd1, char *cmd2,
         nak = plm_recv(fd, IM_RECV_STD, recv, sizeof(recv));
         if (nak)
             err_exit(false, "unexpected NAK while waiting for Insteon packet");
+        cache_update(recv);
     } while (ip->h != recv[2] || ip->m != recv[3] || ip->l != recv[4]);
     if (cmd1)
         *cmd1 = recv[9];
@@ -14,6 +14,10 @@
  * want to iterate through args in the client in order, we keep the hostlist
  * representation of the nodes in the ArgList, and use it to implement an
  * 'iterator' interface.
+ *
+ * A status query on a large cluster creates an Arg per node, so the
+ * ArgList and everything in it are allocated from an arena sized for the
+ * node count, and released in one go when the last reference is dropped.
  */
 
 #if HAVE_CONFIG_H
@@ -32,6 +36,7 @@
 
 #include "list.h"
 #include "xmalloc.h"
+#include "arena.h"
 #include "hostlist.h"
 #include "hash.h"
 #include "arglist.h"
@@ -41,27 +46,23 @@ struct arglist_iterator {
     ArgList arglist;
 };
 
+/* Arena space to reserve per node: an Arg and a short node name.
+ */
+#define ARGLIST_NODE_SIZE   (sizeof(Arg) + 16)
+#define ARGLIST_ARENA_MAX   (1024*1024)
+
 struct arglist {
+    arena_t arena;              /* holds the arglist, Args, and strings */
     hash_t args;
     hostlist_t hl;
     int refcount;               /* free when refcount == 0 */
 };
 
-static void _destroy_arg(Arg * arg)
-{
-    assert(arg != NULL);
-    assert(arg->node != NULL);
-    xfree(arg->node);
-    if (arg->val)
-        xfree(arg->val);
-    xfree(arg);
-}
-
-static Arg *_create_arg(char *node)
+static Arg *_create_arg(ArgList arglist, char *node)
 {
-    Arg *arg = (Arg *) xmalloc(sizeof(Arg));
+    Arg *arg = (Arg *) arena_alloc(arglist->arena, sizeof(Arg));
 
-    arg->node = xstrdup(node);
+    arg->node = arena_strdup(arglist->arena, node);
     arg->state = ST_UNKNOWN;
     arg->val = NULL;
 
@@ -70,28 +71,34 @@ static Arg *_create_arg(char *node)
 
 ArgList arglist_create(hostlist_t hl)
 {
-    ArgList new = (ArgList) xmalloc(sizeof(struct arglist));
+    xmem_tag_t tag = xmem_tag_set(XMEM_ARGLIST);
+    int hash_size = hostlist_count(hl); /* reasonable? */
+    int size = sizeof(struct arglist) + hash_size * ARGLIST_NODE_SIZE;
+    arena_t arena = arena_create(size < ARGLIST_ARENA_MAX
+                                 ? size : ARGLIST_ARENA_MAX);
+    ArgList new = (ArgList) arena_alloc(arena, sizeof(struct arglist));
     hostlist_iterator_t itr;
     char *node;
-    int hash_size;
 
+    new->arena = arena;
     new->refcount = 1;
-    hash_size = hostlist_count(hl); /* reasonable? */
     new->args = hash_create(hash_size, (hash_key_f)hash_key_string,
-            (hash_cmp_f)strcmp, (hash_del_f)_destroy_arg);
+            (hash_cmp_f)strcmp, NULL);
 
     if ((itr = hostlist_iterator_create(hl)) == NULL) {
         arglist_unlink(new);
+        xmem_tag_set(tag);
         return NULL;
     }
     while ((node = hostlist_next(itr)) != NULL) {
-        Arg *arg = _create_arg(node);
+        Arg *arg = _create_arg(new, node);
 
         hash_insert(new->args, arg->node, arg);
         free(node); /* hostlist_next strdups returned string */
     }
     hostlist_iterator_destroy(itr);
     new->hl = hostlist_copy(hl);
+    xmem_tag_set(tag);
 
     return new;
 }
@@ -101,7 +108,7 @@ void arglist_unlink(ArgList arglist)
     if (--arglist->refcount == 0) {
         hash_destroy(arglist->args);
         hostlist_destroy(arglist->hl);
-        xfree(arglist);
+        arena_destroy(arglist->arena);
     }
 }
 
@@ -112,6 +119,20 @@ ArgList arglist_link(ArgList arglist)
     return arglist;
 }
 
+void arglist_set_val(ArgList arglist, Arg *arg, const char *val)
+{
+    xmem_tag_t tag;
+
+    /* a status query sets the same value over and over */
+    if (arg->val && strlen(arg->val) >= strlen(val)) {
+        strcpy(arg->val, val);
+        return;
+    }
+    tag = xmem_tag_set(XMEM_ARGLIST);
+    arg->val = arena_strdup(arglist->arena, val);
+    xmem_tag_set(tag);
+}
+
 Arg *arglist_find(ArgList arglist, char *node)
 {
     Arg *arg = NULL;
@@ -45,6 +45,10 @@ ArgList          arglist_link(ArgList arglist);
  */
 void             arglist_unlink(ArgList arglist);
 
+/* Set arg->val to a copy of val.  The copy belongs to the ArgList.
+ */
+void             arglist_set_val(ArgList arglist, Arg *arg, const char *val);
+
 /* Search ArgList for an Arg entry that matches node.
  * Return pointer to Arg on success (points to actual list entry),
  * or NULL on search failure.
@@ -0,0 +1,183 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "xmalloc.h"
+#include "error.h"
+#include "debug.h"
+#include "hprintf.h"
+#include "capture.h"
+
+#define CAPTURE_MAGIC   "powerman-capture 1"
+
+struct capture {
+    FILE *fp;
+    char *path;
+    struct timeval last;        /* time of previous record */
+};
+
+static char *capture_dir = NULL;
+
+void capture_init(const char *dir)
+{
+    if (dir)
+        capture_dir = xstrdup(dir);
+}
+
+void capture_fini(void)
+{
+    if (capture_dir) {
+        xfree(capture_dir);
+        capture_dir = NULL;
+    }
+}
+
+Capture capture_create(const char *name)
+{
+    Capture cap;
+    char *fname, *p;
+    int fd;
+
+    if (!capture_dir)
+        return NULL;
+
+    /* device names may contain '/' */
+    fname = xstrdup(name);
+    for (p = fname; *p != '\0'; p++) {
+        if (*p == '/')
+            *p = '_';
+    }
+    cap = (Capture)xmalloc(sizeof(*cap));
+    cap->path = hsprintf("%s/%s.cap", capture_dir, fname);
+    xfree(fname);
+
+    fd = open(cap->path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC,
+              0600);
+    if (fd < 0 || !(cap->fp = fdopen(fd, "w"))) {
+        err(true, "capture: %s", cap->path);
+        if (fd >= 0)
+            (void)close(fd);
+        xfree(cap->path);
+        xfree(cap);
+        return NULL;
+    }
+    fprintf(cap->fp, "%s %s\n", CAPTURE_MAGIC, name);
+    if (gettimeofday(&cap->last, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    dbg(DBG_DEVICE, "capturing %s to %s", name, cap->path);
+    return cap;
+}
+
+void capture_destroy(Capture cap)
+{
+    if (fclose(cap->fp) != 0)
+        err(true, "capture: %s", cap->path);
+    xfree(cap->path);
+    xfree(cap);
+}
+
+void capture_record(Capture cap, CaptureType type, const void *buf, int len)
+{
+    struct timeval now, delta;
+
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    timersub(&now, &cap->last, &delta);
+    cap->last = now;
+
+    fprintf(cap->fp, "%c %lu %d\n", type,
+            (unsigned long)delta.tv_sec * 1000000 + delta.tv_usec, len);
+    if (len > 0)
+        fwrite(buf, 1, len, cap->fp);
+    fputc('\n', cap->fp);
+    /* keep the file usable if powermand dies */
+    if (fflush(cap->fp) != 0)
+        err(true, "capture: %s", cap->path);
+}
+
+CaptureRec *capture_load(const char *path, int *count)
+{
+    FILE *fp;
+    CaptureRec *recs = NULL;
+    int n = 0, size = 0;
+    char line[256];
+    int saved_errno;
+
+    if (!(fp = fopen(path, "r")))
+        return NULL;
+    if (!fgets(line, sizeof(line), fp)
+        || strncmp(line, CAPTURE_MAGIC " ", strlen(CAPTURE_MAGIC) + 1) != 0)
+        goto invalid;
+    while (fgets(line, sizeof(line), fp)) {
+        CaptureRec *r;
+        char type;
+
+        if (n == size) {
+            size += 256;
+            recs = (CaptureRec *)(recs
+                ? xrealloc((char *)recs, size * sizeof(CaptureRec))
+                : xmalloc(size * sizeof(CaptureRec)));
+        }
+        r = &recs[n];
+        if (sscanf(line, "%c %lu %d", &type, &r->usec, &r->len) != 3
+            || r->len < 0)
+            goto invalid;
+        if (type == CAPTURE_WRITE || type == CAPTURE_READ) {
+            if (r->len == 0)
+                goto invalid;
+        } else if (type != CAPTURE_CONNECT && type != CAPTURE_DISCONNECT)
+            goto invalid;
+        r->type = type;
+        r->data = xmalloc(r->len + 1);
+        n++;
+        if ((int)fread(r->data, 1, r->len, fp) != r->len || fgetc(fp) != '\n')
+            goto invalid;
+    }
+    if (ferror(fp)) {
+        saved_errno = errno;
+        goto error;
+    }
+    (void)fclose(fp);
+    *count = n;
+    return recs ? recs : (CaptureRec *)xmalloc(sizeof(CaptureRec));
+invalid:
+    saved_errno = EINVAL;
+error:
+    (void)fclose(fp);
+    capture_free(recs, n);
+    errno = saved_errno;
+    return NULL;
+}
+
+void capture_free(CaptureRec *recs, int count)
+{
+    int i;
+
+    if (!recs)
+        return;
+    for (i = 0; i < count; i++)
+        xfree(recs[i].data);
+    xfree(recs);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,68 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef PM_CAPTURE_H
+#define PM_CAPTURE_H
+
+/* Device session capture.  When powermand is started with --capture-dir,
+ * each device's traffic is appended to DIR/<device>.cap, so a session with
+ * real hardware can be played back later by a "replay:" device.
+ *
+ * A capture file is a header line, "powerman-capture 1 <device>\n",
+ * followed by records of the form "<type> <usec> <len>\n<len bytes>\n".
+ * The type is one of the CaptureType characters below, and usec is the
+ * time elapsed since the previous record.
+ */
+
+typedef enum {
+    CAPTURE_CONNECT     = 'c',  /* connection established */
+    CAPTURE_DISCONNECT  = 'd',  /* connection closed */
+    CAPTURE_WRITE       = 'w',  /* data sent to the device */
+    CAPTURE_READ        = 'r',  /* data received from the device */
+} CaptureType;
+
+typedef struct capture *Capture;
+
+/* Set the capture directory (NULL disables capture).
+ * Must be called before devices are created.
+ */
+void capture_init(const char *dir);
+void capture_fini(void);
+
+/* Open the capture file for device 'name'.
+ * Returns NULL if capture is disabled or the file could not be opened.
+ */
+Capture capture_create(const char *name);
+void capture_destroy(Capture cap);
+
+/* Append a record.  'buf' may be NULL if 'len' is zero.
+ */
+void capture_record(Capture cap, CaptureType type, const void *buf, int len);
+
+/* A capture file loaded into memory for replay.
+ */
+typedef struct {
+    CaptureType type;
+    unsigned long usec;         /* time since previous record */
+    int len;
+    char *data;
+} CaptureRec;
+
+/* Load all records from 'path'.  Returns NULL with errno set on error
+ * (EINVAL if the file is not a valid capture).
+ */
+CaptureRec *capture_load(const char *path, int *count);
+void capture_free(CaptureRec *recs, int count);
+
+#endif /* PM_CAPTURE_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -47,6 +47,8 @@
 #include "pluglist.h"
 #include "hprintf.h"
 #include "arglist.h"
+#include "metrics.h"
+#include "trace.h"
 #include "device_private.h"
 #include "fdutil.h"
 #include "powerman.h"
@@ -60,14 +62,25 @@ typedef int socklen_t;                  /* socklen_t is uint32_t in Posix.1g */
 #define MIN_CLIENT_BUF     1024
 #define MAX_CLIENT_BUF     1024*1024
 
+/* Keep this much of the client output buffer free when adding to a
+ * streamed reply.
+ */
+#define STREAM_BUF_ROOM    64*1024
+
 typedef struct {
     int com;                    /* script index */
     hostlist_t hl;              /* target nodes */
     int pending;                /* count of pending device actions */
     bool error;                 /* cumulative error flag for actions */
     ArgList arglist;            /* argument for query commands */
+    struct timeval start;       /* time command was received */
 } Command;
 
+/* Produce the next chunk of a streamed reply.  Return false when done.
+ */
+typedef bool (*StreamNextF)(void *stream, MetricsPrintf fn, void *arg);
+typedef void (*StreamDestroyF)(void *stream);
+
 typedef struct {
     int fd;                     /* file descriptor for the socket */
     int ofd;                    /* separate output file descriptor (if used) */
@@ -81,6 +94,10 @@ typedef struct {
     bool telemetry;             /* client wants telemetry debugging info */
     bool exprange;              /* client wants host ranges expanded */
     bool client_quit;           /* set true after client quit command */
+    void *stream;               /* streamed reply in progress, if any */
+    StreamNextF stream_next;
+    StreamDestroyF stream_destroy;
+    MetricsPrintf stream_printf;/* sends one line of streamed reply */
 } Client;
 
 /* prototypes for internal functions */
@@ -104,6 +121,10 @@ static void _create_client_stdio(void);
 static void _act_finish(int client_id, ActError acterr, const char *fmt, ...);
 static void _telemetry_printf(int client_id, const char *fmt, ...);
 static void _diag_printf(int client_id, const char *fmt, ...);
+static void _client_metrics_reply(Client *c);
+static void _client_trace_reply(Client *c);
+static void _client_memory_reply(Client *c);
+static void _client_stream_continue(Client *c);
 #if HAVE_TCP_WRAPPERS
 /* tcp wrappers support */
 extern int hosts_ctl(char *daemon, char *client_name, char *client_addr,
@@ -118,6 +139,9 @@ static List cli_clients = NULL; /* list of clients */
 static bool one_client = false; /* terminate after first client */
 static bool server_done = false;/* true when stdio client exits */
 
+/* client command latency, indexed by script index */
+static Histogram cmd_hist[NUM_SCRIPTS];
+
 static int cli_id_seq = 1;      /* range 1...INT_MAX */
 #define _next_cli_id() \
     (cli_id_seq < INT_MAX ? cli_id_seq++ : (cli_id_seq = 1, INT_MAX))
@@ -185,6 +209,12 @@ void cli_fini(void)
 {
     /* destroy clients */
     list_destroy(cli_clients);
+
+    if (listen_fds) {
+        xfree(listen_fds);
+        listen_fds = NULL;
+        listen_fds_len = 0;
+    }
 }
 
 /*
@@ -327,6 +357,11 @@ static bool _device_matches_targets(Device *dev, char *arg)
     return res;
 }
 
+static long _tv_msec(struct timeval *tv)
+{
+    return tv->tv_sec * 1000 + tv->tv_usec / 1000;
+}
+
 /*
  * Reply to client request for list of devices in powerman configuration.
  */
@@ -354,6 +389,9 @@ static void _client_query_device_reply(Client * c, char *arg)
                           : "disconnected",
                         con > 0 ? con - 1 : 0,
                         dev->stat_successful_actions,
+                        dev->stat_failed_connects,
+                        _tv_msec(&dev->stat_connect_time),
+                        _tv_msec(&dev->stat_connect_time_max),
                         dev->specname,
                         nodelist);
                 xfree (nodelist);
@@ -364,6 +402,166 @@ static void _client_query_device_reply(Client * c, char *arg)
     _client_printf(c, CP_RSP_QRY_COMPLETE);
 }
 
+/*
+ * MetricsPrintf that sends one line of metrics to the client.
+ */
+static void _metrics_printf(void *arg, const char *fmt, ...)
+{
+    Client *c = arg;
+    va_list ap;
+    char *str;
+
+    va_start(ap, fmt);
+    str = hvsprintf(fmt, ap);
+    va_end(ap);
+    _client_printf(c, CP_INFO_METRICS, str);
+    xfree(str);
+}
+
+/*
+ * TracePrintf that sends one line of the event trace to the client.
+ */
+static void _trace_printf(void *arg, const char *fmt, ...)
+{
+    Client *c = arg;
+    va_list ap;
+    char *str;
+
+    va_start(ap, fmt);
+    str = hvsprintf(fmt, ap);
+    va_end(ap);
+    _client_printf(c, CP_INFO_TRACE, str);
+    xfree(str);
+}
+
+/* Client commands by script index, for the command latency metric
+ * and the event trace */
+static const char *_command_name(int com)
+{
+    switch (com) {
+        case PM_POWER_ON:
+            return "on";
+        case PM_POWER_OFF:
+            return "off";
+        case PM_POWER_CYCLE:
+            return "cycle";
+        case PM_RESET:
+            return "reset";
+        case PM_STATUS_PLUGS:
+            return "status";
+        case PM_STATUS_TEMP:
+            return "temp";
+        case PM_STATUS_BEACON:
+            return "beacon";
+        case PM_BEACON_ON:
+            return "flash";
+        case PM_BEACON_OFF:
+            return "unflash";
+    }
+    return NULL;
+}
+
+/*
+ * Add to a streamed reply while there is room in the client's output
+ * buffer.  When done, complete the reply and re-prompt.
+ */
+static void _client_stream_continue(Client *c)
+{
+    while (MAX_CLIENT_BUF - cbuf_used(c->to) > STREAM_BUF_ROOM) {
+        if (!c->stream_next(c->stream, c->stream_printf, c)) {
+            c->stream_destroy(c->stream);
+            c->stream = NULL;
+            _client_printf(c, CP_RSP_QRY_COMPLETE);
+            _client_printf(c, CP_PROMPT);
+            break;
+        }
+    }
+}
+
+static bool _stream_metrics_next(void *stream, MetricsPrintf fn, void *arg)
+{
+    return dev_metrics_next(stream, fn, arg);
+}
+
+static void _stream_metrics_destroy(void *stream)
+{
+    dev_metrics_iterator_destroy(stream);
+}
+
+static bool _stream_trace_next(void *stream, MetricsPrintf fn, void *arg)
+{
+    return trace_dump_next(stream, fn, arg);
+}
+
+static void _stream_trace_destroy(void *stream)
+{
+    trace_dump_destroy(stream);
+}
+
+/*
+ * Reply to client request for metrics.  Server-wide metrics are sent
+ * right away, device metrics as the client reads them.
+ */
+static void _client_metrics_reply(Client *c)
+{
+    char labels[64];
+    int i;
+
+    metrics_poll_print(_metrics_printf, c);
+    metrics_header(_metrics_printf, c, "powerman_client_command_seconds",
+                   "histogram", "Time to complete a client command.");
+    for (i = 0; i < NUM_SCRIPTS; i++) {
+        if (!_command_name(i))
+            continue;
+        snprintf(labels, sizeof(labels), "command=\"%s\"", _command_name(i));
+        metrics_hist_print(_metrics_printf, c,
+                           "powerman_client_command_seconds", labels,
+                           &cmd_hist[i]);
+    }
+    c->stream = dev_metrics_iterator_create();
+    c->stream_next = _stream_metrics_next;
+    c->stream_destroy = _stream_metrics_destroy;
+    c->stream_printf = _metrics_printf;
+    _client_stream_continue(c);
+}
+
+/*
+ * Reply to client request for the event trace.  The ring is copied now
+ * and sent as the client reads it.
+ */
+static void _client_trace_reply(Client *c)
+{
+    c->stream = trace_dump_create();
+    c->stream_next = _stream_trace_next;
+    c->stream_destroy = _stream_trace_destroy;
+    c->stream_printf = _trace_printf;
+    _client_stream_continue(c);
+}
+
+/*
+ * Reply to client request for memory use.  Live bytes and objects, and
+ * allocations made so far, are reported for each allocation tag (see
+ * xmalloc.h), then in total.
+ */
+static void _client_memory_reply(Client *c)
+{
+    long bytes, objs, total_bytes = 0, total_objs = 0;
+    unsigned long allocs, total_allocs = 0;
+    int i;
+
+    for (i = 0; i < XMEM_NTAGS; i++) {
+        xmem_get(i, &bytes, &objs, &allocs);
+        _client_printf(c, CP_INFO_MEMORY, xmem_tag_name(i), bytes, objs,
+                       allocs);
+        total_bytes += bytes;
+        total_objs += objs;
+        total_allocs += allocs;
+    }
+    _client_printf(c, CP_INFO_MEMORY, "total", total_bytes, total_objs,
+                   total_allocs);
+    _client_printf(c, CP_RSP_QRY_COMPLETE);
+}
+
 /*
  * Reply to client power command (on/off/cycle/reset/beacon on/beacon off)
  */
@@ -507,6 +705,8 @@ static Command *_create_command(Client * c, int com, char *arg1)
     cmd->pending = 0;
     cmd->hl = NULL;
     cmd->arglist = NULL;
+    if (gettimeofday(&cmd->start, NULL) < 0)
+        err_exit(true, "gettimeofday");
 
     if (arg1) {
         /* Note: this can send CP_ERR_HOSTLIST to client */
@@ -581,7 +781,7 @@ static void _parse_input(Client * c, char *input)
 
     if (strlen(str) >= CP_LINEMAX) {
         _client_printf(c, CP_ERR_TOOLONG);              /* error: too long */
-    } else if (c->cmd != NULL) {
+    } else if (c->cmd != NULL || c->stream != NULL) {
         _client_printf(c, CP_ERR_CLIBUSY);              /* error: busy */
         return;                                         /* no prompt */
     } else if (!strncasecmp(str, CP_HELP, strlen(CP_HELP))) {
@@ -595,6 +795,14 @@ static void _parse_input(Client * c, char *input)
     } else if (!strncasecmp(str, CP_EXPRANGE, strlen(CP_EXPRANGE))) {
         c->exprange = !c->exprange;                     /* exprange */
         _client_printf(c, CP_RSP_EXPRANGE, c->exprange ? "ON" : "OFF");
+    } else if (!strncasecmp(str, CP_METRICS, strlen(CP_METRICS))) {
+        _client_metrics_reply(c);                       /* metrics */
+        return;                                         /* prompt later */
+    } else if (!strncasecmp(str, CP_TRACE, strlen(CP_TRACE))) {
+        _client_trace_reply(c);                         /* trace */
+        return;                                         /* prompt later */
+    } else if (!strncasecmp(str, CP_MEMORY, strlen(CP_MEMORY))) {
+        _client_memory_reply(c);                        /* memory */
     } else if (!strncasecmp(str, CP_QUIT, strlen(CP_QUIT))) {
         c->client_quit = true;
         _client_printf(c, CP_RSP_QUIT);                 /* quit */
@@ -645,6 +853,9 @@ static void _parse_input(Client * c, char *input)
         }
         assert(c->cmd == NULL);
         c->cmd = cmd;
+        if (cmd)
+            trace_event(TRACE_ASYNC_BEGIN, "clients", _command_name(cmd->com),
+                        NULL, c->client_id);
     }
 
     /* reissue prompt if we didn't queue up any device actions */
@@ -749,6 +960,9 @@ static void _act_finish(int client_id, ActError acterr, const char *fmt, ...)
 
     /* all actions have called back - return response to client */
     if (--c->cmd->pending == 0) {
+        metrics_hist_since(&cmd_hist[c->cmd->com], &c->cmd->start);
+        trace_event(TRACE_ASYNC_END, "clients", _command_name(c->cmd->com),
+                    c->cmd->error ? "error" : NULL, c->client_id);
         log_state_change(c);
 
         switch (c->cmd->com) {
@@ -803,6 +1017,8 @@ static void _destroy_client(Client *c)
         cbuf_destroy(c->from);
     if (c->cmd)
         _destroy_command(c->cmd);
+    if (c->stream)
+        c->stream_destroy(c->stream);
     if (c->ip)
         xfree(c->ip);
     if (c->host)
@@ -941,6 +1157,7 @@ static void _create_client_socket(int fd)
     c->client_id = _next_cli_id();
     c->telemetry = false;
     c->exprange = false;
+    c->stream = NULL;
     c->ofd = NO_FD;
     c->client_quit = false;
 
@@ -1009,6 +1226,7 @@ static void _create_client_socket(int fd)
 static void _create_client_stdio(void)
 {
     Client *c;
+    xmem_tag_t tag = xmem_tag_set(XMEM_CLIENT);
 
     /* create client data structure */
     c = (Client *) xmalloc(sizeof(Client));
@@ -1016,6 +1234,7 @@ static void _create_client_stdio(void)
     c->client_id = _next_cli_id();
     c->telemetry = false;
     c->exprange = false;
+    c->stream = NULL;
     c->client_quit = false;
     c->fd = STDIN_FILENO;
     c->ofd = STDOUT_FILENO;
@@ -1034,6 +1253,7 @@ static void _create_client_stdio(void)
     /* prompt the client */
     _client_printf(c, CP_VERSION, PACKAGE_VERSION);
     _client_printf(c, CP_PROMPT);
+    xmem_tag_set(tag);
 }
 
 /*
@@ -1133,6 +1353,7 @@ void cli_post_poll(xpollfd_t pfd)
     ListIterator itr;
     Client *c;
     int i;
+    xmem_tag_t tag = xmem_tag_set(XMEM_CLIENT);
 
     for (i = 0; i < listen_fds_len; i++) {
         if (listen_fds[i] != NO_FD)
@@ -1173,6 +1394,9 @@ void cli_post_poll(xpollfd_t pfd)
                 _handle_write(c);
         }
 
+        if (c->stream)
+            _client_stream_continue(c);
+
         _handle_input(c);
 
         if (c->client_quit && c->cmd == NULL)
@@ -1183,6 +1407,7 @@ client_dead:
         list_delete(itr);
     }
     list_iterator_destroy(itr);
+    xmem_tag_set(tag);
 }
 
 /* hook so daemonization function can avoid closing our fd */
@@ -48,6 +48,9 @@
 #define CP_BEACON_OFF "unflash %s"
 #define CP_TELEMETRY  "telemetry"
 #define CP_EXPRANGE   "exprange"
+#define CP_METRICS    "metrics"
+#define CP_TRACE      "trace"
+#define CP_MEMORY     "memory"
 
 /*
  * Responses -
@@ -95,6 +98,9 @@
  "301 unflash <nodes>    - set beacon to OFF (if available)"        CP_EOL \
  "301 telemetry          - toggle telemetry display"                CP_EOL \
  "301 exprange           - toggle host range expansion"             CP_EOL \
+ "301 metrics            - show server metrics (Prometheus format)" CP_EOL \
+ "301 trace              - dump event trace (Chrome trace JSON)"    CP_EOL \
+ "301 memory             - show server memory use by subsystem"     CP_EOL \
  "301 help               - display help"                            CP_EOL \
  "301 quit               - logout"                                  CP_EOL
 #define CP_INFO_STATUS \
@@ -103,12 +109,16 @@
  "302 unknown: %s"                                                  CP_EOL
 #define CP_INFO_XSTATUS     "303 %s: %s"                            CP_EOL
 #define CP_INFO_DEVICE  \
- "304 %s: state=%s reconnects=%-3.3d actions=%-3.3d type=%s hosts=%s" CP_EOL
+ "304 %s: state=%s reconnects=%-3.3d actions=%-3.3d connfails=%-3.3d " \
+ "conntime=%ld/%ldms type=%s hosts=%s" CP_EOL
 #define CP_INFO_TELEMETRY   "305 %s"                                CP_EOL
 #define CP_INFO_NODES       "306 %s"                                CP_EOL
 #define CP_INFO_XNODES      "307 %s"                                CP_EOL
 #define CP_INFO_ACTERROR    "308 %s"                                CP_EOL
 #define CP_INFO_DIAG        "309 %s"                                CP_EOL
+#define CP_INFO_METRICS     "310 %s"                                CP_EOL
+#define CP_INFO_TRACE       "311 %s"                                CP_EOL
+#define CP_INFO_MEMORY      "312 %-8s bytes=%ld objects=%ld allocs=%lu" CP_EOL
 
 #endif  /* PM_CLIENT_PROTO_H */
 
@@ -27,10 +27,14 @@
 
 #define DBG_BUFLEN 1024
 
-static unsigned long dbg_channel_mask = 0;
+unsigned long dbg_channel_mask = 0;
 
 void dbg_setmask(unsigned long mask)
 {
+#if WITHOUT_DEBUG_LOG
+    if (mask != 0)
+        fprintf(stderr, "debug logging was disabled at build time\n");
+#endif
     dbg_channel_mask = mask;
 }
 
@@ -62,22 +66,19 @@ static char *_time(void)
 
 
 /*
- * Report message on stdout/syslog if dbg_channel_mask permits.
+ * Report message on stderr.  The dbg() macro has already checked
+ * dbg_channel_mask.
  */
 void dbg_wrapped(unsigned long channel, const char *fmt, ...)
 {
     va_list ap;
+    char buf[DBG_BUFLEN];
 
-    if ((channel & dbg_channel_mask) == channel) {
-        char buf[DBG_BUFLEN];
-
-        va_start(ap, fmt);
-        vsnprintf(buf, DBG_BUFLEN, fmt, ap); /* overflow ignored on purpose */
-        va_end(ap);
+    va_start(ap, fmt);
+    vsnprintf(buf, DBG_BUFLEN, fmt, ap); /* overflow ignored on purpose */
+    va_end(ap);
 
-        fprintf(stderr, "%s %s: %s\n",
-                _time(), _channel_name(channel), buf);
-    }
+    fprintf(stderr, "%s %s: %s\n", _time(), _channel_name(channel), buf);
 }
 
 /*
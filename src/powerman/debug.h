@@ -20,6 +20,7 @@
 #define DBG_ACTION          0x0008
 #define DBG_MEMORY          0x0010
 #define DBG_TELNET          0x0020
+#define DBG_STARTUP         0x0040
 
 #define DBG_NAME_TAB {                      \
     { DBG_DEVICE,       "device" },         \
@@ -28,15 +29,32 @@
     { DBG_ACTION,       "action" },         \
     { DBG_MEMORY,       "memory" },         \
     { DBG_TELNET,       "telnet" },         \
+    { DBG_STARTUP,      "startup" },        \
     { 0, NULL }                             \
 }
 
+extern unsigned long dbg_channel_mask;
+
 void dbg_setmask(unsigned long mask);
 void dbg_wrapped(unsigned long channel, const char *fmt, ...)
     __attribute__ ((format (printf, 2, 3)));
 char *dbg_memstr(char *mem, int len);
 
-#define dbg(channel, fmt...)    dbg_wrapped(channel, fmt)
+/* Test the mask before evaluating any arguments so disabled channels cost
+ * one compare.  Code that does work just to build a debug message should
+ * be guarded with dbg_enabled() too.  With --disable-debug-log, the
+ * compiler drops all of it (format strings are still checked).
+ */
+#if WITHOUT_DEBUG_LOG
+#define dbg_enabled(channel)    0
+#else
+#define dbg_enabled(channel)    (((channel) & dbg_channel_mask) == (channel))
+#endif
+
+#define dbg(channel, fmt...) do {                                   \
+    if (dbg_enabled(channel))                                       \
+        dbg_wrapped(channel, fmt);                                  \
+} while (0)
 
 #endif /* PM_DEBUG_H */
 
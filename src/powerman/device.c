@@ -50,6 +50,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "list.h"
 #include "hostlist.h"
@@ -57,11 +58,18 @@
 #include "parse_util.h"
 #include "xpoll.h"
 #include "xmalloc.h"
+#include "arena.h"
 #include "xregex.h"
 #include "pluglist.h"
 #include "device.h"
 #include "arglist.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
 #include "device_private.h"
+#include "device_pipe.h"
+#include "device_tcp.h"
+#include "device_replay.h"
 #include "error.h"
 #include "debug.h"
 #include "client_proto.h"
@@ -70,13 +78,14 @@
 
 /* ExecCtx's are the state for the execution of a block of statements.
  * They are stacked on the Action (new ExecCtx pushed when executing an
- * inner block).
+ * inner block).  They are allocated from the Action's arena, and reused
+ * once popped, since a foreach block pushes one per plug.
  */
 typedef struct {
     List plugs;                 /* name(s) used for send "%s" (NULL=all) */
-    List block;                 /* List of stmts */
-    ListIterator stmtitr;       /* next stmt in block */
-    Stmt *cur;                  /* current stmt */
+    Script block;               /* stmts */
+    Stmt **stmtp;               /* current stmt in block */
+    Stmt *cur;                  /* *stmtp (NULL at end of block) */
     PlugListIterator plugitr;   /* used by foreach */
     PlugList pluglist;          /* pluglist if foreach is ranged */
     bool processing;            /* flag used by stmts, ifon/ifoff */
@@ -85,11 +94,15 @@ typedef struct {
 /* Actions are queued on a device and executed one at a time.  Each action
  * represents a request to run a particular script on a device, for a set of
  * plugs.  Actions can be enqueued by the client or internally (e.g. login).
+ * An action and its ExecCtxs live in an arena that is freed with it.
  */
 #define MAX_LEVELS 2
+#define ACTION_ARENA_SIZE 512
 typedef struct {
+    arena_t arena;              /* holds this action and its ExecCtxs */
     int com;                    /* one of the PM_* script types */
     List exec;                  /* stack of ExecCtxs (outer block is first) */
+    List spare;                 /* popped ExecCtxs, for reuse */
     ActionCB complete_fun;      /* callback for action completion */
     VerbosePrintf vpf_fun;      /* callback for device telemetry */
     DiagPrintf dpf_fun;         /* callback for device diagnostics */
@@ -136,12 +149,54 @@ static void _enqueue_ping(Device * dev, struct timeval *timeout);
 static void _enqueue_login(Device *dev);
 static void _disconnect(Device * dev);
 static bool _connect(Device * dev);
-static bool _reconnect(Device * dev, struct timeval *timeout);
 static bool _time_to_reconnect(Device * dev, struct timeval *timeout);
+static void _schedule_connects(List due, struct timeval *timeout);
+static void _breaker_failure(Device * dev);
+static void _act_completion(Action *act, Device *dev);
+static void _act_stats(Device * dev, Action *act);
+
+/* Script names as they appear in powerman.dev, indexed by PM_* */
+static const char *script_names[NUM_SCRIPTS] = {
+    "login", "logout", "status", "status_all", NULL, NULL, "ping",
+    "on", "on_ranged", "on_all", "off", "off_ranged", "off_all",
+    "cycle", "cycle_ranged", "cycle_all", "reset", "reset_ranged", "reset_all",
+    "status_temp", "status_temp_all", "status_beacon", "status_beacon_all",
+    "beacon_on", "beacon_on_ranged", "beacon_off", "beacon_off_ranged",
+    "resolve",
+};
+
+/* Names for ActError values, for the action_errors metric */
+static const char *act_error_names[NUM_ACT_ERRORS] = {
+    "success", "expect_timeout", "aborted", "connect_timeout",
+    "login_timeout", "breaker_open",
+};
+
+/* Statement names for the event trace, indexed by StmtType */
+static const char *stmt_names[] = {
+    "send", "expect", "setplugstate", "setresult", "delay",
+    "foreachplug", "foreachnode", "ifoff", "ifon",
+};
 
 static List dev_devices = NULL;
 static bool short_circuit_delay = false;
 
+/* Device I/O buffers and the regex match cache are only needed while a
+ * device is connected and busy, so they are taken when I/O starts and given
+ * back on disconnect or after buffer_idle seconds without activity.  Given
+ * back buffers are flushed, which shrinks them to MIN_DEV_BUF, and a few
+ * are kept here for the next device that needs them.
+ */
+#define DEV_BUF_POOL_MAX 64
+static List dev_buf_pool = NULL;        /* spare cbufs */
+static List dev_match_pool = NULL;      /* spare xregex_match_t's */
+
+/* scripts of a device made without a ScriptSet */
+static Script no_scripts[NUM_SCRIPTS];
+
+/* for reporting how long it takes for all devices to connect at startup */
+static struct timeval initial_connect_start;
+static int initial_connect_pending = 0;
+
 static void _dbg_actions(Device * dev)
 {
     char tmpstr[1024];
@@ -211,32 +266,50 @@ static char *_getregex_buf(cbuf_t b, xregex_t re, xregex_match_t xm)
     return str;
 }
 
-static ExecCtx *_create_exec_ctx(Device *dev, List block, List plugs)
+static ExecCtx *_create_exec_ctx(Action *act, Script block, List plugs)
 {
-    ExecCtx *new = (ExecCtx *)xmalloc(sizeof(ExecCtx));
+    ExecCtx *new;
 
-    new->stmtitr = list_iterator_create(block);
-    new->cur = list_next(new->stmtitr);
+    if (!(new = list_pop(act->spare))) {
+        xmem_tag_t tag = xmem_tag_set(XMEM_ACTION);
+
+        new = (ExecCtx *)arena_alloc(act->arena, sizeof(ExecCtx));
+        xmem_tag_set(tag);
+    }
     new->block = block;
+    new->stmtp = block;
+    new->cur = *new->stmtp;
     new->plugs = plugs;
     new->plugitr = NULL;
+    new->pluglist = NULL;
     new->processing = false;
 
     return new;
 }
 
+/* Release what an ExecCtx refers to.  Its memory belongs to the Action.
+ */
 static void _destroy_exec_ctx(ExecCtx *e)
 {
-    if (e->stmtitr != NULL)
-        list_iterator_destroy(e->stmtitr);
-    e->stmtitr = NULL;
+    e->stmtp = NULL;
     e->cur = NULL;
     if (e->plugs)
         list_destroy(e->plugs);
+    if (e->plugitr)
+        pluglist_iterator_destroy(e->plugitr);
+    e->plugitr = NULL;
     if (e->pluglist)
         pluglist_destroy(e->pluglist);
+    e->pluglist = NULL;
     e->plugs = NULL;
-    xfree(e);
+}
+
+/* Destroy an ExecCtx popped from the Action's stack, keeping it for reuse.
+ */
+static void _recycle_exec_ctx(Action *act, ExecCtx *e)
+{
+    _destroy_exec_ctx(e);
+    list_push(act->spare, e);
 }
 
 static void _rewind_action(Action *act)
@@ -249,12 +322,12 @@ static void _rewind_action(Action *act)
             list_push(act->exec, e);
             break;
         }
-        _destroy_exec_ctx(e);
+        _recycle_exec_ctx(act, e);
     }
-    /* reset outer block iterator and current pointer */
+    /* reset outer block current pointer */
     if (e) {
-        list_iterator_reset(e->stmtitr);
-        e->cur = list_next(e->stmtitr);
+        e->stmtp = e->block;
+        e->cur = *e->stmtp;
     }
 }
 
@@ -264,9 +337,14 @@ static Action *_create_action(Device * dev, int com, List plugs,
 {
     Action *act;
     ExecCtx *e;
+    arena_t arena;
+    xmem_tag_t tag;
 
     dbg(DBG_ACTION, "_create_action: %d", com);
-    act = (Action *) xmalloc(sizeof(Action));
+    tag = xmem_tag_set(XMEM_ACTION);
+    arena = arena_create(ACTION_ARENA_SIZE);
+    act = (Action *) arena_alloc(arena, sizeof(Action));
+    act->arena = arena;
     act->com = com;
     act->complete_fun = complete_fun;
     act->vpf_fun = vpf_fun;
@@ -274,12 +352,15 @@ static Action *_create_action(Device * dev, int com, List plugs,
     act->client_id = client_id;
 
     act->exec = list_create((ListDelF)_destroy_exec_ctx);
-    e = _create_exec_ctx(dev, dev->scripts[act->com], plugs);
+    act->spare = list_create(NULL);
+    e = _create_exec_ctx(act, dev->scripts[act->com], plugs);
     list_push(act->exec, e);
 
     act->errnum = ACT_ESUCCESS;
     act->arglist = arglist ? arglist_link(arglist) : NULL;
     timerclear(&act->time_stamp);
+    xmem_tag_set(tag);
+    trace_event(TRACE_INSTANT, dev->name, "enqueue", script_names[com], 0);
     return act;
 }
 
@@ -289,23 +370,35 @@ static void _destroy_action(Action * act)
     if (act->exec)
         list_destroy(act->exec);
     act->exec = NULL;
+    list_destroy(act->spare);
     if (act->arglist)
         arglist_unlink(act->arglist);
     act->arglist = NULL;
-    xfree(act);
+    arena_destroy(act->arena);
 }
 
 /* initialize this module */
 void dev_init(bool Sopt)
 {
     dev_devices = list_create((ListDelF) dev_destroy);
+    dev_buf_pool = list_create((ListDelF) cbuf_destroy);
+    dev_match_pool = list_create((ListDelF) xregex_match_destroy);
     short_circuit_delay = Sopt;
+    srandom(time(NULL) ^ getpid());
+    pipe_init();
+    tcp_init();
+    replay_init();
 }
 
 /* tear down this module */
 void dev_fini(void)
 {
     list_destroy(dev_devices);
+    list_destroy(dev_buf_pool);
+    list_destroy(dev_match_pool);
+    pipe_fini();
+    tcp_fini();
+    replay_fini();
 }
 
 /* add a device to the device list (called from config file parser) */
@@ -355,38 +448,154 @@ static bool _timeout(struct timeval *time_stamp, struct timeval *timeout,
 /*
  * If tv is less than timeout, or timeout is zero, set timeout = tv.
  */
-void _update_timeout(struct timeval *timeout, struct timeval *tv)
+void dev_update_timeout(struct timeval *timeout, struct timeval *tv)
 {
     if (timercmp(tv, timeout, <) || !timerisset(timeout))
         *timeout = *tv;
 }
 
 /*
- * Helper for _reconnect().
- * Return true if OK to attempt reconnect.  If false, put the time left
- * in timeout if it is less than timeout or if timeout is zero.
+ * Pick the delay before the next reconnect from the backoff table.
+ * The delay is chosen at random from the upper half of the table entry,
+ * so devices that went away together (e.g. a rack lost power) do not
+ * all come back at the same instant.
  */
-static bool _time_to_reconnect(Device * dev, struct timeval *timeout)
+static void _set_retry_delay(Device * dev)
 {
     static int rtab[] = { 1, 2, 4, 8, 15, 30, 60 };
     int max_rtab_index = sizeof(rtab) / sizeof(int) - 1;
     int rix = dev->retry_count - 1;
-    struct timeval timeleft, retry;
-    bool reconnect = true;
+    long usec = rtab[rix > max_rtab_index ? max_rtab_index : rix] * 1000000L;
 
-    if (dev->retry_count > 0) {
+    usec = usec / 2 + random() % (usec / 2 + 1);
+    dev->retry_delay.tv_sec = usec / 1000000;
+    dev->retry_delay.tv_usec = usec % 1000000;
+}
 
-        timerclear(&retry);
-        retry.tv_sec = rtab[rix > max_rtab_index ? max_rtab_index : rix];
+/*
+ * Return true if OK to attempt reconnect.  If false, put the time left
+ * in timeout if it is less than timeout or if timeout is zero.
+ */
+static bool _time_to_reconnect(Device * dev, struct timeval *timeout)
+{
+    struct timeval timeleft;
+    bool reconnect = true;
 
-        if (!_timeout(&dev->last_retry, &retry, &timeleft))
+    if (dev->retry_count > 0) {
+        if (!_timeout(&dev->last_retry, &dev->retry_delay, &timeleft))
             reconnect = false;
         if (timeout && !reconnect)
-            _update_timeout(timeout, &timeleft);
+            dev_update_timeout(timeout, &timeleft);
     }
     return reconnect;
 }
 
+/*
+ * Count a connect or login failure.  After circuit_breaker consecutive
+ * failures the device's breaker opens:  actions on it are failed right
+ * away instead of waiting out the device timeout, while reconnects go
+ * on in the background on the usual backoff.  A successful login closes
+ * the breaker.  A connect attempt counts once, however many ways it is
+ * seen to fail (e.g. refused, then an action times out waiting on it).
+ */
+static void _breaker_failure(Device * dev)
+{
+    int threshold = conf_get_circuit_breaker();
+
+    if (dev->breaker_counted)
+        return;
+    dev->breaker_counted = true;
+    dev->breaker_failures++;
+    if (threshold > 0 && !dev->breaker_open
+                      && dev->breaker_failures >= threshold) {
+        dev->breaker_open = true;
+        err(false, "%s: circuit breaker open after %d failures", dev->name,
+            dev->breaker_failures);
+    }
+}
+
+static void _breaker_success(Device * dev)
+{
+    if (dev->breaker_open)
+        err(false, "%s: circuit breaker closed", dev->name);
+    dev->breaker_open = false;
+    dev->breaker_failures = 0;
+}
+
+/* Fill in a status query from the plug states last reported by the device.
+ */
+static void _breaker_last_status(Device * dev, Action *act)
+{
+    PlugListIterator itr;
+    Plug *plug;
+    Arg *arg;
+
+    if (act->com != PM_STATUS_PLUGS && act->com != PM_STATUS_PLUGS_ALL)
+        return;
+    itr = pluglist_iterator_create(dev->plugs);
+    while ((plug = pluglist_next(itr))) {
+        if (plug->node && (arg = arglist_find(act->arglist, plug->node)))
+            arg->state = plug->last_state;
+    }
+    pluglist_iterator_destroy(itr);
+}
+
+/* Complete all actions but login on a device whose breaker is open.
+ */
+static void _breaker_fail_actions(Device * dev)
+{
+    ListIterator itr;
+    Action *act;
+
+    itr = list_iterator_create(dev->acts);
+    while ((act = list_next(itr))) {
+        if (act->com == PM_LOG_IN)
+            continue;
+        list_remove(itr);
+        act->errnum = ACT_EBREAKER;
+        _breaker_last_status(dev, act);
+        _act_stats(dev, act);
+        if (act->complete_fun)
+            _act_completion(act, dev);
+        _destroy_action(act);
+    }
+    list_iterator_destroy(itr);
+}
+
+/* Record how long it took to connect, timed from the last (re)connect
+ * attempt, and enqueue login.
+ */
+static void _connected(Device * dev)
+{
+    struct timeval now;
+
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    timersub(&now, &dev->last_retry, &dev->stat_connect_time);
+    if (timercmp(&dev->stat_connect_time, &dev->stat_connect_time_max, >))
+        dev->stat_connect_time_max = dev->stat_connect_time;
+    metrics_hist_observe(&dev->stat_connect_hist, &dev->stat_connect_time);
+    dbg(DBG_DEVICE, "_connected(%s): connect took %ld.%.6lds", dev->name,
+        (long)dev->stat_connect_time.tv_sec,
+        (long)dev->stat_connect_time.tv_usec);
+    trace_event(TRACE_INSTANT, dev->name, "connected", NULL, 0);
+    if (dev->capture)
+        capture_record(dev->capture, CAPTURE_CONNECT, NULL, 0);
+
+    if (dev->stat_successful_connects == 1 && initial_connect_pending > 0) {
+        if (--initial_connect_pending == 0) {
+            struct timeval elapsed;
+
+            timersub(&now, &initial_connect_start, &elapsed);
+            dbg(DBG_STARTUP, "all %d devices connected in %ld.%.3lds",
+                list_count(dev_devices), (long)elapsed.tv_sec,
+                (long)elapsed.tv_usec / 1000);
+        }
+    }
+
+    _enqueue_login(dev);
+}
+
 static bool _connect(Device * dev)
 {
     bool connected;
@@ -396,26 +605,100 @@ static bool _connect(Device * dev)
     if (gettimeofday(&dev->last_retry, NULL) < 0)
         err_exit(true, "gettimeofday");
     dev->retry_count++;
+    _set_retry_delay(dev);
+    dev->breaker_counted = false;
 
     connected = dev->connect(dev);
 
     if (connected)
-        _enqueue_login(dev);
+        _connected(dev);
+    else if (dev->connect_state == DEV_NOT_CONNECTED) {
+        dev->stat_failed_connects++;
+        _breaker_failure(dev);
+    }
 
     return connected;
 }
 
-static bool _reconnect(Device *dev, struct timeval *timeout)
+/* Continue a connect in progress after poll.
+ * Return true on error, which triggers timed retry of _connect().
+ */
+static bool _finish_connect(Device * dev, xpollfd_t pfd,
+                            struct timeval *timeout)
 {
-    bool connected = false;
+    assert(dev->finish_connect != NULL);
 
-    if (dev->connect_state != DEV_NOT_CONNECTED)
-        _disconnect(dev);
+    if (!dev->finish_connect(dev, pfd, timeout)) {
+        dev->stat_failed_connects++;
+        _breaker_failure(dev);
+        return true;
+    }
+    if (dev->connect_state == DEV_CONNECTED)
+        _connected(dev);
+    return false;
+}
 
-    if (_time_to_reconnect(dev, timeout))
-        connected = _connect(dev);
+/* Return true if dev is using one of the connect_limit slots,
+ * i.e. it is connecting or has connected but not yet logged in.
+ */
+static bool _is_connecting(Device * dev)
+{
+    return (dev->connect_state == DEV_CONNECTING
+            || (dev->connect_state == DEV_CONNECTED && !dev->logged_in));
+}
 
-    return connected;
+/* Order devices waiting to connect:  those with actions enqueued (a user
+ * is waiting on them) first, then the ones that have waited longest.
+ */
+static int _connect_order(Device * x, Device * y)
+{
+    bool xacts = !list_is_empty(x->acts);
+    bool yacts = !list_is_empty(y->acts);
+
+    if (xacts != yacts)
+        return xacts ? -1 : 1;
+    if (timercmp(&x->last_retry, &y->last_retry, <))
+        return -1;
+    if (timercmp(&x->last_retry, &y->last_retry, >))
+        return 1;
+    return 0;
+}
+
+/*
+ * Connect devices on the 'due' list, which are ready for a (re)connect,
+ * without exceeding connect_limit devices connecting at once.  Devices
+ * that don't get a slot stay unconnected and are considered again on the
+ * next pass;  a slot frees up when some device finishes connecting and
+ * logging in, which entails poll activity or a timeout.  If timeout is
+ * non-NULL, actions (e.g. login) are processed on devices that connect
+ * right away, as dev_post_poll() would.  Empties 'due'.
+ */
+static void _schedule_connects(List due, struct timeval *timeout)
+{
+    int limit = conf_get_connect_limit();
+    int busy = 0;
+    Device *dev;
+
+    if (limit > 0) {
+        ListIterator itr = list_iterator_create(dev_devices);
+
+        while ((dev = list_next(itr)))
+            if (_is_connecting(dev))
+                busy++;
+        list_iterator_destroy(itr);
+    }
+    list_sort(due, (ListCmpF) _connect_order);
+    while ((dev = list_dequeue(due))) {
+        if (limit > 0 && busy >= limit)
+            continue;
+        if (_connect(dev) && timeout) {
+            _process_action(dev, timeout);
+            if (dev->connect_state == DEV_NOT_CONNECTED)
+                (void)_time_to_reconnect(dev, timeout);
+        }
+        if (_is_connecting(dev))
+            busy++;
+    }
 }
 
 /* helper for dev_check_actions/dev_enqueue_actions */
@@ -486,7 +769,8 @@ int dev_enqueue_actions(int com, hostlist_t hl, ActionCB complete_fun,
             continue;                               /* uninvolved device */
         count = _enqueue_actions(dev, com, hl, complete_fun, vpf_fun, dpf_fun,
                 client_id, arglist);
-        if (count > 0 && dev->connect_state != DEV_CONNECTED)
+        if (count > 0 && dev->connect_state != DEV_CONNECTED
+                      && !dev->breaker_open)
             dev->retry_count = 0;   /* expedite retries on this device since */
         total += count;             /*   the user is beating on us... */
     }
@@ -751,6 +1035,69 @@ cleanup:
     return count;
 }
 
+/* Give dev its I/O buffers, if it doesn't have them already.
+ */
+static void _get_bufs(Device * dev)
+{
+    xmem_tag_t tag;
+
+    if (dev->to)
+        return;
+    tag = xmem_tag_set(XMEM_DEVICE);
+    if (!(dev->to = list_pop(dev_buf_pool)))
+        dev->to = cbuf_create(MIN_DEV_BUF, MAX_DEV_BUF);
+    if (!(dev->from = list_pop(dev_buf_pool)))
+        dev->from = cbuf_create(MIN_DEV_BUF, MAX_DEV_BUF);
+    if (!(dev->xmatch = list_pop(dev_match_pool)))
+        dev->xmatch = xregex_match_create(MAX_MATCH_POS);
+    xmem_tag_set(tag);
+}
+
+static void _put_buf(cbuf_t cb)
+{
+    if (list_count(dev_buf_pool) < DEV_BUF_POOL_MAX) {
+        cbuf_flush(cb);
+        list_push(dev_buf_pool, cb);
+    } else
+        cbuf_destroy(cb);
+}
+
+/* Take dev's I/O buffers away, discarding any data in them.
+ */
+static void _put_bufs(Device * dev)
+{
+    if (!dev->to)
+        return;
+    _put_buf(dev->to);
+    _put_buf(dev->from);
+    if (list_count(dev_match_pool) < DEV_BUF_POOL_MAX / 2) {
+        xregex_match_recycle(dev->xmatch);
+        list_push(dev_match_pool, dev->xmatch);
+    } else
+        xregex_match_destroy(dev->xmatch);
+    dev->to = dev->from = NULL;
+    dev->xmatch = NULL;
+}
+
+/* Take away the buffers of a connected device that has had nothing to do
+ * for buffer_idle seconds.  Unread input is kept, since a script may yet
+ * expect it.
+ */
+static void _put_idle_bufs(Device * dev)
+{
+    struct timeval idle = { conf_get_buffer_idle(), 0 };
+    struct timeval timeleft;
+
+    if (!dev->to || !timerisset(&idle) || !list_is_empty(dev->acts))
+        return;
+    if (!cbuf_is_empty(dev->to) || !cbuf_is_empty(dev->from))
+        return;
+    if (_timeout(&dev->last_busy, &idle, &timeleft)) {
+        dbg(DBG_DEVICE, "%s: releasing idle buffers", dev->name);
+        _put_bufs(dev);
+    }
+}
+
 /* Called upon success of connect or finish_connect device methods.
  */
 static void _enqueue_login(Device *dev)
@@ -765,10 +1112,12 @@ static void _disconnect(Device * dev)
 
     assert(dev->disconnect != NULL);
     dev->disconnect(dev);
+    trace_event(TRACE_INSTANT, dev->name, "disconnected", NULL, 0);
+    if (dev->capture)
+        capture_record(dev->capture, CAPTURE_DISCONNECT, NULL, 0);
 
     /* empty buffers */
-    cbuf_flush(dev->from);
-    cbuf_flush(dev->to);
+    _put_bufs(dev);
 
     /* update state */
     dev->connect_state = DEV_NOT_CONNECTED;
@@ -779,6 +1128,28 @@ static void _disconnect(Device * dev)
         _destroy_action(list_dequeue(dev->acts));
 }
 
+/* Account for a finished action in the device metrics and event trace.
+ */
+static void _act_stats(Device * dev, Action *act)
+{
+    const char *errname = NULL;
+
+    if (act->errnum != ACT_ESUCCESS) {
+        dev->stat_act_errors[act->errnum]++;
+        errname = act_error_names[act->errnum];
+    }
+    if (timerisset(&act->time_stamp)) {
+        Histogram **h = &dev->stat_script_hist[act->com];
+
+        if (!*h)
+            *h = (Histogram *)xmalloc(sizeof(Histogram));
+        metrics_hist_since(*h, &act->time_stamp);
+        trace_event(TRACE_END, dev->name, script_names[act->com], errname, 0);
+    } else
+        trace_event(TRACE_INSTANT, dev->name, "dropped",
+                    script_names[act->com], 0);
+}
+
 static void _act_completion(Action *act, Device *dev)
 {
     assert(act->complete_fun != NULL);
@@ -800,6 +1171,10 @@ static void _act_completion(Action *act, Device *dev)
         act->complete_fun(act->client_id, act->errnum,
                 "%s: action aborted due to previous action timeout", dev->name);
         break;
+    case ACT_EBREAKER:
+        act->complete_fun(act->client_id, act->errnum,
+                "%s: device is down (circuit breaker open)", dev->name);
+        break;
     case ACT_ESUCCESS:
         act->complete_fun(act->client_id, act->errnum, NULL);
         break;
@@ -816,6 +1191,12 @@ static void _process_action(Device * dev, struct timeval *timeout)
     bool stalled = false;
     Action *act;
 
+    if (dev->breaker_open)
+        _breaker_fail_actions(dev);
+
+    if (dev->connect_state == DEV_CONNECTED && !list_is_empty(dev->acts))
+        _get_bufs(dev);
+
     while ((act = list_peek(dev->acts)) && !stalled) {
         struct timeval timeleft;
         ExecCtx *e = list_peek(act->exec);
@@ -823,12 +1204,16 @@ static void _process_action(Device * dev, struct timeval *timeout)
         assert(e != NULL);
 
         dbg(DBG_ACTION, "_process_action: processing action %d", act->com);
-        _dbg_actions(dev);
+        if (dbg_enabled(DBG_ACTION))
+            _dbg_actions(dev);
 
         /* initialize timeout (action is brand new) */
-        if (!timerisset(&act->time_stamp))
+        if (!timerisset(&act->time_stamp)) {
             if (gettimeofday(&act->time_stamp, NULL) < 0)
                 err_exit(true, "gettimeofday");
+            trace_event(TRACE_BEGIN, dev->name, script_names[act->com],
+                        NULL, 0);
+        }
 
         /* timeout exceeded? */
         if (_timeout(&act->time_stamp, &dev->timeout, &timeleft)) {
@@ -838,10 +1223,13 @@ static void _process_action(Device * dev, struct timeval *timeout)
                 act->errnum = ACT_ELOGINTIMEOUT;
             } else
                 act->errnum = ACT_EEXPFAIL;
+            if (act->errnum != ACT_EEXPFAIL)
+                _breaker_failure(dev);
 
             if (act->vpf_fun) {
                 static char mem[MAX_DEV_BUF];
-                int len = cbuf_peek(dev->from, mem, MAX_DEV_BUF);
+                int len = dev->from ? cbuf_peek(dev->from, mem, MAX_DEV_BUF)
+                                    : 0;
                 char *memstr = dbg_memstr(mem, len);
 
                 if (!(dev->connect_state == DEV_CONNECTED))
@@ -874,23 +1262,28 @@ static void _process_action(Device * dev, struct timeval *timeout)
 
         /* stalled - update timeout for select */
         if (stalled) {
-            _update_timeout(timeout, &timeleft);
+            dev_update_timeout(timeout, &timeleft);
 
         /* most recently attempted stmt completed successfully */
         } else if (act->errnum == ACT_ESUCCESS) {
-            e->cur = list_next(e->stmtitr);     /* next stmt this block */
+            trace_event(TRACE_INSTANT, dev->name, stmt_names[e->cur->type],
+                        NULL, 0);
+            e->cur = *++e->stmtp;               /* next stmt this block */
             if (!e->cur) {                  /* ...or new block */
                 ExecCtx *e2 = list_pop(act->exec);
 
                 assert(e2 == e);
-                _destroy_exec_ctx(e2);
+                _recycle_exec_ctx(act, e2);
                 e = list_peek(act->exec);
             }
 
             /* completed action successfully! */
             if (e == NULL) {
-                if (act->com == PM_LOG_IN)
+                if (act->com == PM_LOG_IN) {
                     dev->logged_in = true;
+                    _breaker_success(dev);
+                }
+                _act_stats(dev, act);
                 if (act->complete_fun)
                     _act_completion(act, dev);
                 _destroy_action(list_dequeue(dev->acts));
@@ -901,6 +1294,7 @@ static void _process_action(Device * dev, struct timeval *timeout)
         } else {
             ActError res = act->errnum; /* save for ref after _destroy_action */
 
+            _act_stats(dev, act);
             if (act->complete_fun)
                 _act_completion(act, dev);
             _destroy_action(list_dequeue(dev->acts));
@@ -910,6 +1304,7 @@ static void _process_action(Device * dev, struct timeval *timeout)
              */
             while ((act = list_dequeue(dev->acts)) != NULL) {
                 act->errnum = (res == ACT_EEXPFAIL ? ACT_EABORT : res);
+                _act_stats(dev, act);
                 if (act->complete_fun)
                     _act_completion(act, dev);
                 _destroy_action(act);
@@ -918,7 +1313,7 @@ static void _process_action(Device * dev, struct timeval *timeout)
             /* reconnect/login if expect timed out */
             if ((dev->connect_state == DEV_CONNECTED)) {
                 dbg(DBG_DEVICE, "_process_action: disconnecting due to error");
-                _reconnect(dev, timeout);
+                _disconnect(dev);
                 break;
             }
         }
@@ -1008,7 +1403,7 @@ static bool _process_foreach(Device *dev, Action *act, ExecCtx *e)
             goto cleanup;
         }
 
-        new = _create_exec_ctx(dev, e->cur->u.foreach.stmts, plugs);
+        new = _create_exec_ctx(act, e->cur->u.foreach.stmts, plugs);
         list_push(act->exec, new);
     } else {
         pluglist_iterator_destroy(e->plugitr);
@@ -1074,7 +1469,7 @@ static bool _process_ifonoff(Device *dev, Action *act, ExecCtx *e)
                 }
             }
 
-            new = _create_exec_ctx(dev, e->cur->u.ifonoff.stmts, plugs);
+            new = _create_exec_ctx(act, e->cur->u.ifonoff.stmts, plugs);
             list_push(act->exec, new);
             list_iterator_destroy(itr);
         }
@@ -1126,10 +1521,11 @@ static bool _process_setplugstate(Device *dev, Action *act, ExecCtx *e)
             }
             list_iterator_destroy(itr);
 
+            if (act->com == PM_STATUS_PLUGS || act->com == PM_STATUS_PLUGS_ALL)
+                plug->last_state = state;
             if ((arg = arglist_find(act->arglist, plug->node))) {
                 arg->state = state;
-                xfree(arg->val);
-                arg->val = xstrdup(str);
+                arglist_set_val(act->arglist, arg, str);
             }
         }
         xfree(str);
@@ -1174,8 +1570,7 @@ static bool _process_setresult(Device *dev, Action *act, ExecCtx *e)
 
             if ((arg = arglist_find(act->arglist, plug->node))) {
                 arg->result = result;
-                xfree(arg->val);
-                arg->val = xstrdup(str);
+                arglist_set_val(act->arglist, arg, str);
             }
 
             if (arg && result != RT_SUCCESS) {
@@ -1296,12 +1691,11 @@ static bool _process_send(Device *dev, Action *act, ExecCtx *e)
             else if (dropped > 0)
                 err(false, "_process_send(%s): buffer overrun, %d dropped",
                     dev->name, dropped);
-            else {
+            else if (act->vpf_fun) {
                 char *memstr = dbg_memstr(str, strlen(str));
 
-                if (act->vpf_fun)
-                    act->vpf_fun(act->client_id, "send(%s): '%s'",
-                                 dev->name, memstr);
+                act->vpf_fun(act->client_id, "send(%s): '%s'",
+                             dev->name, memstr);
                 xfree(memstr);
             }
             assert(written < 0 || (dropped == strlen(str) - written));
@@ -1344,7 +1738,7 @@ static bool _process_delay(Device *dev, Action *act, ExecCtx *e,
         e->processing = false;
         finished = true;
     } else
-        _update_timeout(timeout, &timeleft);
+        dev_update_timeout(timeout, &timeleft);
 
     return finished;
 }
@@ -1353,30 +1747,48 @@ Device *dev_create(const char *name)
 {
     Device *dev;
     int i;
+    xmem_tag_t tag = xmem_tag_set(XMEM_DEVICE);
 
     dev = (Device *) xmalloc(sizeof(Device));
     dev->name = xstrdup(name);
     dev->connect_state = DEV_NOT_CONNECTED;
     dev->fd = NO_FD;
     dev->acts = list_create((ListDelF) _destroy_action);
-    dev->xmatch = xregex_match_create(MAX_MATCH_POS);
+    dev->xmatch = NULL;
     dev->data = NULL;
 
     timerclear(&dev->timeout);
     timerclear(&dev->last_retry);
+    timerclear(&dev->retry_delay);
     timerclear(&dev->last_ping);
     timerclear(&dev->ping_period);
+    timerclear(&dev->last_busy);
 
-    dev->to = cbuf_create(MIN_DEV_BUF, MAX_DEV_BUF);
-    dev->from = cbuf_create(MIN_DEV_BUF, MAX_DEV_BUF);
+    dev->to = NULL;
+    dev->from = NULL;
 
-    for (i = 0; i < NUM_SCRIPTS; i++)
-        dev->scripts[i] = NULL;
+    dev->scriptset = NULL;
+    dev->scripts = no_scripts;
 
     dev->plugs = NULL;
     dev->retry_count = 0;
+    dev->breaker_failures = 0;
+    dev->breaker_open = false;
+    dev->breaker_counted = false;
     dev->stat_successful_connects = 0;
     dev->stat_successful_actions = 0;
+    dev->stat_failed_connects = 0;
+    timerclear(&dev->stat_connect_time);
+    timerclear(&dev->stat_connect_time_max);
+    memset(&dev->stat_connect_hist, 0, sizeof(dev->stat_connect_hist));
+    for (i = 0; i < NUM_SCRIPTS; i++)
+        dev->stat_script_hist[i] = NULL;
+    for (i = 0; i < NUM_ACT_ERRORS; i++)
+        dev->stat_act_errors[i] = 0;
+    dev->stat_bytes_read = 0;
+    dev->stat_bytes_written = 0;
+    dev->capture = capture_create(name);
+    xmem_tag_set(tag);
     return dev;
 }
 
@@ -1407,16 +1819,60 @@ void dev_destroy(Device * dev)
     list_destroy(dev->acts);
     if (dev->plugs)
         pluglist_destroy(dev->plugs);
-    for (i = 0; i < NUM_SCRIPTS; i++)
-        if (dev->scripts[i] != NULL)
-            list_destroy(dev->scripts[i]);
+    if (dev->scriptset)
+        scriptset_unlink(dev->scriptset);
+    for (i = 0; i < NUM_SCRIPTS; i++) {
+        if (dev->stat_script_hist[i] != NULL)
+            xfree(dev->stat_script_hist[i]);
+    }
 
-    cbuf_destroy(dev->to);
-    cbuf_destroy(dev->from);
-    xregex_match_destroy(dev->xmatch);
+    if (dev->capture)
+        capture_destroy(dev->capture);
+    _put_bufs(dev);
     xfree(dev);
 }
 
+/* Give dev the scripts in ss (taking a reference).
+ */
+void dev_set_scripts(Device * dev, ScriptSet *ss)
+{
+    assert(dev->scriptset == NULL);
+    dev->scriptset = scriptset_link(ss);
+    dev->scripts = ss->scripts;
+}
+
+ScriptSet *scriptset_create(void (*destroy)(Script script))
+{
+    ScriptSet *ss = (ScriptSet *)xmalloc(sizeof(ScriptSet));
+    int i;
+
+    ss->refcount = 1;
+    ss->destroy = destroy;
+    for (i = 0; i < NUM_SCRIPTS; i++)
+        ss->scripts[i] = NULL;
+    return ss;
+}
+
+ScriptSet *scriptset_link(ScriptSet *ss)
+{
+    ss->refcount++;
+
+    return ss;
+}
+
+void scriptset_unlink(ScriptSet *ss)
+{
+    int i;
+
+    if (--ss->refcount == 0) {
+        for (i = 0; i < NUM_SCRIPTS; i++) {
+            if (ss->scripts[i] != NULL)
+                ss->destroy(ss->scripts[i]);
+        }
+        xfree(ss);
+    }
+}
+
 static void _enqueue_ping(Device * dev, struct timeval *timeout)
 {
     struct timeval timeleft;
@@ -1428,7 +1884,7 @@ static void _enqueue_ping(Device * dev, struct timeval *timeout)
                 err_exit(true, "gettimeofday");
             dbg(DBG_ACTION, "%s: enqeuuing ping", dev->name);
         } else
-            _update_timeout(timeout, &timeleft);
+            dev_update_timeout(timeout, &timeleft);
     }
 }
 
@@ -1439,13 +1895,29 @@ void dev_initial_connect(void)
 {
     Device *dev;
     ListIterator itr;
+    List due;
+    struct timeval elapsed;
 
+    if (gettimeofday(&initial_connect_start, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    initial_connect_pending = list_count(dev_devices);
+
+    due = list_create(NULL);
     itr = list_iterator_create(dev_devices);
     while ((dev = list_next(itr))) {
         assert(dev->connect_state == DEV_NOT_CONNECTED);
-        _connect(dev);
+        list_append(due, dev);
     }
     list_iterator_destroy(itr);
+    _schedule_connects(due, NULL);
+    list_destroy(due);
+
+    if (gettimeofday(&elapsed, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    timersub(&elapsed, &initial_connect_start, &elapsed);
+    dbg(DBG_STARTUP, "initiated connect to %d devices in %ld.%.3lds",
+        list_count(dev_devices), (long)elapsed.tv_sec,
+        (long)elapsed.tv_usec / 1000);
 }
 
 /*
@@ -1467,6 +1939,7 @@ static bool _handle_read(Device * dev)
     }
     if (dropped > 0)
         err(false, "%s lost %d chars due to buffer wrap", dev->name, dropped);
+    dev->stat_bytes_read += n;
     return false;
 err:
     return true;
@@ -1488,18 +1961,43 @@ static bool _handle_write(Device * dev)
         err(false, "write sent no data on %s", dev->name);
         goto err;
     }
+    dev->stat_bytes_written += n;
+    if (dev->capture) {
+        static char mem[MAX_DEV_BUF];
+
+        /* the n bytes just written are now replay data */
+        if (cbuf_replay(dev->to, mem, n) == n)
+            capture_record(dev->capture, CAPTURE_WRITE, mem, n);
+    }
     return false;
 err:
     return true;
 }
 
+/* Capture the n bytes of input just added to dev->from.  This is after
+ * preprocessing, so a replay sees what the script saw.
+ */
+static void _capture_read(Device * dev, int n)
+{
+    static char mem[MAX_DEV_BUF];
+    int used;
+
+    if (n <= 0)
+        return;
+    used = cbuf_peek(dev->from, mem, MAX_DEV_BUF);
+    if (used >= n)
+        capture_record(dev->capture, CAPTURE_READ, mem + used - n, n);
+}
+
 /* One of the poll bits is set for the device - handle it! */
 static bool
 _handle_ready_device(Device *dev, short flags)
 {
-    assert(dev->connect_state != DEV_NOT_CONNECTED);
+    assert(dev->connect_state == DEV_CONNECTED);
     assert(dev->fd != NO_FD);
 
+    _get_bufs(dev);
+
     /* error cases (won't get here with select - only poll) */
     if (flags & XPOLLHUP) {
         err(false, "%s: poll: hangup", dev->name);
@@ -1515,27 +2013,21 @@ _handle_ready_device(Device *dev, short flags)
     }
     /* ready for writing */
     if (flags & XPOLLOUT) {
-        if (dev->connect_state == DEV_CONNECTING) {
-            assert(dev->finish_connect != NULL);
-            if (!dev->finish_connect(dev))
-                goto ioerr;
-            if (dev->connect_state == DEV_CONNECTED)
-                _enqueue_login(dev);    /* enqueue login if connected */
-            goto success;           /* don't want to test read bit */
-        } else {
-            assert(dev->connect_state == DEV_CONNECTED);
-            if (_handle_write(dev))
-                goto ioerr;
-        }
+        assert(dev->connect_state == DEV_CONNECTED);
+        if (_handle_write(dev))
+            goto ioerr;
     }
     /* ready for reading */
     if (flags & XPOLLIN) {
+        int used = cbuf_used(dev->from);
+
         if (_handle_read(dev))
             goto ioerr;
         if (dev->preprocess != NULL)
             dev->preprocess(dev);   /* preprocess input, e.g. telnet escapes */
+        if (dev->capture)
+            _capture_read(dev, cbuf_used(dev->from) - used);
     }
-success:
     return false;
 ioerr:
     return true;
@@ -1553,6 +2045,13 @@ void dev_pre_poll(xpollfd_t pfd)
     while ((dev = list_next(itr))) {
         short flags = 0;
 
+        /* a connect in progress may be racing several sockets */
+        if (dev->connect_state == DEV_CONNECTING) {
+            assert(dev->connect_pre_poll != NULL);
+            dev->connect_pre_poll(dev, pfd);
+            continue;
+        }
+
         if (dev->fd < 0)
             continue;
 
@@ -1563,17 +2062,17 @@ void dev_pre_poll(xpollfd_t pfd)
 
         /* need to be in the write set if we are sending anything */
         if (dev->connect_state == DEV_CONNECTED) {
-            if (!cbuf_is_empty(dev->to))
+            if (dev->to && !cbuf_is_empty(dev->to))
                 flags |= XPOLLOUT;
         }
 
-        /* descriptor will become writable after a connect */
-        if (dev->connect_state == DEV_CONNECTING)
-            flags |= XPOLLOUT;
-
         xpollfd_set(pfd, dev->fd, flags);
     }
     list_iterator_destroy(itr);
+
+    pipe_pre_poll(pfd);
+    tcp_pre_poll(pfd);
+    replay_pre_poll(pfd);
 }
 
 /*
@@ -1583,22 +2082,31 @@ void dev_post_poll(xpollfd_t pfd, struct timeval *timeout)
 {
     Device *dev;
     ListIterator itr;
+    List due = list_create(NULL);
+    xmem_tag_t tag = xmem_tag_set(XMEM_DEVICE);
+
+    /* Consume resolver wakeups before checking on connecting devices.
+     */
+    tcp_post_poll(pfd);
 
     itr = list_iterator_create(dev_devices);
     while ((dev = list_next(itr))) {
-        short flags = dev->fd != NO_FD ? xpollfd_revents(pfd, dev->fd) : 0;
+        short flags = 0;
         bool ioerr = false;
+        bool busy;
+
+        /* A connect is in progress - it may finish, fail, or need a
+         * timeout to start its next attempt.
+         */
+        if (dev->connect_state == DEV_CONNECTING)
+            ioerr = _finish_connect(dev, pfd, timeout);
 
         /* A device is "ready", e.g. it can be read/written or has an error */
-        if (flags)
+        else if (dev->fd != NO_FD && (flags = xpollfd_revents(pfd, dev->fd)))
             ioerr = _handle_ready_device(dev, flags);
 
-        /* Either initiate reconnect or recalculate timeout (for backoff)
-         * so poll will unblock then.  If successful, _reconnect()
-         * will enqueue a login action which will need processing below.
-         */
-        if (ioerr || dev->connect_state == DEV_NOT_CONNECTED)
-            _reconnect(dev, timeout); /* can update dev->connect_state */
+        if (ioerr && dev->connect_state != DEV_NOT_CONNECTED)
+            _disconnect(dev);
 
         /* If we are periodically "pinging" this device, we may need to
          * enqueue a ping action, or update the timeout so poll will
@@ -1615,9 +2123,213 @@ void dev_post_poll(xpollfd_t pfd, struct timeval *timeout)
          * which expedites a reconnect;  if the reconnect then times out,
          * we have to time out the actions (e.g. tell the user).
          */
+         busy = !list_is_empty(dev->acts);
          _process_action(dev, timeout);
+
+        /* Note device activity, or give back the buffers of a device that
+         * has been idle a while.  The latter waits for some other wakeup.
+         */
+        if (dev->connect_state == DEV_CONNECTED) {
+            if (flags || busy) {
+                if (gettimeofday(&dev->last_busy, NULL) < 0)
+                    err_exit(true, "gettimeofday");
+            } else
+                _put_idle_bufs(dev);
+        }
+
+        /* Either queue the device for reconnect or recalculate timeout
+         * (for backoff) so poll will unblock then.
+         */
+        if (dev->connect_state == DEV_NOT_CONNECTED
+                && _time_to_reconnect(dev, timeout))
+            list_append(due, dev);
     }
     list_iterator_destroy(itr);
+
+    /* Reconnect devices that are due, subject to connect_limit.
+     * A successful connect enqueues a login action, processed here too.
+     */
+    _schedule_connects(due, timeout);
+    list_destroy(due);
+
+    /* Reap coprocesses that were terminated on disconnect.
+     */
+    pipe_post_poll(pfd, timeout);
+
+    /* Play back captured sessions, including any just connected.
+     */
+    replay_post_poll(pfd, timeout);
+
+    xmem_tag_set(tag);
+}
+
+typedef void (*MetricsDevF)(Device *dev, const char *name, const char *labels,
+                            MetricsPrintf fn, void *arg);
+
+static void _metrics_connect(Device *dev, const char *name,
+                             const char *labels, MetricsPrintf fn, void *arg)
+{
+    metrics_hist_print(fn, arg, name, labels, &dev->stat_connect_hist);
+}
+
+static void _metrics_action(Device *dev, const char *name,
+                            const char *labels, MetricsPrintf fn, void *arg)
+{
+    char buf[256];
+    int i;
+
+    for (i = 0; i < NUM_SCRIPTS; i++) {
+        if (!dev->stat_script_hist[i] || !script_names[i])
+            continue;
+        snprintf(buf, sizeof(buf), "%s,script=\"%s\"", labels,
+                 script_names[i]);
+        metrics_hist_print(fn, arg, name, buf, dev->stat_script_hist[i]);
+    }
+}
+
+static void _metrics_errors(Device *dev, const char *name,
+                            const char *labels, MetricsPrintf fn, void *arg)
+{
+    int i;
+
+    for (i = 0; i < NUM_ACT_ERRORS; i++) {
+        if (i == ACT_ESUCCESS)
+            continue;
+        fn(arg, "%s{%s,error=\"%s\"} %lu", name, labels,
+           act_error_names[i], dev->stat_act_errors[i]);
+    }
+}
+
+static void _metrics_queue(Device *dev, const char *name,
+                           const char *labels, MetricsPrintf fn, void *arg)
+{
+    fn(arg, "%s{%s} %d", name, labels, list_count(dev->acts));
+}
+
+static void _metrics_read(Device *dev, const char *name,
+                          const char *labels, MetricsPrintf fn, void *arg)
+{
+    fn(arg, "%s{%s} %lu", name, labels, dev->stat_bytes_read);
+}
+
+static void _metrics_written(Device *dev, const char *name,
+                             const char *labels, MetricsPrintf fn, void *arg)
+{
+    fn(arg, "%s{%s} %lu", name, labels, dev->stat_bytes_written);
+}
+
+static void _metrics_connects(Device *dev, const char *name,
+                              const char *labels, MetricsPrintf fn, void *arg)
+{
+    fn(arg, "%s{%s} %d", name, labels, dev->stat_successful_connects);
+}
+
+static void _metrics_connfails(Device *dev, const char *name,
+                               const char *labels, MetricsPrintf fn, void *arg)
+{
+    fn(arg, "%s{%s} %d", name, labels, dev->stat_failed_connects);
+}
+
+static void _metrics_actions(Device *dev, const char *name,
+                             const char *labels, MetricsPrintf fn, void *arg)
+{
+    fn(arg, "%s{%s} %d", name, labels, dev->stat_successful_actions);
+}
+
+static void _metrics_up(Device *dev, const char *name,
+                        const char *labels, MetricsPrintf fn, void *arg)
+{
+    fn(arg, "%s{%s} %d", name, labels, dev->logged_in ? 1 : 0);
+}
+
+static void _metrics_breaker(Device *dev, const char *name,
+                             const char *labels, MetricsPrintf fn, void *arg)
+{
+    fn(arg, "%s{%s} %d", name, labels, dev->breaker_open ? 1 : 0);
+}
+
+static struct {
+    const char *name;
+    const char *type;
+    const char *help;
+    MetricsDevF print;
+} dev_metrics[] = {
+    { "powerman_device_connect_seconds", "histogram",
+      "Time to connect to the device.", _metrics_connect },
+    { "powerman_device_action_seconds", "histogram",
+      "Time to run a device script, by script.", _metrics_action },
+    { "powerman_device_action_errors_total", "counter",
+      "Device actions that failed, by error.", _metrics_errors },
+    { "powerman_device_queue_depth", "gauge",
+      "Actions queued on the device.", _metrics_queue },
+    { "powerman_device_read_bytes_total", "counter",
+      "Bytes read from the device.", _metrics_read },
+    { "powerman_device_written_bytes_total", "counter",
+      "Bytes written to the device.", _metrics_written },
+    { "powerman_device_connects_total", "counter",
+      "Successful connects to the device.", _metrics_connects },
+    { "powerman_device_connect_failures_total", "counter",
+      "Failed connects to the device.", _metrics_connfails },
+    { "powerman_device_actions_total", "counter",
+      "Device actions that succeeded.", _metrics_actions },
+    { "powerman_device_up", "gauge",
+      "1 if the device is connected and logged in.", _metrics_up },
+    { "powerman_device_breaker_open", "gauge",
+      "1 if the device circuit breaker is open.", _metrics_breaker },
+    { NULL, NULL, NULL, NULL },
+};
+
+/* Metrics are printed one metric family at a time (as the text format
+ * requires), one device at a time within a family.
+ */
+struct dev_metrics_iterator {
+    int family;                 /* index into dev_metrics[] */
+    ListIterator itr;           /* next device in this family */
+    bool started;               /* family header has been printed */
+};
+
+DevMetricsIterator dev_metrics_iterator_create(void)
+{
+    DevMetricsIterator mi = (DevMetricsIterator)xmalloc(sizeof(*mi));
+
+    mi->family = 0;
+    mi->itr = list_iterator_create(dev_devices);
+    mi->started = false;
+    return mi;
+}
+
+void dev_metrics_iterator_destroy(DevMetricsIterator mi)
+{
+    list_iterator_destroy(mi->itr);
+    xfree(mi);
+}
+
+bool dev_metrics_next(DevMetricsIterator mi, MetricsPrintf fn, void *arg)
+{
+    Device *dev;
+
+    while (dev_metrics[mi->family].name) {
+        if (!mi->started) {
+            metrics_header(fn, arg, dev_metrics[mi->family].name,
+                           dev_metrics[mi->family].type,
+                           dev_metrics[mi->family].help);
+            mi->started = true;
+        }
+        if ((dev = list_next(mi->itr))) {
+            char *name = metrics_escape(dev->name);
+            char *labels = hsprintf("device=\"%s\"", name);
+
+            dev_metrics[mi->family].print(dev, dev_metrics[mi->family].name,
+                                          labels, fn, arg);
+            xfree(labels);
+            xfree(name);
+            return true;
+        }
+        list_iterator_reset(mi->itr);
+        mi->family++;
+        mi->started = false;
+    }
+    return false;
 }
 
 /*
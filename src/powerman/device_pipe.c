@@ -25,7 +25,9 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
+#include <sys/time.h>
 #include <signal.h>
+#include <spawn.h>
 
 #include "hostlist.h"
 #include "list.h"
@@ -36,18 +38,245 @@
 #include "pluglist.h"
 #include "arglist.h"
 #include "xregex.h"
+#include "metrics.h"
 #include "device_private.h"
 #include "device_pipe.h"
 #include "error.h"
 #include "debug.h"
 #include "argv.h"
 #include "fdutil.h"
+#include "xsignal.h"
+
+/* Seconds a coprocess is given to exit after SIGTERM before SIGKILL.
+ */
+#define PIPE_KILL_TIMEOUT   5
+
+/* Seconds pipe_fini() waits for coprocesses to exit, before and again
+ * after SIGKILL.
+ */
+#define PIPE_FINI_TIMEOUT   1
+
+extern char **environ;
 
 typedef struct {
     char **argv;
     pid_t cpid;
 } PipeDev;
 
+/* A coprocess that has been sent SIGTERM but not yet reaped.
+ * It outlives the device connection (and possibly the device).
+ */
+typedef struct {
+    pid_t pid;
+    char *name;                 /* device name */
+    char *prog;                 /* argv[0] of the coprocess */
+    struct timeval kill_time;   /* when to escalate to SIGKILL */
+    bool killed;
+} PipeChild;
+
+static List pipe_children = NULL;
+
+/* SIGCHLD handler writes here to wake up the poll loop.
+ */
+static int chldpipe[2] = { -1, -1 };
+
+static void _child_destroy(PipeChild *child)
+{
+    xfree(child->name);
+    xfree(child->prog);
+    xfree(child);
+}
+
+static void _sigchld_handler(int signum)
+{
+    int saved_errno = errno;
+    ssize_t n;
+
+    /* if the pipe is full, a wakeup is already pending */
+    n = write(chldpipe[1], "", 1);
+    (void)n;
+    errno = saved_errno;
+}
+
+/* initialize this module */
+void pipe_init(void)
+{
+    pipe_children = list_create((ListDelF)_child_destroy);
+    if (pipe(chldpipe) < 0)
+        err_exit(true, "could not create pipe for SIGCHLD");
+    nonblock_set(chldpipe[0]);
+    nonblock_set(chldpipe[1]);
+    cloexec_set(chldpipe[0]);
+    cloexec_set(chldpipe[1]);
+    xsignal(SIGCHLD, _sigchld_handler);
+}
+
+/* Collect exit status of child if it has terminated.
+ * Return true if child was reaped.
+ */
+static bool _reap(PipeChild *child)
+{
+    int wstat;
+    pid_t pid;
+
+    do {
+        pid = waitpid(child->pid, &wstat, WNOHANG);
+    } while (pid < 0 && errno == EINTR);
+    if (pid == 0)
+        return false;
+    if (pid < 0) {
+        err(true, "_reap(%s): wait", child->name);
+        return true;
+    }
+    if (WIFEXITED(wstat)) {
+        if (WEXITSTATUS(wstat) == 0)
+            dbg(DBG_DEVICE, "_reap(%s): %s exited with status 0",
+                    child->name, child->prog);
+        else
+            err(false, "_reap(%s): %s exited with status %d",
+                    child->name, child->prog, WEXITSTATUS(wstat));
+    } else if (WIFSIGNALED(wstat)) {
+        if (WTERMSIG(wstat) == SIGTERM)
+            dbg(DBG_DEVICE, "_reap(%s): %s terminated",
+                    child->name, child->prog);
+        else
+            err(false, "_reap(%s): %s terminated with signal %d",
+                    child->name, child->prog, WTERMSIG(wstat));
+    } else {
+        err(false, "_reap(%s): %s terminated",
+                child->name, child->prog);
+    }
+    return true;
+}
+
+/* Send SIGKILL to child if it has outstayed its welcome.
+ * Otherwise, update timeout so poll will unblock when it is time.
+ */
+static void _kill_overdue(PipeChild *child, struct timeval *timeout)
+{
+    struct timeval now, timeleft;
+
+    if (child->killed)
+        return;
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    if (timercmp(&now, &child->kill_time, >=)) {
+        err(false, "_kill_overdue(%s): %s did not exit, sending SIGKILL",
+                child->name, child->prog);
+        kill(child->pid, SIGKILL); /* ignore errors */
+        child->killed = true;
+    } else if (timeout) {
+        timersub(&child->kill_time, &now, &timeleft);
+        dev_update_timeout(timeout, &timeleft);
+    }
+}
+
+/* Reap any terminated children without blocking.
+ */
+static void _reap_children(struct timeval *timeout)
+{
+    ListIterator itr;
+    PipeChild *child;
+
+    itr = list_iterator_create(pipe_children);
+    while ((child = list_next(itr))) {
+        if (_reap(child))
+            list_delete(itr);
+        else
+            _kill_overdue(child, timeout);
+    }
+    list_iterator_destroy(itr);
+}
+
+/* Wait up to PIPE_FINI_TIMEOUT seconds for children to be reaped,
+ * waking up on SIGCHLD.
+ */
+static void _wait_children(void)
+{
+    struct timeval now, deadline, timeout;
+    struct timeval limit = { PIPE_FINI_TIMEOUT, 0 };
+    xpollfd_t pfd = xpollfd_create();
+    char buf[64];
+
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    timeradd(&now, &limit, &deadline);
+    for (;;) {
+        _reap_children(NULL);
+        if (list_is_empty(pipe_children))
+            break;
+        if (gettimeofday(&now, NULL) < 0)
+            err_exit(true, "gettimeofday");
+        if (!timercmp(&now, &deadline, <))
+            break;
+        timersub(&deadline, &now, &timeout);
+        xpollfd_zero(pfd);
+        xpollfd_set(pfd, chldpipe[0], XPOLLIN);
+        xpoll(pfd, &timeout);
+        while (read(chldpipe[0], buf, sizeof(buf)) > 0)
+            ;
+    }
+    xpollfd_destroy(pfd);
+}
+
+/* tear down this module - give children still exiting a moment, then
+ * SIGKILL them and wait once more.  A child stuck in the kernel may
+ * never be reaped, so give up on it rather than hang shutdown.
+ */
+void pipe_fini(void)
+{
+    ListIterator itr;
+    PipeChild *child;
+
+    _wait_children();
+    if (!list_is_empty(pipe_children)) {
+        itr = list_iterator_create(pipe_children);
+        while ((child = list_next(itr))) {
+            kill(child->pid, SIGKILL); /* ignore errors */
+            child->killed = true;
+        }
+        list_iterator_destroy(itr);
+        _wait_children();
+
+        itr = list_iterator_create(pipe_children);
+        while ((child = list_next(itr)))
+            err(false, "pipe_fini(%s): %s (pid %d) not reaped, giving up",
+                    child->name, child->prog, (int)child->pid);
+        list_iterator_destroy(itr);
+    }
+    list_destroy(pipe_children);
+    pipe_children = NULL;
+
+    xsignal(SIGCHLD, SIG_DFL);
+    (void)close(chldpipe[0]);
+    (void)close(chldpipe[1]);
+    chldpipe[0] = chldpipe[1] = -1;
+}
+
+/* Called before poll to ready pfd.
+ */
+void pipe_pre_poll(xpollfd_t pfd)
+{
+    if (chldpipe[0] >= 0)
+        xpollfd_set(pfd, chldpipe[0], XPOLLIN);
+}
+
+/* Called after poll to reap children and escalate to SIGKILL.
+ */
+void pipe_post_poll(xpollfd_t pfd, struct timeval *timeout)
+{
+    char buf[64];
+
+    if (chldpipe[0] < 0)
+        return;
+    if (xpollfd_revents(pfd, chldpipe[0])) {
+        while (read(chldpipe[0], buf, sizeof(buf)) > 0)
+            ;
+    }
+    if (!list_is_empty(pipe_children))
+        _reap_children(timeout);
+}
+
 /* Create "pipe device" data struct.
  * cmdline would normally look something like "/usr/bin/conman -j -Q bay0 |&"
  * (Korn shell style "coprocess" syntax)
@@ -78,6 +307,8 @@ bool pipe_connect(Device * dev)
 {
     int fd[2];
     pid_t pid;
+    posix_spawn_file_actions_t fa;
+    int rc;
     PipeDev *pd = (PipeDev *)dev->data;
 
     assert(dev->connect_state == DEV_NOT_CONNECTED);
@@ -85,32 +316,47 @@ bool pipe_connect(Device * dev)
 
     if (socketpair(PF_LOCAL, SOCK_STREAM, 0, fd) < 0)
         err_exit(true, "_pipe_connect(%s): socketpair", dev->name);
-    pid = fork();
-    if (pid < 0) {
-        err_exit(true, "_pipe_connect(%s): fork", dev->name);
-    } else if (pid == 0) {      /* child */
-        (void)dup2(fd[1], STDIN_FILENO);
-        (void)dup2(fd[1], STDOUT_FILENO);
-        (void)close(fd[1]);
-        (void)close(fd[0]);
-        execv(pd->argv[0], pd->argv);
-        err_exit(true, "exec %s", pd->argv[0]);
-    } else {                    /* parent */
-        (void)close(fd[1]);
 
-        nonblock_set(fd[0]);
+    /* Spawn without copying the daemon's address space, and so that
+     * an exec failure is reported here rather than by the child.
+     */
+    if ((rc = posix_spawn_file_actions_init(&fa)) != 0)
+        goto spawn_error;
+    if ((rc = posix_spawn_file_actions_adddup2(&fa, fd[1], STDIN_FILENO)) != 0
+        || (rc = posix_spawn_file_actions_adddup2(&fa, fd[1],
+                                                  STDOUT_FILENO)) != 0
+        || (rc = posix_spawn_file_actions_addclose(&fa, fd[1])) != 0
+        || (rc = posix_spawn_file_actions_addclose(&fa, fd[0])) != 0) {
+        posix_spawn_file_actions_destroy(&fa);
+        goto spawn_error;
+    }
+    rc = posix_spawn(&pid, pd->argv[0], &fa, NULL, pd->argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    if (rc != 0)
+        goto spawn_error;
 
-        dev->fd = fd[0];
+    (void)close(fd[1]);
 
-        dev->connect_state = DEV_CONNECTED;
-        dev->stat_successful_connects++;
+    nonblock_set(fd[0]);
+    cloexec_set(fd[0]);
 
-        pd->cpid = pid;
+    dev->fd = fd[0];
 
-        dbg(DBG_DEVICE, "_pipe_connect(%s): opened", dev->name);
-    }
+    dev->connect_state = DEV_CONNECTED;
+    dev->stat_successful_connects++;
+
+    pd->cpid = pid;
+
+    dbg(DBG_DEVICE, "_pipe_connect(%s): opened", dev->name);
 
     return (dev->connect_state == DEV_CONNECTED);
+
+spawn_error:
+    (void)close(fd[0]);
+    (void)close(fd[1]);
+    errno = rc;
+    err(true, "_pipe_connect(%s): spawn %s", dev->name, pd->argv[0]);
+    return false;
 }
 
 /*
@@ -130,31 +376,26 @@ void pipe_disconnect(Device * dev)
         dev->fd = NO_FD;
     }
 
-    /* reap child */
+    /* Terminate child and reap it later from the poll loop, so a slow
+     * exit doesn't stall the daemon.
+     */
     if (pd->cpid > 0) {
-        int wstat;
+        PipeChild *child = (PipeChild *)xmalloc(sizeof(PipeChild));
 
         kill(pd->cpid, SIGTERM); /* ignore errors */
-        if (waitpid(pd->cpid, &wstat, 0) < 0)
-            err(true, "_pipe_disconnect(%s): wait", dev->name);
-        if (WIFEXITED(wstat)) {
-            if (WEXITSTATUS(wstat) == 0)
-                dbg(DBG_DEVICE, "_pipe_disconnect(%s): %s exited with status 0",
-                        dev->name, pd->argv[0]);
-            else
-                err(false, "_pipe_disconnect(%s): %s exited with status %d",
-                        dev->name, pd->argv[0], WEXITSTATUS(wstat));
-        } else if (WIFSIGNALED(wstat)) {
-            if (WTERMSIG(wstat) == SIGTERM)
-                dbg(DBG_DEVICE, "_pipe_disconnect(%s): %s terminated",
-                        dev->name, pd->argv[0]);
-            else
-                err(false, "_pipe_disconnect(%s): %s terminated with signal %d",
-                        dev->name, pd->argv[0], WTERMSIG(wstat));
-        } else {
-            err(false, "_pipe_disconnect(%s): %s terminated",
-                    dev->name, pd->argv[0]);
-        }
+
+        child->pid = pd->cpid;
+        child->name = xstrdup(dev->name);
+        child->prog = xstrdup(pd->argv[0]);
+        if (gettimeofday(&child->kill_time, NULL) < 0)
+            err_exit(true, "gettimeofday");
+        child->kill_time.tv_sec += PIPE_KILL_TIMEOUT;
+        child->killed = false;
+
+        if (_reap(child))
+            _child_destroy(child);
+        else
+            list_append(pipe_children, child);
         pd->cpid = -1;
     }
 }
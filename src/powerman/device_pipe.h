@@ -11,6 +11,10 @@
 #ifndef PM_DEVICE_PIPE_H
 #define PM_DEVICE_PIPE_H
 
+void pipe_init(void);
+void pipe_fini(void);
+void pipe_pre_poll(xpollfd_t pfd);
+void pipe_post_poll(xpollfd_t pfd, struct timeval *timeout);
 bool pipe_connect(Device * dev);
 void pipe_disconnect(Device * dev);
 void *pipe_create(char *cmdline, char *flags);
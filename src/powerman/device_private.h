@@ -59,7 +59,8 @@ typedef struct {
 } ResultInterp;
 
 /*
- * A Script is a list of Stmts.
+ * A Script is a NULL-terminated array of Stmts.  It is an array rather than
+ * a List so that any number of devices can step through it at once.
  */
 typedef enum {
     STMT_SEND,
@@ -73,7 +74,7 @@ typedef enum {
     STMT_IFON,
 } StmtType;
 
-typedef struct {
+typedef struct _stmt {
     StmtType type;
     union {
         struct {                /* SEND */
@@ -97,20 +98,34 @@ typedef struct {
             struct timeval tv;  /* delay at this point in the script */
         } delay;
         struct {                /* FOREACHPLUG | FOREACHNODE */
-            List stmts;         /* list of statements to exec in a loop */
+            struct _stmt **stmts; /* statements to exec in a loop */
         } foreach;
         struct {                /* IFON | IFOFF */
-            List stmts;         /* list of statements to exec conditionally */
+            struct _stmt **stmts; /* statements to exec conditionally */
         } ifonoff;
     } u;
 } Stmt;
-typedef List Script;
+typedef Stmt **Script;
+
+/*
+ * Scripts are compiled once per specification and shared, read-only, by
+ * the devices made from it.
+ */
+typedef struct {
+    int refcount;
+    Script scripts[NUM_SCRIPTS];
+    void (*destroy)(Script script);
+} ScriptSet;
 
 /*
  * Device
  */
 typedef enum { DEV_NOT_CONNECTED, DEV_CONNECTING, DEV_CONNECTED } ConnectState;
 
+typedef enum { ACT_ESUCCESS, ACT_EEXPFAIL, ACT_EABORT, ACT_ECONNECTTIMEOUT,
+               ACT_ELOGINTIMEOUT, ACT_EBREAKER } ActError;
+#define NUM_ACT_ERRORS        6 /* count of errors above */
+
 typedef struct _device {
     char *name;                 /* name of device */
 
@@ -120,6 +135,7 @@ typedef struct _device {
     bool logged_in;             /* true if login script has run successfully */
 
     xregex_match_t xmatch;      /* cache regex matches for future $N ref */
+                                /*   (NULL with to/from, see below) */
 
     int fd;                     /* socket, serial device, or pty */
 
@@ -129,21 +145,40 @@ typedef struct _device {
 
     cbuf_t to;                  /* buffer -> device */
     cbuf_t from;                /* buffer <- device */
+                                /*   (NULL unless connected and recently busy) */
+    struct timeval last_busy;   /* time of last I/O or action */
 
     PlugList plugs;             /* list of Plugs (node name <-> plug name) */
-    Script scripts[NUM_SCRIPTS]; /* array of scripts */
+    ScriptSet *scriptset;       /* scripts shared with others of this spec */
+    Script *scripts;            /* scriptset->scripts (NULL entries if none) */
 
     struct timeval last_retry;  /* time of last reconnect retry */
     int retry_count;            /* number of retries attempted */
+    struct timeval retry_delay; /* jittered backoff after last retry */
+    int breaker_failures;       /* consecutive connect/login failures */
+    bool breaker_open;          /* fail actions fast until login succeeds */
+    bool breaker_counted;       /* this connect attempt counted as failed */
 
     struct timeval last_ping;   /* time of last ping (if any) */
     struct timeval ping_period; /* configurable ping period (0.0 = none) */
 
     int stat_successful_connects;
     int stat_successful_actions;
+    int stat_failed_connects;
+    struct timeval stat_connect_time;     /* duration of last connect */
+    struct timeval stat_connect_time_max; /* longest connect */
+    Histogram stat_connect_hist;
+    Histogram *stat_script_hist[NUM_SCRIPTS]; /* action times, on demand */
+    unsigned long stat_act_errors[NUM_ACT_ERRORS];
+    unsigned long stat_bytes_read;
+    unsigned long stat_bytes_written;
+
+    struct capture *capture;    /* session capture (NULL if disabled) */
                                 /* network (e.g. tcp/serial)-specific methods */
     bool (*connect)(struct _device *dev);
-    bool (*finish_connect)(struct _device *dev);
+    bool (*finish_connect)(struct _device *dev, xpollfd_t pfd,
+                           struct timeval *timeout);
+    void (*connect_pre_poll)(struct _device *dev, xpollfd_t pfd);
     void (*preprocess)(struct _device *dev);
     void (*disconnect)(struct _device *dev);
     void (*destroy)(void *data);
@@ -151,8 +186,6 @@ typedef struct _device {
     void *data;
 } Device;
 
-typedef enum { ACT_ESUCCESS, ACT_EEXPFAIL, ACT_EABORT, ACT_ECONNECTTIMEOUT,
-               ACT_ELOGINTIMEOUT } ActError;
 typedef void (*ActionCB) (int client_id, ActError acterr, const char *fmt, ...)
     __attribute__ ((format (printf, 3, 4)));
 typedef void (*VerbosePrintf) (int client_id, const char *fmt, ...)
@@ -171,9 +204,24 @@ bool dev_check_actions(int com, hostlist_t hl);
 
 Device *dev_create(const char *name);
 void dev_destroy(Device * dev);
+void dev_set_scripts(Device * dev, ScriptSet *ss);
+
+ScriptSet *scriptset_create(void (*destroy)(Script script));
+ScriptSet *scriptset_link(ScriptSet *ss);
+void scriptset_unlink(ScriptSet *ss);
+void dev_update_timeout(struct timeval *timeout, struct timeval *tv);
 Device *dev_findbyname(char *name);
 List dev_getdevices(void);
 
+/* Device metrics are printed a chunk at a time so a large configuration
+ * doesn't have to fit in the client's output buffer all at once.
+ * dev_metrics_next() returns false when there is nothing more to print.
+ */
+typedef struct dev_metrics_iterator *DevMetricsIterator;
+DevMetricsIterator dev_metrics_iterator_create(void);
+void dev_metrics_iterator_destroy(DevMetricsIterator itr);
+bool dev_metrics_next(DevMetricsIterator itr, MetricsPrintf fn, void *arg);
+
 #endif /* PM_DEVICE_PRIVATE_H */
 
 /*
@@ -0,0 +1,373 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/*
+ * Implement connect/disconnect device methods for playing back a session
+ * recorded with powermand --capture-dir.
+ *
+ * The device end of a socketpair is driven from the poll loop.  Data the
+ * script sends is consumed in place of each recorded write, and recorded
+ * reads are played back after their original delay divided by the speed
+ * factor.  A recorded write is satisfied once as many bytes have arrived,
+ * or, if it ended in a newline or carriage return, at that byte, so a
+ * script that sends different plug names still stays in step.  Writes that
+ * are telnet option replies are skipped, since only a tcp device negotiates
+ * options.  When a recorded session ends the connection is closed and the
+ * next connect plays the next session, wrapping around at the end of the
+ * file.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+
+#include "hostlist.h"
+#include "list.h"
+#include "cbuf.h"
+#include "parse_util.h"
+#include "xmalloc.h"
+#include "xpoll.h"
+#include "pluglist.h"
+#include "arglist.h"
+#include "xregex.h"
+#include "metrics.h"
+#include "capture.h"
+#include "device_private.h"
+#include "device_replay.h"
+#include "error.h"
+#include "debug.h"
+#include "fdutil.h"
+
+#define TELNET_IAC      255
+#define REPLAY_DRAIN_USEC   10000   /* recheck for unread data at end */
+
+typedef struct {
+    char *path;
+    double speed;               /* 0 = no delays */
+    CaptureRec *recs;
+    int nrecs;
+    int next_session;           /* index of the record to start from */
+
+    int fd;                     /* device end of the socketpair */
+    int cur;                    /* index of the record being played */
+    int got;                    /* bytes received toward a write record */
+    int sent;                   /* bytes sent of a read record */
+    bool write_blocked;         /* wait for XPOLLOUT to send more */
+    bool due_set;
+    struct timeval due;         /* when the current read record is sent */
+    unsigned long mismatches;   /* bytes received that differed */
+} ReplayDev;
+
+/* Devices with a session in progress.
+ */
+static List replay_devices = NULL;
+
+void replay_init(void)
+{
+    replay_devices = list_create(NULL);
+}
+
+void replay_fini(void)
+{
+    list_destroy(replay_devices);
+    replay_devices = NULL;
+}
+
+/* Create "replay device" data struct.
+ * 'path' names a capture file, 'flags' is an optional speed factor.
+ * Returns NULL on error.
+ */
+void *replay_create(char *path, char *flags)
+{
+    ReplayDev *rd = (ReplayDev *)xmalloc(sizeof(ReplayDev));
+    int i;
+
+    rd->path = xstrdup(path);
+    rd->speed = 1.0;
+    if (flags) {
+        char *end;
+
+        rd->speed = strtod(flags, &end);
+        if (*end != '\0' || end == flags || rd->speed < 0) {
+            err(false, "replay %s: speed must be a number >= 0", path);
+            goto error;
+        }
+    }
+    if (!(rd->recs = capture_load(path, &rd->nrecs))) {
+        err(true, "replay %s", path);
+        goto error;
+    }
+    /* start at the first recorded connection */
+    for (i = 0; i < rd->nrecs; i++) {
+        if (rd->recs[i].type == CAPTURE_CONNECT)
+            break;
+    }
+    if (i == rd->nrecs) {
+        err(false, "replay %s: no sessions were captured", path);
+        goto error;
+    }
+    rd->next_session = i;
+    rd->fd = NO_FD;
+    return (void *)rd;
+error:
+    replay_destroy(rd);
+    return NULL;
+}
+
+/* Destroy replay device data struct.
+ */
+void replay_destroy(void *data)
+{
+    ReplayDev *rd = (ReplayDev *)data;
+
+    capture_free(rd->recs, rd->nrecs);
+    xfree(rd->path);
+    xfree(rd);
+}
+
+/* Start playing the next session.
+ */
+bool replay_connect(Device * dev)
+{
+    ReplayDev *rd = (ReplayDev *)dev->data;
+    int fd[2];
+
+    assert(dev->connect_state == DEV_NOT_CONNECTED);
+    assert(dev->fd == NO_FD);
+
+    if (socketpair(PF_LOCAL, SOCK_STREAM, 0, fd) < 0)
+        err_exit(true, "_replay_connect(%s): socketpair", dev->name);
+    nonblock_set(fd[0]);
+    cloexec_set(fd[0]);
+    nonblock_set(fd[1]);
+    cloexec_set(fd[1]);
+
+    dev->fd = fd[0];
+    rd->fd = fd[1];
+    rd->cur = rd->next_session + 1;
+    rd->got = rd->sent = 0;
+    rd->write_blocked = false;
+    rd->due_set = false;
+    rd->mismatches = 0;
+
+    dev->connect_state = DEV_CONNECTED;
+    dev->stat_successful_connects++;
+    list_append(replay_devices, dev);
+
+    dbg(DBG_DEVICE, "_replay_connect(%s): playing %s from record %d",
+        dev->name, rd->path, rd->cur);
+
+    return true;
+}
+
+static int _match_dev(void *x, void *key)
+{
+    return x == key;
+}
+
+void replay_disconnect(Device * dev)
+{
+    ReplayDev *rd = (ReplayDev *)dev->data;
+
+    assert(dev->connect_state == DEV_CONNECTED);
+
+    dbg(DBG_DEVICE, "_replay_disconnect: %s on fd %d (%lu bytes differed)",
+        dev->name, dev->fd, rd->mismatches);
+
+    if (dev->fd >= 0) {
+        if (close(dev->fd) < 0)
+            err(true, "_replay_disconnect: %s close fd %d", dev->name, dev->fd);
+        dev->fd = NO_FD;
+    }
+    if (rd->fd >= 0) {
+        (void)close(rd->fd);
+        rd->fd = NO_FD;
+    }
+    list_delete_all(replay_devices, _match_dev, dev);
+}
+
+/* The recorded session is over (or broke off): hang up on the script,
+ * and arrange for the next connect to play the following session.
+ * Wait until the script has read everything first, since poll reports
+ * the hangup ahead of any unread data.
+ */
+static void _end_session(Device *dev, ReplayDev *rd, struct timeval *timeout)
+{
+    struct timeval tv = { .tv_sec = 0, .tv_usec = REPLAY_DRAIN_USEC };
+    int unread, i;
+
+    if (ioctl(dev->fd, FIONREAD, &unread) == 0 && unread > 0) {
+        dev_update_timeout(timeout, &tv);
+        return;
+    }
+    for (i = rd->cur; i < rd->nrecs; i++) {
+        if (rd->recs[i].type == CAPTURE_CONNECT)
+            break;
+    }
+    if (i == rd->nrecs) {
+        for (i = 0; i < rd->nrecs; i++) {
+            if (rd->recs[i].type == CAPTURE_CONNECT)
+                break;
+        }
+    }
+    dbg(DBG_DEVICE, "_replay_end_session(%s): next session at record %d",
+        dev->name, i);
+    rd->next_session = i;
+    (void)close(rd->fd);
+    rd->fd = NO_FD;
+}
+
+/* Consume data sent by the script against recorded writes.
+ */
+static void _replay_input(Device *dev, ReplayDev *rd)
+{
+    static char buf[MAX_DEV_BUF];
+    int n, i;
+    char eol;
+
+    while ((n = read(rd->fd, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < n; i++) {
+            CaptureRec *r;
+
+            if (rd->cur >= rd->nrecs
+                || rd->recs[rd->cur].type != CAPTURE_WRITE) {
+                rd->mismatches += n - i;
+                break;
+            }
+            r = &rd->recs[rd->cur];
+            if (buf[i] != r->data[rd->got])
+                rd->mismatches++;
+            eol = r->data[r->len - 1];
+            if (++rd->got == r->len
+                || ((eol == '\n' || eol == '\r') && buf[i] == eol)) {
+                rd->cur++;
+                rd->got = 0;
+            }
+        }
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        err(true, "_replay_input(%s): read", dev->name);
+}
+
+/* Play recorded reads that are due, and skip to the next recorded write.
+ */
+static void _replay_output(Device *dev, ReplayDev *rd, struct timeval *timeout)
+{
+    struct timeval now, timeleft;
+
+    while (rd->fd >= 0) {
+        CaptureRec *r;
+
+        if (rd->cur >= rd->nrecs) {
+            _end_session(dev, rd, timeout);
+            break;
+        }
+        r = &rd->recs[rd->cur];
+        if (r->type == CAPTURE_WRITE) {
+            /* telnet option replies from a tcp device won't be repeated */
+            if ((unsigned char)r->data[0] == TELNET_IAC && rd->got == 0) {
+                rd->cur++;
+                continue;
+            }
+            break;
+        }
+        if (r->type != CAPTURE_READ) {
+            _end_session(dev, rd, timeout);
+            break;
+        }
+        if (gettimeofday(&now, NULL) < 0)
+            err_exit(true, "gettimeofday");
+        if (!rd->due_set) {
+            unsigned long usec = rd->speed > 0 ? r->usec / rd->speed : 0;
+            struct timeval delay = {
+                .tv_sec = usec / 1000000,
+                .tv_usec = usec % 1000000,
+            };
+            timeradd(&now, &delay, &rd->due);
+            rd->due_set = true;
+        }
+        if (timercmp(&now, &rd->due, <)) {
+            timersub(&rd->due, &now, &timeleft);
+            dev_update_timeout(timeout, &timeleft);
+            break;
+        }
+        while (rd->sent < r->len) {
+            int n = write(rd->fd, r->data + rd->sent, r->len - rd->sent);
+
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    err(true, "_replay_output(%s): write", dev->name);
+                else
+                    rd->write_blocked = true;
+                return;         /* wait for XPOLLOUT */
+            }
+            rd->sent += n;
+            rd->write_blocked = false;
+        }
+        rd->cur++;
+        rd->sent = 0;
+        rd->due_set = false;
+    }
+}
+
+/* Called before poll to ready pfd.
+ */
+void replay_pre_poll(xpollfd_t pfd)
+{
+    ListIterator itr;
+    Device *dev;
+
+    itr = list_iterator_create(replay_devices);
+    while ((dev = list_next(itr))) {
+        ReplayDev *rd = (ReplayDev *)dev->data;
+        short flags = XPOLLIN;
+
+        if (rd->fd < 0)
+            continue;
+        if (rd->write_blocked)
+            flags |= XPOLLOUT;
+        xpollfd_set(pfd, rd->fd, flags);
+    }
+    list_iterator_destroy(itr);
+}
+
+/* Called after poll to play back sessions in progress.
+ */
+void replay_post_poll(xpollfd_t pfd, struct timeval *timeout)
+{
+    ListIterator itr;
+    Device *dev;
+
+    itr = list_iterator_create(replay_devices);
+    while ((dev = list_next(itr))) {
+        ReplayDev *rd = (ReplayDev *)dev->data;
+
+        if (rd->fd < 0)
+            continue;
+        if (xpollfd_revents(pfd, rd->fd) & XPOLLIN)
+            _replay_input(dev, rd);
+        _replay_output(dev, rd, timeout);
+    }
+    list_iterator_destroy(itr);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
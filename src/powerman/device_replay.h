@@ -0,0 +1,27 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef PM_DEVICE_REPLAY_H
+#define PM_DEVICE_REPLAY_H
+
+void replay_init(void);
+void replay_fini(void);
+void replay_pre_poll(xpollfd_t pfd);
+void replay_post_poll(xpollfd_t pfd, struct timeval *timeout);
+bool replay_connect(Device * dev);
+void replay_disconnect(Device * dev);
+void *replay_create(char *path, char *flags);
+void replay_destroy(void *data);
+
+#endif /* PM_DEVICE_REPLAY_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -33,6 +33,7 @@
 #include "pluglist.h"
 #include "arglist.h"
 #include "xregex.h"
+#include "metrics.h"
 #include "device_private.h"
 #include "device_serial.h"
 #include "error.h"
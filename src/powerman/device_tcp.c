@@ -18,6 +18,7 @@
  * telnet machine running.
  */
 
+#define _GNU_SOURCE             /* for getaddrinfo_a */
 #if HAVE_CONFIG_H
 #include "config.h"
 #endif /* HAVE_CONFIG_H */
@@ -26,7 +27,9 @@
 #include <ctype.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdio.h>
 #include <sys/socket.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <netdb.h>
 #include <assert.h>
@@ -34,6 +37,9 @@
 #define TELCMDS
 #include <arpa/telnet.h>
 #include <sys/time.h>
+#if HAVE_GETADDRINFO_A
+#include <stdatomic.h>
+#endif
 
 #include "list.h"
 #include "hostlist.h"
@@ -44,6 +50,7 @@
 #include "pluglist.h"
 #include "arglist.h"
 #include "xregex.h"
+#include "metrics.h"
 #include "device_private.h"
 #include "error.h"
 #include "debug.h"
@@ -54,6 +61,22 @@
 typedef int socklen_t;                  /* socklen_t is uint32_t in Posix.1g */
 #endif /* !HAVE_SOCKLEN_T */
 
+/* Delay before racing a connect to the next address while earlier
+ * attempts are still in progress (RFC 8305 "Connection Attempt Delay").
+ */
+#define TCP_ATTEMPT_DELAY_MS    250
+
+/* How long shutdown waits in all for name lookups that can't be
+ * canceled, and for their completion notices.
+ */
+#define TCP_SHUTDOWN_TIMEOUT_MS 1000
+
+typedef struct {
+    int fd;                     /* socket, or NO_FD if attempt is over */
+    struct addrinfo *addr;
+    bool polled;                /* fd was in the last poll set */
+} TcpAttempt;
+
 typedef enum { TELNET_NONE, TELNET_CMD, TELNET_OPT } TelnetState;
 typedef struct {
     char *host;
@@ -61,13 +84,52 @@ typedef struct {
     TelnetState tstate;         /* state of telnet processing */
     unsigned char tcmd;         /* buffered telnet command */
     bool quiet;                 /* don't report idle timeout messages */
-    struct addrinfo *addrs;
-    struct addrinfo *cur;
+    struct addrinfo hints;
+    bool resolving;             /* host:port is being resolved */
+    bool resolved_once;         /* a lookup has completed (maybe failed) */
+    struct timeval resolve_start;
+#if HAVE_GETADDRINFO_A
+    struct gaicb gai;           /* asynchronous getaddrinfo request */
+#else
+    int gai_error;
+#endif
+    struct addrinfo *addrs;     /* NULL until host:port is resolved */
+    struct addrinfo **order;    /* addrs with address families interleaved */
+    int naddrs;
+    int next;                   /* index in order of next address to try */
+    TcpAttempt *attempts;       /* connects in progress (one per address) */
+    struct timeval next_attempt; /* when to start next connect attempt */
 } TcpDev;
 
 static void _telnet_init(Device *dev);
 static void _telnet_preprocess(Device * dev);
 
+#if HAVE_GETADDRINFO_A
+/* getaddrinfo_a() completion writes here to wake up the poll loop.
+ */
+static int resolvepipe[2] = { -1, -1 };
+
+/* Number of getaddrinfo_a() completion notices that have yet to write
+ * to resolvepipe.  They run in threads of their own, so this is how
+ * tcp_fini() knows when the pipe can be closed.
+ */
+static atomic_int notify_pending = 0;
+
+/* Set by the first tcp_destroy() that has to wait for a lookup.
+ */
+static struct timeval shutdown_deadline;
+#endif
+
+/* Number of name lookups in progress.
+ */
+static int resolve_count = 0;
+
+/* For reporting how long the first lookup of every device takes at startup.
+ */
+static int startup_pending = 0;
+static int startup_failed = 0;
+static struct timeval startup_start;
+
 static void _parse_options(TcpDev *tcp, char *flags)
 {
     char *tmp = xstrdup(flags);
@@ -83,11 +145,44 @@ static void _parse_options(TcpDev *tcp, char *flags)
     xfree(tmp);
 }
 
+/* Order addresses for connect attempts so that address families
+ * alternate, keeping the getaddrinfo() preference within each family
+ * (RFC 8305 section 4).  Then a dead address family costs at most
+ * one attempt delay before the other one is tried.
+ */
+static void _order_addrs(TcpDev *tcp)
+{
+    struct addrinfo *ai, *first, *other;
+    int n = 0;
+
+    for (ai = tcp->addrs; ai != NULL; ai = ai->ai_next)
+        n++;
+    tcp->order = (struct addrinfo **)xmalloc(n * sizeof(struct addrinfo *));
+    tcp->naddrs = n;
+
+    first = tcp->addrs;
+    other = tcp->addrs;
+    n = 0;
+    while (first || other) {
+        while (first && first->ai_family != tcp->addrs->ai_family)
+            first = first->ai_next;
+        if (first) {
+            tcp->order[n++] = first;
+            first = first->ai_next;
+        }
+        while (other && other->ai_family == tcp->addrs->ai_family)
+            other = other->ai_next;
+        if (other) {
+            tcp->order[n++] = other;
+            other = other->ai_next;
+        }
+    }
+    assert(n == tcp->naddrs);
+}
+
 void *tcp_create(char *host, char *port, char *flags)
 {
     TcpDev *tcp = (TcpDev *)xmalloc(sizeof(TcpDev));
-    struct addrinfo hints;
-    int error;
 
     tcp->host = xstrdup(host);
     tcp->port = xstrdup(port);
@@ -97,46 +192,347 @@ void *tcp_create(char *host, char *port, char *flags)
     if (flags)
         _parse_options(tcp, flags);
 
-    /* Store a list of possible addresses/families to connect to
-     * in the tcp->addrs linked list.
+    /* host:port is resolved when the device first connects, so that
+     * names are looked up concurrently and a slow or failing lookup
+     * doesn't hold up the others.
      */
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = PF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    if ((error = getaddrinfo(tcp->host, tcp->port, &hints, &tcp->addrs)) != 0)
-        err_exit(false, "getaddrinfo %s:%s: %s", tcp->host, tcp->port,
-                                                 gai_strerror(error));
-    if (tcp->addrs == NULL)
-        err_exit(false, "no addresses for server %s:%s", tcp->host, tcp->port);
-    tcp->cur = tcp->addrs;
+    tcp->hints.ai_family = PF_UNSPEC;
+    tcp->hints.ai_socktype = SOCK_STREAM;
+    tcp->resolving = false;
+    tcp->resolved_once = false;
+    tcp->addrs = NULL;
+    startup_pending++;
 
     return (void *)tcp;
 }
 
+#if HAVE_GETADDRINFO_A
+/* Return the time left before shutdown stops waiting on the resolver,
+ * starting the clock on the first call.
+ */
+static void _shutdown_timeleft(struct timespec *ts)
+{
+    struct timeval now, left;
+
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    if (!timerisset(&shutdown_deadline)) {
+        shutdown_deadline = now;
+        shutdown_deadline.tv_usec += TCP_SHUTDOWN_TIMEOUT_MS * 1000;
+        while (shutdown_deadline.tv_usec >= 1000000) {
+            shutdown_deadline.tv_sec++;
+            shutdown_deadline.tv_usec -= 1000000;
+        }
+    }
+    if (timercmp(&now, &shutdown_deadline, <))
+        timersub(&shutdown_deadline, &now, &left);
+    else
+        timerclear(&left);
+    ts->tv_sec = left.tv_sec;
+    ts->tv_nsec = left.tv_usec * 1000;
+}
+
+/* Wait for a lookup that couldn't be canceled to finish.
+ * Return false if it is still running when shutdown stops waiting.
+ */
+static bool _resolve_wait(TcpDev *tcp)
+{
+    const struct gaicb *list[1] = { &tcp->gai };
+    struct timespec ts;
+
+    while (gai_error(&tcp->gai) == EAI_INPROGRESS) {
+        _shutdown_timeleft(&ts);
+        if (ts.tv_sec == 0 && ts.tv_nsec == 0)
+            return false;
+        (void)gai_suspend(list, 1, &ts);
+    }
+    return true;
+}
+#endif
+
 void tcp_destroy(void *data)
 {
     TcpDev *tcp = (TcpDev *)data;
 
+#if HAVE_GETADDRINFO_A
+    /* A lookup that can't be canceled still references tcp, so wait for
+     * it before freeing anything.  If it hangs, leave tcp to it, we are
+     * exiting anyway.
+     */
+    if (tcp->resolving) {
+        switch (gai_cancel(&tcp->gai)) {
+            case EAI_CANCELED:
+                atomic_fetch_sub(&notify_pending, 1);
+                break;
+            case EAI_NOTCANCELED:
+                if (!_resolve_wait(tcp)) {
+                    err(false, "tcp_destroy: lookup of %s:%s still running",
+                        tcp->host, tcp->port);
+                    return;
+                }
+                break;
+        }
+        if (gai_error(&tcp->gai) == 0 && tcp->gai.ar_result)
+            freeaddrinfo(tcp->gai.ar_result);
+        tcp->resolving = false;
+        resolve_count--;
+    }
+#endif
     if (tcp->host)
         xfree(tcp->host);
     if (tcp->port)
         xfree(tcp->port);
     if (tcp->addrs)
         freeaddrinfo(tcp->addrs);
+    if (tcp->order)
+        xfree(tcp->order);
+    if (tcp->attempts)
+        xfree(tcp->attempts);
 
     xfree(tcp);
 }
 
-/* After a successful connect, perform some management on
- * the connection.  Returns true on success, false on error.
+#if HAVE_GETADDRINFO_A
+static void _resolve_notify(union sigval sv)
+{
+    int saved_errno = errno;
+
+    /* if the pipe is full, a wakeup is already pending */
+    if (write(resolvepipe[1], "", 1) < 0)
+        ;
+    atomic_fetch_sub(&notify_pending, 1);
+    errno = saved_errno;
+}
+#endif
+
+/* initialize this module */
+void tcp_init(void)
+{
+#if HAVE_GETADDRINFO_A
+    if (pipe(resolvepipe) < 0)
+        err_exit(true, "could not create pipe for resolver");
+    nonblock_set(resolvepipe[0]);
+    nonblock_set(resolvepipe[1]);
+    cloexec_set(resolvepipe[0]);
+    cloexec_set(resolvepipe[1]);
+#endif
+}
+
+/* tear down this module */
+void tcp_fini(void)
+{
+#if HAVE_GETADDRINFO_A
+    struct timespec ts;
+
+    /* Completion notices of finished lookups may still be on the way to
+     * the pipe, so it stays open until they have all written to it.
+     */
+    while (atomic_load(&notify_pending) > 0) {
+        _shutdown_timeleft(&ts);
+        if (ts.tv_sec == 0 && ts.tv_nsec == 0) {
+            err(false, "tcp_fini: resolver still running, leaving pipe open");
+            return;
+        }
+        usleep(1000);
+    }
+    (void)close(resolvepipe[0]);
+    (void)close(resolvepipe[1]);
+    resolvepipe[0] = resolvepipe[1] = -1;
+#endif
+}
+
+/* Called before poll to ready pfd.
+ */
+void tcp_pre_poll(xpollfd_t pfd)
+{
+#if HAVE_GETADDRINFO_A
+    if (resolve_count > 0)
+        xpollfd_set(pfd, resolvepipe[0], XPOLLIN);
+#endif
+}
+
+/* Called after poll, before devices are processed, to consume wakeups
+ * from the resolver.
+ */
+void tcp_post_poll(xpollfd_t pfd)
+{
+#if HAVE_GETADDRINFO_A
+    char buf[64];
+
+    if (xpollfd_revents(pfd, resolvepipe[0])) {
+        while (read(resolvepipe[0], buf, sizeof(buf)) > 0)
+            ;
+    }
+#endif
+}
+
+static long _msec_since(struct timeval *start)
+{
+    struct timeval now, delta;
+
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    timersub(&now, start, &delta);
+    return delta.tv_sec * 1000 + delta.tv_usec / 1000;
+}
+
+/* Start resolving host:port in the background.
+ */
+static void _resolve_start(Device *dev)
+{
+    TcpDev *tcp = (TcpDev *)dev->data;
+#if HAVE_GETADDRINFO_A
+    struct gaicb *list[1] = { &tcp->gai };
+    struct sigevent sev;
+    int error;
+#endif
+
+    if (gettimeofday(&tcp->resolve_start, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    if (!timerisset(&startup_start))
+        startup_start = tcp->resolve_start;
+    resolve_count++;
+    tcp->resolving = true;
+
+    dbg(DBG_DEVICE, "tcp_connect(%s): resolving %s:%s", dev->name,
+        tcp->host, tcp->port);
+#if HAVE_GETADDRINFO_A
+    memset(&tcp->gai, 0, sizeof(tcp->gai));
+    tcp->gai.ar_name = tcp->host;
+    tcp->gai.ar_service = tcp->port;
+    tcp->gai.ar_request = &tcp->hints;
+
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD;
+    sev.sigev_notify_function = _resolve_notify;
+
+    /* On error, gai_error() reports it to _resolve_finish() */
+    atomic_fetch_add(&notify_pending, 1);
+    if ((error = getaddrinfo_a(GAI_NOWAIT, list, 1, &sev)) != 0) {
+        atomic_fetch_sub(&notify_pending, 1);
+        err(false, "tcp_connect(%s): getaddrinfo_a: %s", dev->name,
+            gai_strerror(error));
+    }
+#else
+    tcp->gai_error = getaddrinfo(tcp->host, tcp->port, &tcp->hints,
+                                 &tcp->addrs);
+#endif
+}
+
+/* Set up connect attempts for resolved addresses.
+ */
+static void _resolve_done(TcpDev *tcp)
+{
+    int i;
+
+    _order_addrs(tcp);
+    tcp->next = 0;
+    tcp->attempts = (TcpAttempt *)xmalloc(tcp->naddrs * sizeof(TcpAttempt));
+    for (i = 0; i < tcp->naddrs; i++)
+        tcp->attempts[i].fd = NO_FD;
+}
+
+/* Collect the result of resolving host:port.
+ * Return 1 if resolved, 0 if still in progress, -1 on failure.
+ */
+static int _resolve_finish(Device *dev)
+{
+    TcpDev *tcp = (TcpDev *)dev->data;
+    int error;
+
+#if HAVE_GETADDRINFO_A
+    if ((error = gai_error(&tcp->gai)) == EAI_INPROGRESS)
+        return 0;
+    if (error == 0)
+        tcp->addrs = tcp->gai.ar_result;
+#else
+    error = tcp->gai_error;
+#endif
+    tcp->resolving = false;
+    resolve_count--;
+
+    if (error == 0 && tcp->addrs == NULL)
+        error = EAI_NONAME;
+    if (error != 0) {
+        err(false, "tcp_connect(%s): getaddrinfo %s:%s: %s", dev->name,
+            tcp->host, tcp->port, gai_strerror(error));
+        if (!tcp->resolved_once)
+            startup_failed++;
+    } else {
+        dbg(DBG_DEVICE, "tcp_connect(%s): resolved %s:%s in %ldms",
+            dev->name, tcp->host, tcp->port, _msec_since(&tcp->resolve_start));
+        _resolve_done(tcp);
+    }
+    if (!tcp->resolved_once) {
+        tcp->resolved_once = true;
+        if (--startup_pending == 0)
+            dbg(DBG_STARTUP, "looked up all device names in %ldms, %d failed",
+                _msec_since(&startup_start), startup_failed);
+    }
+    return (error == 0 ? 1 : -1);
+}
+
+/* Format addr as a numeric host string for log messages.
+ */
+static const char *_addrstr(struct addrinfo *addr)
+{
+    static char host[NI_MAXHOST];
+
+    if (getnameinfo(addr->ai_addr, addr->ai_addrlen, host, sizeof(host),
+                    NULL, 0, NI_NUMERICHOST) != 0)
+        snprintf(host, sizeof(host), "<unknown>");
+    return host;
+}
+
+static void _close_attempt(TcpAttempt *att)
+{
+    if (att->fd != NO_FD) {
+        (void)close(att->fd);
+        att->fd = NO_FD;
+    }
+}
+
+static int _attempts_in_progress(TcpDev *tcp)
+{
+    int i, n = 0;
+
+    for (i = 0; i < tcp->next; i++) {
+        if (tcp->attempts[i].fd != NO_FD)
+            n++;
+    }
+    return n;
+}
+
+/* Attempt att has connected.  Close the others and adopt its socket.
  */
-static bool tcp_finish_connect_one(Device *dev)
+static void _connect_won(Device *dev, TcpAttempt *att)
+{
+    TcpDev *tcp = (TcpDev *)dev->data;
+    int i;
+
+    dev->fd = att->fd;
+    att->fd = NO_FD;
+    for (i = 0; i < tcp->next; i++)
+        _close_attempt(&tcp->attempts[i]);
+
+    dev->connect_state = DEV_CONNECTED;
+    dev->stat_successful_connects++;
+    _telnet_init(dev);
+
+    dbg(DBG_DEVICE, "tcp_connect(%s): connected to %s", dev->name,
+        _addrstr(att->addr));
+}
+
+/* Check the outcome of a non-blocking connect.
+ * Returns true on success, false on error.
+ */
+static bool _connect_check(TcpAttempt *att)
 {
     int rc;
     int error = 0;
     socklen_t len = sizeof(error);
 
-    rc = getsockopt(dev->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+    rc = getsockopt(att->fd, SOL_SOCKET, SO_ERROR, &error, &len);
     /*
      *  If an error occurred, Berkeley-derived implementations
      *    return 0 with the pending error in 'error'.  But Solaris
@@ -144,75 +540,148 @@ static bool tcp_finish_connect_one(Device *dev)
      */
     if (rc < 0)
         error = errno;
-    if (! error) {
-        dev->connect_state = DEV_CONNECTED;
-        dev->stat_successful_connects++;
-        _telnet_init(dev);
-        return true;
-    }
-    return false;
+    errno = error;
+    return (error == 0);
 }
 
 /* Obtain a socket for the specified address and attempt to connect it.
  * Return true on completion or connection in progress, false on error.
  */
-static bool tcp_connect_one(Device *dev, struct addrinfo *addr)
+static bool _connect_one(Device *dev, TcpAttempt *att)
 {
-    TcpDev *tcp = (TcpDev *)dev->data;
     int opt;
 
-    assert(tcp->cur != NULL);
-
-    if ((dev->fd = socket(addr->ai_family, addr->ai_socktype, 0)) < 0)
-        return false;
+    att->polled = false;
+    if ((att->fd = socket(att->addr->ai_family,
+                          att->addr->ai_socktype, 0)) < 0)
+        goto error;
     opt = 1;
-    if (setsockopt(dev->fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        close(dev->fd);
-        return false;
-    }
-    nonblock_set(dev->fd);
+    if (setsockopt(att->fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+        goto error;
+    nonblock_set(att->fd);
 
-    if (connect(dev->fd, addr->ai_addr, addr->ai_addrlen) >= 0)
-        return tcp_finish_connect_one(dev);
-    else if (errno == EINPROGRESS)
+    if (connect(att->fd, att->addr->ai_addr, att->addr->ai_addrlen) >= 0) {
+        _connect_won(dev, att);
+        return true;
+    }
+    if (errno == EINPROGRESS) {
+        dbg(DBG_DEVICE, "tcp_connect(%s): connecting to %s", dev->name,
+            _addrstr(att->addr));
         return true;
+    }
+error:
+    dbg(DBG_DEVICE, "tcp_connect(%s): %s: %s", dev->name,
+        _addrstr(att->addr), strerror(errno));
+    _close_attempt(att);
+    return false;
+}
+
+/* Start a connect attempt on the next address that doesn't fail outright,
+ * and schedule the one after that.  Return false if out of addresses.
+ */
+static bool _connect_next(Device *dev)
+{
+    TcpDev *tcp = (TcpDev *)dev->data;
 
-    close(dev->fd);
+    while (tcp->next < tcp->naddrs) {
+        TcpAttempt *att = &tcp->attempts[tcp->next];
+
+        att->addr = tcp->order[tcp->next++];
+        if (_connect_one(dev, att)) {
+            if (gettimeofday(&tcp->next_attempt, NULL) < 0)
+                err_exit(true, "gettimeofday");
+            tcp->next_attempt.tv_usec += TCP_ATTEMPT_DELAY_MS * 1000;
+            while (tcp->next_attempt.tv_usec >= 1000000) {
+                tcp->next_attempt.tv_sec++;
+                tcp->next_attempt.tv_usec -= 1000000;
+            }
+            return true;
+        }
+    }
     return false;
 }
 
+/* Register sockets of connects in progress with poll.
+ */
+void tcp_connect_pre_poll(Device *dev, xpollfd_t pfd)
+{
+    TcpDev *tcp = (TcpDev *)dev->data;
+    int i;
+
+    assert(dev->connect_state == DEV_CONNECTING);
+
+    for (i = 0; i < tcp->next; i++) {
+        TcpAttempt *att = &tcp->attempts[i];
+
+        if (att->fd != NO_FD) {
+            xpollfd_set(pfd, att->fd, XPOLLOUT);
+            att->polled = true;
+        }
+    }
+}
+
 /*
- * Continue TCP connect when fd unblocks.
+ * Continue TCP connect after poll.  Connect attempts to successive
+ * addresses are started TCP_ATTEMPT_DELAY_MS apart, or as soon as the
+ * previous one fails, and the first to succeed wins.  timeout is updated
+ * so poll unblocks in time to start the next attempt.
  * Return false on error, which triggers timed retry of tcp_connect().
- * Return true if connected or still connecting (on the next address).
+ * Return true if connected or still connecting.
  */
-bool tcp_finish_connect(Device * dev)
+bool tcp_finish_connect(Device * dev, xpollfd_t pfd, struct timeval *timeout)
 {
-    TcpDev *tcp;
+    TcpDev *tcp = (TcpDev *)dev->data;
+    struct timeval now, timeleft;
+    int i;
 
     assert(dev->connect_state == DEV_CONNECTING);
 
-    tcp = (TcpDev *)dev->data;
+    /* connect attempts start once host:port is resolved */
+    if (tcp->resolving) {
+        switch (_resolve_finish(dev)) {
+            case 0:
+                return true;
+            case -1:
+                dev->connect_state = DEV_NOT_CONNECTED;
+                return false;
+        }
+    }
+
+    for (i = 0; i < tcp->next; i++) {
+        TcpAttempt *att = &tcp->attempts[i];
+
+        if (att->fd == NO_FD || !att->polled || !xpollfd_revents(pfd, att->fd))
+            continue;
+        if (_connect_check(att)) {
+            _connect_won(dev, att);
+            return true;
+        }
+        dbg(DBG_DEVICE, "tcp_finish_connect(%s): %s: %s", dev->name,
+            _addrstr(att->addr), strerror(errno));
+        _close_attempt(att);
+    }
 
-    if (!tcp_finish_connect_one(dev)) {
-        tcp->cur = tcp->cur->ai_next;
-        while (tcp->cur && !tcp_connect_one(dev, tcp->cur))
-            tcp->cur = tcp->cur->ai_next;
-        if (tcp->cur == NULL)
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    if (_attempts_in_progress(tcp) == 0
+            || timercmp(&now, &tcp->next_attempt, >=)) {
+        if (!_connect_next(dev) && _attempts_in_progress(tcp) == 0) {
             dev->connect_state = DEV_NOT_CONNECTED;
+            err(false, "tcp_finish_connect(%s): connection refused",
+                dev->name);
+            return false;
+        }
+        if (dev->connect_state == DEV_CONNECTED)
+            return true;
     }
-    switch(dev->connect_state) {
-        case DEV_NOT_CONNECTED:
-            err(false, "tcp_finish_connect(%s): connection refused", dev->name);
-            break;
-        case DEV_CONNECTED:
-            dbg(DBG_DEVICE, "tcp_finish_connect(%s): connected", dev->name);
-            break;
-        case DEV_CONNECTING:
-            dbg(DBG_DEVICE, "tcp_finish_connect(%s): connecting", dev->name);
-            break;
+    if (tcp->next < tcp->naddrs) {
+        if (timercmp(&now, &tcp->next_attempt, <))
+            timersub(&tcp->next_attempt, &now, &timeleft);
+        else
+            timerclear(&timeleft);
+        dev_update_timeout(timeout, &timeleft);
     }
-    return (dev->connect_state != DEV_NOT_CONNECTED);
+    return true;
 }
 
 /*
@@ -230,9 +699,24 @@ bool tcp_connect(Device * dev)
     tcp = (TcpDev *)dev->data;
 
     dev->connect_state = DEV_CONNECTING;
-    while (tcp->cur && !tcp_connect_one(dev, tcp->cur))
-        tcp->cur = tcp->cur->ai_next;
-    if (tcp->cur == NULL)
+
+    /* Resolve host:port first, retrying on each reconnect until it works.
+     * If it doesn't finish here, tcp_finish_connect() carries on.
+     */
+    if (!tcp->addrs) {
+        if (!tcp->resolving)
+            _resolve_start(dev);
+        switch (_resolve_finish(dev)) {
+            case 0:
+                return false;
+            case -1:
+                dev->connect_state = DEV_NOT_CONNECTED;
+                return false;
+        }
+    }
+
+    tcp->next = 0;
+    if (!_connect_next(dev))
         dev->connect_state = DEV_NOT_CONNECTED;
 
     switch(dev->connect_state) {
@@ -255,11 +739,18 @@ bool tcp_connect(Device * dev)
  */
 void tcp_disconnect(Device * dev)
 {
+    TcpDev *tcp = (TcpDev *)dev->data;
+    int i;
+
     assert(dev->connect_state == DEV_CONNECTING
            || dev->connect_state == DEV_CONNECTED);
 
     dbg(DBG_DEVICE, "tcp_disconnect: %s on fd %d", dev->name, dev->fd);
 
+    /* abandon any connects in progress */
+    for (i = 0; i < tcp->next; i++)
+        _close_attempt(&tcp->attempts[i]);
+
     /* close socket if open */
     if (dev->fd >= 0) {
         if (close(dev->fd) < 0)
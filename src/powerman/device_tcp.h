@@ -11,7 +11,12 @@
 #ifndef PM_DEVICE_TCP_H
 #define PM_DEVICE_TCP_H
 
-bool tcp_finish_connect(Device * dev);
+void tcp_init(void);
+void tcp_fini(void);
+void tcp_pre_poll(xpollfd_t pfd);
+void tcp_post_poll(xpollfd_t pfd);
+bool tcp_finish_connect(Device * dev, xpollfd_t pfd, struct timeval *timeout);
+void tcp_connect_pre_poll(Device * dev, xpollfd_t pfd);
 bool tcp_connect(Device * dev);
 void tcp_disconnect(Device * dev);
 void tcp_preprocess(Device * dev);
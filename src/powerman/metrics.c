@@ -0,0 +1,121 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/time.h>
+#include <string.h>
+
+#include "xmalloc.h"
+#include "error.h"
+#include "metrics.h"
+
+/* Upper bounds of the histogram buckets in seconds.  Device actions range
+ * from a few milliseconds for a local coprocess to many seconds for a
+ * slow BMC, so the buckets are spread over that range.
+ */
+static const double bounds[METRICS_BUCKETS] = {
+    0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5
+};
+
+static Histogram poll_hist;
+
+void metrics_hist_observe(Histogram *h, struct timeval *tv)
+{
+    double secs = tv->tv_sec + tv->tv_usec / 1E6;
+    int i;
+
+    for (i = 0; i < METRICS_BUCKETS; i++) {
+        if (secs <= bounds[i])
+            break;
+    }
+    h->bucket[i]++;
+    h->count++;
+    h->sum += secs;
+}
+
+void metrics_hist_since(Histogram *h, struct timeval *start)
+{
+    struct timeval now, elapsed;
+
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    timersub(&now, start, &elapsed);
+    metrics_hist_observe(h, &elapsed);
+}
+
+char *metrics_escape(const char *str)
+{
+    char *cpy = xmalloc(strlen(str) * 2 + 1);
+    char *p = cpy;
+
+    while (*str) {
+        if (*str == '\\' || *str == '"') {
+            *p++ = '\\';
+            *p++ = *str;
+        } else if (*str == '\n') {
+            *p++ = '\\';
+            *p++ = 'n';
+        } else
+            *p++ = *str;
+        str++;
+    }
+    *p = '\0';
+    return cpy;
+}
+
+void metrics_header(MetricsPrintf fn, void *arg, const char *name,
+                    const char *type, const char *help)
+{
+    fn(arg, "# HELP %s %s", name, help);
+    fn(arg, "# TYPE %s %s", name, type);
+}
+
+void metrics_hist_print(MetricsPrintf fn, void *arg, const char *name,
+                        const char *labels, Histogram *h)
+{
+    const char *sep = labels ? "," : "";
+    unsigned long cum = 0;
+    int i;
+
+    if (!labels)
+        labels = "";
+    for (i = 0; i < METRICS_BUCKETS; i++) {
+        cum += h->bucket[i];
+        fn(arg, "%s_bucket{%s%sle=\"%g\"} %lu", name, labels, sep,
+           bounds[i], cum);
+    }
+    fn(arg, "%s_bucket{%s%sle=\"+Inf\"} %lu", name, labels, sep, h->count);
+    if (*labels) {
+        fn(arg, "%s_sum{%s} %.6f", name, labels, h->sum);
+        fn(arg, "%s_count{%s} %lu", name, labels, h->count);
+    } else {
+        fn(arg, "%s_sum %.6f", name, h->sum);
+        fn(arg, "%s_count %lu", name, h->count);
+    }
+}
+
+void metrics_poll_observe(struct timeval *start)
+{
+    metrics_hist_since(&poll_hist, start);
+}
+
+void metrics_poll_print(MetricsPrintf fn, void *arg)
+{
+    metrics_header(fn, arg, "powerman_poll_loop_seconds", "histogram",
+                   "Time spent processing each pass of the poll loop.");
+    metrics_hist_print(fn, arg, "powerman_poll_loop_seconds", NULL,
+                       &poll_hist);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
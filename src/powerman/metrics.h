@@ -0,0 +1,63 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef PM_METRICS_H
+#define PM_METRICS_H
+
+#include <sys/time.h>
+
+/* Latency histograms and helpers for printing metrics in the Prometheus
+ * text exposition format.  Output is produced one line at a time through
+ * a MetricsPrintf callback so the caller decides where it goes.
+ */
+
+#define METRICS_BUCKETS 10  /* not counting +Inf */
+
+typedef struct {
+    unsigned long bucket[METRICS_BUCKETS + 1]; /* last one is +Inf */
+    unsigned long count;
+    double sum;                                /* seconds */
+} Histogram;
+
+typedef void (*MetricsPrintf)(void *arg, const char *fmt, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+void metrics_hist_observe(Histogram *h, struct timeval *tv);
+
+/* Record elapsed time since 'start'.
+ */
+void metrics_hist_since(Histogram *h, struct timeval *start);
+
+/* Escape a label value.  Caller must xfree() the result.
+ */
+char *metrics_escape(const char *str);
+
+/* Print "# HELP" and "# TYPE" lines that start a metric family.
+ */
+void metrics_header(MetricsPrintf fn, void *arg, const char *name,
+                    const char *type, const char *help);
+
+/* Print the series of histogram 'h' for metric 'name'.  'labels' is a
+ * comma-separated list of name="value" pairs, or NULL.
+ */
+void metrics_hist_print(MetricsPrintf fn, void *arg, const char *name,
+                        const char *labels, Histogram *h);
+
+/* Time spent processing each pass of the powermand poll loop, not
+ * counting time blocked in poll.
+ */
+void metrics_poll_observe(struct timeval *start);
+void metrics_poll_print(MetricsPrintf fn, void *arg);
+
+#endif /* PM_METRICS_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -35,10 +35,12 @@
 #include "xregex.h"
 #include "pluglist.h"
 #include "arglist.h"
+#include "metrics.h"
 #include "device_private.h"
 #include "device_serial.h"
 #include "device_pipe.h"
 #include "device_tcp.h"
+#include "device_replay.h"
 #include "parse_util.h"
 #include "error.h"
 
@@ -59,7 +61,8 @@ typedef List PreScript;
 
 /*
  * Unprocessed Protocol (used during parsing).
- * This data will be copied for each instantiation of a device.
+ * The scripts are compiled when the first device of this type is
+ * instantiated, and shared by all of them.
  */
 typedef struct {
     char *name;                 /* specification name, e.g. "icebox" */
@@ -67,13 +70,17 @@ typedef struct {
     struct timeval ping_period; /* ping period for this device 0.0 = none */
     List plugs;                 /* list of plug names (e.g. "1" thru "10") */
     PreScript prescripts[NUM_SCRIPTS];  /* array of PreScripts */
-} Spec;                                 /*   script may be NULL if undefined */
+                                        /*   script may be NULL if undefined */
+    ScriptSet *scriptset;       /* compiled scripts (NULL until first use) */
+} Spec;
 
 /* powerman.conf */
 static void makeNode(char *nodestr, char *devstr, char *plugstr);
 static void makeAlias(char *namestr, char *hostsstr);
 static Stmt *makeStmt(PreStmt *p);
 static void destroyStmt(Stmt *stmt);
+static Script makeStmts(List prestmts);
+static void destroyStmts(Script stmts);
 static void makeDevice(char *devstr, char *specstr, char *hoststr,
                         char *portstr);
 
@@ -129,6 +136,7 @@ static Spec current_spec;             /* Holds a Spec as it is built */
 
 /* powerman.conf stuff */
 %token TOK_DEVICE TOK_NODE TOK_ALIAS TOK_TCP_WRAPPERS TOK_LISTEN TOK_PLUG_LOG_LEVEL
+%token TOK_CONNECT_LIMIT TOK_CIRCUIT_BREAKER TOK_BUFFER_IDLE
 
 /* general */
 %token TOK_MATCHPOS TOK_STRING_VAL TOK_NUMERIC_VAL TOK_YES TOK_NO
@@ -151,6 +159,9 @@ config_list     : config_list config_item
 config_item     : listen
                 | TCP_wrappers
                 | plug_log_level
+                | connect_limit
+                | circuit_breaker
+                | buffer_idle
                 | device
                 | node
                 | alias
@@ -169,6 +180,30 @@ plug_log_level          : TOK_PLUG_LOG_LEVEL TOK_STRING_VAL {
     conf_set_plug_log_level($2);
 }
 ;
+connect_limit   : TOK_CONNECT_LIMIT TOK_NUMERIC_VAL {
+    long n = _strtolong($2);
+
+    if (n > INT_MAX)
+        _errormsg("connect_limit is too large");
+    conf_set_connect_limit(n);
+}
+;
+circuit_breaker : TOK_CIRCUIT_BREAKER TOK_NUMERIC_VAL {
+    long n = _strtolong($2);
+
+    if (n > INT_MAX)
+        _errormsg("circuit_breaker is too large");
+    conf_set_circuit_breaker(n);
+}
+;
+buffer_idle     : TOK_BUFFER_IDLE TOK_NUMERIC_VAL {
+    long n = _strtolong($2);
+
+    if (n > INT_MAX)
+        _errormsg("buffer_idle is too large");
+    conf_set_buffer_idle(n);
+}
+;
 listen          : TOK_LISTEN TOK_STRING_VAL {
     conf_add_listen($2);
 }
@@ -476,6 +511,8 @@ static void destroySpec(Spec * spec)
     for (i = 0; i < NUM_SCRIPTS; i++)
         if (spec->prescripts[i])
             list_destroy(spec->prescripts[i]);
+    if (spec->scriptset)
+        scriptset_unlink(spec->scriptset);
     xfree(spec);
 }
 
@@ -598,11 +635,11 @@ static void destroyStmt(Stmt *stmt)
         break;
     case STMT_FOREACHNODE:
     case STMT_FOREACHPLUG:
-        list_destroy(stmt->u.foreach.stmts);
+        destroyStmts(stmt->u.foreach.stmts);
         break;
     case STMT_IFON:
     case STMT_IFOFF:
-        list_destroy(stmt->u.ifonoff.stmts);
+        destroyStmts(stmt->u.ifonoff.stmts);
         break;
     default:
         break;
@@ -610,11 +647,38 @@ static void destroyStmt(Stmt *stmt)
     xfree(stmt);
 }
 
+static void destroyStmts(Script stmts)
+{
+    Stmt **sp;
+
+    for (sp = stmts; *sp != NULL; sp++)
+        destroyStmt(*sp);
+    xfree(stmts);
+}
+
+/* Compile a list of PreStmts into a NULL-terminated array of Stmts.
+ */
+static Script makeStmts(List prestmts)
+{
+    Script stmts;
+    PreStmt *p;
+    ListIterator itr;
+    int i = 0;
+
+    stmts = (Script) xmalloc((list_count(prestmts) + 1) * sizeof(Stmt *));
+    itr = list_iterator_create(prestmts);
+    while((p = list_next(itr))) {
+        stmts[i++] = makeStmt(p);
+    }
+    list_iterator_destroy(itr);
+    stmts[i] = NULL;
+
+    return stmts;
+}
+
 static Stmt *makeStmt(PreStmt *p)
 {
     Stmt *stmt;
-    PreStmt *subp;
-    ListIterator itr;
 
     stmt = (Stmt *) xmalloc(sizeof(Stmt));
     stmt->type = p->type;
@@ -644,21 +708,11 @@ static Stmt *makeStmt(PreStmt *p)
         break;
     case STMT_FOREACHNODE:
     case STMT_FOREACHPLUG:
-        stmt->u.foreach.stmts = list_create((ListDelF) destroyStmt);
-        itr = list_iterator_create(p->prestmts);
-        while((subp = list_next(itr))) {
-            list_append(stmt->u.foreach.stmts, makeStmt(subp));
-        }
-        list_iterator_destroy(itr);
+        stmt->u.foreach.stmts = makeStmts(p->prestmts);
         break;
     case STMT_IFON:
     case STMT_IFOFF:
-        stmt->u.ifonoff.stmts = list_create((ListDelF) destroyStmt);
-        itr = list_iterator_create(p->prestmts);
-        while((subp = list_next(itr))) {
-            list_append(stmt->u.ifonoff.stmts, makeStmt(subp));
-        }
-        list_iterator_destroy(itr);
+        stmt->u.ifonoff.stmts = makeStmts(p->prestmts);
         break;
     default:
         break;
@@ -675,6 +729,19 @@ static void _parse_hoststr(Device *dev, char *hoststr, char *flagstr)
         dev->connect        = pipe_connect;
         dev->disconnect     = pipe_disconnect;
         dev->finish_connect = NULL;
+        dev->connect_pre_poll = NULL;
+        dev->preprocess     = NULL;
+
+    /* replay of a captured session, e.g. "replay:/tmp/cap/pdu0.cap" */
+    } else if (strncmp(hoststr, "replay:", 7) == 0) {
+        dev->data           = replay_create(hoststr + 7, flagstr);
+        if (!dev->data)
+            _errormsg("could not load replay capture");
+        dev->destroy        = replay_destroy;
+        dev->connect        = replay_connect;
+        dev->disconnect     = replay_disconnect;
+        dev->finish_connect = NULL;
+        dev->connect_pre_poll = NULL;
         dev->preprocess     = NULL;
 
     /* serial device, e.g. "/dev/ttyS0" */
@@ -689,6 +756,7 @@ static void _parse_hoststr(Device *dev, char *hoststr, char *flagstr)
         dev->connect        = serial_connect;
         dev->disconnect     = serial_disconnect;
         dev->finish_connect = NULL;
+        dev->connect_pre_poll = NULL;
         dev->preprocess     = NULL;
 
     /* tcp device, e.g. "cyclades0:2001" */
@@ -709,6 +777,7 @@ static void _parse_hoststr(Device *dev, char *hoststr, char *flagstr)
         dev->connect        = tcp_connect;
         dev->disconnect     = tcp_disconnect;
         dev->finish_connect = tcp_finish_connect;
+        dev->connect_pre_poll = tcp_connect_pre_poll;
         dev->preprocess     = tcp_preprocess;
     }
 }
@@ -716,7 +785,6 @@ static void _parse_hoststr(Device *dev, char *hoststr, char *flagstr)
 static void makeDevice(char *devstr, char *specstr, char *hoststr,
                         char *flagstr)
 {
-    ListIterator itr;
     Device *dev;
     Spec *spec;
     int i;
@@ -737,24 +805,15 @@ static void makeDevice(char *devstr, char *specstr, char *hoststr,
     /* create plugs (spec->plugs may be NULL) */
     dev->plugs = pluglist_create(spec->plugs);
 
-    /* transfer remaining info from the spec to the device */
-    for (i = 0; i < NUM_SCRIPTS; i++) {
-        PreStmt *p;
-
-        if (spec->prescripts[i] == NULL) {
-            dev->scripts[i] = NULL;
-            continue; /* unimplemented script */
+    /* compile the scripts the first time the spec is used */
+    if (spec->scriptset == NULL) {
+        spec->scriptset = scriptset_create(destroyStmts);
+        for (i = 0; i < NUM_SCRIPTS; i++) {
+            if (spec->prescripts[i] != NULL) /* else unimplemented script */
+                spec->scriptset->scripts[i] = makeStmts(spec->prescripts[i]);
         }
-
-        dev->scripts[i] = list_create((ListDelF) destroyStmt);
-
-        /* copy the list of statements in each script */
-        itr = list_iterator_create(spec->prescripts[i]);
-        while((p = list_next(itr))) {
-            list_append(dev->scripts[i], makeStmt(p));
-        }
-        list_iterator_destroy(itr);
     }
+    dev_set_scripts(dev, spec->scriptset);
 
     dev_add(dev);
 }
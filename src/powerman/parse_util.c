@@ -53,6 +53,9 @@ typedef struct {
 
 static bool         conf_use_tcp_wrap = false;
 static int          conf_plug_log_level = LOG_DEBUG;    /* syslog level */
+static int          conf_connect_limit = 0; /* max devices connecting */
+static int          conf_circuit_breaker = 0; /* failures to trip breaker */
+static int          conf_buffer_idle = 60;  /* secs before freeing dev bufs */
 static List         conf_listen = NULL;     /* list of host:port strings */
 static hostlist_t   conf_nodes = NULL;
 static List         conf_aliases = NULL;    /* list of alias_t's */
@@ -261,6 +264,36 @@ void conf_set_plug_log_level(char *level_string)
     conf_plug_log_level = level;
 }
 
+int conf_get_connect_limit(void)
+{
+    return conf_connect_limit;
+}
+
+void conf_set_connect_limit(int limit)
+{
+    conf_connect_limit = limit;
+}
+
+int conf_get_circuit_breaker(void)
+{
+    return conf_circuit_breaker;
+}
+
+void conf_set_circuit_breaker(int failures)
+{
+    conf_circuit_breaker = failures;
+}
+
+int conf_get_buffer_idle(void)
+{
+    return conf_buffer_idle;
+}
+
+void conf_set_buffer_idle(int seconds)
+{
+    conf_buffer_idle = seconds;
+}
+
 /*
  * Manage a list of nodename aliases.
  */
@@ -26,6 +26,14 @@ void conf_set_use_tcp_wrappers(bool val);
 int conf_get_plug_log_level(void);
 void conf_set_plug_log_level(char *level);
 
+int conf_get_connect_limit(void);
+void conf_set_connect_limit(int limit);
+
+int conf_get_circuit_breaker(void);
+void conf_set_circuit_breaker(int failures);
+int conf_get_buffer_idle(void);
+void conf_set_buffer_idle(int seconds);
+
 List conf_get_listen(void);
 void conf_add_listen(char *hostport);
 
@@ -46,6 +46,7 @@ static Plug *_create_plug(char *name)
 
     plug->name = xstrdup(name);
     plug->node = NULL;
+    plug->last_state = 0;       /* ST_UNKNOWN */
 
     return plug;
 }
@@ -58,6 +59,7 @@ static Plug *_copy_plug(Plug *p)
 
     plug->name = p->name ? xstrdup(p->name) : NULL;
     plug->node = p->node ? xstrdup(p->node) : NULL;
+    plug->last_state = p->last_state;
 
     return plug;
 }
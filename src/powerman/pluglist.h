@@ -19,6 +19,7 @@
 typedef struct {
     char *name;                 /* how the plug is known to the device */
     char *node;                 /* node name */
+    int last_state;             /* InterpState from last status query */
 } Plug;
 
 typedef struct pluglist_iterator *PlugListIterator;
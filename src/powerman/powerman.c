@@ -56,7 +56,7 @@ static void _set_command (const char **command, const char *value);
 
 static char *prog;
 
-#define OPTIONS "01crfubqtldTxgh:VLR:H"
+#define OPTIONS "01crfubqtldMETmxgh:VLR:H"
 static const struct option longopts[] = {
     // command
     {"on",          no_argument,        0, '1'},
@@ -70,6 +70,9 @@ static const struct option longopts[] = {
     {"temp",        no_argument,        0, 't'},
     {"list",        no_argument,        0, 'l'},
     {"device",      no_argument,        0, 'd'},
+    {"metrics",     no_argument,        0, 'M'},
+    {"trace",       no_argument,        0, 'E'},
+    {"memory",      no_argument,        0, 'm'},
     // options
     {"telemetry",   no_argument,        0, 'T'},
     {"exprange",    no_argument,        0, 'x'},
@@ -145,6 +148,15 @@ int main(int argc, char **argv)
         case 'd':              /* --device */
             _set_command(&command, CP_DEVICE);
             break;
+        case 'M':              /* --metrics */
+            _set_command(&command, CP_METRICS);
+            break;
+        case 'E':              /* --trace */
+            _set_command(&command, CP_TRACE);
+            break;
+        case 'm':              /* --memory */
+            _set_command(&command, CP_MEMORY);
+            break;
         case 'h':              /* --server-host host[:port] */
             if ((p = strchr(optarg, ':'))) {
                 *p++ = '\0';
@@ -280,6 +292,9 @@ static void _usage(void)
 "  -P,--temp            Query temperature on optional targets\n"
 "  -l,--list            List available targets\n"
 "  -d,--device          Show status of devices that control optional targets\n"
+"  -M,--metrics         Show server metrics in Prometheus format\n"
+"  -E,--trace           Dump recent server events as Chrome trace JSON\n"
+"  -m,--memory          Show server memory use by subsystem\n"
 "Options:\n"
 #if WITH_GENDERS
 "  -g,--genders         Interpret targets as attributes\n"
@@ -30,6 +30,9 @@
 #include "parse_util.h"
 #include "xmalloc.h"
 #include "xpoll.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
 #include "xsignal.h"
 #include "pluglist.h"
 #include "device.h"
@@ -44,11 +47,15 @@ static void _usage(char *prog);
 static void _version(void);
 static void _noop_handler(int signum);
 static void _exit_handler(int signum);
+static void _trace_handler(int signum);
 static void _select_loop(void);
+static void _memory_report(void);
 
 static int exitpipe[2];
+static int tracepipe[2];
+static char *trace_filename = NULL;
 
-#define OPTIONS "c:hd:VsY"
+#define OPTIONS "c:hd:VsYt:C:"
 static const struct option longopts[] = {
     {"conf",            required_argument,  0, 'c'},
     {"help",            no_argument,        0, 'h'},
@@ -56,6 +63,8 @@ static const struct option longopts[] = {
     {"version",         no_argument,        0, 'V'},
     {"stdio",           no_argument,        0, 's'},
     {"short-circuit-delay", no_argument,    0, 'Y'},
+    {"trace-file",      required_argument,  0, 't'},
+    {"capture-dir",     required_argument,  0, 'C'},
     {0, 0, 0, 0}
 };
 
@@ -63,8 +72,13 @@ int main(int argc, char **argv)
 {
     int c;
     char *config_filename = NULL;
+    char *capture_dir = NULL;
     bool use_stdio = false;
     bool short_circuit_delay = false;
+    struct timeval start, now;
+
+    /* account for memory by subsystem from the first allocation */
+    xmem_enable();
 
     /* parse command line options */
     err_init(argv[0]);
@@ -94,6 +108,14 @@ int main(int argc, char **argv)
         case 's': /* --stdio */
             use_stdio = true;
             break;
+        case 't': /* --trace-file */
+            if (!trace_filename)
+                trace_filename = xstrdup(optarg);
+            break;
+        case 'C': /* --capture-dir */
+            if (!capture_dir)
+                capture_dir = xstrdup(optarg);
+            break;
         case 'h': /* --help */
         default:
             _usage(argv[0]);
@@ -106,21 +128,38 @@ int main(int argc, char **argv)
         || fcntl (exitpipe[0], F_SETFD, O_CLOEXEC) < 0
         || fcntl (exitpipe[1], F_SETFD, O_CLOEXEC) < 0)
         err_exit (true, "could not create pipe for exit signaling");
+    if (pipe (tracepipe) < 0
+        || fcntl (tracepipe[0], F_SETFD, FD_CLOEXEC) < 0
+        || fcntl (tracepipe[1], F_SETFD, FD_CLOEXEC) < 0
+        || fcntl (tracepipe[0], F_SETFL, O_NONBLOCK) < 0
+        || fcntl (tracepipe[1], F_SETFL, O_NONBLOCK) < 0)
+        err_exit (true, "could not create pipe for trace signaling");
 
     if (!config_filename)
         config_filename = hsprintf("%s/%s/%s", X_SYSCONFDIR,
                                    "powerman", "powerman.conf");
 
+    capture_init(capture_dir);
+    if (capture_dir)
+        xfree(capture_dir);
     dev_init(short_circuit_delay);
     cli_init();
 
+    if (gettimeofday(&start, NULL) < 0)
+        err_exit(true, "gettimeofday");
     conf_init(config_filename);
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    timersub(&now, &start, &now);
+    dbg(DBG_STARTUP, "loaded %s in %ld.%.3lds", config_filename,
+        (long)now.tv_sec, (long)now.tv_usec / 1000);
     xfree(config_filename);
 
     xsignal(SIGHUP, _noop_handler);
     xsignal(SIGTERM, _exit_handler);
     xsignal(SIGINT, _exit_handler);
     xsignal(SIGPIPE, SIG_IGN);
+    xsignal(SIGUSR2, _trace_handler);
 
     cli_start(use_stdio);
 
@@ -130,13 +169,35 @@ int main(int argc, char **argv)
 
     (void)close (exitpipe[0]);
     (void)close (exitpipe[1]);
+    (void)close (tracepipe[0]);
+    (void)close (tracepipe[1]);
+    if (trace_filename)
+        xfree(trace_filename);
 
     cli_fini();
     dev_fini();
     conf_fini();
+    capture_fini();
+    _memory_report();
     return 0;
 }
 
+/* Log memory still allocated at exit, to help find leaks.
+ */
+static void _memory_report(void)
+{
+    long bytes, objs;
+    unsigned long allocs;
+    int i;
+
+    for (i = 0; i < XMEM_NTAGS; i++) {
+        xmem_get(i, &bytes, &objs, &allocs);
+        if (bytes != 0 || objs != 0)
+            dbg(DBG_MEMORY, "%s: %ld bytes in %ld objects not freed",
+                xmem_tag_name(i), bytes, objs);
+    }
+}
+
 static void _usage(char *prog)
 {
     printf("Usage: %s [OPTIONS]\n", prog);
@@ -144,6 +205,8 @@ static void _usage(char *prog)
     printf("  -s,--stdio                Talk to client on stdin/stdout\n");
     printf("  -Y,--short-circuit-delay  Change all device delays to zero\n");
     printf("  -d,--debug=MASK           Enable debug logging\n");
+    printf("  -t,--trace-file=PATH      Dump event trace to PATH on SIGUSR2\n");
+    printf("  -C,--capture-dir=DIR      Record device sessions in DIR\n");
     printf("  -V,--version              Report powerman version\n");
     printf("  -h,--help                 Display help\n");
     exit(0);
@@ -155,9 +218,27 @@ static void _version(void)
     exit(0);
 }
 
+/* Write the event trace to the file named with --trace-file.
+ */
+static void _trace_dump(void)
+{
+    char buf[64];
+
+    while (read(tracepipe[0], buf, sizeof(buf)) > 0)
+        ;
+    if (!trace_filename) {
+        err(false, "SIGUSR2: no trace file was specified with --trace-file");
+        return;
+    }
+    if (trace_dump_file(trace_filename) < 0)
+        err(true, "%s", trace_filename);
+    else
+        dbg(DBG_CLIENT, "wrote trace to %s", trace_filename);
+}
+
 static void _select_loop(void)
 {
-    struct timeval tmout;
+    struct timeval tmout, start;
     xpollfd_t pfd = xpollfd_create();
 
     timerclear(&tmout);
@@ -173,12 +254,17 @@ static void _select_loop(void)
         cli_pre_poll(pfd);
         dev_pre_poll(pfd);
         xpollfd_set(pfd, exitpipe[0], XPOLLIN);
+        xpollfd_set(pfd, tracepipe[0], XPOLLIN);
 
         xpoll(pfd, timerisset(&tmout) ? &tmout : NULL);
         timerclear(&tmout);
+        if (gettimeofday(&start, NULL) < 0)
+            err_exit(true, "gettimeofday");
 
         if (xpollfd_revents(pfd, exitpipe[0]))
             break;
+        if (xpollfd_revents(pfd, tracepipe[0]))
+            _trace_dump();
 
         /*
          * Process activity on client and device fd's.
@@ -187,6 +273,7 @@ static void _select_loop(void)
          */
         cli_post_poll(pfd);
         dev_post_poll(pfd, &tmout);
+        metrics_poll_observe(&start);
 
         if (cli_server_done())
             break;
@@ -207,6 +294,19 @@ static void _exit_handler(int signum)
         err_exit(true, "signal %d: could not write to exit pipe", signum);
 }
 
+/* Wake up the select loop so it can dump the trace outside of signal context.
+ * If the pipe is full a dump is already pending.
+ */
+static void _trace_handler(int signum)
+{
+    int saved_errno = errno;
+    ssize_t n;
+
+    n = write(tracepipe[1], "", 1);
+    (void)n;
+    errno = saved_errno;
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
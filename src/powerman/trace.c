@@ -0,0 +1,234 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "xmalloc.h"
+#include "error.h"
+#include "hash.h"
+#include "trace.h"
+
+#define TRACE_RING_SIZE     16384   /* must be a power of 2 */
+#define TRACE_DUMP_CHUNK    256     /* events per trace_dump_next() */
+
+typedef struct {
+    uint64_t ts;                /* usec since CLOCK_MONOTONIC epoch */
+    const char *track;
+    const char *name;
+    const char *detail;
+    int id;
+    TracePhase ph;
+} TraceRec;
+
+static TraceRec ring[TRACE_RING_SIZE];
+static uint64_t ring_next = 0;  /* total events recorded */
+
+struct trace_dump {
+    TraceRec *recs;             /* snapshot of the ring, oldest first */
+    int count;
+    int next;                   /* next record to print */
+    hash_t tids;                /* track name -> tid */
+    int ntids;
+    bool header_done;
+};
+
+void trace_event(TracePhase ph, const char *track, const char *name,
+                 const char *detail, int id)
+{
+    TraceRec *r = &ring[ring_next++ & (TRACE_RING_SIZE - 1)];
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    r->ts = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    r->track = track;
+    r->name = name;
+    r->detail = detail;
+    r->id = id;
+    r->ph = ph;
+}
+
+TraceDump trace_dump_create(void)
+{
+    TraceDump td = (TraceDump)xmalloc(sizeof(*td));
+    uint64_t first;
+    int i;
+
+    first = ring_next > TRACE_RING_SIZE ? ring_next - TRACE_RING_SIZE : 0;
+    td->count = ring_next - first;
+    td->recs = (TraceRec *)xmalloc(sizeof(TraceRec) * (td->count + 1));
+    for (i = 0; i < td->count; i++)
+        td->recs[i] = ring[(first + i) & (TRACE_RING_SIZE - 1)];
+    td->next = 0;
+    if (!(td->tids = hash_create(1024, (hash_key_f)hash_key_string,
+                                 (hash_cmp_f)strcmp, NULL)))
+        err_exit(true, "hash_create");
+    td->ntids = 0;
+    td->header_done = false;
+    return td;
+}
+
+void trace_dump_destroy(TraceDump td)
+{
+    hash_destroy(td->tids);
+    xfree(td->recs);
+    xfree(td);
+}
+
+/* Copy str to buf as a JSON string body, truncating if necessary.
+ */
+static const char *_json_escape(const char *str, char *buf, int size)
+{
+    int i = 0;
+
+    while (*str && i < size - 7) {
+        unsigned char c = *str++;
+
+        if (c == '"' || c == '\\') {
+            buf[i++] = '\\';
+            buf[i++] = c;
+        } else if (c < 0x20)
+            i += sprintf(&buf[i], "\\u%.4x", c);
+        else
+            buf[i++] = c;
+    }
+    buf[i] = '\0';
+    return buf;
+}
+
+/* Tracks are shown as threads.  Assign each a tid the first time it is
+ * seen and print a metadata event to name it.
+ */
+static int _track_tid(TraceDump td, const char *track, TracePrintf fn,
+                      void *arg)
+{
+    char esc[256];
+    void *tid;
+
+    /* N.B. tids start at 1 and are stored in the data pointer itself */
+    if ((tid = hash_find(td->tids, track)))
+        return (int)(intptr_t)tid;
+    tid = (void *)(intptr_t)++td->ntids;
+    if (!hash_insert(td->tids, track, tid))
+        err_exit(true, "hash_insert");
+    fn(arg, ",{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,"
+       "\"args\":{\"name\":\"%s\"}}", td->ntids,
+       _json_escape(track, esc, sizeof(esc)));
+    return td->ntids;
+}
+
+static void _print_rec(TraceDump td, TraceRec *r, TracePrintf fn, void *arg)
+{
+    static const char *phases[] = { "i", "B", "E", "b", "e" };
+    char esc[256];
+    char args[300] = "";
+    const char *name = r->name ? r->name : "unknown";
+    int tid = 0;
+
+    if (r->track)
+        tid = _track_tid(td, r->track, fn, arg);
+    if (r->detail)
+        snprintf(args, sizeof(args), ",\"args\":{\"detail\":\"%s\"}",
+                 _json_escape(r->detail, esc, sizeof(esc)));
+    switch (r->ph) {
+        case TRACE_INSTANT:
+            fn(arg, ",{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"ts\":%llu,"
+               "\"pid\":1,\"tid\":%d%s}", name,
+               (unsigned long long)r->ts, tid, args);
+            break;
+        case TRACE_BEGIN:
+        case TRACE_END:
+            fn(arg, ",{\"ph\":\"%s\",\"name\":\"%s\",\"ts\":%llu,"
+               "\"pid\":1,\"tid\":%d%s}", phases[r->ph], name,
+               (unsigned long long)r->ts, tid, args);
+            break;
+        case TRACE_ASYNC_BEGIN:
+        case TRACE_ASYNC_END:
+            fn(arg, ",{\"ph\":\"%s\",\"cat\":\"%s\",\"name\":\"%s\","
+               "\"id\":%d,\"ts\":%llu,\"pid\":1,\"tid\":%d%s}",
+               phases[r->ph], r->track ? r->track : "powermand", name,
+               r->id, (unsigned long long)r->ts, tid, args);
+            break;
+    }
+}
+
+bool trace_dump_next(TraceDump td, TracePrintf fn, void *arg)
+{
+    int i;
+
+    if (!td->header_done) {
+        /* a leading metadata event lets every other event start with ',' */
+        fn(arg, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        fn(arg, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,"
+           "\"args\":{\"name\":\"powermand\"}}");
+        td->header_done = true;
+        return true;
+    }
+    if (td->next > td->count)
+        return false;
+    for (i = 0; i < TRACE_DUMP_CHUNK && td->next < td->count; i++)
+        _print_rec(td, &td->recs[td->next++], fn, arg);
+    if (td->next == td->count) {
+        fn(arg, "]}");
+        td->next++;
+    }
+    return true;
+}
+
+static void _file_printf(void *arg, const char *fmt, ...)
+{
+    FILE *fp = arg;
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(fp, fmt, ap);
+    va_end(ap);
+    fputc('\n', fp);
+}
+
+int trace_dump_file(const char *path)
+{
+    TraceDump td;
+    FILE *fp;
+    int fd;
+    int saved_errno;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC,
+              0600);
+    if (fd < 0)
+        return -1;
+    if (!(fp = fdopen(fd, "w"))) {
+        saved_errno = errno;
+        (void)close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+    td = trace_dump_create();
+    while (trace_dump_next(td, _file_printf, fp))
+        ;
+    trace_dump_destroy(td);
+    if (fclose(fp) != 0)
+        return -1;
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,59 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef PM_TRACE_H
+#define PM_TRACE_H
+
+/* Always-on event trace for powermand.  Events go in a fixed-size ring
+ * that overwrites the oldest entries, and can be dumped on demand in the
+ * Chrome trace event JSON format (loadable by Perfetto or chrome://tracing).
+ *
+ * Recording an event just stores a timestamp and some pointers, so it is
+ * cheap enough to leave on.  All strings passed to trace_event() must
+ * remain valid for the life of the daemon (device names, static tables).
+ * The ring is written and read only from the main loop, so it needs no
+ * locking.
+ */
+
+typedef enum {
+    TRACE_INSTANT,              /* point event on a track */
+    TRACE_BEGIN,                /* start of a span on a track */
+    TRACE_END,                  /* end of the innermost span on a track */
+    TRACE_ASYNC_BEGIN,          /* start of a span identified by id */
+    TRACE_ASYNC_END,            /* end of a span identified by id */
+} TracePhase;
+
+typedef void (*TracePrintf)(void *arg, const char *fmt, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+/* Record an event.  'track' groups events on one timeline (e.g. a device
+ * name), 'name' labels the event, 'detail' (may be NULL) is shown as an
+ * argument, and 'id' matches up async begin/end pairs.
+ */
+void trace_event(TracePhase ph, const char *track, const char *name,
+                 const char *detail, int id);
+
+/* Dump a snapshot of the ring a chunk at a time.  trace_dump_next()
+ * returns false when there is nothing more to print.
+ */
+typedef struct trace_dump *TraceDump;
+TraceDump trace_dump_create(void);
+void trace_dump_destroy(TraceDump td);
+bool trace_dump_next(TraceDump td, TracePrintf fn, void *arg);
+
+/* Dump the whole ring to a file.  Returns -1 with errno set on error.
+ */
+int trace_dump_file(const char *path);
+
+#endif /* PM_TRACE_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
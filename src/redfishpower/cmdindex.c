@@ -0,0 +1,171 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cmdindex.h"
+
+#include "xmalloc.h"
+#include "czmq.h"
+#include "error.h"
+
+struct cmdindex {
+    /* map names to zlistx of items */
+    zhashx_t *names;
+    /* map items to zlistx of struct cmdindex_ref, so an item can be
+     * removed from all of its lists without searching them
+     */
+    zhashx_t *refs;
+};
+
+struct cmdindex_ref {
+    char *name;
+    zlistx_t *list;
+    void *handle;
+};
+
+/* zhashx_destructor_fn */
+static void list_destroy_wrapper(void **data)
+{
+    zlistx_t *l = *data;
+    zlistx_destroy(&l);
+    *data = NULL;
+}
+
+/* zlistx_destructor_fn */
+static void ref_destroy_wrapper(void **data)
+{
+    struct cmdindex_ref *ref = *data;
+    if (ref) {
+        xfree(ref->name);
+        xfree(ref);
+        *data = NULL;
+    }
+}
+
+/* zhashx_hash_fn - items are hashed by address */
+static size_t ptr_hasher(const void *key)
+{
+    return (size_t)((uintptr_t)key >> 3);
+}
+
+/* zhashx_comparator_fn */
+static int ptr_comparator(const void *a, const void *b)
+{
+    if (a == b)
+        return 0;
+    return (uintptr_t)a < (uintptr_t)b ? -1 : 1;
+}
+
+cmdindex_t *cmdindex_create(void)
+{
+    cmdindex_t *ci = (cmdindex_t *)xmalloc(sizeof(*ci));
+
+    if (!(ci->names = zhashx_new()))
+        goto cleanup;
+    zhashx_set_destructor(ci->names, list_destroy_wrapper);
+
+    if (!(ci->refs = zhashx_new()))
+        goto cleanup;
+    zhashx_set_destructor(ci->refs, list_destroy_wrapper);
+    zhashx_set_key_hasher(ci->refs, ptr_hasher);
+    zhashx_set_key_comparator(ci->refs, ptr_comparator);
+    zhashx_set_key_duplicator(ci->refs, NULL);
+    zhashx_set_key_destructor(ci->refs, NULL);
+
+    return ci;
+
+cleanup:
+    cmdindex_destroy(ci);
+    return NULL;
+}
+
+void cmdindex_destroy(cmdindex_t *ci)
+{
+    if (ci) {
+        zhashx_destroy(&ci->refs);
+        zhashx_destroy(&ci->names);
+        xfree(ci);
+    }
+}
+
+void cmdindex_add(cmdindex_t *ci, const char *name, void *item)
+{
+    struct cmdindex_ref *ref;
+    zlistx_t *list;
+    zlistx_t *refs;
+
+    if (!(list = zhashx_lookup(ci->names, name))) {
+        if (!(list = zlistx_new()))
+            err_exit(true, "zlistx_new");
+        if (zhashx_insert(ci->names, name, list) < 0)
+            err_exit(false, "zhashx_insert");
+    }
+    if (!(refs = zhashx_lookup(ci->refs, item))) {
+        if (!(refs = zlistx_new()))
+            err_exit(true, "zlistx_new");
+        zlistx_set_destructor(refs, ref_destroy_wrapper);
+        if (zhashx_insert(ci->refs, item, refs) < 0)
+            err_exit(false, "zhashx_insert");
+    }
+
+    ref = (struct cmdindex_ref *)xmalloc(sizeof(*ref));
+    ref->name = xstrdup(name);
+    ref->list = list;
+    if (!(ref->handle = zlistx_add_end(list, item)))
+        err_exit(true, "zlistx_add_end");
+    if (!zlistx_add_end(refs, ref))
+        err_exit(true, "zlistx_add_end");
+}
+
+void cmdindex_remove(cmdindex_t *ci, void *item)
+{
+    struct cmdindex_ref *ref;
+    zlistx_t *refs;
+
+    if (!(refs = zhashx_lookup(ci->refs, item)))
+        return;
+
+    ref = zlistx_first(refs);
+    while (ref) {
+        zlistx_detach(ref->list, ref->handle);
+        if (zlistx_size(ref->list) == 0)
+            zhashx_delete(ci->names, ref->name);
+        ref = zlistx_next(refs);
+    }
+    zhashx_delete(ci->refs, item);
+}
+
+zlistx_t *cmdindex_lookup(cmdindex_t *ci, const char *name)
+{
+    return zhashx_lookup(ci->names, name);
+}
+
+int cmdindex_count(cmdindex_t *ci, const char *name)
+{
+    zlistx_t *list = zhashx_lookup(ci->names, name);
+    return list ? zlistx_size(list) : 0;
+}
+
+void cmdindex_purge(cmdindex_t *ci)
+{
+    zhashx_purge(ci->refs);
+    zhashx_purge(ci->names);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,48 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef REDFISHPOWER_CMDINDEX_H
+#define REDFISHPOWER_CMDINDEX_H
+
+#include "czmq.h"
+
+/* Index of power ops by name (e.g. plugname or parent plugname), so
+ * that the ops related to a plug can be found without scanning every
+ * op.  An op may be indexed under multiple names.  The index does not
+ * own the ops.
+ */
+
+typedef struct cmdindex cmdindex_t;
+
+cmdindex_t *cmdindex_create(void);
+
+void cmdindex_destroy(cmdindex_t *ci);
+
+/* index item under name */
+void cmdindex_add(cmdindex_t *ci, const char *name, void *item);
+
+/* remove item from under all names it is indexed under */
+void cmdindex_remove(cmdindex_t *ci, void *item);
+
+/* items indexed under name, NULL if none.  Do not modify the list,
+ * use zlistx_dup() if the index may change while iterating.
+ */
+zlistx_t *cmdindex_lookup(cmdindex_t *ci, const char *name);
+
+int cmdindex_count(cmdindex_t *ci, const char *name);
+
+/* remove everything */
+void cmdindex_purge(cmdindex_t *ci);
+
+#endif /* REDFISHPOWER_CMDINDEX_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,197 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "delayq.h"
+
+#include "xmalloc.h"
+
+#define DELAYQ_INITIAL_SIZE 64
+
+struct delayq_entry {
+    struct timeval deadline;
+    uint64_t seq;               /* tie breaker, keeps equal deadlines FIFO */
+    size_t pos;                 /* index in heap */
+    void *item;
+};
+
+struct delayq {
+    struct delayq_entry **heap;
+    size_t size;
+    size_t alloc;
+    uint64_t seq;
+    size_t cursor;              /* for delayq_first() / delayq_next() */
+    delayq_destructor_fn *destructor;
+};
+
+static int entry_before(struct delayq_entry *a, struct delayq_entry *b)
+{
+    if (timercmp(&a->deadline, &b->deadline, <))
+        return 1;
+    if (timercmp(&a->deadline, &b->deadline, >))
+        return 0;
+    return a->seq < b->seq;
+}
+
+static void heap_set(delayq_t *dq, size_t pos, struct delayq_entry *e)
+{
+    dq->heap[pos] = e;
+    e->pos = pos;
+}
+
+static void sift_up(delayq_t *dq, size_t pos)
+{
+    struct delayq_entry *e = dq->heap[pos];
+
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!entry_before(e, dq->heap[parent]))
+            break;
+        heap_set(dq, pos, dq->heap[parent]);
+        pos = parent;
+    }
+    heap_set(dq, pos, e);
+}
+
+static void sift_down(delayq_t *dq, size_t pos)
+{
+    struct delayq_entry *e = dq->heap[pos];
+
+    while (1) {
+        size_t child = pos * 2 + 1;
+        if (child >= dq->size)
+            break;
+        if (child + 1 < dq->size
+            && entry_before(dq->heap[child + 1], dq->heap[child]))
+            child++;
+        if (!entry_before(dq->heap[child], e))
+            break;
+        heap_set(dq, pos, dq->heap[child]);
+        pos = child;
+    }
+    heap_set(dq, pos, e);
+}
+
+delayq_t *delayq_create(delayq_destructor_fn *destructor)
+{
+    delayq_t *dq = (delayq_t *)xmalloc(sizeof(*dq));
+
+    dq->alloc = DELAYQ_INITIAL_SIZE;
+    dq->heap = (struct delayq_entry **)xmalloc(sizeof(*dq->heap) * dq->alloc);
+    dq->destructor = destructor;
+    return dq;
+}
+
+void delayq_destroy(delayq_t *dq)
+{
+    if (dq) {
+        size_t i;
+        for (i = 0; i < dq->size; i++) {
+            if (dq->destructor)
+                dq->destructor(&dq->heap[i]->item);
+            xfree(dq->heap[i]);
+        }
+        xfree(dq->heap);
+        xfree(dq);
+    }
+}
+
+void *delayq_add(delayq_t *dq, const struct timeval *deadline, void *item)
+{
+    struct delayq_entry *e = (struct delayq_entry *)xmalloc(sizeof(*e));
+
+    e->deadline = *deadline;
+    e->seq = dq->seq++;
+    e->item = item;
+
+    if (dq->size == dq->alloc) {
+        dq->alloc *= 2;
+        dq->heap = (struct delayq_entry **)xrealloc((char *)dq->heap,
+                                        sizeof(*dq->heap) * dq->alloc);
+    }
+    heap_set(dq, dq->size++, e);
+    sift_up(dq, e->pos);
+    return e;
+}
+
+void delayq_update(delayq_t *dq, void *handle, const struct timeval *deadline)
+{
+    struct delayq_entry *e = handle;
+
+    e->deadline = *deadline;
+    /* a rescheduled item goes behind others with the same deadline */
+    e->seq = dq->seq++;
+    sift_up(dq, e->pos);
+    sift_down(dq, e->pos);
+}
+
+void *delayq_remove(delayq_t *dq, void *handle)
+{
+    struct delayq_entry *e = handle;
+    struct delayq_entry *last;
+    void *item = e->item;
+    size_t pos = e->pos;
+
+    last = dq->heap[--dq->size];
+    if (last != e) {
+        heap_set(dq, pos, last);
+        sift_up(dq, pos);
+        sift_down(dq, last->pos);
+    }
+    xfree(e);
+    return item;
+}
+
+void *delayq_head(delayq_t *dq, struct timeval *deadline)
+{
+    if (dq->size == 0)
+        return NULL;
+    if (deadline)
+        *deadline = dq->heap[0]->deadline;
+    return dq->heap[0]->item;
+}
+
+void *delayq_pop_due(delayq_t *dq, const struct timeval *due)
+{
+    if (dq->size == 0 || timercmp(&dq->heap[0]->deadline, due, >))
+        return NULL;
+    return delayq_remove(dq, dq->heap[0]);
+}
+
+size_t delayq_size(delayq_t *dq)
+{
+    return dq->size;
+}
+
+void *delayq_first(delayq_t *dq)
+{
+    dq->cursor = 0;
+    return dq->size > 0 ? dq->heap[0]->item : NULL;
+}
+
+void *delayq_next(delayq_t *dq)
+{
+    if (dq->cursor + 1 >= dq->size) {
+        dq->cursor = dq->size;
+        return NULL;
+    }
+    return dq->heap[++dq->cursor]->item;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
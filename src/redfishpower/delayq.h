@@ -0,0 +1,62 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef REDFISHPOWER_DELAYQ_H
+#define REDFISHPOWER_DELAYQ_H
+
+#include <sys/time.h>
+
+/* Queue of items ordered by deadline (binary min-heap).  Items with
+ * equal deadlines come out in the order they were added.
+ */
+
+typedef struct delayq delayq_t;
+
+typedef void (delayq_destructor_fn)(void **item);
+
+/* destructor is called on items still queued at destroy, may be NULL */
+delayq_t *delayq_create(delayq_destructor_fn *destructor);
+
+void delayq_destroy(delayq_t *dq);
+
+/* add item with deadline, returns handle for delayq_update() /
+ * delayq_remove().  The handle is valid until the item leaves the queue.
+ */
+void *delayq_add(delayq_t *dq, const struct timeval *deadline, void *item);
+
+/* change deadline of queued item */
+void delayq_update(delayq_t *dq, void *handle, const struct timeval *deadline);
+
+/* remove item from queue, caller owns item */
+void *delayq_remove(delayq_t *dq, void *handle);
+
+/* item with earliest deadline, NULL if empty.  If deadline is
+ * non-NULL, it is set to that item's deadline.
+ */
+void *delayq_head(delayq_t *dq, struct timeval *deadline);
+
+/* remove and return item with earliest deadline if it is due by
+ * 'due', NULL otherwise.  Call in a loop to take a batch.
+ */
+void *delayq_pop_due(delayq_t *dq, const struct timeval *due);
+
+size_t delayq_size(delayq_t *dq);
+
+/* iterate over all queued items in unspecified order.  Do not modify
+ * the queue while iterating.
+ */
+void *delayq_first(delayq_t *dq);
+void *delayq_next(delayq_t *dq);
+
+#endif /* REDFISHPOWER_DELAYQ_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,179 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jsonscan.h"
+
+/* max nesting of skipped objects / arrays */
+#define JSONSCAN_MAX_DEPTH 64
+
+struct scan {
+    const char *buf;
+    size_t len;
+    size_t pos;
+};
+
+static void skip_ws(struct scan *s)
+{
+    while (s->pos < s->len
+           && (s->buf[s->pos] == ' '
+               || s->buf[s->pos] == '\t'
+               || s->buf[s->pos] == '\n'
+               || s->buf[s->pos] == '\r'))
+        s->pos++;
+}
+
+/* scan string at s->pos (opening quote), set str/str_len to the raw
+ * contents and escaped if it contains any escapes.
+ */
+static int scan_string(struct scan *s,
+                       const char **str,
+                       size_t *str_len,
+                       int *escaped)
+{
+    size_t start;
+
+    if (s->pos >= s->len || s->buf[s->pos] != '"')
+        return -1;
+    start = ++s->pos;
+    *escaped = 0;
+    while (s->pos < s->len) {
+        char c = s->buf[s->pos];
+        if (c == '"') {
+            *str = s->buf + start;
+            *str_len = s->pos - start;
+            s->pos++;
+            return 0;
+        }
+        if (c == '\\') {
+            *escaped = 1;
+            s->pos++;
+        }
+        else if ((unsigned char)c < 0x20)
+            return -1;
+        s->pos++;
+    }
+    return -1;
+}
+
+/* skip over any value, nested objects / arrays are only checked for
+ * balanced brackets outside of strings.
+ */
+static int skip_value(struct scan *s)
+{
+    char stack[JSONSCAN_MAX_DEPTH];
+    int depth = 0;
+    const char *str;
+    size_t str_len;
+    int escaped;
+
+    skip_ws(s);
+    if (s->pos >= s->len)
+        return -1;
+    switch (s->buf[s->pos]) {
+        case '"':
+            return scan_string(s, &str, &str_len, &escaped);
+        case '{':
+        case '[':
+            break;
+        default:
+            /* number, true, false, null */
+            while (s->pos < s->len
+                   && strchr(",}] \t\r\n", s->buf[s->pos]) == NULL)
+                s->pos++;
+            return 0;
+    }
+    while (s->pos < s->len) {
+        char c = s->buf[s->pos];
+        if (c == '"') {
+            if (scan_string(s, &str, &str_len, &escaped) < 0)
+                return -1;
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            if (depth == JSONSCAN_MAX_DEPTH)
+                return -1;
+            stack[depth++] = c == '{' ? '}' : ']';
+        }
+        else if (c == '}' || c == ']') {
+            if (depth == 0 || stack[--depth] != c)
+                return -1;
+            if (depth == 0) {
+                s->pos++;
+                return 0;
+            }
+        }
+        s->pos++;
+    }
+    return -1;
+}
+
+int jsonscan_string(const char *buf,
+                    size_t len,
+                    const char *key,
+                    const char **valp,
+                    size_t *val_lenp)
+{
+    struct scan s = { .buf = buf, .len = len, .pos = 0 };
+    size_t key_len = strlen(key);
+
+    skip_ws(&s);
+    if (s.pos >= s.len || s.buf[s.pos] != '{')
+        return -1;
+    s.pos++;
+    skip_ws(&s);
+    if (s.pos < s.len && s.buf[s.pos] == '}')
+        return 0;
+
+    while (s.pos < s.len) {
+        const char *name;
+        size_t name_len;
+        int escaped;
+
+        skip_ws(&s);
+        if (scan_string(&s, &name, &name_len, &escaped) < 0)
+            return -1;
+        skip_ws(&s);
+        if (s.pos >= s.len || s.buf[s.pos] != ':')
+            return -1;
+        s.pos++;
+        skip_ws(&s);
+
+        if (!escaped
+            && name_len == key_len
+            && memcmp(name, key, key_len) == 0) {
+            if (scan_string(&s, valp, val_lenp, &escaped) < 0 || escaped)
+                return -1;
+            return 1;
+        }
+
+        if (skip_value(&s) < 0)
+            return -1;
+        skip_ws(&s);
+        if (s.pos >= s.len)
+            return -1;
+        if (s.buf[s.pos] == '}')
+            return 0;
+        if (s.buf[s.pos] != ',')
+            return -1;
+        s.pos++;
+    }
+    return -1;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
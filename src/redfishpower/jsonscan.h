@@ -0,0 +1,35 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef REDFISHPOWER_JSONSCAN_H
+#define REDFISHPOWER_JSONSCAN_H
+
+#include <stddef.h>
+
+/* Find the string value of a top level key in a JSON object without
+ * building a DOM.  Nested values are skipped over, not decoded.
+ *
+ * Returns 1 and sets valp/val_lenp (pointing into buf, not NUL
+ * terminated) if key was found, 0 if the object does not contain key,
+ * -1 if buf could not be scanned, including if the value is not a
+ * string or contains escapes.  On -1, callers should fall back to a
+ * full parser for error reporting.
+ */
+int jsonscan_string(const char *buf,
+                    size_t len,
+                    const char *key,
+                    const char **valp,
+                    size_t *val_lenp);
+
+#endif /* REDFISHPOWER_JSONSCAN_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -13,6 +13,7 @@
 #endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "redfishpower_defs.h"
@@ -27,6 +28,8 @@ struct plugs {
     hostlist_t plugs;
     /* map plug names to plug_data */
     zhashx_t *plug_map;
+    /* map parent plug names to zlistx of child plug names */
+    zhashx_t *children;
 };
 
 static struct plug_data *plug_data_create(const char *plugname,
@@ -63,6 +66,51 @@ static void plug_data_destroy_wrapper(void **data)
     plug_data_destroy(pd);
 }
 
+/* zhashx_destructor_fn */
+static void children_destroy_wrapper(void **data)
+{
+    zlistx_t *l = *data;
+    zlistx_destroy(&l);
+    *data = NULL;
+}
+
+/* zlistx_destructor_fn */
+static void child_destroy_wrapper(void **data)
+{
+    char *name = *data;
+    xfree(name);
+    *data = NULL;
+}
+
+static void children_add(plugs_t *p, const char *parent, const char *plugname)
+{
+    zlistx_t *l;
+
+    if (!(l = zhashx_lookup(p->children, parent))) {
+        if (!(l = zlistx_new()))
+            err_exit(true, "zlistx_new");
+        zlistx_set_destructor(l, child_destroy_wrapper);
+        zlistx_set_comparator(l, (zlistx_comparator_fn *)strcmp);
+        if (zhashx_insert(p->children, parent, l) < 0)
+            err_exit(false, "zhashx_insert");
+    }
+    if (!zlistx_add_end(l, xstrdup(plugname)))
+        err_exit(true, "zlistx_add_end");
+}
+
+static void children_remove(plugs_t *p, const char *parent, const char *plugname)
+{
+    zlistx_t *l;
+    void *handle;
+
+    if (!(l = zhashx_lookup(p->children, parent)))
+        return;
+    if ((handle = zlistx_find(l, (void *)plugname)))
+        zlistx_delete(l, handle);
+    if (zlistx_size(l) == 0)
+        zhashx_delete(p->children, parent);
+}
+
 plugs_t *plugs_create(void)
 {
     plugs_t *p = (plugs_t *)xmalloc(sizeof(*p));
@@ -74,6 +122,10 @@ plugs_t *plugs_create(void)
         goto cleanup;
     zhashx_set_destructor(p->plug_map, plug_data_destroy_wrapper);
 
+    if (!(p->children = zhashx_new()))
+        goto cleanup;
+    zhashx_set_destructor(p->children, children_destroy_wrapper);
+
     return p;
 
 cleanup:
@@ -86,6 +138,7 @@ void plugs_destroy(plugs_t *p)
     if (p) {
         hostlist_destroy(p->plugs);
         zhashx_destroy(&p->plug_map);
+        zhashx_destroy(&p->children);
         xfree(p);
     }
 }
@@ -96,16 +149,27 @@ void plugs_add(plugs_t *p,
                const char *parent)
 {
     struct plug_data *pd;
-    if (hostlist_find(p->plugs, plugname) < 0) {
+    if ((pd = zhashx_lookup(p->plug_map, plugname))) {
+        if (pd->parent)
+            children_remove(p, pd->parent, plugname);
+    }
+    else {
         if (hostlist_push(p->plugs, plugname) == 0)
             err_exit(false, "hostlist_push failed");
     }
     pd = plug_data_create(plugname, hostname, parent);
     zhashx_update(p->plug_map, plugname, pd);
+    if (parent)
+        children_add(p, parent, plugname);
 }
 
 void plugs_remove(plugs_t *p, const char *plugname)
 {
+    struct plug_data *pd;
+    if ((pd = zhashx_lookup(p->plug_map, plugname))) {
+        if (pd->parent)
+            children_remove(p, pd->parent, plugname);
+    }
     zhashx_delete(p->plug_map, plugname);
     hostlist_delete(p->plugs, plugname);
 }
@@ -172,7 +236,7 @@ int plugs_update_path(plugs_t *p,
 
 int plugs_name_valid(plugs_t *p, const char *plugname)
 {
-    if (hostlist_find(p->plugs, plugname) < 0)
+    if (!zhashx_lookup(p->plug_map, plugname))
         return 0;
     return 1;
 }
@@ -217,6 +281,11 @@ char *plugs_child_of_ancestor(plugs_t *p,
     return NULL;
 }
 
+zlistx_t *plugs_children(plugs_t *p, const char *plugname)
+{
+    return zhashx_lookup(p->children, plugname);
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
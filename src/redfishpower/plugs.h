@@ -12,6 +12,7 @@
 #define REDFISHPOWER_PLUGS_H
 
 #include "hostlist.h"
+#include "czmq.h"
 
 struct plug_data {
     char *plugname;
@@ -72,6 +73,9 @@ char *plugs_child_of_ancestor(plugs_t *p,
                               const char *plugname,
                               const char *ancestor);
 
+/* child plug names of plugname, NULL if none.  Do not modify. */
+zlistx_t *plugs_children(plugs_t *p, const char *plugname);
+
 #endif /* REDFISHPOWER_PLUGS_H */
 
 /*
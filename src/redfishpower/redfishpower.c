@@ -32,6 +32,10 @@
 
 #include "redfishpower_defs.h"
 #include "plugs.h"
+#include "cmdindex.h"
+#include "delayq.h"
+#include "jsonscan.h"
+#include "sseparse.h"
 
 #include "xmalloc.h"
 #include "czmq.h"
@@ -57,15 +61,38 @@ static char *onpostdata = NULL;
 static char *offpath = NULL;
 static char *offpostdata = NULL;
 
+/* statcollection - optional path of a collection that returns the
+ * PowerState of each member inline (e.g. using $expand).  If set, a
+ * stat of multiple plugs on the same host is done with one query.
+ */
+static char *statcollection = NULL;
+/* hosts where the collection query did not work, stat per plug only */
+static hostlist_t statcollection_unsupported_hosts = NULL;
+
 /* activecmds - power ops to be sent / in progress now */
 static zlistx_t *activecmds = NULL;
-/* delayedcmds - power ops waiting to be sent
+/* delayedcmds - power ops waiting to be sent, ordered by delaystart
  * - typically holds status polling ops after an on / off, we wait to
  *   send at a later time.
  */
-static zlistx_t *delayedcmds = NULL;
+static delayq_t *delayedcmds = NULL;
 /* waitcmds - power ops waiting for a parent check to be completed */
 static zlistx_t *waitcmds = NULL;
+/* output_pool - free response buffers, see output_cb() */
+static zlistx_t *output_pool = NULL;
+/* activecmds_index - activecmds by plugname
+ * waitcmds_index - waitcmds by each ancestor of the plugname
+ *
+ * so that handling a completion only touches the related power ops.
+ */
+static cmdindex_t *activecmds_index = NULL;
+static cmdindex_t *waitcmds_index = NULL;
+/* delayedcmds_index - delayedcmds by hostname, and by hostname plus
+ * each parent of the status path (see delayedcmds_add())
+ *
+ * so that an event only touches the status polls it can complete.
+ */
+static cmdindex_t *delayedcmds_index = NULL;
 
 static int test_mode = 0;
 static hostlist_t test_fail_power_cmd_hosts;
@@ -73,6 +100,18 @@ static zhashx_t *test_power_status;
 
 static zhashx_t *resolve_hosts_cache = NULL;
 
+/* eventpath - optional Redfish EventService SSE path.  If set, an
+ * event stream is opened to each host with an on/off in progress and
+ * power state change events are used to complete the on/off instead
+ * of waiting on the next status poll.
+ */
+static char *eventpath = NULL;
+/* eventstreams - hostname -> struct eventstream, open only while
+ * power ops are outstanding */
+static zhashx_t *eventstreams = NULL;
+/* hosts whose event stream failed, these fall back to polling only */
+static hostlist_t event_unsupported_hosts = NULL;
+
 /* in seconds */
 #define MESSAGE_TIMEOUT_DEFAULT    10
 #define CMD_TIMEOUT_DEFAULT        60
@@ -83,6 +122,25 @@ static zhashx_t *resolve_hosts_cache = NULL;
 /* in usec */
 #define STATUS_POLLING_INTERVAL_DEFAULT  1000000
 
+/* when an event stream is established, status polls are only a
+ * backstop for missed events, so poll this many times less often
+ */
+#define EVENT_POLLING_MULTIPLIER         4
+
+/* response buffers start at OUTPUT_BUFSIZE_MIN and double as needed.
+ * Up to OUTPUT_POOL_MAX buffers no larger than OUTPUT_POOL_BUFSIZE_MAX
+ * are kept for reuse by later power ops.
+ */
+#define OUTPUT_BUFSIZE_MIN               4096
+#define OUTPUT_POOL_MAX                  64
+#define OUTPUT_POOL_BUFSIZE_MAX          (256*1024)
+
+/* longest PowerState value we expect */
+#define POWERSTATE_MAX                   64
+
+/* delayed power ops due within this window are sent together */
+#define DELAY_COALESCE_USEC              1000
+
 #define MS_IN_SEC                1000
 
 #define STATUS_ON           "on"
@@ -106,6 +164,23 @@ static zhashx_t *resolve_hosts_cache = NULL;
 enum {
       STATE_SEND_POWERCMD,      /* stat, on, off */
       STATE_WAIT_UNTIL_ON_OFF,  /* on, off */
+      STATE_STAT_COLLECTION,    /* stat, all plugs of a host at once */
+};
+
+struct eventstream {
+    CURLM *mh;                  /* curl multi handle pointer */
+    CURL *eh;                   /* curl easy handle */
+    char *hostname;
+    char *url;
+    struct curl_slist *headers;
+
+    sseparse_t *sse;
+
+    /* established - stream is delivering data
+     * last_event - when the last event was received
+     */
+    int established;
+    struct timeval last_event;
 };
 
 struct powermsg {
@@ -120,9 +195,12 @@ struct powermsg {
     char *postdata;             /* on, off */
     char *output;               /* on, off, stat */
     size_t output_len;
+    size_t output_alloc;        /* size of output buffer */
 
     int output_result;          /* output result or not */
 
+    hostlist_t batchplugs;      /* plugs covered by a collection stat */
+
     int state;
 
     /* start - when power op started, may be set to start time of a
@@ -185,6 +263,8 @@ void help(void)
     printf("  setoffpath path [postdata]\n");
     printf("  setplugs plugnames hostindices [<parentplug]]\n");
     printf("  setpath plugnames cmd path [postdata]\n");
+    printf("  setstatcollection [path]\n");
+    printf("  seteventpath [path]\n");
     printf("  settimeout seconds\n");
     printf("  stat [plugs]\n");
     printf("  on [plugs]\n");
@@ -250,31 +330,88 @@ static void get_path(const char *cmd,
         (*postdata) = xstrdup(lpostdata);
 }
 
+struct output_buf {
+    char *buf;
+    size_t alloc;
+};
+
+/* zlistx_destructor_fn */
+static void output_buf_destroy(void **item)
+{
+    if (item) {
+        struct output_buf *ob = *item;
+        if (ob) {
+            free(ob->buf);
+            free(ob);
+        }
+        *item = NULL;
+    }
+}
+
+/* grow pm output buffer to hold at least size bytes, starting with a
+ * pooled buffer if available
+ */
+static void output_grow(struct powermsg *pm, size_t size)
+{
+    size_t alloc;
+
+    if (!pm->output) {
+        struct output_buf *ob;
+        if ((ob = zlistx_first(output_pool))) {
+            zlistx_detach_cur(output_pool);
+            pm->output = ob->buf;
+            pm->output_alloc = ob->alloc;
+            free(ob);
+        }
+    }
+    if (pm->output_alloc >= size)
+        return;
+
+    alloc = pm->output_alloc ? pm->output_alloc : OUTPUT_BUFSIZE_MIN;
+    while (alloc < size)
+        alloc *= 2;
+    if (!(pm->output = realloc(pm->output, alloc)))
+        err_exit(true, "realloc");
+    pm->output_alloc = alloc;
+}
+
+/* return pm output buffer to the pool */
+static void output_release(struct powermsg *pm)
+{
+    if (!pm->output)
+        return;
+    if (output_pool
+        && zlistx_size(output_pool) < OUTPUT_POOL_MAX
+        && pm->output_alloc <= OUTPUT_POOL_BUFSIZE_MAX) {
+        struct output_buf *ob;
+        if (!(ob = malloc(sizeof(*ob))))
+            err_exit(true, "malloc");
+        ob->buf = pm->output;
+        ob->alloc = pm->output_alloc;
+        if (!zlistx_add_end(output_pool, ob))
+            err_exit(true, "zlistx_add_end");
+    }
+    else
+        free(pm->output);
+    pm->output = NULL;
+    pm->output_len = 0;
+    pm->output_alloc = 0;
+}
+
 static size_t output_cb(void *contents, size_t size, size_t nmemb, void *userp)
 {
     size_t realsize = size * nmemb;
     struct powermsg *pm = userp;
 
-    if (pm->output) {
-        char *tmp = calloc(1, pm->output_len + realsize + 1);
-        if (!tmp)
-            err_exit(true, "calloc");
-        memcpy(tmp, pm->output, pm->output_len);
-        memcpy(tmp + pm->output_len, contents, realsize);
-        pm->output_len += realsize;
-        free(pm->output);
-        pm->output = tmp;
-    }
-    else {
-        if (!(pm->output = calloc(1, realsize + 1)))
-            err_exit(true, "calloc");
-        memcpy(pm->output, contents, realsize);
-        pm->output_len = realsize;
-    }
+    output_grow(pm, pm->output_len + realsize + 1);
+    memcpy(pm->output + pm->output_len, contents, realsize);
+    pm->output_len += realsize;
+    pm->output[pm->output_len] = '\0';
     return realsize;
 }
 
-/* called before putting powermsg on activecmds list */
+/* called before putting powermsg on activecmds list, see
+ * activecmds_add() */
 static void powermsg_init_curl(struct powermsg *pm)
 {
     CURLMcode mc;
@@ -472,7 +609,8 @@ static void powermsg_destroy(struct powermsg *pm)
         xfree(pm->parent);
         xfree(pm->url);
         xfree(pm->postdata);
-        free(pm->output);
+        output_release(pm);
+        hostlist_destroy(pm->batchplugs);
         if (!test_mode && pm->eh) {
             CURLMcode mc;
             Curl_easy_setopt((pm->eh, CURLOPT_URL, ""));
@@ -486,6 +624,365 @@ static void powermsg_destroy(struct powermsg *pm)
     }
 }
 
+/* send power op, i.e. put on activecmds */
+static void activecmds_add(struct powermsg *pm)
+{
+    powermsg_init_curl(pm);
+    if (!(pm->handle = zlistx_add_end(activecmds, pm)))
+        err_exit(true, "zlistx_add_end");
+
+    if (pm->state == STATE_STAT_COLLECTION) {
+        hostlist_iterator_t itr;
+        char *plugname;
+        if (!(itr = hostlist_iterator_create(pm->batchplugs)))
+            err_exit(true, "hostlist_iterator_create");
+        while ((plugname = hostlist_next(itr))) {
+            cmdindex_add(activecmds_index, plugname, pm);
+            free(plugname);
+        }
+        hostlist_iterator_destroy(itr);
+    }
+    else
+        cmdindex_add(activecmds_index, pm->plugname, pm);
+}
+
+/* remove from activecmds and destroy */
+static void activecmds_delete(struct powermsg *pm)
+{
+    cmdindex_remove(activecmds_index, pm);
+    if (zlistx_delete(activecmds, pm->handle) < 0)
+        err_exit(false, "zlistx_delete failed to delete");
+}
+
+static void waitcmds_add(struct powermsg *pm)
+{
+    const char *ancestor = pm->parent;
+
+    if (!(pm->handle = zlistx_add_end(waitcmds, pm)))
+        err_exit(true, "zlistx_add_end");
+
+    /* the status of any ancestor can complete this power op */
+    while (ancestor) {
+        struct plug_data *pd;
+        cmdindex_add(waitcmds_index, ancestor, pm);
+        if (!(pd = plugs_get_data(plugs, ancestor)))
+            break;
+        ancestor = pd->parent;
+    }
+}
+
+/* remove from waitcmds, caller now owns power op */
+static void waitcmds_detach(struct powermsg *pm)
+{
+    cmdindex_remove(waitcmds_index, pm);
+    zlistx_detach(waitcmds, pm->handle);
+    pm->handle = NULL;
+}
+
+/* index key for path on hostname, path is normalized as an "@odata.id",
+ * which is absolute, would be.  len is the number of path chars to use
+ */
+static char *delayedcmds_key(const char *hostname, const char *path, int len)
+{
+    char *key;
+    int size;
+
+    while (*path == '/') {
+        path++;
+        len--;
+    }
+    while (len > 0 && path[len - 1] == '/')
+        len--;
+    size = strlen(hostname) + len + 2;
+    key = xmalloc(size);
+    snprintf(key, size, "%s %.*s", hostname, len, path);
+    return key;
+}
+
+/* delay power op, it is indexed under its hostname for events that
+ * do not say where they came from, and under each "@odata.id" that
+ * refers to the resource at path or one of its parents.
+ */
+static void delayedcmds_add(struct powermsg *pm, const char *path)
+{
+    const char *p;
+
+    pm->handle = delayq_add(delayedcmds, &pm->delaystart, pm);
+
+    cmdindex_add(delayedcmds_index, pm->hostname, pm);
+    for (p = path; ; p++) {
+        if ((*p == '\0' || *p == '/' || *p == '?')
+            && p > path && p[-1] != '/') {
+            char *key = delayedcmds_key(pm->hostname, path, p - path);
+            cmdindex_add(delayedcmds_index, key, pm);
+            xfree(key);
+        }
+        if (*p == '\0' || *p == '?')
+            break;
+    }
+}
+
+/* take a delayed power op that is due, caller now owns power op */
+static struct powermsg *delayedcmds_pop_due(const struct timeval *due)
+{
+    struct powermsg *pm;
+
+    if ((pm = delayq_pop_due(delayedcmds, due))) {
+        cmdindex_remove(delayedcmds_index, pm);
+        pm->handle = NULL;
+    }
+    return pm;
+}
+
+static void eventstream_destroy(struct eventstream *es)
+{
+    if (es) {
+        if (!test_mode && es->eh) {
+            CURLMcode mc;
+            if ((mc = curl_multi_remove_handle(es->mh, es->eh)) != CURLM_OK)
+                err_exit(false,
+                         "curl_multi_remove_handle: %s",
+                         curl_multi_strerror(mc));
+            curl_easy_cleanup(es->eh);
+        }
+        if (es->headers)
+            curl_slist_free_all(es->headers);
+        xfree(es->hostname);
+        xfree(es->url);
+        sseparse_destroy(es->sse);
+        free(es);
+    }
+}
+
+/* zhashx_destructor_fn */
+static void eventstream_destroy_wrapper(void **item)
+{
+    if (item) {
+        eventstream_destroy(*item);
+        *item = NULL;
+    }
+}
+
+/* An event arrived for hostname.  Wake status polls waiting on an
+ * on/off of plugs on that host, so the completion is checked now
+ * instead of after the poll delay.  If origin is known, only wake
+ * polls for plugs whose status path matches it.
+ */
+static void event_wake(const char *hostname, const char *origin)
+{
+    zlistx_t *wake;
+    struct powermsg *pm;
+    struct timeval now;
+
+    if (origin) {
+        char *key = delayedcmds_key(hostname, origin, strlen(origin));
+        wake = cmdindex_lookup(delayedcmds_index, key);
+        xfree(key);
+    }
+    else
+        wake = cmdindex_lookup(delayedcmds_index, hostname);
+    if (!wake)
+        return;
+
+    gettimeofday(&now, NULL);
+
+    /* delayq_update() does not change the index, no need to dup */
+    pm = zlistx_first(wake);
+    while (pm) {
+        if (verbose > 1)
+            printf("DEBUG: event hostname=%s plugname=%s poll now\n",
+                   pm->hostname, pm->plugname);
+        pm->delaystart = now;
+        delayq_update(delayedcmds, pm->handle, &pm->delaystart);
+        pm = zlistx_next(wake);
+    }
+}
+
+/* Parse a Redfish event, typically of the form
+ *
+ * {"Events":[{"OriginOfCondition":{"@odata.id":"/redfish/v1/Systems/1"},
+ *             ...}]}
+ *
+ * Events that do not say where they came from wake every waiter on
+ * the host, the follow on status poll will sort out what changed.
+ */
+static void event_process(const char *data, void *arg)
+{
+    struct eventstream *es = arg;
+    json_error_t error;
+    json_t *o;
+    json_t *events;
+
+    gettimeofday(&es->last_event, NULL);
+
+    if (!(o = json_loads(data, 0, &error))) {
+        if (verbose)
+            printf("%s: parse event error %s\n", es->hostname, error.text);
+        return;
+    }
+
+    if ((events = json_object_get(o, "Events")) && json_is_array(events)) {
+        size_t index;
+        json_t *event;
+        json_array_foreach(events, index, event) {
+            json_t *origin = json_object_get(event, "OriginOfCondition");
+            json_t *id = origin ? json_object_get(origin, "@odata.id") : NULL;
+            event_wake(es->hostname, id ? json_string_value(id) : NULL);
+        }
+    }
+    else
+        event_wake(es->hostname, NULL);
+
+    json_decref(o);
+}
+
+/* Content-Type may carry parameters, e.g. "text/event-stream; charset=utf-8"
+ */
+static int event_stream_is_sse(struct eventstream *es)
+{
+    char *ct = NULL;
+
+    if (curl_easy_getinfo(es->eh, CURLINFO_CONTENT_TYPE, &ct) != CURLE_OK
+        || !ct)
+        return 0;
+    return strncasecmp(ct, "text/event-stream", 17) == 0;
+}
+
+static size_t event_cb(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    size_t realsize = size * nmemb;
+    struct eventstream *es = userp;
+
+    if (!es->established) {
+        /* a 200 that is not an event stream means the host does not
+         * support SSE on eventpath, returning short fails the transfer
+         * and event_stream_done() marks the host unsupported.
+         */
+        if (!event_stream_is_sse(es)) {
+            if (verbose)
+                printf("%s: event stream is not text/event-stream\n",
+                       es->hostname);
+            return 0;
+        }
+        es->established = 1;
+        if (verbose > 1)
+            fprintf(stderr,
+                    "DEBUG: event stream hostname=%s established\n",
+                    es->hostname);
+    }
+
+    sseparse_feed(es->sse, contents, realsize);
+    return realsize;
+}
+
+static void event_stream_open(CURLM *mh, const char *hostname)
+{
+    struct eventstream *es;
+    CURLMcode mc;
+
+    if (!eventpath
+        || zhashx_lookup(eventstreams, hostname)
+        || hostlist_find(event_unsupported_hosts, hostname) >= 0)
+        return;
+
+    if (!(es = calloc(1, sizeof(*es))))
+        err_exit(true, "calloc");
+    es->mh = mh;
+    es->hostname = xstrdup(hostname);
+    es->sse = sseparse_create(event_process, es);
+    if (resolve_hosts)
+        es->url = resolve_hosts_url(hostname, eventpath);
+    else {
+        es->url = xmalloc(strlen("https://") + strlen(hostname)
+                          + strlen(eventpath) + 2);
+        sprintf(es->url, "https://%s/%s", hostname, eventpath);
+    }
+
+    if (zhashx_insert(eventstreams, hostname, es) < 0)
+        err_exit(false, "zhashx_insert");
+
+    if (verbose > 1)
+        printf("DEBUG: event stream hostname=%s path=%s\n",
+               hostname, eventpath);
+
+    /* in test mode, events are delivered by on_off_process() */
+    if (test_mode) {
+        es->established = 1;
+        return;
+    }
+
+    if ((es->eh = curl_easy_init()) == NULL)
+        err_exit(false, "curl_easy_init failed");
+
+    /* the stream is long lived, so only limit the connect */
+    Curl_easy_setopt((es->eh, CURLOPT_CONNECTTIMEOUT, message_timeout));
+    Curl_easy_setopt((es->eh, CURLOPT_FAILONERROR, 1));
+
+    /* for time being */
+    Curl_easy_setopt((es->eh, CURLOPT_SSL_VERIFYPEER, 0L));
+    Curl_easy_setopt((es->eh, CURLOPT_SSL_VERIFYHOST, 0L));
+
+    if (verbose > 2)
+        Curl_easy_setopt((es->eh, CURLOPT_VERBOSE, 1L));
+
+    if (header) {
+        if (!(es->headers = curl_slist_append(es->headers, header)))
+            err_exit(false, "curl_slist_append");
+    }
+    if (!(es->headers = curl_slist_append(es->headers,
+                                          "Accept: text/event-stream")))
+        err_exit(false, "curl_slist_append");
+    Curl_easy_setopt((es->eh, CURLOPT_HTTPHEADER, es->headers));
+
+    if (userpwd) {
+        Curl_easy_setopt((es->eh, CURLOPT_USERPWD, userpwd));
+        Curl_easy_setopt((es->eh, CURLOPT_HTTPAUTH, CURLAUTH_BASIC));
+    }
+
+    Curl_easy_setopt((es->eh, CURLOPT_WRITEFUNCTION, event_cb));
+    Curl_easy_setopt((es->eh, CURLOPT_WRITEDATA, (void *)es));
+    /* NULL private data distinguishes streams from powermsgs */
+    Curl_easy_setopt((es->eh, CURLOPT_PRIVATE, NULL));
+    Curl_easy_setopt((es->eh, CURLOPT_URL, es->url));
+    Curl_easy_setopt((es->eh, CURLOPT_HTTPGET, 1));
+
+    if ((mc = curl_multi_add_handle(mh, es->eh)) != CURLM_OK)
+        err_exit(false, "curl_multi_add_handle: %s", curl_multi_strerror(mc));
+}
+
+/* An event stream ended.  If it failed before delivering anything
+ * (e.g. 404 on the SSE path) or was answered with something other than
+ * an event stream, the host does not support it, so do not try again
+ * and rely on polling.
+ */
+static void event_stream_done(CURL *eh, CURLcode result)
+{
+    struct eventstream *es = zhashx_first(eventstreams);
+
+    while (es) {
+        if (es->eh == eh)
+            break;
+        es = zhashx_next(eventstreams);
+    }
+    if (!es)
+        err_exit(false, "private data not set in easy handle");
+
+    if (!es->established
+        && (result != CURLE_OK || !event_stream_is_sse(es))) {
+        if (verbose)
+            printf("%s: event stream unavailable, polling: %s\n",
+                   es->hostname, curl_easy_strerror(result));
+        if (!hostlist_push(event_unsupported_hosts, es->hostname))
+            err_exit(true, "hostlist_push error on %s", es->hostname);
+    }
+    else if (verbose > 1)
+        fprintf(stderr,
+                "DEBUG: event stream hostname=%s closed\n",
+                es->hostname);
+
+    zhashx_delete(eventstreams, es->hostname);
+}
+
 static struct powermsg *stat_cmd_plug(CURLM * mh,
                                       char *plugname,
                                       int output_result)
@@ -534,16 +1031,19 @@ static struct powermsg *stat_cmd_plug(CURLM * mh,
  */
 static int plugname_active(const char *plugname, const char *cmd)
 {
-    struct powermsg *pm = zlistx_first(activecmds);
+    zlistx_t *l = cmdindex_lookup(activecmds_index, plugname);
+    struct powermsg *pm;
+
+    if (!l)
+        return 0;
+    pm = zlistx_first(l);
     while (pm) {
-        if (strcmp(pm->plugname, plugname) == 0) {
-            if (strcmp(pm->cmd, CMD_STAT) == 0)
-                return 1;
-            else if (strcmp(cmd, CMD_OFF) == 0
-                     && strcmp(pm->cmd, CMD_OFF) == 0)
-                return 1;
-        }
-        pm = zlistx_next(activecmds);
+        if (strcmp(pm->cmd, CMD_STAT) == 0)
+            return 1;
+        else if (strcmp(cmd, CMD_OFF) == 0
+                 && strcmp(pm->cmd, CMD_OFF) == 0)
+            return 1;
+        pm = zlistx_next(l);
     }
     return 0;
 }
@@ -567,9 +1067,7 @@ static void send_initial_parent_queries(CURLM *mh)
             rootpm = stat_cmd_plug(mh, root_plugname, NO_OUTPUT);
             if (!rootpm)
                 goto next;
-            powermsg_init_curl(rootpm);
-            if (!(rootpm->handle = zlistx_add_end(activecmds, rootpm)))
-                err_exit(true, "zlistx_add_end");
+            activecmds_add(rootpm);
             if (verbose > 1)
                 fprintf(stderr,
                         "DEBUG: parent query hostname=%s plugname=%s\n",
@@ -580,12 +1078,70 @@ static void send_initial_parent_queries(CURLM *mh)
     }
 }
 
+static struct powermsg *stat_cmd_collection(CURLM *mh,
+                                            const char *hostname,
+                                            hostlist_t batchplugs)
+{
+    struct powermsg *pm;
+
+    /* plugname is only for error output, the collection covers
+     * batchplugs
+     */
+    pm = powermsg_create(mh,
+                         hostname,
+                         hostname,
+                         NULL,
+                         CMD_STAT,
+                         statcollection,
+                         NULL,
+                         NULL,
+                         0,
+                         0,
+                         OUTPUT_RESULT,
+                         STATE_STAT_COLLECTION);
+    pm->batchplugs = batchplugs;
+    if (verbose > 1) {
+        char buf[1024];
+        if (hostlist_ranged_string(batchplugs, sizeof(buf), buf) < 0)
+            strcpy(buf, "...");
+        printf("DEBUG: %s hostname=%s plugnames=%s path=%s\n",
+               CMD_STAT, hostname, buf, statcollection);
+    }
+    return pm;
+}
+
+/* batches - hostname -> hostlist of plugs to stat on that host */
+static void stat_cmd_batches(CURLM *mh, zhashx_t *batches)
+{
+    hostlist_t batch = zhashx_first(batches);
+
+    while (batch) {
+        const char *hostname = zhashx_cursor(batches);
+        struct powermsg *pm;
+
+        /* no point in a collection query for a single plug */
+        if (hostlist_count(batch) == 1) {
+            char *plugname = hostlist_nth(batch, 0);
+            pm = stat_cmd_plug(mh, plugname, OUTPUT_RESULT);
+            free(plugname);
+            hostlist_destroy(batch);
+        }
+        else
+            pm = stat_cmd_collection(mh, hostname, batch);
+        if (pm) {
+            activecmds_add(pm);
+        }
+        batch = zhashx_next(batches);
+    }
+}
+
 static void stat_cmd(CURLM *mh, char **av)
 {
     hostlist_iterator_t itr;
     char *plugname;
     hostlist_t *plugsptr;
     hostlist_t lplugs = NULL;
+    zhashx_t *batches = NULL;
 
     if (av[0]) {
         if (!(lplugs = hostlist_create(av[0]))) {
@@ -600,29 +1156,58 @@ static void stat_cmd(CURLM *mh, char **av)
     if (!(itr = hostlist_iterator_create(*plugsptr)))
         err_exit(true, "hostlist_iterator_create");
 
+    /* plugs w/o a parent can be queried right away, so group them by
+     * host for a collection query
+     */
+    if (statcollection) {
+        if (!(batches = zhashx_new()))
+            err_exit(false, "zhashx_new error");
+    }
+
     while ((plugname = hostlist_next(itr))) {
         struct powermsg *pm;
+        struct plug_data *pd;
         if (!plugs_name_valid(plugs, plugname)) {
             printf("unknown plug specified: %s\n", plugname);
             free(plugname);
             continue;
         }
+        if (batches
+            && (pd = plugs_get_data(plugs, plugname))
+            && !pd->parent
+            && hostlist_find(statcollection_unsupported_hosts,
+                             pd->hostname) < 0) {
+            hostlist_t batch = zhashx_lookup(batches, pd->hostname);
+            if (!batch) {
+                if (!(batch = hostlist_create(NULL)))
+                    err_exit(true, "hostlist_create error");
+                if (zhashx_insert(batches, pd->hostname, batch) < 0)
+                    err_exit(false, "zhashx_insert");
+            }
+            if (!hostlist_push_host(batch, plugname))
+                err_exit(true, "hostlist_push_host error on %s", plugname);
+            free(plugname);
+            continue;
+        }
         if (!(pm = stat_cmd_plug(mh, plugname, OUTPUT_RESULT))) {
             free(plugname);
             continue;
         }
         if (pm->parent) {
-            if (!(pm->handle = zlistx_add_end(waitcmds, pm)))
-                err_exit(true, "zlistx_add_end");
+            waitcmds_add(pm);
         }
         else {
-            powermsg_init_curl(pm);
-            if (!(pm->handle = zlistx_add_end(activecmds, pm)))
-                err_exit(true, "zlistx_add_end");
+            activecmds_add(pm);
         }
         free(plugname);
     }
 
+    /* batches own their hostlists until given to a powermsg */
+    if (batches) {
+        stat_cmd_batches(mh, batches);
+        zhashx_destroy(&batches);
+    }
+
     if (zlistx_size(waitcmds) > 0)
         send_initial_parent_queries(mh);
 
@@ -630,6 +1215,39 @@ static void stat_cmd(CURLM *mh, char **av)
     hostlist_destroy(lplugs);
 }
 
+static void parse_powerstate(struct powermsg *pm,
+                             const char *str,
+                             const char **status_strp,
+                             const char **rstatus_strp)
+{
+    if (strcasecmp(str, "On") == 0) {
+        (*status_strp) = STATUS_ON;
+        if (rstatus_strp)
+            (*rstatus_strp) = STATUS_ON;
+    }
+    else if (strcasecmp(str, "Off") == 0) {
+        (*status_strp) = STATUS_OFF;
+        if (rstatus_strp)
+            (*rstatus_strp) = STATUS_OFF;
+    }
+    else {
+        (*status_strp) = STATUS_UNKNOWN;
+        if (rstatus_strp) {
+            if (strcasecmp(str, "Paused") == 0)
+                (*rstatus_strp) = STATUS_PAUSED;
+            else if (strcasecmp(str, "PoweringOff") == 0)
+                (*rstatus_strp) = STATUS_POWERING_OFF;
+            else if (strcasecmp(str, "PoweringOn") == 0)
+                (*rstatus_strp) = STATUS_POWERING_ON;
+            else
+                (*rstatus_strp) = STATUS_UNKNOWN;
+        }
+        if (verbose)
+            printf("%s: unknown status - %s\n",
+                   pm->plugname, str);
+    }
+}
+
 /* status_strp - on, off, unknown
  * rstatus_strp - on, off, paused, poweringoff, poweringon, unknown
  */
@@ -640,6 +1258,33 @@ static void parse_onoff_response(struct powermsg *pm,
     if (pm->output) {
         json_error_t error;
         json_t *o;
+        const char *val;
+        size_t val_len;
+        int ret;
+
+        /* Only PowerState is needed, so scan for it rather than
+         * building the whole response (which may be large).  Fall
+         * back to the full parser for anything unusual so that errors
+         * are reported the same way.
+         */
+        ret = jsonscan_string(pm->output,
+                              pm->output_len,
+                              "PowerState",
+                              &val,
+                              &val_len);
+        if (ret == 0) {
+            (*status_strp) = "no powerstate";
+            if (verbose)
+                printf("%s: no PowerState\n", pm->plugname);
+            return;
+        }
+        if (ret == 1 && val_len < POWERSTATE_MAX) {
+            char str[POWERSTATE_MAX];
+            memcpy(str, val, val_len);
+            str[val_len] = '\0';
+            parse_powerstate(pm, str, status_strp, rstatus_strp);
+            return;
+        }
 
         if (!(o = json_loads(pm->output, 0, &error))) {
             (*status_strp) = "parse error";
@@ -652,40 +1297,16 @@ static void parse_onoff_response(struct powermsg *pm,
         }
         else {
             json_t *val = json_object_get(o, "PowerState");
-            if (!val) {
+            if (!val || !json_is_string(val)) {
                 (*status_strp) = "no powerstate";
                 if (verbose)
                     printf("%s: no PowerState\n", pm->plugname);
             }
-            else {
-                const char *str = json_string_value(val);
-                if (strcasecmp(str, "On") == 0) {
-                    (*status_strp) = STATUS_ON;
-                    if (rstatus_strp)
-                        (*rstatus_strp) = STATUS_ON;
-                }
-                else if (strcasecmp(str, "Off") == 0) {
-                    (*status_strp) = STATUS_OFF;
-                    if (rstatus_strp)
-                        (*rstatus_strp) = STATUS_OFF;
-                }
-                else {
-                    (*status_strp) = STATUS_UNKNOWN;
-                    if (rstatus_strp) {
-                        if (strcasecmp(str, "Paused") == 0)
-                            (*rstatus_strp) = STATUS_PAUSED;
-                        else if (strcasecmp(str, "PoweringOff") == 0)
-                            (*rstatus_strp) = STATUS_POWERING_OFF;
-                        else if (strcasecmp(str, "PoweringOn") == 0)
-                            (*rstatus_strp) = STATUS_POWERING_ON;
-                        else
-                            (*rstatus_strp) = STATUS_UNKNOWN;
-                    }
-                    if (verbose)
-                        printf("%s: unknown status - %s\n",
-                               pm->plugname, str);
-                }
-            }
+            else
+                parse_powerstate(pm,
+                                 json_string_value(val),
+                                 status_strp,
+                                 rstatus_strp);
         }
         json_decref(o);
     }
@@ -715,69 +1336,74 @@ static void process_waiters(CURLM *mh,
                             const char *ancestor,
                             const char *status_str)
 {
+    zlistx_t *descendants;
     struct powermsg *pm;
 
+    /* only descendants of ancestor on waitcmds are affected */
+    if (!(descendants = cmdindex_lookup(waitcmds_index, ancestor)))
+        return;
+
     /* first pass - deal with descendants that will be removed from
      * waitcmds (either removed outright or moved to activecmds)
+     *
+     * this modifies the index, so iterate over a copy
      */
-    pm = zlistx_first(waitcmds);
+    if (!(descendants = zlistx_dup(descendants)))
+        err_exit(true, "zlistx_dup");
+    pm = zlistx_first(descendants);
     while (pm) {
-        int descendant = plugs_is_descendant(plugs, pm->plugname, ancestor);
-        if (descendant) {
-            if (strcmp(status_str, STATUS_ON) != 0) {
-                if (verbose > 1)
-                    fprintf(stderr,
-                            "DEBUG: descendant: "
-                            "%s hostname=%s plugname=%s status=%s\n",
-                            pm->cmd, pm->hostname, pm->plugname, status_str);
-
-                if (pm->output_result) {
-                    /* for stat if ancestor is off/unknown/error, the child is
-                     * defined as off/unknown/error
-                     *
-                     * for off, if ancestor is off, we consider
-                     * operation a success
-                     *
-                     * otherwise can't do operation
-                     */
-                    if (strcmp(pm->cmd, CMD_STAT) == 0)
-                        printf("%s: %s\n", pm->plugname, status_str);
-                    else if (strcmp(pm->cmd, CMD_OFF) == 0
-                             && strcmp(status_str, STATUS_OFF) == 0)
-                        printf("%s: %s\n", pm->plugname, "ok");
-                    else {
-                        struct plug_data *pd = plugs_get_data(plugs, ancestor);
-                        printf("%s: cannot perform %s, dependency %s"
-                               " (host=%s plug=%s)\n",
-                               pm->plugname,
-                               pm->cmd,
-                               status_str,
-                               pd->hostname,
-                               pd->plugname);
-                    }
-                }
+        if (strcmp(status_str, STATUS_ON) != 0) {
+            if (verbose > 1)
+                fprintf(stderr,
+                        "DEBUG: descendant: "
+                        "%s hostname=%s plugname=%s status=%s\n",
+                        pm->cmd, pm->hostname, pm->plugname, status_str);
 
-                /* this power op is now done */
-                zlistx_detach_cur(waitcmds);
-                powermsg_destroy(pm);
-            }
-            else {
-                /* if ancestor is direct parent, move waiter to active list */
-                if (strcmp(pm->parent, ancestor) == 0) {
-                    if (verbose > 1)
-                        fprintf(stderr,
-                                "DEBUG: %s hostname=%s plugname=%s "
-                                "moved to activecmds\n",
-                                pm->cmd, pm->hostname, pm->plugname);
-                    zlistx_detach_cur(waitcmds);
-                    powermsg_init_curl(pm);
-                    if (!(pm->handle = zlistx_add_end(activecmds, pm)))
-                        err_exit(true, "zlistx_add_end");
+            if (pm->output_result) {
+                /* for stat if ancestor is off/unknown/error, the child is
+                 * defined as off/unknown/error
+                 *
+                 * for off, if ancestor is off, we consider
+                 * operation a success
+                 *
+                 * otherwise can't do operation
+                 */
+                if (strcmp(pm->cmd, CMD_STAT) == 0)
+                    printf("%s: %s\n", pm->plugname, status_str);
+                else if (strcmp(pm->cmd, CMD_OFF) == 0
+                         && strcmp(status_str, STATUS_OFF) == 0)
+                    printf("%s: %s\n", pm->plugname, "ok");
+                else {
+                    struct plug_data *pd = plugs_get_data(plugs, ancestor);
+                    printf("%s: cannot perform %s, dependency %s"
+                           " (host=%s plug=%s)\n",
+                           pm->plugname,
+                           pm->cmd,
+                           status_str,
+                           pd->hostname,
+                           pd->plugname);
                 }
             }
+
+            /* this power op is now done */
+            waitcmds_detach(pm);
+            powermsg_destroy(pm);
         }
-        pm = zlistx_next(waitcmds);
+        else {
+            /* if ancestor is direct parent, move waiter to active list */
+            if (strcmp(pm->parent, ancestor) == 0) {
+                if (verbose > 1)
+                    fprintf(stderr,
+                            "DEBUG: %s hostname=%s plugname=%s "
+                            "moved to activecmds\n",
+                            pm->cmd, pm->hostname, pm->plugname);
+                waitcmds_detach(pm);
+                activecmds_add(pm);
+            }
+        }
+        pm = zlistx_next(descendants);
     }
+    zlistx_destroy(&descendants);
 
     /* second loop only deals w/ STATUS_ON, so we can give up now if
      * not on */
@@ -790,39 +1416,36 @@ static void process_waiters(CURLM *mh,
      *
      * This has to be done as a second pass because we need to
      * previous loop to finish moving all possible power ops on
-     * waitcmds to the activecmds list before we scan it with
+     * waitcmds to the activecmds list before we check it with
      * plugname_active().
      */
-    pm = zlistx_first(waitcmds);
+    if (!(descendants = cmdindex_lookup(waitcmds_index, ancestor)))
+        return;
+    pm = zlistx_first(descendants);
     while (pm) {
-        int descendant = plugs_is_descendant(plugs, pm->plugname, ancestor);
-        if (descendant) {
-            /* status query the child of that ancestor */
-            char *child = plugs_child_of_ancestor(plugs, pm->plugname, ancestor);
-            assert(child);
-            int is_active = plugname_active(child, pm->cmd);
-            /* if not active, that means no active attempts to on/off/stat
-             * the child plugname, so we need to stat it now
+        /* status query the child of that ancestor */
+        char *child = plugs_child_of_ancestor(plugs, pm->plugname, ancestor);
+        assert(child);
+        int is_active = plugname_active(child, pm->cmd);
+        /* if not active, that means no active attempts to on/off/stat
+         * the child plugname, so we need to stat it now
+         */
+        if (!is_active) {
+            struct powermsg *childpm;
+            /* no_output, we do not output this query result since it
+             * is only to determine if we should perform power op
              */
-            if (!is_active) {
-                struct powermsg *childpm;
-                /* no_output, we do not output this query result since it
-                 * is only to determine if we should perform power op
-                 */
-                childpm = stat_cmd_plug(mh, child, NO_OUTPUT);
-                if (!childpm)
-                    goto next;
-                powermsg_init_curl(childpm);
-                if (!(childpm->handle = zlistx_add_end(activecmds, childpm)))
-                    err_exit(true, "zlistx_add_end");
-                if (verbose > 1)
-                    fprintf(stderr,
-                            "DEBUG: parent query hostname=%s plugname=%s\n",
-                            childpm->hostname, childpm->plugname);
-            }
+            childpm = stat_cmd_plug(mh, child, NO_OUTPUT);
+            if (!childpm)
+                goto next;
+            activecmds_add(childpm);
+            if (verbose > 1)
+                fprintf(stderr,
+                        "DEBUG: parent query hostname=%s plugname=%s\n",
+                        childpm->hostname, childpm->plugname);
         }
     next:
-        pm = zlistx_next(waitcmds);
+        pm = zlistx_next(descendants);
     }
 }
 
@@ -840,6 +1463,181 @@ static void stat_process(struct powermsg *pm)
     process_waiters(pm->mh, pm->plugname, status_str);
 }
 
+/* map PowerState to status, NULL if not available */
+static const char *member_status(json_t *member, const char *plugname)
+{
+    json_t *val;
+    const char *str;
+
+    if (!(val = json_object_get(member, "PowerState"))
+        || !(str = json_string_value(val)))
+        return NULL;
+    if (strcasecmp(str, "On") == 0)
+        return STATUS_ON;
+    if (strcasecmp(str, "Off") == 0)
+        return STATUS_OFF;
+    if (verbose)
+        printf("%s: unknown status - %s\n", plugname, str);
+    return STATUS_UNKNOWN;
+}
+
+/* "@odata.id" and stat paths are compared w/o leading or trailing
+ * slashes and w/o any query string
+ */
+static char *collection_key(const char *path)
+{
+    char *key;
+    size_t len;
+
+    while (*path == '/')
+        path++;
+    len = strcspn(path, "?");
+    while (len > 0 && path[len - 1] == '/')
+        len--;
+    key = xmalloc(len + 1);
+    memcpy(key, path, len);
+    key[len] = '\0';
+    return key;
+}
+
+/* issue per plug stat for plugs the collection query did not cover */
+static void stat_collection_fallback(struct powermsg *pm, hostlist_t fallback)
+{
+    hostlist_iterator_t itr;
+    char *plugname;
+
+    if (!(itr = hostlist_iterator_create(fallback)))
+        err_exit(true, "hostlist_iterator_create");
+
+    while ((plugname = hostlist_next(itr))) {
+        struct powermsg *plugpm;
+        if ((plugpm = stat_cmd_plug(pm->mh, plugname, pm->output_result))) {
+            activecmds_add(plugpm);
+        }
+        free(plugname);
+    }
+
+    hostlist_iterator_destroy(itr);
+}
+
+/* collection query failed, if the host does not support it (e.g. http
+ * error), do not try it again
+ */
+static void stat_collection_error(struct powermsg *pm,
+                                  int unsupported,
+                                  const char *errstr)
+{
+    if (verbose)
+        printf("%s: stat collection error, stat per plug: %s\n",
+               pm->hostname, errstr);
+    if (unsupported
+        && hostlist_find(statcollection_unsupported_hosts, pm->hostname) < 0) {
+        if (!hostlist_push_host(statcollection_unsupported_hosts,
+                                pm->hostname))
+            err_exit(true, "hostlist_push_host error on %s", pm->hostname);
+    }
+    stat_collection_fallback(pm, pm->batchplugs);
+}
+
+static void stat_collection_process(struct powermsg *pm)
+{
+    zhashx_t *members = NULL;
+    json_t *o = NULL;
+    hostlist_iterator_t itr;
+    hostlist_t fallback;
+    char *plugname;
+    int found = 0;
+
+    /* index members by "@odata.id" */
+    if (!test_mode) {
+        json_error_t error;
+        json_t *array;
+        size_t index;
+        json_t *member;
+
+        if (!pm->output || !(o = json_loads(pm->output, 0, &error))) {
+            stat_collection_error(pm,
+                                  1,
+                                  pm->output ? error.text : "no output");
+            return;
+        }
+        if (!(members = zhashx_new()))
+            err_exit(false, "zhashx_new error");
+        if ((array = json_object_get(o, "Members"))) {
+            json_array_foreach(array, index, member) {
+                json_t *id = json_object_get(member, "@odata.id");
+                const char *idstr;
+                if (id && (idstr = json_string_value(id))) {
+                    char *key = collection_key(idstr);
+                    /* ignore duplicate ids */
+                    (void)zhashx_insert(members, key, member);
+                    free(key);
+                }
+            }
+        }
+    }
+
+    if (!(fallback = hostlist_create(NULL)))
+        err_exit(true, "hostlist_create error");
+
+    if (!(itr = hostlist_iterator_create(pm->batchplugs)))
+        err_exit(true, "hostlist_iterator_create");
+
+    while ((plugname = hostlist_next(itr))) {
+        const char *status_str = NULL;
+
+        if (test_mode) {
+            if (!(status_str = zhashx_lookup(test_power_status, plugname)))
+                err_exit(false, "zhashx_lookup on test status failed");
+        }
+        else {
+            char *path = NULL;
+            json_t *member = NULL;
+
+            get_path(CMD_STAT, plugname, &path, NULL);
+            if (path) {
+                char *key = collection_key(path);
+                member = zhashx_lookup(members, key);
+                free(key);
+                free(path);
+            }
+            if (member)
+                status_str = member_status(member, plugname);
+        }
+
+        /* member missing or PowerState not expanded */
+        if (!status_str) {
+            if (!hostlist_push_host(fallback, plugname))
+                err_exit(true, "hostlist_push_host error on %s", plugname);
+            free(plugname);
+            continue;
+        }
+
+        found++;
+        if (pm->output_result)
+            printf("%s: %s\n", plugname, status_str);
+        if (verbose > 1)
+            fprintf(stderr,
+                    "DEBUG: %s hostname=%s plugname=%s status=%s\n",
+                    pm->cmd, pm->hostname, plugname, status_str);
+        process_waiters(pm->mh, plugname, status_str);
+        free(plugname);
+    }
+
+    hostlist_iterator_destroy(itr);
+
+    if (hostlist_count(fallback) > 0) {
+        if (!found)
+            stat_collection_error(pm, 1, "no PowerState in members");
+        else
+            stat_collection_fallback(pm, fallback);
+    }
+    hostlist_destroy(fallback);
+
+    zhashx_destroy(&members);
+    json_decref(o);
+}
+
 static void stat_cleanup(struct powermsg *pm)
 {
     powermsg_destroy(pm);
@@ -904,12 +1702,26 @@ struct powermsg *power_cmd_plug(CURLM * mh,
  * So we simply don't allow it.  Powering on different levels
  * is left to users.
  */
+static int phased_power_on_target(zhashx_t *targets, struct powermsg *pm)
+{
+    const char *ancestor = pm->parent;
+
+    while (ancestor) {
+        struct plug_data *pd;
+        if (zhashx_lookup(targets, ancestor))
+            return 1;
+        if (!(pd = plugs_get_data(plugs, ancestor)))
+            break;
+        ancestor = pd->parent;
+    }
+    return 0;
+}
+
 static void phased_power_on_check(const char *cmd)
 {
-    struct powermsg **allpm;
+    zhashx_t *targets;
     struct powermsg *pm;
     int total = 0;
-    int i = 0;
     int cancel = 0;
 
     if (strcmp(cmd, CMD_ON) != 0)
@@ -924,35 +1736,33 @@ static void phased_power_on_check(const char *cmd)
     if (total == 1)
         return;
 
-    /* we need to compare every target to every other target, an array
-     * is easier for this than the lists.
+    /* a target cannot be an ancestor of any other target, so gather
+     * all targets, then look for them in every target's ancestors.
      */
 
-    allpm = (struct powermsg **)xmalloc(sizeof(*allpm) * total);
+    if (!(targets = zhashx_new()))
+        err_exit(false, "zhashx_new error");
 
     pm = zlistx_first(activecmds);
     while (pm) {
-        allpm[i++] = pm;
+        (void)zhashx_insert(targets, pm->plugname, pm);
         pm = zlistx_next(activecmds);
     }
 
     pm = zlistx_first(waitcmds);
     while (pm) {
-        allpm[i++] = pm;
+        (void)zhashx_insert(targets, pm->plugname, pm);
         pm = zlistx_next(waitcmds);
     }
 
-    for (i = 0; i < (total - 1); i++) {
-        struct powermsg *pm1 = allpm[i];
-        for (int j = i + 1; j < total; j++) {
-            struct powermsg *pm2 = allpm[j];
-            int d1 = plugs_is_descendant(plugs, pm1->plugname, pm2->plugname);
-            int d2 = plugs_is_descendant(plugs, pm2->plugname, pm1->plugname);
-            if (d1 || d2) {
-                cancel++;
-                break;
-            }
+    /* only waitcmds have ancestors */
+    pm = zlistx_first(waitcmds);
+    while (pm) {
+        if (phased_power_on_target(targets, pm)) {
+            cancel++;
+            break;
         }
+        pm = zlistx_next(waitcmds);
     }
 
     if (cancel) {
@@ -961,6 +1771,7 @@ static void phased_power_on_check(const char *cmd)
             printf("%s: %s\n", pm->plugname, "cannot turn on parent and child");
             pm = zlistx_next(activecmds);
         }
+        cmdindex_purge(activecmds_index);
         zlistx_purge(activecmds);
 
         pm = zlistx_first(waitcmds);
@@ -968,10 +1779,11 @@ static void phased_power_on_check(const char *cmd)
             printf("%s: %s\n", pm->plugname, "cannot turn on parent and child");
             pm = zlistx_next(waitcmds);
         }
+        cmdindex_purge(waitcmds_index);
         zlistx_purge(waitcmds);
     }
 
-    free(allpm);
+    zhashx_destroy(&targets);
     return;
 }
 
@@ -1008,14 +1820,12 @@ static void power_cmd(CURLM *mh,
             free(plugname);
             continue;
         }
+        event_stream_open(mh, pm->hostname);
         if (pm->parent) {
-            if (!(pm->handle = zlistx_add_end(waitcmds, pm)))
-                err_exit(true, "zlistx_add_end");
+            waitcmds_add(pm);
         }
         else {
-            powermsg_init_curl(pm);
-            if (!(pm->handle = zlistx_add_end(activecmds, pm)))
-                err_exit(true, "zlistx_add_end");
+            activecmds_add(pm);
         }
         free(plugname);
     }
@@ -1045,6 +1855,7 @@ static void off_cmd(CURLM *mh, char **av)
 static void send_status_poll(struct powermsg *pm)
 {
     struct powermsg *nextpm;
+    struct eventstream *es;
     char *path = NULL;
     long int poll_delay;
 
@@ -1090,6 +1901,16 @@ static void send_status_poll(struct powermsg *pm)
     else
         poll_delay = status_polling_interval * 4;
 
+    /* If an event stream is delivering events, the event will wake
+     * this poll early (see event_wake()), polling is only a backstop.
+     * Unless an event was already seen since the on/off started, which
+     * we may have missed the target of, poll less often.
+     */
+    if ((es = zhashx_lookup(eventstreams, pm->hostname))
+        && es->established
+        && !timercmp(&es->last_event, &pm->start, >))
+        poll_delay = status_polling_interval * EVENT_POLLING_MULTIPLIER;
+
     /* issue a follow on stat to wait until the on/off is complete.
      * note that we set the initial start time of this new command to
      * the original on/off, so we can timeout correctly
@@ -1109,11 +1930,25 @@ static void send_status_poll(struct powermsg *pm)
                              pm->poll_count + 1,
                              OUTPUT_RESULT,
                              STATE_WAIT_UNTIL_ON_OFF);
-    if (!(nextpm->handle = zlistx_add_end(delayedcmds, nextpm)))
-        err_exit(true, "zlistx_add_end");
+    delayedcmds_add(nextpm, path);
     free(path);
 }
 
+static void test_power_off_descendants(const char *plugname)
+{
+    zlistx_t *children = plugs_children(plugs, plugname);
+    char *name;
+
+    if (!children)
+        return;
+    name = zlistx_first(children);
+    while (name) {
+        zhashx_update(test_power_status, name, STATUS_OFF);
+        test_power_off_descendants(name);
+        name = zlistx_next(children);
+    }
+}
+
 static void on_off_process(struct powermsg *pm)
 {
     if (pm->state == STATE_SEND_POWERCMD) {
@@ -1128,22 +1963,18 @@ static void on_off_process(struct powermsg *pm)
             if (strcmp(pm->cmd, CMD_ON) == 0)
                 zhashx_update(test_power_status, pm->plugname, STATUS_ON);
             else { /* cmd == CMD_OFF */
-                zlistx_t *keys;
-                char *name;
                 zhashx_update(test_power_status, pm->plugname, STATUS_OFF);
                 /* all children automatically become off too */
-                if (!(keys = zhashx_keys(test_power_status)))
-                    err_exit(false, "zhashx_keys");
-                name = zlistx_first(keys);
-                while (name) {
-                    int descendant = plugs_is_descendant(plugs,
-                                                         name,
-                                                         pm->plugname);
-                    if (descendant)
-                        zhashx_update(test_power_status, name, STATUS_OFF);
-                    name = zlistx_next(keys);
-                }
-                zlistx_destroy(&keys);
+                test_power_off_descendants(pm->plugname);
+            }
+
+            /* simulate the power state change event */
+            if (zhashx_lookup(eventstreams, pm->hostname)) {
+                char *path = NULL;
+                get_path(CMD_STAT, pm->plugname, &path, NULL);
+                if (path)
+                    event_wake(pm->hostname, path);
+                free(path);
             }
         }
     }
@@ -1209,8 +2040,12 @@ static void off_process(struct powermsg *pm)
 
 static void power_cmd_process(struct powermsg *pm)
 {
-    if (strcmp(pm->cmd, CMD_STAT) == 0)
-        stat_process(pm);
+    if (strcmp(pm->cmd, CMD_STAT) == 0) {
+        if (pm->state == STATE_STAT_COLLECTION)
+            stat_collection_process(pm);
+        else
+            stat_process(pm);
+    }
     else if (strcmp(pm->cmd, CMD_ON) == 0)
         on_process(pm);
     else if (strcmp(pm->cmd, CMD_OFF) == 0)
@@ -1457,6 +2292,26 @@ cleanup:
     hostlist_destroy(lplugs);
 }
 
+static void setstatcollection(char **av)
+{
+    if (statcollection) {
+        xfree(statcollection);
+        statcollection = NULL;
+    }
+    if (av[0])
+        statcollection = xstrdup(av[0]);
+}
+
+static void seteventpath(char **av)
+{
+    if (eventpath) {
+        xfree(eventpath);
+        eventpath = NULL;
+    }
+    if (av[0])
+        eventpath = xstrdup(av[0]);
+}
+
 static void settimeout(char **av)
 {
     if (av[0]) {
@@ -1494,6 +2349,10 @@ static void process_cmd(CURLM *mh, char **av, int *exitflag)
             setplugs(av + 1);
         else if (strcmp(av[0], "setpath") == 0)
             setpath(av + 1);
+        else if (strcmp(av[0], "setstatcollection") == 0)
+            setstatcollection(av + 1);
+        else if (strcmp(av[0], "seteventpath") == 0)
+            seteventpath(av + 1);
         else if (strcmp(av[0], "settimeout") == 0)
             settimeout(av + 1);
         else if (strcmp(av[0], CMD_STAT) == 0)
@@ -1571,8 +2430,11 @@ static void shell(CURLM *mh)
         FD_ZERO(&fderror);
 
         if (!zlistx_size(activecmds)
-            && !zlistx_size(delayedcmds)
+            && !delayq_size(delayedcmds)
             && !zlistx_size(waitcmds)) {
+            /* nothing left to wait on, event streams not needed */
+            zhashx_purge(eventstreams);
+
             printf("redfishpower> ");
             fflush(stdout);
 
@@ -1585,30 +2447,25 @@ static void shell(CURLM *mh)
             long curl_timeout_ms;
 
             /* First check if there are any delayedcmds to send or are
-             * waiting.  If there are some ready to send, put to
-             * activecmds.  If not, setup timeout accordingly if one
-             * is waiting */
-            if (zlistx_size(delayedcmds) > 0) {
-                struct powermsg *delaypm = zlistx_first(delayedcmds);
-                struct timeval delaytimeout;
+             * waiting.  Send all that are due within the next
+             * DELAY_COALESCE_USEC as one batch, rather than waking up
+             * for each.  If none are ready, setup timeout for the
+             * earliest.
+             */
+            if (delayq_size(delayedcmds) > 0) {
+                struct powermsg *delaypm;
+                struct timeval coalesce = { 0, DELAY_COALESCE_USEC };
                 struct timeval now;
+                struct timeval due;
+                struct timeval delaystart;
+
                 gettimeofday(&now, NULL);
-                while (delaypm) {
-                    if (timercmp(&delaypm->delaystart, &now, >))
-                        break;
-                    zlistx_detach_cur(delayedcmds);
-                    powermsg_init_curl(delaypm);
-                    if (!(delaypm->handle = zlistx_add_end(activecmds,
-                                                           delaypm)))
-                        err_exit(true, "zlistx_add_end");
-                    delaypm = zlistx_next(delayedcmds);
-                }
+                timeradd(&now, &coalesce, &due);
+                while ((delaypm = delayedcmds_pop_due(&due)))
+                    activecmds_add(delaypm);
 
-                delaypm = zlistx_first(delayedcmds);
-                if (delaypm) {
-                    timersub(&delaypm->delaystart, &now, &delaytimeout);
-                    timeout.tv_sec = delaytimeout.tv_sec;
-                    timeout.tv_usec = delaytimeout.tv_usec;
+                if (delayq_head(delayedcmds, &delaystart)) {
+                    timersub(&delaystart, &now, &timeout);
                     timeoutptr = &timeout;
                 }
             }
@@ -1683,7 +2540,8 @@ static void shell(CURLM *mh)
                 break;
         }
 
-        if (zlistx_size(activecmds) == 0)
+        if (zlistx_size(activecmds) == 0
+            && (test_mode || zhashx_size(eventstreams) == 0))
             continue;
 
         if (!test_mode) {
@@ -1710,21 +2568,30 @@ static void shell(CURLM *mh)
                                  "curl_easy_getinfo: %s",
                                  curl_easy_strerror(ec));
 
-                    if (!pm)
-                        err_exit(false, "private data not set in easy handle");
+                    if (!pm) {
+                        event_stream_done(eh, cmsg->data.result);
+                        continue;
+                    }
 
                     if (cmsg->data.result != 0) {
-                        if (pm->output_result)
-                            output_curl_error (cmsg, pm);
-                        process_waiters(mh,
-                                        pm->plugname,
-                                        STATUS_ERROR);
+                        if (pm->state == STATE_STAT_COLLECTION) {
+                            CURLcode result = cmsg->data.result;
+                            stat_collection_error(pm,
+                                                  result == CURLE_HTTP_RETURNED_ERROR,
+                                                  curl_easy_strerror(result));
+                        }
+                        else {
+                            if (pm->output_result)
+                                output_curl_error (cmsg, pm);
+                            process_waiters(mh,
+                                            pm->plugname,
+                                            STATUS_ERROR);
+                        }
                     }
                     else
                         power_cmd_process(pm);
                     fflush(stdout);
-                    if (zlistx_delete(activecmds, pm->handle) < 0)
-                        err_exit(false, "zlistx_delete failed to delete");
+                    activecmds_delete(pm);
                 }
             } while (cmsg);
         }
@@ -1754,11 +2621,15 @@ static void shell(CURLM *mh)
             pm = zlistx_first(cpy);
             while (pm) {
                 if (hostlist_find(test_fail_power_cmd_hosts, pm->hostname) >= 0) {
-                    if (pm->output_result)
-                        printf("%s: %s\n", pm->plugname, "error");
-                    process_waiters(mh,
-                                    pm->plugname,
-                                    STATUS_ERROR);
+                    if (pm->state == STATE_STAT_COLLECTION)
+                        stat_collection_error(pm, 1, "error");
+                    else {
+                        if (pm->output_result)
+                            printf("%s: %s\n", pm->plugname, "error");
+                        process_waiters(mh,
+                                        pm->plugname,
+                                        STATUS_ERROR);
+                    }
                 }
                 else
                     power_cmd_process(pm);
@@ -1768,8 +2639,7 @@ static void shell(CURLM *mh)
 
             pm = zlistx_first(cpy);
             while (pm) {
-                if (zlistx_delete(activecmds, pm->handle) < 0)
-                    err_exit(false, "zlistx_delete failed to delete");
+                activecmds_delete(pm);
                 pm = zlistx_next(cpy);
             }
 
@@ -1815,14 +2685,33 @@ static void init_redfishpower(char *argv[])
         err_exit(true, "zlistx_new");
     zlistx_set_destructor(activecmds, cleanup_powermsg);
 
-    if (!(delayedcmds = zlistx_new()))
-        err_exit(true, "zlistx_new");
-    zlistx_set_destructor(delayedcmds, cleanup_powermsg);
+    delayedcmds = delayq_create(cleanup_powermsg);
 
     if (!(waitcmds = zlistx_new()))
         err_exit(true, "zlistx_new");
     zlistx_set_destructor(waitcmds, cleanup_powermsg);
 
+    if (!(output_pool = zlistx_new()))
+        err_exit(true, "zlistx_new");
+    zlistx_set_destructor(output_pool, output_buf_destroy);
+
+    if (!(activecmds_index = cmdindex_create()))
+        err_exit(true, "cmdindex_create");
+    if (!(waitcmds_index = cmdindex_create()))
+        err_exit(true, "cmdindex_create");
+    if (!(delayedcmds_index = cmdindex_create()))
+        err_exit(true, "cmdindex_create");
+
+    if (!(statcollection_unsupported_hosts = hostlist_create(NULL)))
+        err_exit(true, "hostlist_create error");
+
+    if (!(eventstreams = zhashx_new ()))
+        err_exit(false, "zhashx_new error");
+    zhashx_set_destructor(eventstreams, eventstream_destroy_wrapper);
+
+    if (!(event_unsupported_hosts = hostlist_create(NULL)))
+        err_exit(true, "hostlist_create error");
+
     if (!(test_fail_power_cmd_hosts = hostlist_create(NULL)))
         err_exit(true, "hostlist_create error");
 
@@ -1845,12 +2734,22 @@ static void cleanup_redfishpower(void)
     xfree(onpostdata);
     xfree(offpath);
     xfree(offpostdata);
+    xfree(statcollection);
+    hostlist_destroy(statcollection_unsupported_hosts);
 
     hostlist_destroy(hosts);
 
     zlistx_destroy(&activecmds);
-    zlistx_destroy(&delayedcmds);
+    delayq_destroy(delayedcmds);
     zlistx_destroy(&waitcmds);
+    cmdindex_destroy(activecmds_index);
+    cmdindex_destroy(waitcmds_index);
+    cmdindex_destroy(delayedcmds_index);
+    zlistx_destroy(&output_pool);
+
+    xfree(eventpath);
+    zhashx_destroy(&eventstreams);
+    hostlist_destroy(event_unsupported_hosts);
 
     hostlist_destroy(test_fail_power_cmd_hosts);
     zhashx_destroy(&test_power_status);
@@ -2008,8 +2907,10 @@ int main(int argc, char *argv[])
 
     shell(mh);
 
-    if (!test_mode)
+    if (!test_mode) {
+        zhashx_purge(eventstreams);
         curl_multi_cleanup(mh);
+    }
 
     cleanup_redfishpower();
     exit(0);
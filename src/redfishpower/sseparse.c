@@ -0,0 +1,110 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sseparse.h"
+
+#include "xmalloc.h"
+
+struct sseparse {
+    sseparse_event_fn *cb;
+    void *arg;
+
+    /* buf - partial line not yet processed
+     * data - "data:" lines of the current event
+     */
+    char *buf;
+    size_t buf_len;
+    char *data;
+    size_t data_len;
+};
+
+sseparse_t *sseparse_create(sseparse_event_fn *cb, void *arg)
+{
+    sseparse_t *sp = (sseparse_t *)xmalloc(sizeof(*sp));
+
+    sp->cb = cb;
+    sp->arg = arg;
+    sp->buf = NULL;
+    sp->buf_len = 0;
+    sp->data = NULL;
+    sp->data_len = 0;
+    return sp;
+}
+
+void sseparse_destroy(sseparse_t *sp)
+{
+    if (sp) {
+        xfree(sp->buf);
+        xfree(sp->data);
+        xfree(sp);
+    }
+}
+
+/* Lines are "field: value", an event is terminated by an empty line.
+ */
+static void parse_line(sseparse_t *sp, char *line)
+{
+    if (line[0] == '\0') {
+        if (sp->data) {
+            sp->cb(sp->data, sp->arg);
+            xfree(sp->data);
+            sp->data = NULL;
+            sp->data_len = 0;
+        }
+    }
+    else if (strncmp(line, "data:", 5) == 0) {
+        char *val = line + 5;
+        size_t len;
+
+        if (*val == ' ')
+            val++;
+        len = strlen(val);
+        /* +2 for joining newline and NUL */
+        sp->data = xrealloc(sp->data, sp->data_len + len + 2);
+        if (sp->data_len)
+            sp->data[sp->data_len++] = '\n';
+        memcpy(sp->data + sp->data_len, val, len);
+        sp->data_len += len;
+        sp->data[sp->data_len] = '\0';
+    }
+}
+
+void sseparse_feed(sseparse_t *sp, const char *buf, size_t len)
+{
+    char *start;
+    char *nl;
+
+    sp->buf = xrealloc(sp->buf, sp->buf_len + len + 1);
+    memcpy(sp->buf + sp->buf_len, buf, len);
+    sp->buf_len += len;
+    sp->buf[sp->buf_len] = '\0';
+
+    start = sp->buf;
+    while ((nl = strchr(start, '\n'))) {
+        *nl = '\0';
+        if (nl > start && *(nl - 1) == '\r')
+            *(nl - 1) = '\0';
+        parse_line(sp, start);
+        start = nl + 1;
+    }
+    sp->buf_len -= (start - sp->buf);
+    memmove(sp->buf, start, sp->buf_len + 1);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,38 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+#ifndef REDFISHPOWER_SSEPARSE_H
+#define REDFISHPOWER_SSEPARSE_H
+
+#include <stddef.h>
+
+/* Incremental Server-Sent Events parser.  Input may be split anywhere,
+ * including in the middle of a line or between the CR and LF of a
+ * line ending.  Only "data" fields are collected, "event", "id",
+ * "retry" and comments are ignored.
+ */
+
+typedef struct sseparse sseparse_t;
+
+/* called with the "data" lines of an event joined by newlines */
+typedef void (sseparse_event_fn)(const char *data, void *arg);
+
+sseparse_t *sseparse_create(sseparse_event_fn *cb, void *arg);
+
+void sseparse_destroy(sseparse_t *sp);
+
+/* parse len bytes of input, calling cb for each complete event */
+void sseparse_feed(sseparse_t *sp, const char *buf, size_t len);
+
+#endif /* REDFISHPOWER_SSEPARSE_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,157 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/*
+ * Test driver for cmdindex
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+#include "cmdindex.h"
+
+static void basic_tests(void)
+{
+    cmdindex_t *ci;
+    zlistx_t *l;
+    int a, b, c;
+
+    ci = cmdindex_create();
+    if (!ci)
+        BAIL_OUT("cmdindex_create");
+
+    ok(cmdindex_lookup(ci, "node0") == NULL,
+       "cmdindex_lookup returns NULL before we added any");
+    ok(cmdindex_count(ci, "node0") == 0,
+       "cmdindex_count returns 0 before we added any");
+
+    cmdindex_add(ci, "node0", &a);
+    cmdindex_add(ci, "node0", &b);
+    cmdindex_add(ci, "node1", &c);
+
+    ok(cmdindex_count(ci, "node0") == 2,
+       "cmdindex_count returns 2 items for node0");
+    ok(cmdindex_count(ci, "node1") == 1,
+       "cmdindex_count returns 1 item for node1");
+
+    l = cmdindex_lookup(ci, "node0");
+    ok(l != NULL
+       && zlistx_first(l) == &a
+       && zlistx_next(l) == &b,
+       "cmdindex_lookup returns items in order added");
+
+    cmdindex_remove(ci, &a);
+    ok(cmdindex_count(ci, "node0") == 1,
+       "cmdindex_count returns 1 item for node0 after removal");
+    l = cmdindex_lookup(ci, "node0");
+    ok(l != NULL && zlistx_first(l) == &b,
+       "cmdindex_lookup returns remaining item");
+
+    cmdindex_remove(ci, &b);
+    ok(cmdindex_lookup(ci, "node0") == NULL,
+       "cmdindex_lookup returns NULL after all items removed");
+
+    /* removing an item not in the index is a no-op */
+    cmdindex_remove(ci, &a);
+    ok(cmdindex_count(ci, "node1") == 1,
+       "cmdindex_remove of unknown item does not affect index");
+
+    cmdindex_destroy(ci);
+}
+
+static void multiple_names_tests(void)
+{
+    cmdindex_t *ci;
+    int a, b;
+
+    ci = cmdindex_create();
+    if (!ci)
+        BAIL_OUT("cmdindex_create");
+
+    /* e.g. waiter indexed under each ancestor */
+    cmdindex_add(ci, "root", &a);
+    cmdindex_add(ci, "blade0", &a);
+    cmdindex_add(ci, "root", &b);
+    cmdindex_add(ci, "blade1", &b);
+
+    ok(cmdindex_count(ci, "root") == 2,
+       "cmdindex_count returns 2 items for root");
+    ok(cmdindex_count(ci, "blade0") == 1
+       && cmdindex_count(ci, "blade1") == 1,
+       "cmdindex_count returns 1 item for each blade");
+
+    cmdindex_remove(ci, &a);
+    ok(cmdindex_count(ci, "root") == 1,
+       "cmdindex_remove removes item from root");
+    ok(cmdindex_lookup(ci, "blade0") == NULL,
+       "cmdindex_remove removes item from blade0");
+    ok(cmdindex_count(ci, "blade1") == 1,
+       "cmdindex_remove leaves other items alone");
+
+    cmdindex_purge(ci);
+    ok(cmdindex_lookup(ci, "root") == NULL
+       && cmdindex_lookup(ci, "blade1") == NULL,
+       "cmdindex_purge removes everything");
+
+    /* index is usable after purge */
+    cmdindex_add(ci, "root", &a);
+    ok(cmdindex_count(ci, "root") == 1,
+       "cmdindex_add works after purge");
+
+    cmdindex_destroy(ci);
+}
+
+static void many_items_tests(void)
+{
+    cmdindex_t *ci;
+    int items[10000];
+    int i;
+
+    ci = cmdindex_create();
+    if (!ci)
+        BAIL_OUT("cmdindex_create");
+
+    for (i = 0; i < 10000; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "blade%d", i / 100);
+        cmdindex_add(ci, "root", &items[i]);
+        cmdindex_add(ci, name, &items[i]);
+    }
+    ok(cmdindex_count(ci, "root") == 10000,
+       "cmdindex_count returns 10000 items for root");
+    ok(cmdindex_count(ci, "blade99") == 100,
+       "cmdindex_count returns 100 items for blade99");
+
+    for (i = 0; i < 10000; i += 2)
+        cmdindex_remove(ci, &items[i]);
+    ok(cmdindex_count(ci, "root") == 5000,
+       "cmdindex_count returns 5000 items for root after removal");
+    ok(cmdindex_count(ci, "blade0") == 50,
+       "cmdindex_count returns 50 items for blade0 after removal");
+
+    cmdindex_destroy(ci);
+}
+
+int main(int argc, char *argv[])
+{
+    plan(NO_PLAN);
+
+    basic_tests();
+    multiple_names_tests();
+    many_items_tests();
+
+    done_testing();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,192 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/*
+ * Test driver for delayq
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "tap.h"
+#include "delayq.h"
+
+static int destroyed;
+
+static void count_destructor(void **item)
+{
+    destroyed++;
+    *item = NULL;
+}
+
+static void basic_tests(void)
+{
+    delayq_t *dq;
+    struct timeval tv;
+    struct timeval due;
+    int a, b, c;
+    void *ha;
+
+    dq = delayq_create(NULL);
+    if (!dq)
+        BAIL_OUT("delayq_create");
+
+    ok(delayq_size(dq) == 0,
+       "delayq_size returns 0 on empty queue");
+    ok(delayq_head(dq, NULL) == NULL,
+       "delayq_head returns NULL on empty queue");
+
+    tv = (struct timeval){ 30, 0 };
+    ha = delayq_add(dq, &tv, &a);
+    tv = (struct timeval){ 10, 0 };
+    delayq_add(dq, &tv, &b);
+    tv = (struct timeval){ 20, 0 };
+    delayq_add(dq, &tv, &c);
+
+    ok(delayq_size(dq) == 3,
+       "delayq_size returns 3");
+    ok(delayq_head(dq, &tv) == &b && tv.tv_sec == 10,
+       "delayq_head returns earliest deadline, not first added");
+
+    due = (struct timeval){ 5, 0 };
+    ok(delayq_pop_due(dq, &due) == NULL,
+       "delayq_pop_due returns NULL if nothing due");
+
+    due = (struct timeval){ 20, 0 };
+    ok(delayq_pop_due(dq, &due) == &b
+       && delayq_pop_due(dq, &due) == &c
+       && delayq_pop_due(dq, &due) == NULL,
+       "delayq_pop_due returns all due items in deadline order");
+
+    tv = (struct timeval){ 1, 0 };
+    delayq_update(dq, ha, &tv);
+    ok(delayq_head(dq, &tv) == &a && tv.tv_sec == 1,
+       "delayq_update changes deadline");
+
+    ok(delayq_remove(dq, ha) == &a && delayq_size(dq) == 0,
+       "delayq_remove returns item and removes it");
+
+    delayq_destroy(dq);
+}
+
+static void fifo_tests(void)
+{
+    delayq_t *dq;
+    struct timeval tv = { 10, 500 };
+    int items[5];
+    int i;
+    int inorder = 1;
+
+    dq = delayq_create(NULL);
+    if (!dq)
+        BAIL_OUT("delayq_create");
+
+    for (i = 0; i < 5; i++)
+        delayq_add(dq, &tv, &items[i]);
+    for (i = 0; i < 5; i++) {
+        if (delayq_pop_due(dq, &tv) != &items[i])
+            inorder = 0;
+    }
+    ok(inorder,
+       "items with equal deadlines come out in order added");
+
+    delayq_destroy(dq);
+}
+
+static void many_items_tests(void)
+{
+    delayq_t *dq;
+    struct timeval tv;
+    struct timeval last = { 0, 0 };
+    struct timeval due = { 100000, 0 };
+    void *handles[10000];
+    int items[10000];
+    int count = 0;
+    int inorder = 1;
+    int i;
+
+    dq = delayq_create(NULL);
+    if (!dq)
+        BAIL_OUT("delayq_create");
+
+    /* pseudo random deadlines */
+    for (i = 0; i < 10000; i++) {
+        tv.tv_sec = (i * 7919) % 10007;
+        tv.tv_usec = (i * 104729) % 1000000;
+        items[i] = i;
+        handles[i] = delayq_add(dq, &tv, &items[i]);
+    }
+    ok(delayq_size(dq) == 10000,
+       "delayq_size returns 10000");
+
+    for (i = 0; i < 10000; i += 3)
+        delayq_remove(dq, handles[i]);
+    ok(delayq_size(dq) == 6666,
+       "delayq_size returns 6666 after removal");
+
+    count = 0;
+    if (delayq_first(dq)) {
+        count++;
+        while (delayq_next(dq))
+            count++;
+    }
+    ok(count == 6666,
+       "delayq_first/next iterate over all items");
+
+    count = 0;
+    while (delayq_head(dq, &tv)) {
+        if (timercmp(&tv, &last, <))
+            inorder = 0;
+        last = tv;
+        if (!delayq_pop_due(dq, &due))
+            break;
+        count++;
+    }
+    ok(inorder && count == 6666,
+       "delayq_pop_due returns items in deadline order");
+
+    delayq_destroy(dq);
+}
+
+static void destructor_tests(void)
+{
+    delayq_t *dq;
+    struct timeval tv = { 1, 0 };
+    int a, b;
+
+    dq = delayq_create(count_destructor);
+    if (!dq)
+        BAIL_OUT("delayq_create");
+
+    delayq_add(dq, &tv, &a);
+    delayq_add(dq, &tv, &b);
+    destroyed = 0;
+    delayq_destroy(dq);
+    ok(destroyed == 2,
+       "delayq_destroy calls destructor on queued items");
+}
+
+int main(int argc, char *argv[])
+{
+    plan(NO_PLAN);
+
+    basic_tests();
+    fifo_tests();
+    many_items_tests();
+    destructor_tests();
+
+    done_testing();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,118 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/*
+ * Test driver for jsonscan
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+#include "jsonscan.h"
+
+static int scan(const char *buf, const char *key, char *val, size_t val_size)
+{
+    const char *v;
+    size_t len;
+    int ret;
+
+    val[0] = '\0';
+    ret = jsonscan_string(buf, strlen(buf), key, &v, &len);
+    if (ret == 1 && len < val_size) {
+        memcpy(val, v, len);
+        val[len] = '\0';
+    }
+    return ret;
+}
+
+struct scantest {
+    const char *buf;
+    int ret;
+    const char *val;
+    const char *desc;
+};
+
+static struct scantest tests[] = {
+    { "{\"PowerState\":\"On\"}", 1, "On", "simple object" },
+    { " { \"PowerState\" : \"Off\" } ", 1, "Off", "whitespace" },
+    { "{\"Id\":\"Node0\",\"PowerState\":\"PoweringOn\"}", 1, "PoweringOn",
+      "key after string value" },
+    { "{\"Status\":{\"PowerState\":\"Off\",\"x\":[1,{\"y\":\"}\"}]},"
+      "\"PowerState\":\"On\"}", 1, "On",
+      "nested PowerState is skipped" },
+    { "{\"a\":[1,2,[3,{}]],\"b\":true,\"c\":null,\"d\":-1.5e3,"
+      "\"PowerState\":\"Paused\"}", 1, "Paused",
+      "arrays, literals and numbers skipped" },
+    { "{\"s\":\"a\\\"b\\\\\",\"PowerState\":\"On\"}", 1, "On",
+      "escaped quotes in skipped string" },
+    { "{\"PowerState\":\"On\"", 1, "On",
+      "scan stops once key is found" },
+    { "{\"Id\":\"Node0\"}", 0, "", "key not present" },
+    { "{}", 0, "", "empty object" },
+    { "{\"Power\\u0053tate\":\"On\"}", 0, "", "escaped key not matched" },
+    { "{\"PowerState\":1}", -1, "", "non-string value" },
+    { "{\"PowerState\":\"O\\u006e\"}", -1, "", "escaped value" },
+    { "[\"PowerState\"]", -1, "", "not an object" },
+    { "", -1, "", "empty input" },
+    { "{\"Id\":\"Node0\"", -1, "", "truncated before key" },
+    { "{\"a\":{\"b\":[}}", -1, "", "mismatched brackets" },
+    { "{\"Id\" \"Node0\"}", -1, "", "missing colon" },
+    { "{\"Id\":\"Node0\" \"x\":1}", -1, "", "missing comma" },
+    { NULL, 0, NULL, NULL },
+};
+
+static void scan_tests(void)
+{
+    struct scantest *t;
+    char val[64];
+
+    for (t = tests; t->buf; t++) {
+        int ret = scan(t->buf, "PowerState", val, sizeof(val));
+        ok(ret == t->ret && strcmp(val, t->val) == 0,
+           "jsonscan_string: %s", t->desc);
+    }
+}
+
+static void large_tests(void)
+{
+    char *buf;
+    char val[64];
+    size_t len = 0;
+    int i;
+
+    if (!(buf = malloc(1024 * 1024)))
+        BAIL_OUT("malloc");
+    len += sprintf(buf + len, "{\"Members\":[");
+    for (i = 0; i < 10000; i++)
+        len += sprintf(buf + len, "%s{\"Id\":\"Node%d\",\"PowerState\":\"Off\"}",
+                       i ? "," : "", i);
+    sprintf(buf + len, "],\"PowerState\":\"On\"}");
+
+    ok(scan(buf, "PowerState", val, sizeof(val)) == 1
+       && strcmp(val, "On") == 0,
+       "jsonscan_string skips large nested array");
+    free(buf);
+}
+
+int main(int argc, char *argv[])
+{
+    plan(NO_PLAN);
+
+    scan_tests();
+    large_tests();
+
+    done_testing();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -171,6 +171,7 @@ static void hierarchy_tests(void)
 {
     plugs_t *p;
     struct plug_data *pd;
+    zlistx_t *children;
     char *plug;
     int ret;
 
@@ -295,6 +296,33 @@ static void hierarchy_tests(void)
     ok(strcmp(plug, "node2") == 0,
        "plugs_child_of_ancestor child of node0 starting from node5 is node2");
 
+    /* plugs_children tests */
+
+    children = plugs_children(p, "node0");
+    ok(children != NULL && zlistx_size(children) == 2,
+       "plugs_children node0 has 2 children");
+    ok(children != NULL
+       && strcmp(zlistx_first(children), "node1") == 0
+       && strcmp(zlistx_next(children), "node2") == 0,
+       "plugs_children of node0 are node1 and node2");
+    children = plugs_children(p, "node3");
+    ok(children == NULL,
+       "plugs_children node3 has no children");
+
+    /* re-parent node4 under node2 */
+    plugs_add(p, "node4", "foo4", "node2");
+    children = plugs_children(p, "node1");
+    ok(children != NULL && zlistx_size(children) == 1,
+       "plugs_children node1 has 1 child after re-parent");
+    children = plugs_children(p, "node2");
+    ok(children != NULL && zlistx_size(children) == 3,
+       "plugs_children node2 has 3 children after re-parent");
+
+    plugs_remove(p, "node3");
+    children = plugs_children(p, "node1");
+    ok(children == NULL,
+       "plugs_children node1 has no children after removal");
+
     plugs_destroy(p);
 }
 
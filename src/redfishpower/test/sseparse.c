@@ -0,0 +1,164 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/*
+ * Test driver for sseparse
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tap.h"
+#include "sseparse.h"
+
+#define MAXEVENTS 8
+
+struct events {
+    int count;
+    char *data[MAXEVENTS];
+};
+
+static void events_clear(struct events *e)
+{
+    int i;
+
+    for (i = 0; i < e->count; i++)
+        free(e->data[i]);
+    e->count = 0;
+}
+
+static void event_cb(const char *data, void *arg)
+{
+    struct events *e = arg;
+
+    if (e->count < MAXEVENTS)
+        e->data[e->count] = strdup(data);
+    e->count++;
+}
+
+/* A Redfish EventService stream as sent by a BMC, CRLF line endings,
+ * with a keepalive comment, id/event fields, and a multi-line event.
+ */
+static const char *stream =
+    ": keepalive\r\n"
+    "\r\n"
+    "id: 1\r\n"
+    "event: message\r\n"
+    "data: {\"Events\":[{\"OriginOfCondition\":"
+        "{\"@odata.id\":\"/redfish/v1/Systems/1\"}}]}\r\n"
+    "\r\n"
+    "id: 2\r\n"
+    "data: {\"Events\":[\r\n"
+    "data:{\"EventType\":\"Alert\"}]}\r\n"
+    "\r\n"
+    "data: {\"Events\":[]}\n"
+    "\n"
+    "data: incomplete";
+
+static const char *expected[] = {
+    "{\"Events\":[{\"OriginOfCondition\":"
+        "{\"@odata.id\":\"/redfish/v1/Systems/1\"}}]}",
+    "{\"Events\":[\n{\"EventType\":\"Alert\"}]}",
+    "{\"Events\":[]}",
+    NULL,
+};
+
+static int events_match(struct events *e)
+{
+    int i;
+
+    for (i = 0; expected[i]; i++) {
+        if (i >= e->count || i >= MAXEVENTS || strcmp(e->data[i], expected[i]))
+            return 0;
+    }
+    return e->count == i;
+}
+
+/* feed the stream as HTTP chunks of the given sizes, then the rest */
+static int feed_chunks(const int *sizes, struct events *e)
+{
+    sseparse_t *sp = sseparse_create(event_cb, e);
+    size_t len = strlen(stream);
+    size_t off = 0;
+    int match;
+
+    for (; *sizes && off < len; sizes++) {
+        size_t n = *sizes;
+        if (n > len - off)
+            n = len - off;
+        sseparse_feed(sp, stream + off, n);
+        off += n;
+    }
+    if (off < len)
+        sseparse_feed(sp, stream + off, len - off);
+    match = events_match(e);
+    sseparse_destroy(sp);
+    events_clear(e);
+    return match;
+}
+
+static void basic_tests(void)
+{
+    struct events e = { 0 };
+    sseparse_t *sp;
+    int whole[] = { 0 };
+    /* chunk boundaries inside "data:", between CR and LF, and inside
+     * the blank line that ends an event
+     */
+    int chunked[] = { 16, 3, 91, 1, 20, 7, 0 };
+    int bytes[4096];
+    size_t i;
+    int ok_all;
+
+    ok(feed_chunks(whole, &e), "stream in one buffer yields 3 events");
+    ok(feed_chunks(chunked, &e), "stream in chunks yields 3 events");
+
+    for (i = 0; i < strlen(stream); i++)
+        bytes[i] = 1;
+    bytes[i] = 0;
+    ok(feed_chunks(bytes, &e), "stream a byte at a time yields 3 events");
+
+    ok_all = 1;
+    for (i = 1; i < strlen(stream); i++) {
+        int split[] = { i, 0 };
+        if (!feed_chunks(split, &e)) {
+            diag("split at %zu failed", i);
+            ok_all = 0;
+        }
+    }
+    ok(ok_all, "stream split at every offset yields 3 events");
+
+    sp = sseparse_create(event_cb, &e);
+    sseparse_feed(sp, "data: a\r", 8);
+    ok(e.count == 0, "no event before the terminating blank line");
+    sseparse_feed(sp, "\n\r", 2);
+    ok(e.count == 0, "no event on a CR split from its LF");
+    sseparse_feed(sp, "\n", 1);
+    ok(e.count == 1 && strcmp(e.data[0], "a") == 0,
+       "event delivered once the blank line completes");
+    sseparse_feed(sp, "\n\n: comment\n\n", 13);
+    ok(e.count == 1, "blank lines and comments without data are ignored");
+    sseparse_destroy(sp);
+    events_clear(&e);
+}
+
+int main(int argc, char *argv[])
+{
+    plan(NO_PLAN);
+
+    basic_tests();
+
+    done_testing();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
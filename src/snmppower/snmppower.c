@@ -17,6 +17,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <errno.h>
+#include <sys/select.h>
 
 #include <net-snmp/net-snmp-config.h>
 #include <net-snmp/net-snmp-includes.h>
@@ -24,13 +26,84 @@
 #include "xmalloc.h"
 #include "error.h"
 #include "argv.h"
+#include "hostlist.h"
+#include "hash.h"
 
-#define OPTIONS "h:"
+/* number of table rows requested per GETBULK by walk */
+#define WALK_MAX_REPETITIONS 32
+
+#define HOSTSESSIONS_HASH_SIZE 1024
+
+/* Sessions to the hosts given by --hosts, used by the host commands
+ * (hget, hset, hwalk).  These send the request to each host at once
+ * and tag each line of output with the host name.
+ */
+struct hostsess {
+    char *host;
+    struct snmp_session *ss;
+    int reqid;                  /* outstanding request, 0 if none */
+    oid name[MAX_OID_LEN];      /* hwalk position */
+    size_t name_len;
+};
+
+enum {
+    HOSTREQ_GET,
+    HOSTREQ_SET,
+    HOSTREQ_WALK,
+};
+
+/* the host command in progress */
+struct hostreq {
+    int type;
+    char **oids;                /* oid (and type, value) arguments */
+    oid root[MAX_OID_LEN];      /* hwalk subtree */
+    size_t root_len;
+    int active;                 /* hosts with a request outstanding */
+};
+
+static hostlist_t hosts = NULL;
+static hash_t hostsessions = NULL;
+static struct hostreq hostreq;
+static long session_timeout = -1;   /* usec, -1 for net-snmp default */
+
+#define OPTIONS "h:H:t:"
 static struct option longopts[] = {
     {"hostname", required_argument, 0, 'h' },
+    {"hosts", required_argument, 0, 'H' },
+    {"timeout", required_argument, 0, 't' },
     {0,0,0,0},
 };
 
+/* Print "label: value", prefixed with "host: " if host is non-NULL.
+ */
+static void
+print_var (const char *host, const char *label, struct variable_list *vars)
+{
+    char buf[1024];
+
+    if (host)
+        printf ("%s: ", host);
+    switch (vars->type) {
+        case ASN_OCTET_STR:
+            printf("%s: %.*s\n", label,
+                   (int)vars->val_len, vars->val.string);
+            break;
+        case ASN_INTEGER:
+            printf("%s: %ld\n", label, *vars->val.integer);
+            break;
+        default:
+            /* print_variable() prints its own oid, the host needs a label */
+            if (host) {
+                snprint_value (buf, sizeof (buf),
+                               vars->name, vars->name_length, vars);
+                printf ("%s: %s\n", label, buf);
+            }
+            else
+                print_variable (vars->name, vars->name_length, vars);
+            break;
+    }
+}
+
 static void
 get (char **av, struct snmp_session **ssp)
 {
@@ -58,20 +131,8 @@ get (char **av, struct snmp_session **ssp)
     snmp_add_null_var (pdu, anOID, anOID_len);
     status = snmp_synch_response (*ssp, pdu, &response);
     if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-        for (vars = response->variables; vars; vars = vars->next_variable) {
-            switch (vars->type) {
-                case ASN_OCTET_STR:
-                    printf("%s: %*s\n", av[1],
-                           (int)vars->val_len, vars->val.string);
-                    break;
-                case ASN_INTEGER:
-                    printf("%s: %ld\n", av[1], *vars->val.integer);
-                    break;
-                default:
-                    print_variable (vars->name, vars->name_length, vars);
-                    break;
-            }
-        }
+        for (vars = response->variables; vars; vars = vars->next_variable)
+            print_var (NULL, av[1], vars);
     } else {
         if (status == STAT_SUCCESS)
             err_exit (false, "error in packet: %s",
@@ -83,6 +144,186 @@ get (char **av, struct snmp_session **ssp)
         snmp_free_pdu (response);
 }
 
+/* Get several oids with one PDU, so a whole PDU can be queried in one
+ * round trip.  Values are printed in the order requested.
+ */
+static void
+mget (char **av, struct snmp_session **ssp)
+{
+    struct snmp_pdu *pdu;
+    struct snmp_pdu *response = NULL;
+    struct variable_list *vars;
+    int status;
+    int i;
+
+    if (av[1] == NULL) {
+        err (false, "missing oid");
+        return;
+    }
+    if (*ssp == NULL) {
+        err (false, "start session first");
+        return;
+    }
+    pdu = snmp_pdu_create (SNMP_MSG_GET);
+    for (i = 1; av[i] != NULL; i++) {
+        oid anOID[MAX_OID_LEN];
+        size_t anOID_len = MAX_OID_LEN;
+
+        if (!get_node (av[i], anOID, &anOID_len)) {
+            snmp_free_pdu (pdu);
+            printf ("error parsing oid\n");
+            return;
+        }
+        snmp_add_null_var (pdu, anOID, anOID_len);
+    }
+    status = snmp_synch_response (*ssp, pdu, &response);
+    if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
+        for (vars = response->variables, i = 1;
+             vars != NULL && av[i] != NULL;
+             vars = vars->next_variable, i++)
+            print_var (NULL, av[i], vars);
+    } else {
+        /* errindex is 1-based, same as av */
+        if (status == STAT_SUCCESS)
+            err (false, "error in packet: %s: %s",
+                 snmp_errstring (response->errstat),
+                 response->errindex > 0 && response->errindex < i
+                 ? av[response->errindex] : "?");
+        else
+            snmp_sess_perror ("snmpget", *ssp);
+    }
+    if (response)
+        snmp_free_pdu (response);
+}
+
+/* Print a walked var labeled with the walk oid as given on the command
+ * line plus the sub-identifiers below it, e.g. "oid.table.5: 1".
+ */
+static void
+print_walk_var (const char *host,
+                const char *root,
+                size_t root_len,
+                struct variable_list *vars)
+{
+    char label[1024];
+    int len;
+    size_t i;
+
+    len = snprintf (label, sizeof (label), "%s", root);
+    for (i = root_len; i < vars->name_length; i++) {
+        if ((size_t)len >= sizeof (label))
+            break;
+        len += snprintf (label + len, sizeof (label) - len, ".%lu",
+                         (unsigned long)vars->name[i]);
+    }
+    print_var (host, label, vars);
+}
+
+/* Create the next request of a walk from name.
+ */
+static struct snmp_pdu *
+walk_pdu (struct snmp_session *ss, oid *name, size_t name_len)
+{
+    struct snmp_pdu *pdu;
+
+    if (ss->version == SNMP_VERSION_1)
+        pdu = snmp_pdu_create (SNMP_MSG_GETNEXT);
+    else {
+        pdu = snmp_pdu_create (SNMP_MSG_GETBULK);
+        pdu->non_repeaters = 0;
+        pdu->max_repetitions = WALK_MAX_REPETITIONS;
+    }
+    snmp_add_null_var (pdu, name, name_len);
+    return pdu;
+}
+
+/* Print the vars in a walk response that are under root (labeled with
+ * rootstr), and advance name past them.  Returns 1 if the walk is done.
+ */
+static int
+walk_response (const char *host,
+               const char *rootstr,
+               oid *root,
+               size_t root_len,
+               oid *name,
+               size_t *name_len,
+               struct snmp_pdu *response)
+{
+    struct variable_list *vars;
+
+    if (response->variables == NULL)
+        return 1;
+    for (vars = response->variables; vars; vars = vars->next_variable) {
+        if (vars->type == SNMP_ENDOFMIBVIEW
+            || vars->type == SNMP_NOSUCHOBJECT
+            || vars->type == SNMP_NOSUCHINSTANCE
+            || vars->name_length < root_len
+            || snmp_oid_compare (root, root_len,
+                                 vars->name, root_len) != 0)
+            return 1;
+        /* don't loop forever on an agent that doesn't increase */
+        if (snmp_oid_compare (vars->name, vars->name_length,
+                              name, *name_len) <= 0)
+            return 1;
+        print_walk_var (host, rootstr, root_len, vars);
+        memcpy (name, vars->name, vars->name_length * sizeof (oid));
+        *name_len = vars->name_length;
+    }
+    return 0;
+}
+
+/* Get all values in the subtree under oid, using GETBULK on v2c/v3 so
+ * a table of outlets can be read in one round trip, or GETNEXT on v1.
+ */
+static void
+walk (char **av, struct snmp_session **ssp)
+{
+    oid root[MAX_OID_LEN];
+    size_t root_len = MAX_OID_LEN;
+    oid name[MAX_OID_LEN];
+    size_t name_len;
+    int done = 0;
+
+    if (av[1] == NULL) {
+        err (false, "missing oid");
+        return;
+    }
+    if (*ssp == NULL) {
+        err (false, "start session first");
+        return;
+    }
+    if (!get_node (av[1], root, &root_len)) {
+        printf ("error parsing oid\n");
+        return;
+    }
+    memcpy (name, root, root_len * sizeof (oid));
+    name_len = root_len;
+
+    while (!done) {
+        struct snmp_pdu *pdu;
+        struct snmp_pdu *response = NULL;
+        int status;
+
+        pdu = walk_pdu (*ssp, name, name_len);
+        status = snmp_synch_response (*ssp, pdu, &response);
+        if (status != STAT_SUCCESS) {
+            snmp_sess_perror ("snmpwalk", *ssp);
+            break;
+        }
+        if (response->errstat != SNMP_ERR_NOERROR) {
+            /* v1 agents report the end of the mib as noSuchName */
+            if (response->errstat != SNMP_ERR_NOSUCHNAME)
+                err (false, "error in packet: %s",
+                     snmp_errstring (response->errstat));
+            snmp_free_pdu (response);
+            break;
+        }
+        done = walk_response (NULL, av[1], root, root_len,
+                              name, &name_len, response);
+        snmp_free_pdu (response);
+    }
+}
+
 static void
 set (char **av, struct snmp_session **ssp)
 {
@@ -118,20 +359,8 @@ set (char **av, struct snmp_session **ssp)
     snmp_add_var (pdu, anOID, anOID_len, *(av[2]), av[3]);
     status = snmp_synch_response (*ssp, pdu, &response);
     if (status == STAT_SUCCESS && response->errstat == SNMP_ERR_NOERROR) {
-        for (vars = response->variables; vars; vars = vars->next_variable) {
-            switch (vars->type) {
-                case ASN_OCTET_STR:
-                    printf("%s: %*s\n", av[1],
-                           (int)vars->val_len, vars->val.string);
-                    break;
-                case ASN_INTEGER:
-                    printf("%s: %ld\n", av[1], *vars->val.integer);
-                    break;
-                default:
-                    print_variable (vars->name, vars->name_length, vars);
-                    break;
-            }
-        }
+        for (vars = response->variables; vars; vars = vars->next_variable)
+            print_var (NULL, av[1], vars);
     } else {
         if (status == STAT_SUCCESS)
             err_exit (false, "error in packet: %s",
@@ -143,6 +372,296 @@ set (char **av, struct snmp_session **ssp)
         snmp_free_pdu (response);
 }
 
+static void
+hostsess_destroy (void *data)
+{
+    struct hostsess *hs = data;
+
+    if (hs) {
+        if (hs->ss)
+            snmp_close (hs->ss);
+        xfree (hs->host);
+        xfree (hs);
+    }
+}
+
+static int
+hostsess_match_all (void *data, void *arg)
+{
+    return 1;
+}
+
+static void
+host_error (struct hostsess *hs)
+{
+    int liberr, syserr;
+    char *errstr;
+
+    snmp_error (hs->ss, &liberr, &syserr, &errstr);
+    printf ("%s: Error: %s\n", hs->host, errstr);
+    free (errstr);
+}
+
+static int host_cb (int op,
+                    struct snmp_session *sp,
+                    int reqid,
+                    struct snmp_pdu *pdu,
+                    void *magic);
+
+/* Send pdu to hs without waiting for the response, which is handled
+ * by host_cb().
+ */
+static int
+host_send (struct hostsess *hs, struct snmp_pdu *pdu)
+{
+    if (!(hs->reqid = snmp_async_send (hs->ss, pdu, host_cb, hs))) {
+        host_error (hs);
+        snmp_free_pdu (pdu);
+        return -1;
+    }
+    return 0;
+}
+
+/* Print a response from hs.  Returns 0 if another request was sent to
+ * continue a walk, else 1.
+ */
+static int
+host_response (struct hostsess *hs, struct snmp_pdu *response)
+{
+    struct variable_list *vars;
+    int i;
+
+    if (response->errstat != SNMP_ERR_NOERROR) {
+        /* v1 agents report the end of the mib as noSuchName */
+        if (hostreq.type != HOSTREQ_WALK
+            || response->errstat != SNMP_ERR_NOSUCHNAME)
+            printf ("%s: Error: %s\n",
+                    hs->host,
+                    snmp_errstring (response->errstat));
+        return 1;
+    }
+    switch (hostreq.type) {
+        case HOSTREQ_GET:
+            for (vars = response->variables, i = 0;
+                 vars != NULL && hostreq.oids[i] != NULL;
+                 vars = vars->next_variable, i++)
+                print_var (hs->host, hostreq.oids[i], vars);
+            break;
+        case HOSTREQ_SET:
+            if (response->variables)
+                print_var (hs->host, hostreq.oids[0], response->variables);
+            break;
+        case HOSTREQ_WALK:
+            if (walk_response (hs->host, hostreq.oids[0],
+                               hostreq.root, hostreq.root_len,
+                               hs->name, &hs->name_len, response))
+                break;
+            if (host_send (hs, walk_pdu (hs->ss, hs->name, hs->name_len)) < 0)
+                break;
+            return 0;
+    }
+    return 1;
+}
+
+static int
+host_cb (int op,
+         struct snmp_session *sp,
+         int reqid,
+         struct snmp_pdu *pdu,
+         void *magic)
+{
+    struct hostsess *hs = magic;
+
+    /* Newer net-snmp also calls back on each retry (RESEND) and on
+     * connection events, which do not end the request.
+     */
+    if (reqid != hs->reqid)
+        return 1;
+    switch (op) {
+        case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
+            hs->reqid = 0;
+            if (host_response (hs, pdu) == 0)
+                return 1;
+            break;
+        case NETSNMP_CALLBACK_OP_TIMED_OUT:
+            printf ("%s: Error: timeout\n", hs->host);
+            break;
+        case NETSNMP_CALLBACK_OP_SEND_FAILED:
+        case NETSNMP_CALLBACK_OP_DISCONNECT:
+            printf ("%s: Error: request failed\n", hs->host);
+            break;
+        default:
+            return 1;
+    }
+    hs->reqid = 0;
+    hostreq.active--;
+    return 1;
+}
+
+/* Wait for all hosts to respond or time out.  Each session has its own
+ * timeout and retries, handled by snmp_timeout().
+ */
+static void
+host_wait (void)
+{
+    while (hostreq.active > 0) {
+        fd_set fdset;
+        struct timeval timeout;
+        int block = 1;
+        int fds = 0;
+
+        FD_ZERO (&fdset);
+        snmp_select_info (&fds, &fdset, &timeout, &block);
+        fds = select (fds, &fdset, NULL, NULL, block ? NULL : &timeout);
+        if (fds < 0) {
+            if (errno == EINTR)
+                continue;
+            err_exit (true, "select");
+        }
+        if (fds > 0)
+            snmp_read (&fdset);
+        else
+            snmp_timeout ();
+    }
+}
+
+/* hget, hset, hwalk - send the request to each host concurrently */
+static void
+hostcmd (int type, char **av)
+{
+    hostlist_t targets;
+    hostlist_iterator_t itr;
+    struct snmp_pdu *template = NULL;
+    char *host;
+    int i;
+
+    if (av[1] == NULL) {
+        err (false, "missing hosts");
+        return;
+    }
+    if (av[2] == NULL) {
+        err (false, "missing oid");
+        return;
+    }
+    if (type == HOSTREQ_SET && av[3] == NULL) {
+        err (false, "missing type");
+        return;
+    }
+    if (type == HOSTREQ_SET && av[4] == NULL) {
+        err (false, "missing value");
+        return;
+    }
+    if (hash_is_empty (hostsessions)) {
+        err (false, "start session first");
+        return;
+    }
+
+    memset (&hostreq, 0, sizeof (hostreq));
+    hostreq.type = type;
+    hostreq.oids = av + 2;
+    if (type == HOSTREQ_WALK) {
+        hostreq.root_len = MAX_OID_LEN;
+        if (!get_node (av[2], hostreq.root, &hostreq.root_len)) {
+            printf ("error parsing oid\n");
+            return;
+        }
+    }
+    else {
+        template = snmp_pdu_create (type == HOSTREQ_GET ? SNMP_MSG_GET
+                                                        : SNMP_MSG_SET);
+        for (i = 2; av[i] != NULL; i++) {
+            oid anOID[MAX_OID_LEN];
+            size_t anOID_len = MAX_OID_LEN;
+
+            if (!get_node (av[i], anOID, &anOID_len)) {
+                snmp_free_pdu (template);
+                printf ("error parsing oid\n");
+                return;
+            }
+            if (type == HOSTREQ_SET) {
+                snmp_add_var (template, anOID, anOID_len, *(av[3]), av[4]);
+                break;
+            }
+            snmp_add_null_var (template, anOID, anOID_len);
+        }
+    }
+
+    if (strcmp (av[1], "all") == 0)
+        targets = hostlist_copy (hosts);
+    else
+        targets = hostlist_create (av[1]);
+    if (!targets) {
+        err (false, "invalid hostlist %s", av[1]);
+        if (template)
+            snmp_free_pdu (template);
+        return;
+    }
+    if (!(itr = hostlist_iterator_create (targets)))
+        err_exit (true, "hostlist_iterator_create");
+    while ((host = hostlist_next (itr))) {
+        struct hostsess *hs = hash_find (hostsessions, host);
+        struct snmp_pdu *pdu;
+
+        if (!hs || !hs->ss) {
+            printf ("%s: Error: no session\n", host);
+            free (host);
+            continue;
+        }
+        if (type == HOSTREQ_WALK) {
+            memcpy (hs->name, hostreq.root, hostreq.root_len * sizeof (oid));
+            hs->name_len = hostreq.root_len;
+            pdu = walk_pdu (hs->ss, hs->name, hs->name_len);
+        }
+        else if (!(pdu = snmp_clone_pdu (template)))
+            err_exit (false, "snmp_clone_pdu failed");
+        if (host_send (hs, pdu) == 0)
+            hostreq.active++;
+        free (host);
+    }
+    hostlist_iterator_destroy (itr);
+    hostlist_destroy (targets);
+    if (template)
+        snmp_free_pdu (template);
+
+    host_wait ();
+}
+
+/* Open the session for hostname, if set, and one for each of the hosts,
+ * if set.  snmp_open() copies the session.
+ */
+static void
+open_sessions (struct snmp_session *session,
+               char *hostname,
+               struct snmp_session **ssp)
+{
+    if (session_timeout >= 0)
+        session->timeout = session_timeout;
+    if (hostname) {
+        session->peername = hostname;
+        if (!(*ssp = snmp_open (session)))
+            err (false, "snmp_open failed");
+    }
+    if (hosts) {
+        hostlist_iterator_t itr;
+        char *host;
+
+        if (!(itr = hostlist_iterator_create (hosts)))
+            err_exit (true, "hostlist_iterator_create");
+        while ((host = hostlist_next (itr))) {
+            struct hostsess *hs = (struct hostsess *)xmalloc (sizeof (*hs));
+
+            hs->host = xstrdup (host);
+            session->peername = hs->host;
+            if (!(hs->ss = snmp_open (session)))
+                err (false, "%s: snmp_open failed", host);
+            if (!hash_insert (hostsessions, hs->host, hs))
+                err_exit (true, "hash_insert");
+            free (host);
+        }
+        hostlist_iterator_destroy (itr);
+    }
+}
+
 static void
 start_v1v2c (char **av, int version, char *hostname, struct snmp_session **ssp)
 {
@@ -152,7 +671,7 @@ start_v1v2c (char **av, int version, char *hostname, struct snmp_session **ssp)
         err (false, "missing community");
         return;
     }
-    if (*ssp) {
+    if (*ssp || !hash_is_empty (hostsessions)) {
         err (false, "finish current session first");
         return;
     }
@@ -160,12 +679,9 @@ start_v1v2c (char **av, int version, char *hostname, struct snmp_session **ssp)
     session.version = version;
     session.community = (u_char *)xstrdup (av[1]);
     session.community_len = strlen (av[1]);
-    session.peername = hostname;
 
-    if (!(*ssp = snmp_open (&session))) {
-        err (false, "snmp_open failed");
-        xfree (session.community);
-    }
+    open_sessions (&session, hostname, ssp);
+    xfree (session.community);
 }
 
 static void
@@ -185,9 +701,12 @@ start_v3 (char **av, char *hostname, struct snmp_session **ssp)
         err (false, "passphrase must be at least 8 characters");
         return;
     }
+    if (*ssp || !hash_is_empty (hostsessions)) {
+        err (false, "finish current session first");
+        return;
+    }
     snmp_sess_init (&session);
     session.version = SNMP_VERSION_3;
-    session.peername = hostname;
     session.securityName = xstrdup (av[1]);
     session.securityNameLen = strlen (av[1]);
 
@@ -205,8 +724,8 @@ start_v3 (char **av, char *hostname, struct snmp_session **ssp)
         err (false, "Error generating Ku from auth pass phrase");
     }
 
-    if (!(*ssp = snmp_open (&session)))
-        err (false, "snmp_open failed");
+    open_sessions (&session, hostname, ssp);
+    xfree (session.securityName);
 }
 
 static void
@@ -228,8 +747,10 @@ mib (char **av, struct snmp_session **ssp)
 static void
 finish (char **av, struct snmp_session **ssp)
 {
-    snmp_close (*ssp);
+    if (*ssp)
+        snmp_close (*ssp);
     *ssp = NULL;
+    hash_delete_if (hostsessions, hostsess_match_all, NULL);
 }
 
 static void
@@ -242,7 +763,12 @@ help (void)
     printf ("  mib name\n");
     printf ("  finish\n");
     printf ("  get oid\n");
+    printf ("  mget oid [oid...]\n");
+    printf ("  walk oid\n");
     printf ("  set oid type value\n");
+    printf ("  hget <hosts|all> oid [oid...]\n");
+    printf ("  hset <hosts|all> oid type value\n");
+    printf ("  hwalk <hosts|all> oid\n");
 }
 
 static int
@@ -255,8 +781,18 @@ docmd (char **av, char *hostname, struct snmp_session **ssp)
             help ();
         else if (strcmp (av[0], "get") == 0)
             get (av, ssp);
+        else if (strcmp (av[0], "mget") == 0)
+            mget (av, ssp);
+        else if (strcmp (av[0], "walk") == 0)
+            walk (av, ssp);
         else if (strcmp (av[0], "set") == 0)
             set (av, ssp);
+        else if (strcmp (av[0], "hget") == 0)
+            hostcmd (HOSTREQ_GET, av);
+        else if (strcmp (av[0], "hset") == 0)
+            hostcmd (HOSTREQ_SET, av);
+        else if (strcmp (av[0], "hwalk") == 0)
+            hostcmd (HOSTREQ_WALK, av);
         else if (strcmp (av[0], "start_v1") == 0)
             start_v1v2c (av, SNMP_VERSION_1, hostname, ssp);
         else if (strcmp (av[0], "start_v2c") == 0)
@@ -276,7 +812,7 @@ docmd (char **av, char *hostname, struct snmp_session **ssp)
 static void
 shell (char *hostname)
 {
-    char buf[128];
+    char buf[1024];   /* room for mget of a few dozen oids */
     char **av;
     int rc = 0;
     struct snmp_session *ss = NULL;
@@ -296,7 +832,7 @@ shell (char *hostname)
 static void
 usage (void)
 {
-    fprintf (stderr, "Usage: snmppower -h hostname\n");
+    fprintf (stderr, "Usage: snmppower [-h hostname] [-H hosts] [-t timeout]\n");
     exit(1);
 }
 
@@ -315,6 +851,16 @@ main (int argc, char *argv[])
             case 'h':  /* --hostname */
                 hostname = optarg;
                 break;
+            case 'H':  /* --hosts */
+                if (!(hosts = hostlist_create (optarg)))
+                    err_exit (false, "invalid hostlist %s", optarg);
+                hostlist_uniq (hosts);
+                break;
+            case 't':  /* --timeout */
+                session_timeout = (long)(strtod (optarg, NULL) * 1E6);
+                if (session_timeout <= 0)
+                    err_exit (false, "invalid timeout %s", optarg);
+                break;
             default:
                 usage();
                 break;
@@ -322,11 +868,20 @@ main (int argc, char *argv[])
     }
     if (optind != argc)
         usage ();
-    if (hostname == NULL)
+    if (hostname == NULL && hosts == NULL)
         usage ();
 
+    if (!(hostsessions = hash_create (HOSTSESSIONS_HASH_SIZE,
+                                      (hash_key_f)hash_key_string,
+                                      (hash_cmp_f)strcmp,
+                                      hostsess_destroy)))
+        err_exit (true, "hash_create");
+
     shell(hostname);
 
+    hash_destroy (hostsessions);
+    if (hosts)
+        hostlist_destroy (hosts);
     exit(0);
 }
 
@@ -0,0 +1,567 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/* microbench - time the liblsd and libcommon primitives on powermand's
+ * hot paths at cluster scale.
+ *
+ * Host lists are built with three naming schemes:
+ *   sierra - one ranged node statement, "sierra[0,2-N]"
+ *   mcr    - one node statement per host, "mcr0", "mcr1", ..., in
+ *            random order
+ *   sparse - every other host, "n0", "n2", ..., in random order, which
+ *            leaves one range per host (worst case for hostlist_find)
+ * Device buffers are cbufs sized like powermand's (MIN_DEV_BUF/MAX_DEV_BUF),
+ * and the regexes are typical script expects.
+ *
+ * Each benchmark prints one line of key=value pairs.  Results are checked
+ * so a broken data structure change fails rather than looking fast.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <libgen.h>
+
+#include "hostlist.h"
+#include "hash.h"
+#include "cbuf.h"
+#include "xregex.h"
+#include "xmalloc.h"
+#include "error.h"
+
+#define MIN_DEV_BUF     1024        /* keep in sync with device_private.h */
+#define MAX_DEV_BUF     1024*64
+#define MAX_MATCH_POS   20
+#define RANGE_CHUNK     16384       /* MAX_RANGE in hostlist.c */
+
+typedef enum { NAME_SIERRA, NAME_MCR, NAME_SPARSE, NUM_NAMING } Naming;
+
+static const char *naming_names[NUM_NAMING] = { "sierra", "mcr", "sparse" };
+
+static void _usage(void);
+
+static char *prog;
+static char *filter = NULL;
+
+#define OPTIONS "n:l:b:f:s:"
+static const struct option longopts[] = {
+    {"hosts",       required_argument, 0, 'n'},
+    {"lookups",     required_argument, 0, 'l'},
+    {"bufsize",     required_argument, 0, 'b'},
+    {"filter",      required_argument, 0, 'f'},
+    {"seed",        required_argument, 0, 's'},
+    {0, 0, 0, 0},
+};
+
+static double _now(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+        err_exit(true, "clock_gettime");
+    return ts.tv_sec + ts.tv_nsec / 1E9;
+}
+
+/* Return true if the benchmark named [name] was selected with --filter.
+ */
+static bool _selected(const char *name)
+{
+    return !filter || strstr(name, filter) != NULL;
+}
+
+static void _report(const char *name, const char *naming, int n, int ops,
+                    double sec, double bytes)
+{
+    printf("bench=%s", name);
+    if (naming)
+        printf(" naming=%s", naming);
+    printf(" n=%d ops=%d seconds=%.6f ns_per_op=%.1f",
+           n, ops, sec, ops > 0 ? sec * 1E9 / ops : 0);
+    if (bytes > 0)
+        printf(" mb_per_sec=%.1f", sec > 0 ? bytes / (1024*1024) / sec : 0);
+    printf("\n");
+    fflush(stdout);
+}
+
+/* Fisher-Yates shuffle of an array of strings.
+ */
+static void _shuffle(char **v, int n)
+{
+    int i;
+
+    for (i = n - 1; i > 0; i--) {
+        int j = random() % (i + 1);
+        char *tmp = v[i];
+
+        v[i] = v[j];
+        v[j] = tmp;
+    }
+}
+
+/* Generate the host names for [naming] in config order.
+ */
+static char **_names_create(Naming naming, int n)
+{
+    char **names = (char **)xmalloc(n * sizeof(char *));
+    char buf[64];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        switch (naming) {
+        case NAME_SIERRA:
+            snprintf(buf, sizeof(buf), "sierra%d", i == 0 ? 0 : i + 1);
+            break;
+        case NAME_MCR:
+            snprintf(buf, sizeof(buf), "mcr%d", i);
+            break;
+        case NAME_SPARSE:
+        default:
+            snprintf(buf, sizeof(buf), "n%d", i * 2);
+            break;
+        }
+        names[i] = xstrdup(buf);
+    }
+    return names;
+}
+
+static void _names_destroy(char **names, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        xfree(names[i]);
+    xfree(names);
+}
+
+/* Build the host list as powermand's config parser would see it.
+ */
+static hostlist_t _hostlist_build(Naming naming, char **names, int n)
+{
+    hostlist_t hl;
+    char **order;
+    int i;
+
+    if (naming == NAME_SIERRA) {
+        char *buf = xmalloc(64 + (n / RANGE_CHUNK + 1) * 32);
+        int lo, len;
+
+        /* hostlist caps a single range at 16K hosts, so split it */
+        len = sprintf(buf, "sierra[0");
+        for (lo = 2; lo <= n; lo += RANGE_CHUNK) {
+            int hi = lo + RANGE_CHUNK - 1 < n ? lo + RANGE_CHUNK - 1 : n;
+
+            len += sprintf(buf + len, ",%d-%d", lo, hi);
+        }
+        sprintf(buf + len, "]");
+        if (!(hl = hostlist_create(buf)))
+            err_exit(true, "hostlist_create");
+        xfree(buf);
+        return hl;
+    }
+    order = (char **)xmalloc(n * sizeof(char *));
+    memcpy(order, names, n * sizeof(char *));
+    _shuffle(order, n);
+    if (!(hl = hostlist_create(NULL)))
+        err_exit(true, "hostlist_create");
+    for (i = 0; i < n; i++) {
+        if (!hostlist_push_host(hl, order[i]))
+            err_exit(true, "hostlist_push_host");
+    }
+    xfree(order);
+    return hl;
+}
+
+/* Wrapped hostlist_ranged_string() with buffer growth, as in device.c.
+ */
+static char *_xhostlist_ranged_string(hostlist_t hl)
+{
+    int size = 0;
+    char *str = NULL;
+
+    do {
+        str = (str == NULL) ? xmalloc(size += 1024)
+                            : xrealloc(str, size += 1024);
+    } while (hostlist_ranged_string(hl, size, str) == -1);
+    return str;
+}
+
+/* Return the ranged string a sorted list of [n] hosts should produce.
+ * Not a round trip through hostlist_create(), which rejects ranges
+ * over 16K hosts.
+ */
+static char *_expected_ranged_string(Naming naming, int n)
+{
+    char *buf = xmalloc(64 + n * 16);
+    int i, len;
+
+    if (n == 1) {
+        sprintf(buf, "%s0", naming == NAME_SPARSE ? "n" : naming_names[naming]);
+        return buf;
+    }
+    switch (naming) {
+    case NAME_SIERRA:
+        sprintf(buf, "sierra[0,2-%d]", n);
+        break;
+    case NAME_MCR:
+        sprintf(buf, "mcr[0-%d]", n - 1);
+        break;
+    case NAME_SPARSE:
+    default:
+        len = sprintf(buf, "n[0");
+        for (i = 1; i < n; i++)
+            len += sprintf(buf + len, ",%d", i * 2);
+        sprintf(buf + len, "]");
+        break;
+    }
+    return buf;
+}
+
+static void _bench_hostlist(Naming naming, int n, int lookups)
+{
+    const char *nm = naming_names[naming];
+    char **names = _names_create(naming, n);
+    hostlist_t hl;
+    double t;
+    char *str;
+    int i;
+
+    t = _now();
+    hl = _hostlist_build(naming, names, n);
+    t = _now() - t;
+    if (hostlist_count(hl) != n)
+        err_exit(false, "%s: hostlist has %d hosts, expected %d",
+                 nm, hostlist_count(hl), n);
+    if (_selected("hostlist_create"))
+        _report("hostlist_create", nm, n, n, t, 0);
+
+    t = _now();
+    hostlist_sort(hl);
+    t = _now() - t;
+    if (_selected("hostlist_sort"))
+        _report("hostlist_sort", nm, n, n, t, 0);
+
+    if (_selected("hostlist_ranged_string")) {
+        char *exp = _expected_ranged_string(naming, n);
+        size_t len = strlen(exp);
+        double elapsed = 0;
+        int reps = 0;
+
+        do {
+            t = _now();
+            str = _xhostlist_ranged_string(hl);
+            elapsed += _now() - t;
+            if (reps++ == 0 && strcmp(str, exp) != 0)
+                err_exit(false, "%s: unexpected ranged string", nm);
+            xfree(str);
+        } while (elapsed < 0.1);
+        _report("hostlist_ranged_string", nm, n, reps, elapsed,
+                (double)len * reps);
+        xfree(exp);
+    }
+
+    if (_selected("hostlist_find")) {
+        t = _now();
+        for (i = 0; i < lookups; i++) {
+            int j = random() % n;
+
+            if (hostlist_find(hl, names[j]) < 0)
+                err_exit(false, "%s: hostlist_find %s failed", nm, names[j]);
+        }
+        t = _now() - t;
+        _report("hostlist_find", nm, n, lookups, t, 0);
+    }
+
+    hostlist_destroy(hl);
+    _names_destroy(names, n);
+}
+
+/* Build a node -> data hash the way arglist_create() does.
+ */
+static void _bench_hash(Naming naming, int n, int lookups)
+{
+    const char *nm = naming_names[naming];
+    char **names = _names_create(naming, n);
+    hash_t h;
+    double t;
+    int i;
+
+    t = _now();
+    if (!(h = hash_create(n, (hash_key_f)hash_key_string,
+                          (hash_cmp_f)strcmp, NULL)))
+        err_exit(true, "hash_create");
+    for (i = 0; i < n; i++) {
+        if (!hash_insert(h, names[i], names[i]))
+            err_exit(true, "hash_insert");
+    }
+    t = _now() - t;
+    if (_selected("hash_insert"))
+        _report("hash_insert", nm, n, n, t, 0);
+
+    if (_selected("hash_find")) {
+        t = _now();
+        for (i = 0; i < lookups; i++) {
+            int j = random() % n;
+
+            if (hash_find(h, names[j]) != names[j])
+                err_exit(false, "%s: hash_find %s failed", nm, names[j]);
+        }
+        t = _now() - t;
+        _report("hash_find", nm, n, lookups, t, 0);
+    }
+
+    hash_destroy(h);
+    _names_destroy(names, n);
+}
+
+/* Fill [buf] with [len] bytes of plausible device output:
+ * "NNN  On\r\n" plug status lines ending in a prompt.
+ */
+static void _devout_fill(char *buf, int len)
+{
+    const char *prompt = "Enter Selection>";
+    int plen = strlen(prompt);
+    int i = 0, plug = 1;
+
+    while (i < len - plen) {
+        int n = snprintf(buf + i, len - plen - i, "%d  %s\r\n",
+                         plug, plug % 3 ? "On" : "Off");
+        if (n >= len - plen - i)
+            break;
+        i += n;
+        plug++;
+    }
+    while (i < len - plen)
+        buf[i++] = ' ';
+    memcpy(buf + i, prompt, plen);
+}
+
+static void _bench_cbuf(int bufsize)
+{
+    char *data = xmalloc(bufsize);
+    char *peek = xmalloc(bufsize + 1);
+    cbuf_t cb;
+    double t;
+    int reps, n, dropped;
+    int fds[2];
+
+    _devout_fill(data, bufsize);
+    if (!(cb = cbuf_create(MIN_DEV_BUF, MAX_DEV_BUF)))
+        err_exit(true, "cbuf_create");
+
+    /* device output arrives in pipe-sized chunks */
+    if (_selected("cbuf_write_from_fd")) {
+        size_t total = 0;
+
+        /* nonblocking like a device fd, as a read may wrap the ring */
+        if (pipe(fds) < 0 || fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0)
+            err_exit(true, "pipe");
+        reps = 0;
+        t = _now();
+        do {
+            int off = 0;
+
+            while (off < bufsize) {
+                int chunk = bufsize - off < 4096 ? bufsize - off : 4096;
+
+                if (write(fds[1], data + off, chunk) != chunk)
+                    err_exit(true, "write");
+                /* one call per poll event, as in _handle_read() */
+                while (chunk > 0) {
+                    n = cbuf_write_from_fd(cb, fds[0], -1, &dropped);
+                    if (n <= 0)
+                        err_exit(true, "cbuf_write_from_fd");
+                    total += n;
+                    off += n;
+                    chunk -= n;
+                }
+            }
+            if (cbuf_used(cb) != bufsize)
+                err_exit(false, "cbuf holds %d bytes, expected %d",
+                         cbuf_used(cb), bufsize);
+            /* consume it as a script would, keeping the grown buffer */
+            if (cbuf_drop(cb, bufsize) != bufsize)
+                err_exit(true, "cbuf_drop");
+            reps++;
+        } while (_now() - t < 0.1);
+        t = _now() - t;
+        _report("cbuf_write_from_fd", NULL, bufsize, reps, t, total);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    /* _getregex_buf() peeks the whole buffer each time data arrives */
+    if (_selected("cbuf_peek")) {
+        cbuf_flush(cb);
+        if (cbuf_write(cb, data, bufsize, &dropped) < 0)
+            err_exit(true, "cbuf_write");
+        /* make the data wrap around the end of the ring */
+        if (cbuf_drop(cb, bufsize / 2) < 0
+            || cbuf_write(cb, data, bufsize / 2, &dropped) < 0)
+            err_exit(true, "cbuf_drop/write");
+        reps = 0;
+        t = _now();
+        do {
+            n = cbuf_peek(cb, peek, cbuf_used(cb));
+            if (n != cbuf_used(cb))
+                err_exit(true, "cbuf_peek returned %d", n);
+            reps++;
+        } while (_now() - t < 0.1);
+        t = _now() - t;
+        _report("cbuf_peek", NULL, n, reps, t, (double)n * reps);
+    }
+
+    cbuf_destroy(cb);
+    xfree(peek);
+    xfree(data);
+}
+
+static void _bench_xregex(int bufsize)
+{
+    char *data = xmalloc(bufsize + 1);
+    xregex_t re;
+    xregex_match_t xm;
+    double t;
+    int reps;
+
+    _devout_fill(data, bufsize);
+
+    if (_selected("xregex_compile")) {
+        reps = 0;
+        t = _now();
+        do {
+            re = xregex_create();
+            xregex_compile(re, "([0-9]+)[ ]+(On|Off)", true);
+            xregex_destroy(re);
+            reps++;
+        } while (_now() - t < 0.1);
+        t = _now() - t;
+        _report("xregex_compile", NULL, 0, reps, t, 0);
+    }
+
+    re = xregex_create();
+    xm = xregex_match_create(MAX_MATCH_POS);
+
+    /* prompt at the end of a full buffer, as after a large status reply */
+    if (_selected("xregex_exec_match")) {
+        xregex_compile(re, "Enter Selection>", true);
+        reps = 0;
+        t = _now();
+        do {
+            xregex_match_recycle(xm);
+            if (!xregex_exec(re, data, xm))
+                err_exit(false, "xregex_exec: expected a match");
+            reps++;
+        } while (_now() - t < 0.1);
+        t = _now() - t;
+        if (xregex_match_strlen(xm) != bufsize)
+            err_exit(false, "xregex_exec: match length %d, expected %d",
+                     xregex_match_strlen(xm), bufsize);
+        _report("xregex_exec_match", NULL, bufsize, reps, t,
+                (double)bufsize * reps);
+        xregex_destroy(re);
+        re = xregex_create();
+    }
+
+    /* scanning a full buffer that does not yet contain the expect */
+    if (_selected("xregex_exec_nomatch")) {
+        xregex_compile(re, "Circuit Breaker:[^\n]*\r\n", true);
+        reps = 0;
+        t = _now();
+        do {
+            xregex_match_recycle(xm);
+            if (xregex_exec(re, data, xm))
+                err_exit(false, "xregex_exec: unexpected match");
+            reps++;
+        } while (_now() - t < 0.1);
+        t = _now() - t;
+        _report("xregex_exec_nomatch", NULL, bufsize, reps, t,
+                (double)bufsize * reps);
+    }
+
+    xregex_match_destroy(xm);
+    xregex_destroy(re);
+    xfree(data);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int hosts = 100000;
+    int lookups = 1000;
+    int bufsize = MAX_DEV_BUF;
+    unsigned int seed = 1;
+    Naming naming;
+
+    prog = basename(argv[0]);
+    err_init(prog);
+
+    while ((c = getopt_long(argc, argv, OPTIONS, longopts, NULL)) != EOF) {
+        switch (c) {
+        case 'n':
+            hosts = strtol(optarg, NULL, 10);
+            break;
+        case 'l':
+            lookups = strtol(optarg, NULL, 10);
+            break;
+        case 'b':
+            bufsize = strtol(optarg, NULL, 10);
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            _usage();
+        }
+    }
+    if (optind < argc)
+        _usage();
+    if (hosts < 1 || lookups < 0)
+        err_exit(false, "--hosts must be > 0 and --lookups >= 0");
+    if (bufsize < 64 || bufsize > MAX_DEV_BUF)
+        err_exit(false, "--bufsize must be between 64 and %d", MAX_DEV_BUF);
+    srandom(seed);
+
+    for (naming = 0; naming < NUM_NAMING; naming++)
+        _bench_hostlist(naming, hosts, lookups);
+    for (naming = 0; naming < NUM_NAMING; naming++)
+        _bench_hash(naming, hosts, lookups);
+    _bench_cbuf(bufsize);
+    _bench_xregex(bufsize);
+
+    exit(0);
+}
+
+static void _usage(void)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", prog);
+    fprintf(stderr, "  -n,--hosts N      hosts per list (default 100000)\n");
+    fprintf(stderr, "  -l,--lookups N    lookups per find benchmark (default 1000)\n");
+    fprintf(stderr, "  -b,--bufsize N    device buffer bytes (default %d)\n",
+            MAX_DEV_BUF);
+    fprintf(stderr, "  -f,--filter STR   run only benchmarks whose name contains STR\n");
+    fprintf(stderr, "  -s,--seed N       random seed (default 1)\n");
+    exit(1);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
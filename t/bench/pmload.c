@@ -0,0 +1,361 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/* pmload - drive powermand with concurrent clients and report throughput
+ * and latency.
+ *
+ * Each client connects over the real protocol, then issues commands chosen
+ * at random from a weighted mix against random targets named t0...tN-1,
+ * waiting for each reply before sending the next.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <libgen.h>
+
+#include "xmalloc.h"
+#include "xpoll.h"
+#include "error.h"
+#include "client_proto.h"
+#include "powerman.h"
+
+#define CLIENT_BUFSIZE  (64*1024)
+#define STALL_TIMEOUT   30          /* seconds without any reply */
+
+typedef enum { MIX_STATUS, MIX_ON, MIX_OFF, MIX_CYCLE, NUM_MIX } MixType;
+
+static const char *mix_names[NUM_MIX] = { "status", "on", "off", "cycle" };
+static const char *mix_cmds[NUM_MIX] = { CP_STATUS, CP_ON, CP_OFF, CP_CYCLE };
+
+typedef enum { CLI_PROMPT, CLI_RESPONSE } ClientState;
+
+typedef struct {
+    int fd;
+    ClientState state;
+    char buf[CLIENT_BUFSIZE + 1];
+    int len;
+    struct timespec sent;       /* time current command was sent */
+} Client;
+
+static void _usage(void);
+static int _connect(const char *host, const char *port);
+
+static char *prog;
+
+#define OPTIONS "h:k:c:n:m:s:"
+static const struct option longopts[] = {
+    {"server-host", required_argument, 0, 'h'},
+    {"clients",     required_argument, 0, 'k'},
+    {"commands",    required_argument, 0, 'c'},
+    {"nodes",       required_argument, 0, 'n'},
+    {"mix",         required_argument, 0, 'm'},
+    {"seed",        required_argument, 0, 's'},
+    {0, 0, 0, 0},
+};
+
+static double _msec_between(struct timespec *a, struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1E3 + (b->tv_nsec - a->tv_nsec) / 1E6;
+}
+
+static int _cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* Parse "status=40,on=20,off=20,cycle=20" into weights.
+ */
+static void _parse_mix(char *str, int *weight)
+{
+    char *tok, *val;
+    int i;
+
+    for (i = 0; i < NUM_MIX; i++)
+        weight[i] = 0;
+    for (tok = strtok(str, ","); tok; tok = strtok(NULL, ",")) {
+        if (!(val = strchr(tok, '=')))
+            err_exit(false, "mix: expected name=weight, got '%s'", tok);
+        *val++ = '\0';
+        for (i = 0; i < NUM_MIX; i++) {
+            if (!strcmp(tok, mix_names[i]))
+                break;
+        }
+        if (i == NUM_MIX)
+            err_exit(false, "mix: unknown command '%s'", tok);
+        weight[i] = strtol(val, NULL, 10);
+        if (weight[i] < 0)
+            err_exit(false, "mix: weight must be >= 0");
+    }
+}
+
+static MixType _pick(int *weight, int total)
+{
+    int r = random() % total;
+    int i;
+
+    for (i = 0; i < NUM_MIX - 1; i++) {
+        if (r < weight[i])
+            break;
+        r -= weight[i];
+    }
+    return i;
+}
+
+static void _send_command(Client *c, int *weight, int total, int nodes)
+{
+    char target[32];
+    char cmd[CP_LINEMAX];
+
+    snprintf(target, sizeof(target), "t%ld", random() % nodes);
+    snprintf(cmd, sizeof(cmd), mix_cmds[_pick(weight, total)], target);
+    strcat(cmd, CP_EOL);
+    if (clock_gettime(CLOCK_MONOTONIC, &c->sent) < 0)
+        err_exit(true, "clock_gettime");
+    if (write(c->fd, cmd, strlen(cmd)) != strlen(cmd))
+        err_exit(true, "write to server");
+    c->state = CLI_RESPONSE;
+}
+
+/* Consume complete lines or the prompt from the client buffer.
+ * Return 1 if a command completed, 2 if it completed with an error,
+ * 3 if the client is ready for a new command, or 0 if more input is needed.
+ */
+static int _parse(Client *c)
+{
+    char *eol;
+    int code;
+
+    if (c->state == CLI_PROMPT) {
+        int plen = strlen(CP_PROMPT);
+
+        if (c->len < plen)
+            return 0;
+        if (strncmp(c->buf, CP_PROMPT, plen) != 0) {
+            /* skip anything before the prompt, e.g. the version banner */
+            if (!(eol = strstr(c->buf, CP_EOL)))
+                return 0;
+            plen = eol - c->buf + strlen(CP_EOL);
+            memmove(c->buf, c->buf + plen, c->len - plen + 1);
+            c->len -= plen;
+            return _parse(c);
+        }
+        memmove(c->buf, c->buf + plen, c->len - plen + 1);
+        c->len -= plen;
+        return 3;
+    }
+    while ((eol = strstr(c->buf, CP_EOL))) {
+        int n = eol - c->buf + strlen(CP_EOL);
+
+        code = strtol(c->buf, NULL, 10);
+        memmove(c->buf, c->buf + n, c->len - n + 1);
+        c->len -= n;
+        if (code >= 100 && code < 300) {
+            c->state = CLI_PROMPT;
+            return code < 200 ? 1 : 2;
+        }
+    }
+    return 0;
+}
+
+static void _read(Client *c)
+{
+    int n = read(c->fd, c->buf + c->len, CLIENT_BUFSIZE - c->len);
+
+    if (n < 0)
+        err_exit(true, "read from server");
+    if (n == 0)
+        err_exit(false, "server closed connection");
+    c->len += n;
+    c->buf[c->len] = '\0';
+    if (c->len == CLIENT_BUFSIZE)
+        err_exit(false, "server reply is too long");
+}
+
+int main(int argc, char *argv[])
+{
+    char *host = "localhost";
+    char *port = DFLT_PORT;
+    char *mix = NULL;
+    int nclients = 1;
+    int ncommands = 1000;
+    int nodes = 16;
+    unsigned int seed = 1;
+    int weight[NUM_MIX] = { 40, 20, 20, 20 };
+    int total_weight;
+    Client *clients;
+    double *lat;
+    int issued = 0, done = 0, errors = 0;
+    struct timespec start, now;
+    struct timeval tv;
+    xpollfd_t pfd;
+    double secs;
+    char *p;
+    int c, i;
+
+    prog = basename(argv[0]);
+    err_init(prog);
+    while ((c = getopt_long(argc, argv, OPTIONS, longopts, NULL)) != -1) {
+        switch (c) {
+            case 'h':   /* --server-host host[:port] */
+                if ((p = strchr(optarg, ':'))) {
+                    *p++ = '\0';
+                    port = p;
+                }
+                host = optarg;
+                break;
+            case 'k':   /* --clients */
+                nclients = strtol(optarg, NULL, 10);
+                break;
+            case 'c':   /* --commands */
+                ncommands = strtol(optarg, NULL, 10);
+                break;
+            case 'n':   /* --nodes */
+                nodes = strtol(optarg, NULL, 10);
+                break;
+            case 'm':   /* --mix */
+                mix = optarg;
+                break;
+            case 's':   /* --seed */
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                _usage();
+        }
+    }
+    if (optind < argc || nclients < 1 || ncommands < 1 || nodes < 1)
+        _usage();
+    if (mix)
+        _parse_mix(mix, weight);
+    for (total_weight = 0, i = 0; i < NUM_MIX; i++)
+        total_weight += weight[i];
+    if (total_weight == 0)
+        err_exit(false, "mix: all weights are zero");
+    srandom(seed);
+
+    /* Connect clients one at a time and wait for each prompt, so the
+     * server's short listen backlog doesn't delay anyone.
+     */
+    clients = (Client *)xmalloc(sizeof(Client) * nclients);
+    for (i = 0; i < nclients; i++) {
+        clients[i].fd = _connect(host, port);
+        clients[i].state = CLI_PROMPT;
+        while (_parse(&clients[i]) != 3)
+            _read(&clients[i]);
+    }
+
+    lat = (double *)xmalloc(sizeof(double) * ncommands);
+    pfd = xpollfd_create();
+    if (clock_gettime(CLOCK_MONOTONIC, &start) < 0)
+        err_exit(true, "clock_gettime");
+    for (i = 0; i < nclients && issued < ncommands; i++, issued++)
+        _send_command(&clients[i], weight, total_weight, nodes);
+    while (done < ncommands) {
+        xpollfd_zero(pfd);
+        for (i = 0; i < nclients; i++)
+            xpollfd_set(pfd, clients[i].fd, XPOLLIN);
+        tv.tv_sec = STALL_TIMEOUT;
+        tv.tv_usec = 0;
+        if (xpoll(pfd, &tv) == 0)
+            err_exit(false, "no reply in %ds", STALL_TIMEOUT);
+        for (i = 0; i < nclients; i++) {
+            Client *cli = &clients[i];
+            int rc;
+
+            if (!(xpollfd_revents(pfd, cli->fd) & (XPOLLIN | XPOLLHUP)))
+                continue;
+            _read(cli);
+            while ((rc = _parse(cli)) != 0) {
+                if (rc == 1 || rc == 2) {
+                    if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+                        err_exit(true, "clock_gettime");
+                    lat[done++] = _msec_between(&cli->sent, &now);
+                    if (rc == 2)
+                        errors++;
+                } else if (issued < ncommands) {
+                    _send_command(cli, weight, total_weight, nodes);
+                    issued++;
+                }
+            }
+        }
+    }
+    if (clock_gettime(CLOCK_MONOTONIC, &now) < 0)
+        err_exit(true, "clock_gettime");
+    secs = _msec_between(&start, &now) / 1E3;
+
+    qsort(lat, done, sizeof(double), _cmp_double);
+    printf("clients=%d commands=%d errors=%d seconds=%.3f rate=%.1f"
+           " p50_ms=%.3f p99_ms=%.3f max_ms=%.3f\n",
+           nclients, done, errors, secs, secs > 0 ? done / secs : 0,
+           lat[(done - 1) / 2], lat[(int)((done - 1) * 0.99)], lat[done - 1]);
+
+    for (i = 0; i < nclients; i++)
+        (void)close(clients[i].fd);
+    xpollfd_destroy(pfd);
+    xfree(lat);
+    xfree(clients);
+    exit(errors > 0 ? 1 : 0);
+}
+
+static int _connect(const char *host, const char *port)
+{
+    struct addrinfo hints, *res, *r;
+    int error, fd = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = PF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if ((error = getaddrinfo(host, port, &hints, &res)) != 0)
+        err_exit(false, "getaddrinfo %s:%s: %s", host, port,
+                 gai_strerror(error));
+    for (r = res; r != NULL; r = r->ai_next) {
+        if ((fd = socket(r->ai_family, r->ai_socktype, 0)) < 0)
+            continue;
+        if (connect(fd, r->ai_addr, r->ai_addrlen) == 0)
+            break;
+        (void)close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd < 0)
+        err_exit(true, "could not connect to %s:%s", host, port);
+    return fd;
+}
+
+static void _usage(void)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", prog);
+    fprintf(stderr, "  -h,--server-host=HOST[:PORT]  powermand address\n");
+    fprintf(stderr, "  -k,--clients=K                concurrent clients (1)\n");
+    fprintf(stderr, "  -c,--commands=N               total commands (1000)\n");
+    fprintf(stderr, "  -n,--nodes=N                  targets are t0...tN-1 (16)\n");
+    fprintf(stderr, "  -m,--mix=status=W,on=W,...    command weights"
+                    " (status=40,on=20,off=20,cycle=20)\n");
+    fprintf(stderr, "  -s,--seed=N                   random seed (1)\n");
+    exit(1);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
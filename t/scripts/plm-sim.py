@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+
+#
+# plm-sim - a tiny Insteon PLM stand-in for testing plmpower.  It opens
+# a pty, links its slave side to the given path for plmpower --device,
+# and answers direct Insteon commands (on, off, status, ping) and PLM
+# all-link group commands for a set of simulated devices.
+#
+#   -g group:addr,...     PLM all-link group members
+#   -f addr               device that never answers (cleanup fails)
+#   -c addr:addr,...      controller and its responders.  On SIGUSR1 the
+#                         controller sends an all-link on broadcast, as
+#                         if switched locally, and its responders turn on.
+#
+# Like a real PLM, the responders' cleanup acks to a group command are
+# not passed to the host, only failures and the final cleanup status.
+#
+# Each request is logged to the log file as
+#   send <addr> <cmd1> <cmd2>    or    group <group> <cmd1>
+# and "ready" is written to it once the pty is linked.
+#
+import argparse
+import os
+import select
+import signal
+import tty
+
+STX = 0x02
+ACK = 0x06
+RECV_STD = 0x50
+ALL_LINK_FAIL = 0x56
+ALL_LINK_STAT = 0x58
+SEND_ALL_LINK = 0x61
+SEND = 0x62
+
+CMD_PING = 0x10
+CMD_ON = 0x11
+CMD_ON_FAST = 0x12
+CMD_OFF = 0x13
+CMD_OFF_FAST = 0x14
+CMD_STATUS = 0x19
+
+FLAGS_DIRECT_ACK = 0x2B
+FLAGS_ALL_LINK_BROADCAST = 0xCB
+
+PLM_ADDR = bytes([0x0A, 0x0B, 0x0C])
+
+
+def addr(s):
+    return bytes(int(x, 16) for x in s.split("."))
+
+
+def addrstr(a):
+    return ".".join("%.2X" % x for x in a)
+
+
+p = argparse.ArgumentParser()
+p.add_argument("-g", "--group", action="append", default=[])
+p.add_argument("-f", "--fail", action="append", default=[])
+p.add_argument("-c", "--controller")
+p.add_argument("ptylink")
+p.add_argument("logfile")
+args = p.parse_args()
+
+levels = {}
+groups = {}
+for g in args.group:
+    num, members = g.split(":")
+    groups[int(num)] = [addr(m) for m in members.split(",")]
+    for m in groups[int(num)]:
+        levels[m] = 0
+failed = {addr(a) for a in args.fail}
+controller = None
+responders = []
+if args.controller:
+    c, members = args.controller.split(":")
+    controller = addr(c)
+    responders = [addr(m) for m in members.split(",")]
+    for m in [controller] + responders:
+        levels[m] = 0
+
+
+def log(msg):
+    with open(args.logfile, "a") as f:
+        f.write(msg + "\n")
+
+
+master, slave = os.openpty()
+tty.setraw(slave)
+if os.path.lexists(args.ptylink):
+    os.unlink(args.ptylink)
+os.symlink(os.ttyname(slave), args.ptylink)
+
+
+def write(b):
+    os.write(master, bytes(b))
+
+
+def read(n):
+    b = b""
+    while len(b) < n:
+        b += os.read(master, n - len(b))
+    return b
+
+
+def set_level(a, cmd1, cmd2):
+    if cmd1 in (CMD_ON, CMD_ON_FAST):
+        levels[a] = cmd2 if cmd1 == CMD_ON else 0xFF
+    elif cmd1 in (CMD_OFF, CMD_OFF_FAST):
+        levels[a] = 0
+
+
+def broadcast(signum, frame):
+    set_level(controller, CMD_ON_FAST, 0)
+    for r in responders:
+        set_level(r, CMD_ON_FAST, 0)
+    write([STX, RECV_STD, *controller, 0, 0, 1,
+           FLAGS_ALL_LINK_BROADCAST, CMD_ON_FAST, 0])
+
+
+signal.signal(signal.SIGUSR1, broadcast)
+
+log("ready")
+while True:
+    select.select([master], [], [])
+    b = read(1)
+    if b[0] != STX:
+        continue
+    cmd = read(1)[0]
+    if cmd == SEND:
+        msg = read(6)
+        a, cmd1, cmd2 = msg[0:3], msg[4], msg[5]
+        log("send %s %.2X %.2X" % (addrstr(a), cmd1, cmd2))
+        write([STX, SEND, *msg, ACK])
+        if a not in levels or a in failed:
+            continue
+        set_level(a, cmd1, cmd2)
+        if cmd1 in (CMD_ON, CMD_ON_FAST, CMD_OFF, CMD_OFF_FAST, CMD_STATUS):
+            cmd2 = levels[a]
+        write([STX, RECV_STD, *a, *PLM_ADDR, FLAGS_DIRECT_ACK, cmd1, cmd2])
+    elif cmd == SEND_ALL_LINK:
+        msg = read(3)
+        group, cmd1 = msg[0], msg[1]
+        log("group %d %.2X" % (group, cmd1))
+        write([STX, SEND_ALL_LINK, *msg, ACK])
+        for m in groups.get(group, []):
+            if m in failed:
+                write([STX, ALL_LINK_FAIL, 0x01, group, *m])
+            else:
+                set_level(m, cmd1, 0)
+        write([STX, ALL_LINK_STAT, ACK])
@@ -0,0 +1,182 @@
+#!/bin/bash
+
+#
+# powermand-bench - measure powermand throughput, latency, CPU and memory
+# with N simulated devices of M plugs each and K concurrent clients.
+# Devices are coprocesses, or with -F, TCP devices served by one simfarm.
+# Prints one line of key=value pairs so results can be tracked over time.
+#
+declare -r prog=powermand-bench
+
+PATH=/usr/bin:/bin:$PATH
+
+die()
+{
+    echo "${prog}: $1" >&2
+    exit 1
+}
+
+usage()
+{
+    echo "Usage: ${prog} [OPTIONS] path/to/builddir" 2>&1
+    echo "where OPTIONS are:" 2>&1
+    echo "  -n devices       number of simulated devices (100)" 2>&1
+    echo "  -m plugs         plugs per device (vpc 16, baytech 8, icebox 10)" 2>&1
+    echo "  -t type          simulator: vpc, baytech, or icebox (vpc)" 2>&1
+    echo "  -k clients       concurrent clients (8)" 2>&1
+    echo "  -c commands      total client commands (2000)" 2>&1
+    echo "  -x mix           command weights (status=40,on=20,off=20,cycle=20)" 2>&1
+    echo "  -p port          powermand port (11999)" 2>&1
+    echo "  -F               serve devices from simfarm on ports port+1000..." 2>&1
+    echo "  -L spec          simfarm response latency, e.g. exp:5 (0)" 2>&1
+    echo "  -D mask          powermand debug mask, e.g. 0x9 (none)" 2>&1
+    exit 1
+}
+
+devices=100
+plugs=""
+type=vpc
+clients=8
+commands=2000
+mix="status=40,on=20,off=20,cycle=20"
+port=11999
+farm=0
+latency=0
+debug=""
+while getopts "n:m:t:k:c:x:p:FL:D:" opt; do
+    case ${opt} in
+        n) devices=${OPTARG} ;;
+        m) plugs=${OPTARG} ;;
+        t) type=${OPTARG} ;;
+        k) clients=${OPTARG} ;;
+        c) commands=${OPTARG} ;;
+        x) mix=${OPTARG} ;;
+        p) port=${OPTARG} ;;
+        F) farm=1 ;;
+        L) latency=${OPTARG} ;;
+        D) debug=${OPTARG} ;;
+        *) usage ;;
+    esac
+done
+shift $((${OPTIND} - 1))
+[ $# -eq 1 ] || usage
+builddir=$1
+srcdir=$(cd $(dirname $0)/../.. && pwd)
+
+powermand=${builddir}/src/powerman/powermand
+powerman=${builddir}/src/powerman/powerman
+pmload=${builddir}/t/bench/pmload
+simdir=${builddir}/t/simulators
+simfarm=${simdir}/simfarm
+farmport=$((${port} + 1000))
+for f in ${powermand} ${powerman} ${pmload} ${simfarm}; do
+    [ -x $f ] || die "$f is not executable"
+done
+
+# devfile spec simulator first-plug max-plugs
+case ${type} in
+    vpc)
+        sim=(${srcdir}/t/etc/vpc.dev vpc "${simdir}/vpcd" 0 16) ;;
+    baytech)
+        sim=(${srcdir}/etc/devices/baytech-rpc3-nc.dev baytech-rpc3-nc
+             "${simdir}/baytech -p rpc3-nc" 1 8) ;;
+    icebox)
+        sim=(${srcdir}/etc/devices/icebox3.dev icebox3
+             "${simdir}/icebox -p v3" 1 10) ;;
+    *)
+        usage ;;
+esac
+[ -n "${plugs}" ] || plugs=${sim[4]}
+[ ${devices} -gt 0 ] && [ ${plugs} -gt 0 ] && [ ${plugs} -le ${sim[4]} ] \
+    || die "need 1 or more devices and 1 to ${sim[4]} plugs for ${type}"
+nodes=$((${devices} * ${plugs}))
+
+# each device is a coprocess
+ulimit -n $(ulimit -H -n) 2>/dev/null
+[ $(ulimit -n) -ge $((${devices} * 2 + ${clients} + 100)) ] \
+    || die "open file limit $(ulimit -n) is too low for ${devices} devices"
+
+tmpdir=$(mktemp -d) || die "mktemp failed"
+pid=""
+farmpid=""
+cleanup()
+{
+    [ -n "${pid}" ] && kill -15 ${pid} 2>/dev/null && wait ${pid}
+    [ -n "${farmpid}" ] && kill -15 ${farmpid} 2>/dev/null && wait ${farmpid}
+    rm -rf ${tmpdir}
+}
+trap cleanup EXIT
+
+conf()
+{
+    local first=${sim[3]}
+
+    echo "include \"${sim[0]}\""
+    echo "listen \"localhost:${port}\""
+    for ((d = 0; d < ${devices}; d++)); do
+        if [ ${farm} -eq 1 ]; then
+            echo "device \"d${d}\" \"${sim[1]}\"" \
+                 "\"127.0.0.1:$((${farmport} + ${d}))\""
+        else
+            echo "device \"d${d}\" \"${sim[1]}\" \"${sim[2]} |&\""
+        fi
+        echo "node \"t[$((${d} * ${plugs}))-$(((${d} + 1) * ${plugs} - 1))]\"" \
+             "\"d${d}\" \"[${first}-$((${first} + ${plugs} - 1))]\""
+    done
+}
+
+# Print user+system CPU time of process $1 in milliseconds.
+cpu_msec()
+{
+    awk -v hz=$(getconf CLK_TCK) '{ print int(($14 + $15) * 1000 / hz) }' \
+        /proc/$1/stat
+}
+
+# Print field $2 (in kB) of /proc/$1/status.
+status_kb()
+{
+    awk -v key="$2:" '$1 == key { print $2 }' /proc/$1/status
+}
+
+# Print the number of allocations powermand has made so far.
+allocs()
+{
+    ${powerman} -h localhost:${port} --memory \
+        | sed -n -e 's/^total.* allocs=\([0-9]*\).*/\1/p'
+}
+
+conf >${tmpdir}/powerman.conf
+if [ ${farm} -eq 1 ]; then
+    ${simfarm} -d ${type} -p ${farmport} -n ${devices} -l ${latency} \
+        2>${tmpdir}/simfarm.log &
+    farmpid=$!
+fi
+${powermand} -Y -c ${tmpdir}/powerman.conf ${debug:+-d ${debug}} \
+    2>${tmpdir}/powermand.log &
+pid=$!
+
+# wait for the server, then for every device to log in
+${powerman} --retry-connect=100 -h localhost:${port} -l >/dev/null \
+    || die "powermand did not start: $(cat ${tmpdir}/powermand.log)"
+${powerman} -h localhost:${port} -q >/dev/null \
+    || die "some devices did not respond"
+
+allocs_before=$(allocs)
+cpu_before=$(cpu_msec ${pid})
+${pmload} -h localhost:${port} -k ${clients} -c ${commands} -n ${nodes} \
+    -m ${mix} >${tmpdir}/pmload.out
+rc=$?
+cpu_after=$(cpu_msec ${pid})
+allocs_after=$(allocs)
+[ -s ${tmpdir}/pmload.out ] || die "pmload failed"
+
+cpu=$((${cpu_after} - ${cpu_before}))
+echo "type=${type} farm=${farm} devices=${devices} plugs=${plugs}" \
+     "$(cat ${tmpdir}/pmload.out)" \
+     "cpu_sec=$(awk "BEGIN {printf \"%.3f\", ${cpu} / 1000}")" \
+     "cpu_us_per_cmd=$((${cpu} * 1000 / ${commands}))" \
+     "allocs_per_cmd=$(((${allocs_after} - ${allocs_before}) / ${commands}))" \
+     "rss_kb=$(status_kb ${pid} VmRSS)" \
+     "peak_rss_kb=$(status_kb ${pid} VmHWM)" \
+     "debug=${debug:-0}"
+exit ${rc}
@@ -0,0 +1,206 @@
+#!/bin/bash
+
+#
+# powermand-soak - run status storms against powermand for a long time and
+# fail if its RSS or live memory (as reported by powerman --memory) drifts.
+# A baseline is taken after the warmup rounds, once buffers have grown to
+# their working size; every later round must stay within the tolerances.
+# Prints one line of key=value pairs per round, then a pass/fail line.
+#
+declare -r prog=powermand-soak
+
+PATH=/usr/bin:/bin:$PATH
+
+die()
+{
+    echo "${prog}: $1" >&2
+    exit 1
+}
+
+usage()
+{
+    echo "Usage: ${prog} [OPTIONS] path/to/builddir" 2>&1
+    echo "where OPTIONS are:" 2>&1
+    echo "  -n devices       number of simulated vpc devices (10)" 2>&1
+    echo "  -k clients       concurrent clients (4)" 2>&1
+    echo "  -c commands      client commands per round (2000)" 2>&1
+    echo "  -x mix           command weights (status=1)" 2>&1
+    echo "  -T seconds       stop starting rounds after this long (3600)" 2>&1
+    echo "  -r rounds        stop after this many rounds (no limit)" 2>&1
+    echo "  -w rounds        warmup rounds before the baseline (2)" 2>&1
+    echo "  -R kB            allowed RSS growth (8192)" 2>&1
+    echo "  -B bytes         allowed growth of live bytes per subsystem (65536)" 2>&1
+    echo "  -O objects       allowed growth of live objects per subsystem (10)" 2>&1
+    echo "  -p port          powermand port (11998)" 2>&1
+    echo "  -F               serve devices from simfarm on ports port+1000..." 2>&1
+    echo "  -L spec          simfarm response latency, e.g. exp:5 (0)" 2>&1
+    exit 1
+}
+
+devices=10
+clients=4
+commands=2000
+mix="status=1"
+duration=3600
+rounds=0
+warmup=2
+rss_tol=8192
+bytes_tol=65536
+objs_tol=10
+port=11998
+farm=0
+latency=0
+while getopts "n:k:c:x:T:r:w:R:B:O:p:FL:" opt; do
+    case ${opt} in
+        n) devices=${OPTARG} ;;
+        k) clients=${OPTARG} ;;
+        c) commands=${OPTARG} ;;
+        x) mix=${OPTARG} ;;
+        T) duration=${OPTARG} ;;
+        r) rounds=${OPTARG} ;;
+        w) warmup=${OPTARG} ;;
+        R) rss_tol=${OPTARG} ;;
+        B) bytes_tol=${OPTARG} ;;
+        O) objs_tol=${OPTARG} ;;
+        p) port=${OPTARG} ;;
+        F) farm=1 ;;
+        L) latency=${OPTARG} ;;
+        *) usage ;;
+    esac
+done
+shift $((${OPTIND} - 1))
+[ $# -eq 1 ] || usage
+builddir=$1
+srcdir=$(cd $(dirname $0)/../.. && pwd)
+
+powermand=${builddir}/src/powerman/powermand
+powerman=${builddir}/src/powerman/powerman
+pmload=${builddir}/t/bench/pmload
+simdir=${builddir}/t/simulators
+simfarm=${simdir}/simfarm
+farmport=$((${port} + 1000))
+for f in ${powermand} ${powerman} ${pmload} ${simfarm}; do
+    [ -x $f ] || die "$f is not executable"
+done
+[ ${devices} -gt 0 ] || die "need 1 or more devices"
+[ ${warmup} -gt 0 ] || die "need 1 or more warmup rounds"
+plugs=16
+nodes=$((${devices} * ${plugs}))
+
+tmpdir=$(mktemp -d) || die "mktemp failed"
+pid=""
+farmpid=""
+cleanup()
+{
+    [ -n "${pid}" ] && kill -15 ${pid} 2>/dev/null && wait ${pid}
+    [ -n "${farmpid}" ] && kill -15 ${farmpid} 2>/dev/null && wait ${farmpid}
+    rm -rf ${tmpdir}
+}
+trap cleanup EXIT
+
+conf()
+{
+    echo "include \"${srcdir}/t/etc/vpc.dev\""
+    echo "listen \"localhost:${port}\""
+    for ((d = 0; d < ${devices}; d++)); do
+        if [ ${farm} -eq 1 ]; then
+            echo "device \"d${d}\" \"vpc\" \"127.0.0.1:$((${farmport} + ${d}))\""
+        else
+            echo "device \"d${d}\" \"vpc\" \"${simdir}/vpcd |&\""
+        fi
+        echo "node \"t[$((${d} * ${plugs}))-$(((${d} + 1) * ${plugs} - 1))]\"" \
+             "\"d${d}\" \"[0-15]\""
+    done
+}
+
+# Print field $2 (in kB) of /proc/$1/status.
+status_kb()
+{
+    awk -v key="$2:" '$1 == key { print $2 }' /proc/$1/status
+}
+
+# Write "subsystem bytes objects" lines for powermand's live memory to $1.
+memory()
+{
+    ${powerman} -h localhost:${port} --memory \
+        | sed -e 's/bytes=//' -e 's/objects=//' -e 's/allocs=//' >$1
+}
+
+# Compare live memory in $1 against the baseline, printing the first
+# subsystem that grew too much.  Fails if one did.
+check_memory()
+{
+    awk -v btol=${bytes_tol} -v otol=${objs_tol} '
+        NR == FNR { bytes[$1] = $2; objs[$1] = $3; next }
+        $1 != "total" && ($2 > bytes[$1] + btol || $3 > objs[$1] + otol) {
+            printf "%s grew from %d bytes/%d objects to %d/%d\n",
+                $1, bytes[$1], objs[$1], $2, $3
+            bad = 1
+            exit
+        }
+        END { exit bad }' ${tmpdir}/baseline $1
+}
+
+conf >${tmpdir}/powerman.conf
+if [ ${farm} -eq 1 ]; then
+    ${simfarm} -d vpc -p ${farmport} -n ${devices} -l ${latency} \
+        2>${tmpdir}/simfarm.log &
+    farmpid=$!
+fi
+${powermand} -Y -c ${tmpdir}/powerman.conf 2>${tmpdir}/powermand.log &
+pid=$!
+
+# wait for the server, then for every device to log in
+${powerman} --retry-connect=100 -h localhost:${port} -l >/dev/null \
+    || die "powermand did not start: $(cat ${tmpdir}/powermand.log)"
+${powerman} -h localhost:${port} -q >/dev/null \
+    || die "some devices did not respond"
+
+start=${SECONDS}
+round=0
+rss_base=""
+while [ ${rounds} -eq 0 ] || [ ${round} -lt ${rounds} ]; do
+    [ ${round} -ge ${warmup} ] && [ $((${SECONDS} - ${start})) -ge ${duration} ] \
+        && break
+    round=$((${round} + 1))
+    ${pmload} -h localhost:${port} -k ${clients} -c ${commands} -n ${nodes} \
+        -m ${mix} >${tmpdir}/pmload.out
+    [ -s ${tmpdir}/pmload.out ] || die "pmload failed in round ${round}"
+    kill -0 ${pid} 2>/dev/null || die "powermand exited in round ${round}"
+    errors=$(sed -e 's/.* errors=\([0-9]*\).*/\1/' ${tmpdir}/pmload.out)
+
+    # The server may not have reaped the load clients yet, so give any
+    # growth a few chances to settle before calling it a leak.
+    for try in 1 2 3; do
+        memory ${tmpdir}/memory
+        rss=$(status_kb ${pid} VmRSS)
+        if [ ${round} -le ${warmup} ]; then
+            cp ${tmpdir}/memory ${tmpdir}/baseline
+            rss_base=${rss}
+            result=""
+            break
+        fi
+        if [ ${rss} -gt $((${rss_base} + ${rss_tol})) ]; then
+            result="RSS grew from ${rss_base} kB to ${rss} kB"
+        elif ! result=$(check_memory ${tmpdir}/memory); then
+            :
+        else
+            result=""
+            break
+        fi
+        sleep 1
+    done
+    echo "round=${round}" \
+         "elapsed_sec=$((${SECONDS} - ${start}))" \
+         "errors=${errors}" \
+         "rss_kb=${rss}" \
+         "live_bytes=$(awk '$1 == "total" { print $2 }' ${tmpdir}/memory)" \
+         "live_objects=$(awk '$1 == "total" { print $3 }' ${tmpdir}/memory)"
+    if [ -n "${result}" ]; then
+        echo "result=fail round=${round} ${result}"
+        exit 1
+    fi
+done
+[ ${round} -gt ${warmup} ] || die "no rounds ran after the warmup"
+echo "result=pass rounds=${round}"
+exit 0
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+
+#
+# redfish-session - a tiny Redfish SessionService stand-in for testing
+# httppower session auth.  URLs are of the form /<host>/redfish/v1/...
+#
+#   POST   /<host>/redfish/v1/SessionService/Sessions  login (root:pw)
+#   DELETE /<host>/redfish/v1/SessionService/Sessions/<id>  logout
+#   GET    /<host>/redfish/v1/Systems/1  needs a valid X-Auth-Token
+#   GET    /expire  forget all sessions, so the next request gets a 401
+#
+# Each request is logged to the log file as
+#   METHOD path token=<X-Auth-Token or -> auth=<basic or ->
+# and "ready" is written to it once the server is listening.
+#
+import json
+import sys
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+SESSIONS = "/redfish/v1/SessionService/Sessions"
+
+lock = threading.Lock()
+tokens = {}  # token -> session path
+count = 0
+
+
+def log(msg):
+    with lock:
+        with open(logfile, "a") as f:
+            f.write(msg + "\n")
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, format, *args):
+        pass
+
+    def reply(self, code, body=b"", headers=None):
+        self.send_response(code)
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def request_body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        return self.rfile.read(length) if length else b""
+
+    def token(self):
+        return self.headers.get("X-Auth-Token")
+
+    def log_request_line(self):
+        auth = self.headers.get("Authorization", "")
+        log(
+            "%s %s token=%s auth=%s"
+            % (
+                self.command,
+                self.path,
+                self.token() or "-",
+                "basic" if auth.startswith("Basic") else "-",
+            )
+        )
+
+    def do_POST(self):
+        global count
+        self.log_request_line()
+        body = self.request_body()
+        if not self.path.endswith(SESSIONS):
+            self.reply(404)
+            return
+        try:
+            creds = json.loads(body)
+        except ValueError:
+            self.reply(400)
+            return
+        if creds.get("UserName") != "root" or creds.get("Password") != "pw":
+            self.reply(401)
+            return
+        with lock:
+            count += 1
+            token = "token%d" % count
+            location = "%s/%d" % (self.path, count)
+            tokens[token] = location
+        self.reply(201, b"{}", {"X-Auth-Token": token, "Location": location})
+
+    def do_DELETE(self):
+        self.log_request_line()
+        with lock:
+            ok = tokens.get(self.token()) == self.path
+            if ok:
+                del tokens[self.token()]
+        self.reply(204 if ok else 401)
+
+    def do_GET(self):
+        self.log_request_line()
+        if self.path == "/expire":
+            with lock:
+                tokens.clear()
+            self.reply(200)
+            return
+        with lock:
+            ok = self.token() in tokens
+        if not ok:
+            self.reply(401)
+        elif self.path.endswith("/redfish/v1/Systems/1"):
+            self.reply(200, b'{\n  "PowerState": "On"\n}\n')
+        else:
+            self.reply(404)
+
+
+if len(sys.argv) != 3:
+    sys.exit("Usage: redfish-session.py port logfile")
+logfile = sys.argv[2]
+server = ThreadingHTTPServer(("127.0.0.1", int(sys.argv[1])), Handler)
+log("ready")
+server.serve_forever()
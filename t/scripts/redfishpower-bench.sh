@@ -0,0 +1,84 @@
+#!/bin/bash
+
+#
+# redfishpower-bench - time redfishpower --test-mode with a large
+# synthetic plug hierarchy (Root -> Blades -> Nodes)
+#
+declare -r prog=redfishpower-bench
+
+PATH=/usr/bin:/bin:$PATH
+
+die()
+{
+    echo "${prog}: $1" >&2
+    exit 1
+}
+
+usage()
+{
+    echo "Usage: ${prog} [-n nodes] [-b nodes-per-blade] path/to/redfishpower" 2>&1
+    exit 1
+}
+
+nodes=10000
+perblade=100
+while getopts "n:b:" opt; do
+    case ${opt} in
+        n) nodes=${OPTARG} ;;
+        b) perblade=${OPTARG} ;;
+        *) usage ;;
+    esac
+done
+shift $((${OPTIND} - 1))
+[ $# -eq 1 ] || usage
+redfishpower=$1
+[ -x ${redfishpower} ] || die "${redfishpower} is not executable"
+[ ${nodes} -gt 0 ] && [ ${perblade} -gt 0 ] || usage
+
+blades=$(( (${nodes} + ${perblade} - 1) / ${perblade} ))
+
+# all plugs are on the one host, test mode does not care
+input()
+{
+    echo "setplugs Root 0"
+    echo "setplugs Blade[0-$((${blades} - 1))] 0 Root"
+    for ((b = 0; b < ${blades}; b++)); do
+        first=$((${b} * ${perblade}))
+        last=$((${first} + ${perblade} - 1))
+        [ ${last} -lt ${nodes} ] || last=$((${nodes} - 1))
+        echo "setplugs Node[${first}-${last}] 0 Blade${b}"
+    done
+    echo "setstatpath redfish/v1/Systems/{{plug}}"
+    echo "setonpath redfish/v1/Systems/{{plug}}/Actions/ComputerSystem.Reset"
+    echo "setoffpath redfish/v1/Systems/{{plug}}/Actions/ComputerSystem.Reset"
+    echo "stat"
+    echo "on Root"
+    echo "on Blade[0-$((${blades} - 1))]"
+    echo "on Node[0-$((${nodes} - 1))]"
+    echo "stat"
+    echo "off Node[0-$((${nodes} - 1))]"
+    echo "off Root"
+    echo "stat"
+    echo "quit"
+}
+
+tmp=$(mktemp) || die "mktemp failed"
+trap "rm -f ${tmp}" EXIT
+
+start=$(date +%s.%N)
+input | ${redfishpower} -h bench0 --test-mode >${tmp} || die "redfishpower failed"
+end=$(date +%s.%N)
+
+ok=$(grep -c ": ok$" ${tmp})
+on=$(grep -c ": on$" ${tmp})
+off=$(grep -c ": off$" ${tmp})
+plugs=$((1 + ${blades} + ${nodes}))
+
+echo "plugs=${plugs} ok=${ok} on=${on} off=${off}" \
+     "seconds=$(awk "BEGIN {printf \"%.3f\", ${end} - ${start}}")"
+
+# ok: on Root, Blades, Nodes, off Nodes, Root
+# on/off: every plug in each of the three stat
+[ ${ok} -eq $((1 + ${blades} + ${nodes} + ${nodes} + 1)) ] || exit 1
+[ $((${on} + ${off})) -eq $((3 * ${plugs})) ] || exit 1
+exit 0
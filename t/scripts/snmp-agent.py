@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+
+#
+# snmp-agent - a tiny SNMP v1/v2c agent for testing snmppower.  It
+# listens on count consecutive UDP ports starting at port, each one a
+# separate PDU with its own state, and answers GET, GETNEXT, GETBULK
+# (v2c only) and SET with community "private".
+#
+# Each PDU has the Eaton Revelation outlet state table
+# enterprises.534.6.6.6.1.2.2.1.3.<outlet> with outlets 0 to outlets-1,
+# where outlet n of PDU index starts on if n + index is even.  The table
+# is followed by another column, so walks must stop at the end of the
+# subtree.  The last object is enterprises.99999.1.5.0, a string
+# "pdu<index>", so a walk past it reaches the end of the MIB.
+#
+# Each request is logged to the log file as
+#   port=<port> version=<1|2c> pdu=<type> [max-repetitions=<n>] oid=<first>
+# and "ready" is written to it once all ports are open.  PDU indices
+# listed with --drop never answer.
+#
+import argparse
+import select
+import socket
+
+ASN_INTEGER = 0x02
+ASN_OCTET_STR = 0x04
+ASN_NULL = 0x05
+ASN_OBJECT_ID = 0x06
+ASN_SEQUENCE = 0x30
+NO_SUCH_OBJECT = 0x80
+END_OF_MIB_VIEW = 0x82
+
+GET = 0xA0
+GETNEXT = 0xA1
+RESPONSE = 0xA2
+SET = 0xA3
+GETBULK = 0xA5
+PDU_NAMES = {GET: "get", GETNEXT: "getnext", SET: "set", GETBULK: "getbulk"}
+
+NO_ERROR = 0
+NO_SUCH_NAME = 2
+BAD_VALUE = 3
+NOT_WRITABLE = 17
+
+OUTLET_STATE = (1, 3, 6, 1, 4, 1, 534, 6, 6, 6, 1, 2, 2, 1, 3)
+OUTLET_NEXT = (1, 3, 6, 1, 4, 1, 534, 6, 6, 6, 1, 2, 2, 1, 4)
+NAME = (1, 3, 6, 1, 4, 1, 99999, 1, 5, 0)
+
+
+def enc_len(n):
+    if n < 0x80:
+        return bytes([n])
+    b = n.to_bytes((n.bit_length() + 7) // 8, "big")
+    return bytes([0x80 | len(b)]) + b
+
+
+def enc(tag, content):
+    return bytes([tag]) + enc_len(len(content)) + content
+
+
+def enc_int(v, tag=ASN_INTEGER):
+    n = 1
+    while not -(1 << (8 * n - 1)) <= v < (1 << (8 * n - 1)):
+        n += 1
+    return enc(tag, v.to_bytes(n, "big", signed=True))
+
+
+def enc_oid(o):
+    out = bytearray([o[0] * 40 + o[1]])
+    for sub in o[2:]:
+        chunk = [sub & 0x7F]
+        sub >>= 7
+        while sub:
+            chunk.append(0x80 | (sub & 0x7F))
+            sub >>= 7
+        out += bytes(reversed(chunk))
+    return enc(ASN_OBJECT_ID, bytes(out))
+
+
+def dec(data, pos):
+    """Return (tag, content, next position)."""
+    tag = data[pos]
+    n = data[pos + 1]
+    pos += 2
+    if n & 0x80:
+        k = n & 0x7F
+        n = int.from_bytes(data[pos : pos + k], "big")
+        pos += k
+    return tag, data[pos : pos + n], pos + n
+
+
+def dec_seq(content):
+    items = []
+    pos = 0
+    while pos < len(content):
+        tag, value, pos = dec(content, pos)
+        items.append((tag, value))
+    return items
+
+
+def dec_int(value):
+    return int.from_bytes(value, "big", signed=True)
+
+
+def dec_oid(value):
+    o = [value[0] // 40, value[0] % 40]
+    sub = 0
+    for b in value[1:]:
+        sub = (sub << 7) | (b & 0x7F)
+        if not b & 0x80:
+            o.append(sub)
+            sub = 0
+    return tuple(o)
+
+
+class Pdu:
+    def __init__(self, index, outlets):
+        self.mib = {}
+        for n in range(outlets):
+            self.mib[OUTLET_STATE + (n,)] = (ASN_INTEGER, (n + index + 1) % 2)
+            self.mib[OUTLET_NEXT + (n,)] = (ASN_INTEGER, 0)
+        self.mib[NAME] = (ASN_OCTET_STR, b"pdu%d" % index)
+        self.order = sorted(self.mib)
+
+    def next(self, name):
+        for o in self.order:
+            if o > name:
+                return o
+        return None
+
+    def value(self, name):
+        tag, v = self.mib[name]
+        return enc_int(v) if tag == ASN_INTEGER else enc(tag, v)
+
+    def respond(self, version, command, names, values, a, b):
+        """Return (errstat, errindex, [(oid, encoded value)])."""
+        out = []
+        if command == GET:
+            for i, name in enumerate(names):
+                if name in self.mib:
+                    out.append((name, self.value(name)))
+                elif version == 0:
+                    return NO_SUCH_NAME, i + 1, []
+                else:
+                    out.append((name, enc(NO_SUCH_OBJECT, b"")))
+        elif command == GETNEXT:
+            for i, name in enumerate(names):
+                n = self.next(name)
+                if n:
+                    out.append((n, self.value(n)))
+                elif version == 0:
+                    return NO_SUCH_NAME, i + 1, []
+                else:
+                    out.append((name, enc(END_OF_MIB_VIEW, b"")))
+        elif command == GETBULK:
+            nonrep, maxrep = max(a, 0), max(b, 0)
+            for name in names[:nonrep]:
+                n = self.next(name)
+                out.append((n, self.value(n)) if n else
+                           (name, enc(END_OF_MIB_VIEW, b"")))
+            cur = list(names[nonrep:])
+            for _ in range(maxrep):
+                if not cur:
+                    break
+                for j, name in enumerate(cur):
+                    n = self.next(name) if name else None
+                    if n:
+                        out.append((n, self.value(n)))
+                        cur[j] = n
+                    else:
+                        out.append((name, enc(END_OF_MIB_VIEW, b"")))
+                        cur[j] = name
+                if all(self.next(c) is None for c in cur):
+                    break
+        elif command == SET:
+            for i, (name, value) in enumerate(zip(names, values)):
+                if name not in self.mib or name[: len(OUTLET_STATE)] != OUTLET_STATE:
+                    return (NO_SUCH_NAME if version == 0 else NOT_WRITABLE), i + 1, []
+                tag, v = value
+                if tag != ASN_INTEGER or dec_int(v) not in (0, 1):
+                    return BAD_VALUE, i + 1, []
+            for name, (tag, v) in zip(names, values):
+                self.mib[name] = (ASN_INTEGER, dec_int(v))
+                out.append((name, self.value(name)))
+        return NO_ERROR, 0, out
+
+
+def handle(pdu, port, data, log):
+    _, msg, _ = dec(data, 0)
+    (_, ver), (_, community), (command, body) = dec_seq(msg)
+    version = dec_int(ver)
+    if community != b"private" or command not in PDU_NAMES:
+        return None
+    if command == GETBULK and version == 0:
+        return None
+    (_, reqid), (_, a), (_, b), (_, vbl) = dec_seq(body)
+    names = []
+    values = []
+    for _, vb in dec_seq(vbl):
+        (_, o), value = dec_seq(vb)
+        names.append(dec_oid(o))
+        values.append(value)
+    a = dec_int(a)
+    b = dec_int(b)
+    line = "port=%d version=%s pdu=%s" % (
+        port,
+        "1" if version == 0 else "2c",
+        PDU_NAMES[command],
+    )
+    if command == GETBULK:
+        line += " max-repetitions=%d" % b
+    line += " oid=%s" % ".".join(str(x) for x in names[0]) if names else ""
+    log(line)
+    errstat, errindex, out = pdu.respond(version, command, names, values, a, b)
+    if errstat != NO_ERROR:
+        # echo the request varbinds on error
+        out = [(n, enc(t, v)) for n, (t, v) in zip(names, values)]
+    vbl = b"".join(enc(ASN_SEQUENCE, enc_oid(n) + v) for n, v in out)
+    body = (
+        enc_int(dec_int(reqid))
+        + enc_int(errstat)
+        + enc_int(errindex)
+        + enc(ASN_SEQUENCE, vbl)
+    )
+    return enc(
+        ASN_SEQUENCE,
+        enc_int(version) + enc(ASN_OCTET_STR, community) + enc(RESPONSE, body),
+    )
+
+
+def main():
+    p = argparse.ArgumentParser()
+    p.add_argument("-p", "--port", type=int, required=True)
+    p.add_argument("-n", "--count", type=int, default=1)
+    p.add_argument("-o", "--outlets", type=int, default=20)
+    p.add_argument("-d", "--drop", type=int, action="append", default=[])
+    p.add_argument("logfile")
+    args = p.parse_args()
+
+    def log(msg):
+        with open(args.logfile, "a") as f:
+            f.write(msg + "\n")
+
+    socks = {}
+    for i in range(args.count):
+        s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        s.bind(("127.0.0.1", args.port + i))
+        socks[s] = (i, args.port + i, Pdu(i, args.outlets))
+    log("ready")
+    while True:
+        ready, _, _ = select.select(list(socks), [], [])
+        for s in ready:
+            data, addr = s.recvfrom(65536)
+            index, port, pdu = socks[s]
+            if index in args.drop:
+                continue
+            try:
+                reply = handle(pdu, port, data, log)
+            except (ValueError, IndexError):
+                reply = None
+            if reply:
+                s.sendto(reply, addr)
+
+
+main()
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+
+#
+# tcp-serve - listen on one specific address for tcp connect tests.
+#
+#   tcp-serve.py host port logfile cmd [arg...]
+#       accept connections and run cmd on each, with the connection as
+#       its stdin and stdout (e.g. vpcd without -p)
+#   tcp-serve.py --blackhole host port logfile
+#       fill the listen backlog so that further connects to host:port
+#       are never answered
+#
+# Each accepted connection is logged to the log file as "accept", and
+# "ready" is written to it once the address is listening.
+#
+import argparse
+import os
+import signal
+import socket
+
+p = argparse.ArgumentParser()
+p.add_argument("--blackhole", action="store_true")
+p.add_argument("host")
+p.add_argument("port", type=int)
+p.add_argument("logfile")
+p.add_argument("cmd", nargs=argparse.REMAINDER)
+args = p.parse_args()
+
+
+def log(msg):
+    with open(args.logfile, "a") as f:
+        f.write(msg + "\n")
+
+
+family = socket.AF_INET6 if ":" in args.host else socket.AF_INET
+s = socket.socket(family, socket.SOCK_STREAM)
+s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+s.bind((args.host, args.port))
+
+if args.blackhole:
+    s.listen(0)
+    # never accepted, so it occupies the backlog
+    c = socket.create_connection((args.host, args.port))
+    log("ready")
+    signal.pause()
+
+signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+s.listen(16)
+log("ready")
+while True:
+    conn, peer = s.accept()
+    log("accept")
+    if os.fork() == 0:
+        os.dup2(conn.fileno(), 0)
+        os.dup2(conn.fileno(), 1)
+        os.execv(args.cmd[0], args.cmd)
+    conn.close()
@@ -0,0 +1,195 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/* fakehosts - LD_PRELOAD resolver for tests
+ *
+ * FAKE_HOSTS="name=addr,addr;name2=addr" makes getaddrinfo() and
+ * getaddrinfo_a() return the listed numeric addresses for name, in the
+ * order given, so tests can give a device several addresses without
+ * touching /etc/hosts.  Other names are passed to the real resolver.
+ * Fake lookups complete immediately.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+typedef int (*getaddrinfo_f)(const char *node,
+                             const char *service,
+                             const struct addrinfo *hints,
+                             struct addrinfo **res);
+typedef int (*getaddrinfo_a_f)(int mode,
+                               struct gaicb *list[],
+                               int nitems,
+                               struct sigevent *sevp);
+
+static getaddrinfo_f real_getaddrinfo(void)
+{
+    static getaddrinfo_f fn = NULL;
+
+    if (!fn)
+        fn = (getaddrinfo_f)dlsym(RTLD_NEXT, "getaddrinfo");
+    return fn;
+}
+
+/* Return the comma separated address list for node in FAKE_HOSTS
+ * (malloced), or NULL if node is not listed.
+ */
+static char *fake_addrs(const char *node)
+{
+    const char *env = getenv("FAKE_HOSTS");
+    size_t len;
+
+    if (!env || !node)
+        return NULL;
+    len = strlen(node);
+    while (*env) {
+        const char *end = strchr(env, ';');
+
+        if (!end)
+            end = env + strlen(env);
+        if (strncmp(env, node, len) == 0 && env[len] == '=')
+            return strndup(env + len + 1, end - env - len - 1);
+        env = *end ? end + 1 : end;
+    }
+    return NULL;
+}
+
+/* Resolve each listed address numerically and chain the results.
+ * Each node is allocated by the real getaddrinfo(), so the chain can
+ * be released with freeaddrinfo().
+ */
+static int fake_getaddrinfo(char *addrs,
+                            const char *service,
+                            const struct addrinfo *hints,
+                            struct addrinfo **res)
+{
+    struct addrinfo h = { 0 };
+    struct addrinfo *head = NULL;
+    struct addrinfo **tail = &head;
+    char *saveptr = NULL;
+    char *addr;
+    int error = 0;
+
+    if (hints)
+        h = *hints;
+    h.ai_flags |= AI_NUMERICHOST;
+    for (addr = strtok_r(addrs, ",", &saveptr); addr != NULL;
+         addr = strtok_r(NULL, ",", &saveptr)) {
+        struct addrinfo *ai;
+
+        if ((error = real_getaddrinfo()(addr, service, &h, &ai)) != 0)
+            break;
+        *tail = ai;
+        while (ai->ai_next)
+            ai = ai->ai_next;
+        tail = &ai->ai_next;
+    }
+    if (error != 0 && head) {
+        freeaddrinfo(head);
+        head = NULL;
+    }
+    if (error == 0 && !head)
+        error = EAI_NONAME;
+    *res = head;
+    return error;
+}
+
+int getaddrinfo(const char *node,
+                const char *service,
+                const struct addrinfo *hints,
+                struct addrinfo **res)
+{
+    char *addrs = fake_addrs(node);
+    int error;
+
+    if (!addrs)
+        return real_getaddrinfo()(node, service, hints, res);
+    error = fake_getaddrinfo(addrs, service, hints, res);
+    free(addrs);
+    return error;
+}
+
+static void *notify_thread(void *arg)
+{
+    struct sigevent *sev = arg;
+
+    sev->sigev_notify_function(sev->sigev_value);
+    free(sev);
+    return NULL;
+}
+
+/* Complete every request now, then notify as getaddrinfo_a() would.
+ */
+int getaddrinfo_a(int mode,
+                  struct gaicb *list[],
+                  int nitems,
+                  struct sigevent *sevp)
+{
+    static getaddrinfo_a_f real = NULL;
+    bool fake = false;
+    int i;
+
+    for (i = 0; i < nitems; i++) {
+        char *addrs;
+
+        if (list[i] && (addrs = fake_addrs(list[i]->ar_name))) {
+            fake = true;
+            free(addrs);
+        }
+    }
+    if (!fake) {
+        if (!real)
+            real = (getaddrinfo_a_f)dlsym(RTLD_NEXT, "getaddrinfo_a");
+        return real(mode, list, nitems, sevp);
+    }
+    for (i = 0; i < nitems; i++) {
+        if (list[i])
+            list[i]->__return = getaddrinfo(list[i]->ar_name,
+                                            list[i]->ar_service,
+                                            list[i]->ar_request,
+                                            &list[i]->ar_result);
+    }
+    if (mode == GAI_NOWAIT && sevp) {
+        if (sevp->sigev_notify == SIGEV_THREAD) {
+            struct sigevent *sev = malloc(sizeof(*sev));
+            pthread_t t;
+
+            if (!sev)
+                return EAI_MEMORY;
+            *sev = *sevp;
+            if (pthread_create(&t, NULL, notify_thread, sev) != 0) {
+                free(sev);
+                return EAI_SYSTEM;
+            }
+            pthread_detach(t);
+        }
+        else if (sevp->sigev_notify == SIGEV_SIGNAL)
+            raise(sevp->sigev_signo);
+    }
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
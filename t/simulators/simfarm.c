@@ -0,0 +1,755 @@
+/************************************************************\
+ * Copyright (C) 2024 The Regents of the University of California.
+ * (c.f. DISCLAIMER, COPYING)
+ *
+ * This file is part of PowerMan, a remote power management program.
+ * For details, see https://github.com/chaos/powerman.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+\************************************************************/
+
+/* simfarm - simulate many power controllers in one process
+ *
+ * Device i listens on TCP port BASE+i and speaks the vpc (vpcd), baytech
+ * (rpc3-nc) or icebox (v3) dialect.  Plug state survives reconnects.
+ * Faults can be injected per response: latency drawn from a distribution,
+ * dropped connections, hangs, and slow-drip output a byte at a time.
+ * A config file may override the faults for ranges of devices.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <libgen.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "xmalloc.h"
+#include "xpoll.h"
+#include "error.h"
+#include "hprintf.h"
+#include "cbuf.h"
+#include "hostlist.h"
+
+#define MAX_PLUGS       16
+#define MAX_LINE        128
+#define MIN_BUF         1024
+#define MAX_BUF         64*1024
+#define LISTEN_BACKLOG  5
+
+typedef enum { DIALECT_VPC, DIALECT_BAYTECH, DIALECT_ICEBOX } Dialect;
+
+typedef enum { LAT_FIXED, LAT_UNIFORM, LAT_EXP } LatencyType;
+
+typedef struct {
+    LatencyType type;
+    double a;                   /* fixed value, uniform min, or exp mean */
+    double b;                   /* uniform max */
+} Latency;                      /* milliseconds */
+
+typedef struct {
+    Latency latency;            /* delay before each response */
+    double drop;                /* probability of closing instead of reply */
+    double hang;                /* probability of never replying again */
+    double drip;                /* probability of replying a byte at a time */
+    double drip_ms;             /* delay between dripped bytes */
+} Faults;
+
+typedef struct {
+    int listen_fd;
+    int fd;                     /* current connection or -1 */
+    Faults faults;
+    int plug[MAX_PLUGS];
+    int beacon[MAX_PLUGS];
+    /* per-connection state */
+    bool logged_in;
+    int seq;
+    bool hung;
+    bool dripping;
+    bool closing;               /* close once output is sent */
+    struct timeval ready;       /* send no output before this time */
+    cbuf_t in;
+    cbuf_t out;
+} Sim;
+
+static void _usage(void);
+
+static char *prog;
+static Dialect dialect = DIALECT_VPC;
+static Sim *sims;
+static int nsims = 1;
+
+#define OPTIONS "d:p:n:a:l:D:H:S:I:f:s:"
+static const struct option longopts[] = {
+    {"dialect",     required_argument, 0, 'd'},
+    {"port",        required_argument, 0, 'p'},
+    {"count",       required_argument, 0, 'n'},
+    {"address",     required_argument, 0, 'a'},
+    {"latency",     required_argument, 0, 'l'},
+    {"drop",        required_argument, 0, 'D'},
+    {"hang",        required_argument, 0, 'H'},
+    {"drip",        required_argument, 0, 'S'},
+    {"drip-interval", required_argument, 0, 'I'},
+    {"config",      required_argument, 0, 'f'},
+    {"seed",        required_argument, 0, 's'},
+    {0, 0, 0, 0},
+};
+
+static double _uniform(void)
+{
+    return random() / ((double)RAND_MAX + 1);
+}
+
+static bool _chance(double p)
+{
+    return p > 0 && _uniform() < p;
+}
+
+static double _draw_latency(Latency *l)
+{
+    switch (l->type) {
+        case LAT_FIXED:
+            return l->a;
+        case LAT_UNIFORM:
+            return l->a + (l->b - l->a) * _uniform();
+        case LAT_EXP:
+            return -l->a * log(1 - _uniform());
+    }
+    return 0;
+}
+
+static double _parse_prob(const char *str)
+{
+    char *end;
+    double p = strtod(str, &end);
+
+    if (*end != '\0' || p < 0 || p > 1)
+        err_exit(false, "'%s' is not a probability between 0 and 1", str);
+    return p;
+}
+
+/* Parse latency spec: MS, fixed:MS, uniform:MIN:MAX, or exp:MEAN.
+ */
+static void _parse_latency(const char *str, Latency *l)
+{
+    if (sscanf(str, "uniform:%lf:%lf", &l->a, &l->b) == 2)
+        l->type = LAT_UNIFORM;
+    else if (sscanf(str, "exp:%lf", &l->a) == 1)
+        l->type = LAT_EXP;
+    else if (sscanf(str, "fixed:%lf", &l->a) == 1
+             || sscanf(str, "%lf", &l->a) == 1)
+        l->type = LAT_FIXED;
+    else
+        err_exit(false, "bad latency '%s'", str);
+    if (l->a < 0 || (l->type == LAT_UNIFORM && l->b < l->a))
+        err_exit(false, "bad latency '%s'", str);
+}
+
+/* Apply one name=value fault setting.
+ */
+static void _parse_fault(char *str, Faults *f)
+{
+    char *val = strchr(str, '=');
+
+    if (!val)
+        err_exit(false, "expected name=value, got '%s'", str);
+    *val++ = '\0';
+    if (!strcmp(str, "latency"))
+        _parse_latency(val, &f->latency);
+    else if (!strcmp(str, "drop"))
+        f->drop = _parse_prob(val);
+    else if (!strcmp(str, "hang"))
+        f->hang = _parse_prob(val);
+    else if (!strcmp(str, "drip"))
+        f->drip = _parse_prob(val);
+    else if (!strcmp(str, "drip-interval"))
+        f->drip_ms = strtod(val, NULL);
+    else
+        err_exit(false, "unknown fault '%s'", str);
+}
+
+/* Each line of the config file is a device index or range of indices
+ * followed by fault settings, e.g. "[0-99] latency=exp:20 drop=0.01".
+ */
+static void _read_config(const char *path)
+{
+    FILE *fp;
+    char line[1024];
+    int lineno = 0;
+
+    if (!(fp = fopen(path, "r")))
+        err_exit(true, "%s", path);
+    while (fgets(line, sizeof(line), fp)) {
+        char *tok, *p;
+        hostlist_t hl;
+        hostlist_iterator_t itr;
+        char *idx;
+
+        lineno++;
+        if ((p = strchr(line, '#')))
+            *p = '\0';
+        if (!(tok = strtok(line, " \t\n")))
+            continue;
+        if (!(hl = hostlist_create(tok)) || hostlist_count(hl) == 0)
+            err_exit(false, "%s:%d: bad device range", path, lineno);
+        while ((tok = strtok(NULL, " \t\n"))) {
+            if (!(itr = hostlist_iterator_create(hl)))
+                err_exit(false, "hostlist_iterator_create failed");
+            while ((idx = hostlist_next(itr))) {
+                int i = strtol(idx, NULL, 10);
+                char *dup = xstrdup(tok);
+
+                if (i < 0 || i >= nsims)
+                    err_exit(false, "%s:%d: no device %d", path, lineno, i);
+                _parse_fault(dup, &sims[i].faults);
+                xfree(dup);
+                free(idx);
+            }
+            hostlist_iterator_destroy(itr);
+        }
+        hostlist_destroy(hl);
+    }
+    fclose(fp);
+}
+
+static void _out(Sim *s, const char *fmt, ...)
+    __attribute__ ((format (printf, 2, 3)));
+static void _out(Sim *s, const char *fmt, ...)
+{
+    va_list ap;
+    char *str;
+    int dropped;
+
+    va_start(ap, fmt);
+    str = hvsprintf(fmt, ap);
+    va_end(ap);
+    if (cbuf_write(s->out, str, strlen(str), &dropped) < 0 || dropped > 0)
+        err(false, "output buffer overrun");
+    xfree(str);
+}
+
+/* Call fn on each plug named by 'arg' (a number, a range, or "*").
+ * 'origin' is the number of the first plug.  Return false if any plug
+ * is out of range.
+ */
+static bool _foreach_plug(Sim *s, const char *arg, int origin, int count,
+                          void (*fn)(Sim *s, int i, void *data), void *data)
+{
+    hostlist_t hl;
+    char *p;
+    bool ok = true;
+    int i;
+
+    if (!strcmp(arg, "*")) {
+        for (i = 0; i < count; i++)
+            fn(s, i, data);
+        return true;
+    }
+    if (!(hl = hostlist_create(arg)))
+        return false;
+    while ((p = hostlist_shift(hl))) {
+        i = strtol(p, NULL, 10) - origin;
+        if (i >= 0 && i < count)
+            fn(s, i, data);
+        else
+            ok = false;
+        free(p);
+    }
+    hostlist_destroy(hl);
+    return ok;
+}
+
+/* vpc */
+
+static void _vpc_set(Sim *s, int i, void *data)
+{
+    s->plug[i] = *(int *)data;
+    _out(s, "%d: OK\n", i);
+}
+
+static void _vpc_stat(Sim *s, int i, void *data)
+{
+    _out(s, "plug %d: %s\n", i, (*(int **)data)[i] ? "ON" : "OFF");
+}
+
+static void _vpc_temp(Sim *s, int i, void *data)
+{
+    _out(s, "plug %d: %d\n", i, 83 + i);
+}
+
+static void _vpc_connect(Sim *s)
+{
+    _out(s, "%d vpc> ", s->seq);
+}
+
+static void _vpc_command(Sim *s, char *cmd)
+{
+    char arg[MAX_LINE];
+    int *state;
+    int on;
+
+    if (strlen(cmd) == 0) {
+        _out(s, "%d vpc> ", ++s->seq);
+        return;
+    }
+    if (!strcmp(cmd, "logoff")) {
+        _out(s, "%d OK\n", s->seq);
+        s->closing = true;
+        return;
+    }
+    if (!strcmp(cmd, "login"))
+        s->logged_in = true;
+    else if (!s->logged_in) {
+        _out(s, "%d Please login\n%d vpc> ", s->seq, s->seq + 1);
+        s->seq++;
+        return;
+    } else if (sscanf(cmd, "stat %s", arg) == 1) {
+        state = s->plug;
+        if (!_foreach_plug(s, arg, 0, MAX_PLUGS, _vpc_stat, &state))
+            goto badval;
+    } else if (sscanf(cmd, "beacon %s", arg) == 1) {
+        state = s->beacon;
+        if (!_foreach_plug(s, arg, 0, MAX_PLUGS, _vpc_stat, &state))
+            goto badval;
+    } else if (sscanf(cmd, "temp %s", arg) == 1) {
+        if (!_foreach_plug(s, arg, 0, MAX_PLUGS, _vpc_temp, NULL))
+            goto badval;
+    } else if (sscanf(cmd, "on %s", arg) == 1) {
+        on = 1;
+        if (!_foreach_plug(s, arg, 0, MAX_PLUGS, _vpc_set, &on))
+            goto badval;
+    } else if (sscanf(cmd, "off %s", arg) == 1) {
+        on = 0;
+        if (!_foreach_plug(s, arg, 0, MAX_PLUGS, _vpc_set, &on))
+            goto badval;
+    } else if (sscanf(cmd, "flash %d", &on) == 1 && on >= 0 && on < MAX_PLUGS)
+        s->beacon[on] = 1;
+    else if (sscanf(cmd, "unflash %d", &on) == 1 && on >= 0 && on < MAX_PLUGS)
+        s->beacon[on] = 0;
+    else if (sscanf(cmd, "reset %s", arg) == 1)
+        ;
+    else {
+        _out(s, "%d UNKNOWN: %s\n%d vpc> ", s->seq, cmd, s->seq + 1);
+        s->seq++;
+        return;
+    }
+    _out(s, "%d OK\n%d vpc> ", s->seq, s->seq + 1);
+    s->seq++;
+    return;
+badval:
+    _out(s, "%d BADVAL: %s\n%d vpc> ", s->seq, arg, s->seq + 1);
+    s->seq++;
+}
+
+/* baytech rpc3-nc */
+
+#define BAYTECH_PLUGS   8
+#define BAYTECH_PROMPT  "RPC3-NC>"
+
+static void _baytech_connect(Sim *s)
+{
+    _out(s, "\r\n\r\nRPC3-NC Series\r\n(C) 2002 by BayTech\r\nF4.00\r\n"
+         "\r\n" BAYTECH_PROMPT);
+}
+
+static void _baytech_command(Sim *s, char *cmd)
+{
+    int i, on;
+
+    if (strlen(cmd) == 0)
+        ;
+    else if (!strcmp(cmd, "logoff") || !strcmp(cmd, "logout")
+                                    || !strcmp(cmd, "exit")) {
+        s->closing = true;
+        return;
+    } else if (!strcmp(cmd, "status")) {
+        _out(s, "\r\n\r\n Circuit Breaker:       Good\r\n\r\n");
+        for (i = 0; i < BAYTECH_PLUGS; i++)
+            _out(s, " %d)...Outlet  %d       : %s          \r\n",
+                 i + 1, i + 1, s->plug[i] ? "On " : "Off");
+        _out(s, "\r\nType \"Help\" for a list of commands\r\n\r\n");
+    } else if (sscanf(cmd, "on %d", &i) == 1
+               || (sscanf(cmd, "off %d", &i) == 1)) {
+        on = !strncmp(cmd, "on", 2);
+        if (i == 0) {
+            for (i = 0; i < BAYTECH_PLUGS; i++)
+                s->plug[i] = on;
+        } else if (i >= 1 && i <= BAYTECH_PLUGS)
+            s->plug[i - 1] = on;
+        else
+            _out(s, "Input error\r\n\r\n");
+    } else
+        _out(s, "Input error\r\n\r\n");
+    _out(s, BAYTECH_PROMPT);
+}
+
+/* icebox v3 */
+
+#define ICEBOX_PLUGS    10
+
+static void _icebox_connect(Sim *s)
+{
+    _out(s, "V3.0\r\n");
+}
+
+static void _icebox_command(Sim *s, char *cmd)
+{
+    int i, on;
+
+    if (!s->logged_in) {
+        if (!strcmp(cmd, "auth icebox")) {
+            s->logged_in = true;
+            _out(s, "OK\r\n");
+        } else
+            _out(s, "ERROR 4\r\n");
+        return;
+    }
+    if (!strcmp(cmd, "q")) {
+        s->closing = true;
+        return;
+    }
+    if (!strcmp(cmd, "ps *") || !strcmp(cmd, "ns *")) {
+        for (i = 0; i < ICEBOX_PLUGS; i++)
+            _out(s, "N%d:%d%s", i + 1, s->plug[i],
+                 i < ICEBOX_PLUGS - 1 ? " " : "\r\n");
+        return;
+    }
+    if (!strcmp(cmd, "ph *") || !strcmp(cmd, "pl *")) {
+        for (i = 0; i < ICEBOX_PLUGS; i++)
+            s->plug[i] = (cmd[1] == 'h');
+    } else if (sscanf(cmd, "ph %d", &i) == 1 || sscanf(cmd, "pl %d", &i) == 1) {
+        on = (cmd[1] == 'h');
+        if (i < 1 || i > ICEBOX_PLUGS)
+            goto err;
+        s->plug[i - 1] = on;
+    } else if (!strcmp(cmd, "rp *"))
+        ;
+    else if (sscanf(cmd, "rp %d", &i) == 1) {
+        if (i < 1 || i > ICEBOX_PLUGS)
+            goto err;
+    } else
+        goto err;
+    _out(s, "OK\r\n");
+    return;
+err:
+    _out(s, "ERROR 0\r\n");
+}
+
+static void _sim_disconnect(Sim *s)
+{
+    if (s->fd >= 0)
+        (void)close(s->fd);
+    s->fd = -1;
+    cbuf_flush(s->in);
+    cbuf_flush(s->out);
+}
+
+/* Delay the next output according to the device latency.
+ */
+static void _delay_output(Sim *s, double ms)
+{
+    struct timeval now, tv;
+
+    if (gettimeofday(&now, NULL) < 0)
+        err_exit(true, "gettimeofday");
+    tv.tv_sec = (long)(ms / 1000);
+    tv.tv_usec = (long)((ms - tv.tv_sec * 1000) * 1000);
+    timeradd(&now, &tv, &s->ready);
+}
+
+static void _sim_accept(Sim *s)
+{
+    int fd = accept(s->listen_fd, NULL, NULL);
+
+    if (fd < 0) {
+        err(true, "accept");
+        return;
+    }
+    /* a new connection replaces the old one, as a real device would
+     * after its peer went away without saying so */
+    _sim_disconnect(s);
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0)
+        err_exit(true, "fcntl");
+    s->fd = fd;
+    s->logged_in = false;
+    s->seq = 0;
+    s->hung = false;
+    s->dripping = false;
+    s->closing = false;
+    switch (dialect) {
+        case DIALECT_VPC:
+            _vpc_connect(s);
+            break;
+        case DIALECT_BAYTECH:
+            _baytech_connect(s);
+            break;
+        case DIALECT_ICEBOX:
+            _icebox_connect(s);
+            break;
+    }
+    _delay_output(s, _draw_latency(&s->faults.latency));
+}
+
+/* Handle one command if the previous response has been sent.
+ */
+static void _sim_process(Sim *s)
+{
+    char line[MAX_LINE];
+    int n;
+
+    if (s->fd < 0 || s->hung || s->closing || !cbuf_is_empty(s->out))
+        return;
+    if ((n = cbuf_read_line(s->in, line, sizeof(line), 1)) <= 0)
+        return;
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+        line[--n] = '\0';
+
+    if (_chance(s->faults.drop)) {
+        _sim_disconnect(s);
+        return;
+    }
+    if (_chance(s->faults.hang)) {
+        s->hung = true;
+        return;
+    }
+    switch (dialect) {
+        case DIALECT_VPC:
+            _vpc_command(s, line);
+            break;
+        case DIALECT_BAYTECH:
+            _baytech_command(s, line);
+            break;
+        case DIALECT_ICEBOX:
+            _icebox_command(s, line);
+            break;
+    }
+    if (s->closing && cbuf_is_empty(s->out)) {
+        _sim_disconnect(s);
+        return;
+    }
+    s->dripping = _chance(s->faults.drip);
+    _delay_output(s, _draw_latency(&s->faults.latency));
+}
+
+static void _sim_read(Sim *s)
+{
+    int n, dropped;
+
+    n = cbuf_write_from_fd(s->in, s->fd, -1, &dropped);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+    if (n <= 0) {
+        _sim_disconnect(s);
+        return;
+    }
+    if (s->hung)
+        cbuf_flush(s->in);
+}
+
+static void _sim_write(Sim *s)
+{
+    int n = cbuf_read_to_fd(s->out, s->fd, s->dripping ? 1 : -1);
+
+    if (n < 0 && errno != EAGAIN && errno != EINTR) {
+        _sim_disconnect(s);
+        return;
+    }
+    if (s->dripping && !cbuf_is_empty(s->out))
+        _delay_output(s, s->faults.drip_ms);
+    if (cbuf_is_empty(s->out) && s->closing)
+        _sim_disconnect(s);
+}
+
+static int _listen(const char *addr, int port)
+{
+    struct sockaddr_in sin;
+    int fd, opt = 1;
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr, &sin.sin_addr) != 1)
+        err_exit(false, "bad address '%s'", addr);
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        err_exit(true, "socket");
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+        err_exit(true, "setsockopt");
+    if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+        err_exit(true, "bind %s:%d", addr, port);
+    if (listen(fd, LISTEN_BACKLOG) < 0)
+        err_exit(true, "listen");
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0)
+        err_exit(true, "fcntl");
+    return fd;
+}
+
+static void _loop(void)
+{
+    xpollfd_t pfd = xpollfd_create();
+    struct timeval now, tmout, tv;
+    int i;
+
+    for (;;) {
+        bool have_tmout = false;
+
+        if (gettimeofday(&now, NULL) < 0)
+            err_exit(true, "gettimeofday");
+        xpollfd_zero(pfd);
+        for (i = 0; i < nsims; i++) {
+            Sim *s = &sims[i];
+
+            xpollfd_set(pfd, s->listen_fd, XPOLLIN);
+            if (s->fd < 0)
+                continue;
+            if (cbuf_is_empty(s->out) || timercmp(&s->ready, &now, <=))
+                xpollfd_set(pfd, s->fd, XPOLLIN
+                            | (cbuf_is_empty(s->out) ? 0 : XPOLLOUT));
+            else {
+                xpollfd_set(pfd, s->fd, XPOLLIN);
+                timersub(&s->ready, &now, &tv);
+                if (!have_tmout || timercmp(&tv, &tmout, <)) {
+                    tmout = tv;
+                    have_tmout = true;
+                }
+            }
+        }
+        if (xpoll(pfd, have_tmout ? &tmout : NULL) < 0)
+            err_exit(true, "poll");
+        for (i = 0; i < nsims; i++) {
+            Sim *s = &sims[i];
+            short flags;
+
+            if (xpollfd_revents(pfd, s->listen_fd) & XPOLLIN)
+                _sim_accept(s);
+            if (s->fd < 0)
+                continue;
+            flags = xpollfd_revents(pfd, s->fd);
+            if (flags & (XPOLLIN | XPOLLHUP | XPOLLERR))
+                _sim_read(s);
+            if (s->fd >= 0 && (flags & XPOLLOUT))
+                _sim_write(s);
+            _sim_process(s);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    char *addr = "127.0.0.1";
+    char *config = NULL;
+    int port = -1;
+    unsigned int seed = 1;
+    Faults faults;
+    int c, i;
+
+    prog = basename(argv[0]);
+    err_init(prog);
+    memset(&faults, 0, sizeof(faults));
+    faults.drip_ms = 1;
+    while ((c = getopt_long(argc, argv, OPTIONS, longopts, NULL)) != -1) {
+        switch (c) {
+            case 'd':   /* --dialect */
+                if (!strcmp(optarg, "vpc"))
+                    dialect = DIALECT_VPC;
+                else if (!strcmp(optarg, "baytech"))
+                    dialect = DIALECT_BAYTECH;
+                else if (!strcmp(optarg, "icebox"))
+                    dialect = DIALECT_ICEBOX;
+                else
+                    _usage();
+                break;
+            case 'p':   /* --port */
+                port = strtol(optarg, NULL, 10);
+                break;
+            case 'n':   /* --count */
+                nsims = strtol(optarg, NULL, 10);
+                break;
+            case 'a':   /* --address */
+                addr = optarg;
+                break;
+            case 'l':   /* --latency */
+                _parse_latency(optarg, &faults.latency);
+                break;
+            case 'D':   /* --drop */
+                faults.drop = _parse_prob(optarg);
+                break;
+            case 'H':   /* --hang */
+                faults.hang = _parse_prob(optarg);
+                break;
+            case 'S':   /* --drip */
+                faults.drip = _parse_prob(optarg);
+                break;
+            case 'I':   /* --drip-interval */
+                faults.drip_ms = strtod(optarg, NULL);
+                break;
+            case 'f':   /* --config */
+                config = optarg;
+                break;
+            case 's':   /* --seed */
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                _usage();
+        }
+    }
+    if (optind < argc || port <= 0 || nsims < 1 || port + nsims > 65536)
+        _usage();
+    srandom(seed);
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+        err_exit(true, "signal");
+
+    sims = (Sim *)xmalloc(sizeof(Sim) * nsims);
+    for (i = 0; i < nsims; i++) {
+        sims[i].fd = -1;
+        sims[i].faults = faults;
+        if (!(sims[i].in = cbuf_create(MIN_BUF, MAX_BUF))
+            || !(sims[i].out = cbuf_create(MIN_BUF, MAX_BUF)))
+            err_exit(false, "cbuf_create failed");
+    }
+    if (config)
+        _read_config(config);
+    for (i = 0; i < nsims; i++)
+        sims[i].listen_fd = _listen(addr, port + i);
+
+    _loop();
+    /*NOTREACHED*/
+    exit(0);
+}
+
+static void _usage(void)
+{
+    fprintf(stderr,
+"Usage: %s -p PORT [OPTIONS]\n"
+"  -d,--dialect=vpc|baytech|icebox  device protocol (vpc)\n"
+"  -p,--port=PORT                   device i listens on PORT+i\n"
+"  -n,--count=N                     number of devices (1)\n"
+"  -a,--address=ADDR                IPv4 address to listen on (127.0.0.1)\n"
+"  -l,--latency=SPEC                response delay in ms: MS, fixed:MS,\n"
+"                                   uniform:MIN:MAX, or exp:MEAN (0)\n"
+"  -D,--drop=P                      chance of closing instead of replying\n"
+"  -H,--hang=P                      chance of never replying again\n"
+"  -S,--drip=P                      chance of replying a byte at a time\n"
+"  -I,--drip-interval=MS            delay between dripped bytes (1)\n"
+"  -f,--config=FILE                 per-device faults, one range per line,\n"
+"                                   e.g. \"[0-9] latency=exp:20 drop=0.01\"\n"
+"  -s,--seed=N                      random seed (1)\n", prog);
+    exit(1);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
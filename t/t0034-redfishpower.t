@@ -677,6 +677,97 @@ test_expect_success 'stop powerman daemon (parents3Lbad)' '
 	wait
 '
 
+#
+# redfishpower event stream coverage
+#
+# - in test mode a power state change event is simulated for each on/off
+#
+
+test_expect_success 'create powerman.conf for 16 cray redfish nodes (events)' '
+	cat >powerman_events.conf <<-EOT
+	listen "$testaddr"
+	include "$testdevicesdir/redfishpower-events.dev"
+	device "d0" "redfishpower-events" "$redfishdir/redfishpower -h t[0-15] --test-mode -vv |&"
+	node "t[0-15]" "d0" "Node[0-15]"
+	EOT
+'
+test_expect_success 'start powerman daemon and wait for it to start (events)' '
+	$powermand -Y -c powerman_events.conf &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'powerman -T -1 opens event stream' '
+	$powerman -h $testaddr -T -1 t0 >test_events_on_T.out &&
+	grep "event stream hostname=t0 path=redfish/v1/EventService/SSE" test_events_on_T.out
+'
+test_expect_success 'powerman -T -1 completes via event' '
+	grep "event hostname=t0 plugname=Node0 poll now" test_events_on_T.out &&
+	grep "Node0: ok" test_events_on_T.out
+'
+test_expect_success 'powerman -T -0 t[0-15] completes via events' '
+	$powerman -h $testaddr -T -0 t[0-15] >test_events_off_T.out &&
+	test $(grep -o "event hostname=t[0-9]* plugname=Node[0-9]* poll now" test_events_off_T.out | wc -l) -eq 16 &&
+	test $(grep -o "Node[0-9]*: ok" test_events_off_T.out | wc -l) -eq 16
+'
+test_expect_success 'stop powerman daemon (events)' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_expect_success 'events on one host only wake the matching plug' '
+	cat >events_host.in <<-EOT &&
+	setplugs Node[0-10] 0
+	setstatpath redfish/v1/Systems/{{plug}}
+	setonpath redfish/v1/Systems/{{plug}}/Actions/ComputerSystem.Reset {\"ResetType\":\"On\"}
+	seteventpath redfish/v1/EventService/SSE
+	on Node[0-10]
+	quit
+	EOT
+	$redfishdir/redfishpower -h t0 --test-mode -vv <events_host.in >events_host.out &&
+	test $(grep "event hostname=t0 plugname=Node[0-9]* poll now" events_host.out | wc -l) -eq 11 &&
+	test $(grep "event hostname=t0 plugname=Node[0-9]* poll now" events_host.out | sort -u | wc -l) -eq 11 &&
+	test $(grep "Node[0-9]*: ok" events_host.out | wc -l) -eq 11
+'
+
+#
+# redfishpower stat collection coverage
+#
+
+test_expect_success 'stat with collection queries each host once' '
+	cat >statcollection.in <<-EOT &&
+	setplugs Node[0-7] 0
+	setplugs Node[8-15] 1
+	setstatpath redfish/v1/Systems/{{plug}}
+	setstatcollection redfish/v1/Systems?\$expand=.
+	stat
+	quit
+	EOT
+	$redfishdir/redfishpower -h t[0-1] --test-mode -vv <statcollection.in >statcollection.out &&
+	grep "hostname=t0 plugnames=Node\[0-7\] path=redfish/v1/Systems?\$expand=." statcollection.out &&
+	grep "hostname=t1 plugnames=Node\[8-15\] path=redfish/v1/Systems?\$expand=." statcollection.out &&
+	test_must_fail grep "path=redfish/v1/Systems/Node" statcollection.out &&
+	test $(grep "^Node[0-9]*: off" statcollection.out | wc -l) -eq 16
+'
+test_expect_success 'stat with collection falls back to per plug stat' '
+	$redfishdir/redfishpower -h t[0-1] --test-mode -vv \
+	    --test-fail-power-cmd-hosts=t1 <statcollection.in >statcollection2.out &&
+	grep "t1: stat collection error" statcollection2.out &&
+	grep "path=redfish/v1/Systems/Node8" statcollection2.out &&
+	test $(grep "^Node[0-9]*: off" statcollection2.out | wc -l) -eq 8 &&
+	test $(grep "^Node[0-9]*: error" statcollection2.out | wc -l) -eq 8
+'
+test_expect_success 'stat of single plug does not use collection' '
+	cat >statcollection3.in <<-EOT &&
+	setplugs Node[0-7] 0
+	setstatpath redfish/v1/Systems/{{plug}}
+	setstatcollection redfish/v1/Systems?\$expand=.
+	stat Node3
+	quit
+	EOT
+	$redfishdir/redfishpower -h t0 --test-mode -vv <statcollection3.in >statcollection3.out &&
+	grep "plugname=Node3 path=redfish/v1/Systems/Node3" statcollection3.out &&
+	test_must_fail grep "plugnames=" statcollection3.out
+'
+
 #
 # options
 #
@@ -700,6 +791,17 @@ test_expect_success 'resolve-hosts option setting appears to work' '
 	grep "resolve-hosts set" resolve_hosts.err
 '
 
+#
+# large hierarchy
+#
+
+test_expect_success 'redfishpower handles large plug hierarchy' '
+	$SHARNESS_TEST_SRCDIR/scripts/redfishpower-bench.sh -n 2000 -b 50 \
+	    $redfishdir/redfishpower >bench.out &&
+	cat bench.out &&
+	grep "plugs=2041 ok=4042" bench.out
+'
+
 #
 # valgrind
 #
@@ -729,6 +831,8 @@ test_expect_success HAVE_VALGRIND 'create redfishpower test input' '
 	setpath Node[0-15] stat redfish/v1/Systems/Node0
 	setpath Node[0-15] on redfish/v1/Systems/Node0/Actions/ComputerSystem.Reset {\"ResetType\":\"On\"}
 	setpath Node[0-15] off redfish/v1/Systems/Node0/Actions/ComputerSystem.Reset {\"ResetType\":\"ForceOff\"}
+	seteventpath redfish/v1/EventService/SSE
+	setstatcollection redfish/v1/Chassis?\$expand=.
 	settimeout 60
 	stat
 	stat Enclosure,Perif[0-7],Blade[0-7],Node[0-15]
@@ -0,0 +1,329 @@
+#!/bin/sh
+
+test_description='Check httppower multi-host commands'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+httppower=$SHARNESS_BUILD_DIRECTORY/src/httppower/httppower
+devicesdir=$SHARNESS_TEST_SRCDIR/../etc/devices
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11040
+
+# Responses are read from files via file:// URLs, laid out as
+#   hosts/<host>/redfish/v1/Systems/1
+# so no web server is needed.
+baseurl="file://$(pwd)/hosts/{{host}}"
+
+# Session auth is tested against a small Redfish SessionService
+# stand-in, which listens on sessport.
+sessiond=$SHARNESS_TEST_SRCDIR/scripts/redfish-session.py
+sessport=15400
+sessurl=http://127.0.0.1:$sessport
+
+command -v python3 >/dev/null && test_set_prereq PYTHON3
+
+makeoutput() {
+	printf "on:      %s\n" $1
+	printf "off:     %s\n" $2
+	printf "unknown: %s\n" $3
+}
+
+setstate() {
+	mkdir -p hosts/$1/redfish/v1/Systems &&
+	printf "{\n  \"PowerState\": \"%s\"\n}\n" $2 \
+	    >hosts/$1/redfish/v1/Systems/1
+}
+
+test_expect_success 'create response files' '
+	setstate t0 On &&
+	setstate t1 Off &&
+	setstate t2 On &&
+	setstate t3 Off
+'
+test_expect_success 'mget works and tags output with host' '
+	cat >mget.in <<-EOT &&
+	seturl $baseurl
+	mget t[0-3] redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <mget.in >mget.out &&
+	cat mget.out &&
+	test $(grep -c "PowerState" mget.out) -eq 4 &&
+	grep "^t0:   \"PowerState\": \"On\"" mget.out &&
+	grep "^t1:   \"PowerState\": \"Off\"" mget.out &&
+	grep "^t2: {" mget.out &&
+	grep "^t3: }" mget.out
+'
+test_expect_success 'mget reports errors per host' '
+	cat >mget_err.in <<-EOT &&
+	seturl $baseurl
+	mget t[3-4] redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <mget_err.in >mget_err.out &&
+	cat mget_err.out &&
+	grep "^t3:   \"PowerState\": \"Off\"" mget_err.out &&
+	grep "^t4: Error: " mget_err.out
+'
+test_expect_success 'mget all uses sethosts' '
+	cat >mget_all.in <<-EOT &&
+	seturl $baseurl
+	sethosts t[1-2]
+	mget all redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <mget_all.in >mget_all.out &&
+	test $(grep -c "PowerState" mget_all.out) -eq 2 &&
+	grep "^t1:" mget_all.out &&
+	grep "^t2:" mget_all.out
+'
+test_expect_success 'mget all uses --hosts' '
+	cat >mget_hosts.in <<-EOT &&
+	seturl $baseurl
+	mget all redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower --hosts=t[0,3] <mget_hosts.in >mget_hosts.out &&
+	test $(grep -c "PowerState" mget_hosts.out) -eq 2 &&
+	grep "^t0:" mget_hosts.out &&
+	grep "^t3:" mget_hosts.out
+'
+test_expect_success 'mget all fails without hosts' '
+	cat >mget_nohosts.in <<-EOT &&
+	seturl $baseurl
+	mget all redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <mget_nohosts.in >mget_nohosts.out &&
+	grep "Error: no hosts set" mget_nohosts.out
+'
+test_expect_success 'mget fails without {{host}} in url' '
+	cat >mget_nourl.in <<-EOT &&
+	seturl file://$(pwd)/hosts
+	mget t0 redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <mget_nourl.in >mget_nourl.out &&
+	grep "Error: url must contain {{host}}" mget_nourl.out
+'
+test_expect_success 'mget fails with bad hostlist' '
+	cat >mget_badhosts.in <<-EOT &&
+	seturl $baseurl
+	mget t[0-  redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <mget_badhosts.in >mget_badhosts.out &&
+	grep "Error: invalid hostlist" mget_badhosts.out
+'
+test_expect_success 'mpost without data fails' '
+	cat >mpost_nodata.in <<-EOT &&
+	seturl $baseurl
+	mpost t0
+	quit
+	EOT
+	$httppower <mpost_nodata.in >mpost_nodata.out &&
+	grep "Nothing to post!" mpost_nodata.out
+'
+test_expect_success 'mget with setsession fails if login fails' '
+	cat >mget_session.in <<-EOT &&
+	auth root:pw
+	seturl $baseurl
+	setsession redfish/v1/SessionService/Sessions
+	mget t[0-1] redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <mget_session.in >mget_session.out &&
+	cat mget_session.out &&
+	grep "t0: Error: session login failed" mget_session.out &&
+	grep "t1: Error: session login failed" mget_session.out
+'
+test_expect_success 'mget with --session uses cached tokens' '
+	for i in 0 1; do \
+	    echo "root file://$(pwd)/hosts/t$i token$i -"; \
+	done >tokens &&
+	cat >mget_cached.in <<-EOT &&
+	auth root:pw
+	mget t[0-1] redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower -u $baseurl -s redfish/v1/SessionService/Sessions \
+	    -t tokens <mget_cached.in >mget_cached.out &&
+	cat mget_cached.out &&
+	test $(grep -c "PowerState" mget_cached.out) -eq 2 &&
+	test_must_fail grep Error mget_cached.out
+'
+test_expect_success 'settokencache fails on unreadable file' '
+	cat >tokencache_bad.in <<-EOT &&
+	settokencache $(pwd)
+	quit
+	EOT
+	$httppower <tokencache_bad.in >tokencache_bad.out &&
+	grep "Error: " tokencache_bad.out
+'
+
+#
+# session auth against the SessionService stand-in
+#
+
+# token of the first GET in session.log
+sessiontoken() {
+	sed -n "s/^GET .* token=\(token[0-9]*\) .*/\1/p" session.log | head -1
+}
+
+test_expect_success PYTHON3 'start redfish session stand-in' '
+	python3 $sessiond $sessport session.log &
+	echo $! >sessiond.pid &&
+	for i in $(seq 1 50); do \
+	    grep -q ready session.log 2>/dev/null && break; \
+	    sleep 0.1; \
+	done &&
+	grep ready session.log
+'
+test_expect_success PYTHON3 'get logs in once and sends X-Auth-Token' '
+	: >session.log &&
+	cat >login.in <<-EOT &&
+	auth root:pw
+	seturl $sessurl/t0
+	setsession redfish/v1/SessionService/Sessions
+	get redfish/v1/Systems/1
+	get redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <login.in >login.out &&
+	cat login.out session.log &&
+	test $(grep -c PowerState login.out) -eq 2 &&
+	test $(grep -c "^POST /t0/redfish/v1/SessionService/Sessions token=- auth=-$" \
+	    session.log) -eq 1 &&
+	test $(grep -c "^GET /t0/redfish/v1/Systems/1 token=$(sessiontoken) auth=-$" \
+	    session.log) -eq 2
+'
+test_expect_success PYTHON3 'session is deleted on exit without a token cache' '
+	tok=$(sessiontoken) &&
+	grep "^DELETE /t0/redfish/v1/SessionService/Sessions/${tok#token} token=$tok " \
+	    session.log
+'
+test_expect_success PYTHON3 'mget logs in to and out of each host' '
+	: >session.log &&
+	cat >mlogin.in <<-EOT &&
+	auth root:pw
+	seturl $sessurl/{{host}}
+	setsession redfish/v1/SessionService/Sessions
+	mget t[0-3] redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <mlogin.in >mlogin.out &&
+	cat mlogin.out session.log &&
+	test $(grep -c PowerState mlogin.out) -eq 4 &&
+	for i in 0 1 2 3; do \
+	    grep "^t$i: " mlogin.out && \
+	    grep "^POST /t$i/redfish/v1/SessionService/Sessions token=- " session.log && \
+	    grep "^GET /t$i/redfish/v1/Systems/1 token=token[0-9]* auth=-$" session.log && \
+	    grep "^DELETE /t$i/redfish/v1/SessionService/Sessions/[0-9]* token=token[0-9]* " \
+	        session.log || return 1; \
+	done
+'
+test_expect_success PYTHON3 'token cache is written with mode 0600' '
+	: >session.log &&
+	cat >cache.in <<-EOT &&
+	auth root:pw
+	get redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower -u $sessurl/t0 -s redfish/v1/SessionService/Sessions \
+	    -t sessiontokens <cache.in >cache.out &&
+	cat cache.out session.log sessiontokens &&
+	grep PowerState cache.out &&
+	test "$(ls -l sessiontokens | cut -c1-10)" = "-rw-------" &&
+	grep "^root $sessurl/t0 $(sessiontoken) " sessiontokens
+'
+test_expect_success PYTHON3 'session is kept on exit with a token cache' '
+	test_must_fail grep "^DELETE" session.log
+'
+test_expect_success PYTHON3 'cached token is used without logging in' '
+	tok=$(sessiontoken) &&
+	: >session.log &&
+	$httppower -u $sessurl/t0 -s redfish/v1/SessionService/Sessions \
+	    -t sessiontokens <cache.in >cache2.out &&
+	cat cache2.out session.log &&
+	grep PowerState cache2.out &&
+	test_must_fail grep "^POST" session.log &&
+	grep "^GET /t0/redfish/v1/Systems/1 token=$tok " session.log
+'
+test_expect_success PYTHON3 'rejected token causes a new login and a retry' '
+	tok=$(sessiontoken) &&
+	python3 -c "import urllib.request as u; u.urlopen(\"$sessurl/expire\")" &&
+	: >session.log &&
+	$httppower -u $sessurl/t0 -s redfish/v1/SessionService/Sessions \
+	    -t sessiontokens <cache.in >cache3.out &&
+	cat cache3.out session.log sessiontokens &&
+	grep PowerState cache3.out &&
+	test_must_fail grep Error cache3.out &&
+	sed -n "s/ auth=.*//p" session.log >relogin.out &&
+	newtok=$(sed -n "s/^GET .* token=\(token[0-9]*\) .*/\1/p" session.log | tail -1) &&
+	test "$newtok" != "$tok" &&
+	cat >relogin.exp <<-EOT &&
+	GET /t0/redfish/v1/Systems/1 token=$tok
+	POST /t0/redfish/v1/SessionService/Sessions token=-
+	GET /t0/redfish/v1/Systems/1 token=$newtok
+	EOT
+	test_cmp relogin.exp relogin.out &&
+	grep "^root $sessurl/t0 $newtok " sessiontokens
+'
+test_expect_success PYTHON3 'login with a bad password fails' '
+	: >session.log &&
+	cat >badpw.in <<-EOT &&
+	auth root:nope
+	seturl $sessurl/t0
+	setsession redfish/v1/SessionService/Sessions
+	get redfish/v1/Systems/1
+	quit
+	EOT
+	$httppower <badpw.in >badpw.out &&
+	cat badpw.out &&
+	grep "Error: session login failed" badpw.out &&
+	test_must_fail grep "^GET" session.log
+'
+test_expect_success PYTHON3 'stop redfish session stand-in' '
+	kill $(cat sessiond.pid) &&
+	wait
+'
+
+#
+# one powerman device for all hosts
+#
+
+test_expect_success 'create powerman.conf for 4 redfish-supermicro-multi nodes' '
+	cat >powerman.conf <<-EOT
+	listen "$testaddr"
+	include "$devicesdir/redfish-supermicro-multi.dev"
+	device "d0" "redfish-supermicro-multi" "$httppower -u $baseurl -h t[0-3] |&"
+	node "t[0-3]" "d0" "t[0-3]"
+	EOT
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -Y -c powerman.conf &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'powerman -q shows status of all hosts' '
+	$powerman -h $testaddr -q >query.out &&
+	makeoutput "t[0,2]" "t[1,3]" "" >query.exp &&
+	test_cmp query.exp query.out
+'
+test_expect_success 'powerman -q shows unknown for failed host' '
+	rm -f hosts/t2/redfish/v1/Systems/1 &&
+	$powerman -h $testaddr -q >query2.out &&
+	makeoutput "t0" "t[1,3]" "t2" >query2.exp &&
+	test_cmp query2.exp query2.out
+'
+test_expect_success 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_done
+
+# vi: set ft=sh
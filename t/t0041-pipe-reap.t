@@ -0,0 +1,99 @@
+#!/bin/sh
+
+test_description='Check that pipe coprocesses are reaped without blocking'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+vpcd=$SHARNESS_BUILD_DIRECTORY/t/simulators/vpcd
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11041
+
+# wait up to 10s for process to exit
+waitgone() {
+	count=0
+	while kill -0 $1 2>/dev/null; do
+		count=$(($count+1))
+		test $count -eq 100 && return 1
+		sleep 0.1
+	done
+	return 0
+}
+
+# The wrapper ignores SIGTERM and lingers after vpcd sees EOF on stdin,
+# like a coprocess that is slow to finish up.
+test_expect_success 'create coprocess wrapper that ignores SIGTERM' '
+	cat >stubborn <<-EOT &&
+	#!/bin/sh
+	echo \$\$ >>stubborn.pids
+	trap "" TERM
+	$vpcd
+	exec sleep 60
+	EOT
+	chmod +x stubborn
+'
+test_expect_success 'create test powerman.conf with broken status_all' '
+	cat >powerman.conf <<-EOT
+	specification "vpcbroke" {
+	    timeout 	1.0
+	    plug name { "0" "1" "2" "3" "4" "5" "6" "7" "8"
+	                "9" "10" "11" "12" "13" "14" "15" }
+	    script login {
+	        send "login\n"
+	        expect "[0-9]* OK\n"
+	        expect "[0-9]* vpc> "
+	    }
+	    script status_all {
+	        send "stat *\n"
+	        expect "WONTGETTHIS"
+	    }
+	}
+	include "$vpcdev"
+	listen "$testaddr"
+	device "test0" "vpcbroke" "$(pwd)/stubborn |&"
+	device "test1" "vpc" "$vpcd |&"
+	node "t[0-15]" "test0"
+	node "t[16-31]" "test1"
+	EOT
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -c powerman.conf 2>powermand.err &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'powerman -q t0 times out, disconnecting test0' '
+	test_must_fail $powerman -h $testaddr -q t0
+'
+test_expect_success 'first coprocess ignored SIGTERM and is still running' '
+	kill -0 $(head -1 stubborn.pids)
+'
+test_expect_success 'powerman -q t16 works while it is being reaped' '
+	$powerman -h $testaddr -q t16 >query.out &&
+	grep "off:     t16" query.out
+'
+test_expect_success 'first coprocess is killed with SIGKILL' '
+	waitgone $(head -1 stubborn.pids) &&
+	grep "did not exit, sending SIGKILL" powermand.err
+'
+test_expect_success 'powerman -q t0 times out again, leaving another one' '
+	test_must_fail $powerman -h $testaddr -q t0 &&
+	kill -0 $(tail -1 stubborn.pids)
+'
+test_expect_success 'stop powerman daemon without waiting out the SIGKILL timeout' '
+	start=$(date +%s) &&
+	kill -15 $(cat powermand.pid) &&
+	wait &&
+	test $(($(date +%s) - $start)) -lt 4
+'
+test_expect_success 'all coprocesses are gone after daemon exits' '
+	for pid in $(cat stubborn.pids); do \
+	    waitgone $pid || return 1; \
+	done
+'
+test_done
+
+# vi: set ft=sh
@@ -0,0 +1,195 @@
+#!/bin/sh
+
+test_description='Check connecting to tcp devices'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+vpcd=$SHARNESS_BUILD_DIRECTORY/t/simulators/vpcd
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+tcpserve=$SHARNESS_TEST_SRCDIR/scripts/tcp-serve.py
+fakehosts=$SHARNESS_BUILD_DIRECTORY/t/simulators/.libs/fakehosts.so
+
+command -v python3 >/dev/null && test_set_prereq PYTHON3
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11042
+
+makeoutput() {
+	printf "on:      %s\n" $1
+	printf "off:     %s\n" $2
+	printf "unknown: %s\n" $3
+}
+
+# "localhost" may resolve to both ::1 and 127.0.0.1 while vpcd only
+# listens on IPv4, in which case the connect falls back to 127.0.0.1.
+# Nothing listens on port 10943.  The .invalid name can't be resolved,
+# which shouldn't keep powermand from starting.
+test_expect_success 'create test powerman.conf with devices over tcp' '
+	cat >powerman.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	device "test0" "vpc" "localhost:10942"
+	device "test1" "vpc" "127.0.0.1:10943"
+	device "test2" "vpc" "no-such-host.invalid:10942"
+	node "t[0-15]" "test0"
+	node "t[16-31]" "test1"
+	node "t[32-47]" "test2"
+	EOT
+'
+test_expect_success 'start device server' '
+	$vpcd -p 10942 &
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -d 0x40 -c powerman.conf 2>powermand.err &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'powerman -q t[0-15] works' '
+	$powerman -h $testaddr -q t[0-15] >query.out &&
+	makeoutput "" "t[0-15]" "" >query.exp &&
+	test_cmp query.exp query.out
+'
+test_expect_success 'powerman -d shows connect time for test0' '
+	$powerman -h $testaddr -d t0 >device.out &&
+	grep "^test0: state=connected .* conntime=[0-9]*/[0-9]*ms" \
+	    device.out
+'
+test_expect_success 'powerman -d shows failed connects for test1' '
+	$powerman -h $testaddr -d t16 >device2.out &&
+	grep "^test1: state=disconnected .* connfails=00[1-9]" device2.out
+'
+test_expect_success 'powerman -d shows failed lookups for test2' '
+	$powerman -h $testaddr -d t32 >device3.out &&
+	grep "^test2: state=disconnected .* connfails=00[1-9]" device3.out
+'
+test_expect_success 'powermand reported startup timing' '
+	grep "startup: loaded powerman.conf in" powermand.err &&
+	grep "startup: looked up all device names in .*, 1 failed" \
+	    powermand.err &&
+	grep "getaddrinfo no-such-host.invalid:10942" powermand.err
+'
+# powermand will disconnect from device server, which will cause it to exit
+test_expect_success 'stop powerman daemon and device server' '
+	kill -15 $(cat powermand.pid) &&
+	wait &&
+	wait
+'
+# Multi-address hosts, named through the fakehosts resolver.  Only
+# 127.0.0.1 has a device server behind it.  Nothing listens on 127.0.0.3
+# or 127.0.0.4, so connects there are refused, and connects to 127.0.0.2
+# are never answered because its listen backlog is full.
+#   test3: first address refuses
+#   test4: first address black-holes, so test4 must wait out the attempt
+#          delay (250ms) before the second address is tried
+#   test5: IPv6 and IPv4 addresses, tried with address families alternating
+#   test6: every address refuses, which is one failed connect per round
+fake_hosts="multi.test=127.0.0.3,127.0.0.1"
+fake_hosts="$fake_hosts;hole.test=127.0.0.2,127.0.0.1"
+fake_hosts="$fake_hosts;mixed.test=::3,::4,127.0.0.3,127.0.0.1"
+fake_hosts="$fake_hosts;dead.test=127.0.0.3,127.0.0.4"
+
+waitready() {
+	for i in $(seq 1 50); do
+		grep -q ready $1 2>/dev/null && return 0
+		sleep 0.1
+	done
+	return 1
+}
+devstat() {
+	$powerman -h $testaddr -d $1 | sed -n "s/.* $2=\([0-9]*\).*/\1/p"
+}
+attempts() {
+	sed -n -e "s/.*tcp_connect($1): connecting to \([^ ]*\)$/\1/p" \
+	    -e "s/.*tcp_connect($1): \([^ ]*\): .*/\1/p" powermand2.err
+}
+refused() {
+	grep -c "_connect($1): connection refused" powermand2.err
+}
+
+test_expect_success PYTHON3 'create powerman.conf with multi-address devices' '
+	cat >powerman2.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	device "test3" "vpc" "multi.test:10948"
+	device "test4" "vpc" "hole.test:10945"
+	device "test5" "vpc" "mixed.test:10946"
+	device "test6" "vpc" "dead.test:10947"
+	node "t[48-63]" "test3"
+	node "t[64-79]" "test4"
+	node "t[80-95]" "test5"
+	node "t[96-111]" "test6"
+	EOT
+'
+test_expect_success PYTHON3 'start device servers on one address of each host' '
+	python3 $tcpserve 127.0.0.1 10948 serve3.log $vpcd &
+	echo $! >serve3.pid &&
+	python3 $tcpserve 127.0.0.1 10945 serve4.log $vpcd &
+	echo $! >serve4.pid &&
+	python3 $tcpserve --blackhole 127.0.0.2 10945 hole4.log &
+	echo $! >hole4.pid &&
+	python3 $tcpserve 127.0.0.1 10946 serve5.log $vpcd &
+	echo $! >serve5.pid &&
+	waitready serve3.log &&
+	waitready serve4.log &&
+	waitready hole4.log &&
+	waitready serve5.log
+'
+test_expect_success PYTHON3 'start powerman daemon with fake host addresses' '
+	LD_PRELOAD=$fakehosts FAKE_HOSTS="$fake_hosts" \
+	    $powermand -d 0x01 -c powerman2.conf 2>powermand2.err &
+	echo $! >powermand2.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success PYTHON3 'device with a refusing first address works' '
+	$powerman -h $testaddr -q t[48-63] >query3.out &&
+	makeoutput "" "t[48-63]" "" >query3.exp &&
+	test_cmp query3.exp query3.out &&
+	attempts test3 | head -2 >attempts3.out &&
+	printf "%s\n" 127.0.0.3 127.0.0.1 >attempts3.exp &&
+	test_cmp attempts3.exp attempts3.out &&
+	grep "tcp_connect(test3): connected to 127.0.0.1" powermand2.err &&
+	test $(devstat t48 connfails) -eq 0
+'
+test_expect_success PYTHON3 'device with a black-holed first address works' '
+	$powerman -h $testaddr -q t[64-79] >query4.out &&
+	makeoutput "" "t[64-79]" "" >query4.exp &&
+	test_cmp query4.exp query4.out &&
+	grep "tcp_connect(test4): connecting to 127.0.0.2" powermand2.err &&
+	grep "tcp_connect(test4): connected to 127.0.0.1" powermand2.err &&
+	test $(devstat t64 connfails) -eq 0
+'
+test_expect_success PYTHON3 'second address was tried after the attempt delay' '
+	conntime=$(devstat t64 conntime) &&
+	test $conntime -ge 250
+'
+test_expect_success PYTHON3 'address families are interleaved' '
+	$powerman -h $testaddr -q t[80-95] >query5.out &&
+	makeoutput "" "t[80-95]" "" >query5.exp &&
+	test_cmp query5.exp query5.out &&
+	attempts test5 | head -4 >attempts5.out &&
+	printf "%s\n" ::3 127.0.0.3 ::4 127.0.0.1 >attempts5.exp &&
+	test_cmp attempts5.exp attempts5.out &&
+	test $(devstat t80 connfails) -eq 0
+'
+test_expect_success PYTHON3 'dead device counts one failed connect per round' '
+	before=$(refused test6) &&
+	fails=$(devstat t96 connfails) &&
+	after=$(refused test6) &&
+	test $(attempts test6 | grep -c 127.0.0.3) -ge 1 &&
+	test $(attempts test6 | grep -c 127.0.0.4) -ge 1 &&
+	test $fails -ge 1 &&
+	test $fails -ge $before &&
+	test $fails -le $after
+'
+test_expect_success PYTHON3 'stop powerman daemon and device servers' '
+	kill -15 $(cat powermand2.pid) &&
+	kill $(cat serve3.pid) $(cat serve4.pid) $(cat hole4.pid) \
+	    $(cat serve5.pid) &&
+	wait
+'
+test_done
+
+# vi: set ft=sh
@@ -0,0 +1,114 @@
+#!/bin/sh
+
+test_description='Check connecting to many devices at once'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+vpcd=$SHARNESS_BUILD_DIRECTORY/t/simulators/vpcd
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11043
+
+# The 2000 device tests take a while, so they only run with --long-tests
+# (or TEST_LONG=1 in the environment).
+# Each vpcd coprocess costs powermand one file descriptor
+ndevs=2000
+ulimit -n 4096 2>/dev/null
+test $(ulimit -n) -ge $(($ndevs + 100)) && test_set_prereq FDS
+
+# makeconf limit
+makeconf() {
+	echo "include \"$vpcdev\""
+	echo "listen \"$testaddr\""
+	test $1 -gt 0 && echo "connect_limit $1"
+	i=0
+	while test $i -lt $ndevs; do
+		echo "device \"d$i\" \"vpc\" \"$vpcd |&\""
+		echo "node \"t$i-[0-15]\" \"d$i\" \"[0-15]\""
+		i=$(($i + 1))
+	done
+}
+
+# waitconnected logfile
+waitconnected() {
+	count=0
+	while ! grep -q "all $ndevs devices connected" $1 \
+	    && test $count -lt 600; do
+		sleep 0.1
+		count=$(($count + 1))
+	done
+	grep "all $ndevs devices connected" $1 | sed -e "s/.*startup: //"
+}
+
+test_expect_success FDS,EXPENSIVE 'create powerman.conf with 2000 devices' '
+	makeconf 0 >powerman.conf &&
+	test $(grep -c "^device" powerman.conf) -eq $ndevs
+'
+test_expect_success FDS,EXPENSIVE 'start powerman daemon and wait for it to start' '
+	$powermand -d 0x40 -c powerman.conf 2>powermand.err &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success FDS,EXPENSIVE 'all devices connect' '
+	waitconnected powermand.err >connected.out &&
+	say "unlimited: $(cat connected.out)" &&
+	test -s connected.out
+'
+test_expect_success FDS,EXPENSIVE 'powerman -q works on first and last device' '
+	$powerman -h $testaddr -q t0-[0-15],t1999-[0-15] >query.out &&
+	grep "^off: *t0-\[0-15\],t1999-\[0-15\]" query.out
+'
+test_expect_success FDS,EXPENSIVE 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_expect_success FDS,EXPENSIVE 'create powerman.conf with connect_limit 64' '
+	makeconf 64 >powerman2.conf &&
+	grep "^connect_limit 64" powerman2.conf
+'
+test_expect_success FDS,EXPENSIVE 'start powerman daemon and wait for it to start' '
+	$powermand -d 0x40 -c powerman2.conf 2>powermand2.err &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success FDS,EXPENSIVE 'all devices connect' '
+	waitconnected powermand2.err >connected2.out &&
+	say "connect_limit 64: $(cat connected2.out)" &&
+	test -s connected2.out
+'
+test_expect_success FDS,EXPENSIVE 'powerman -q works on first and last device' '
+	$powerman -h $testaddr -q t0-[0-15],t1999-[0-15] >query2.out &&
+	grep "^off: *t0-\[0-15\],t1999-\[0-15\]" query2.out
+'
+# d1000 is halfway down the reconnect queue, so unless its query moved it
+# to the front, half the devices would have reconnected before it did.
+test_expect_success FDS,EXPENSIVE 'client actions jump the queue after devices drop' '
+	pkill -P $(cat powermand.pid) &&
+	$powerman -h $testaddr -q t1000-[0-15] >query3.out &&
+	$powerman -h $testaddr -d >devices3.out &&
+	grep "^off: *t1000-\[0-15\]" query3.out &&
+	connected=$(grep -c "state=connected" devices3.out) &&
+	say "connected when t1000 query finished: $connected/$ndevs" &&
+	test $connected -lt $(($ndevs / 2))
+'
+test_expect_success FDS,EXPENSIVE 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_expect_success 'connect_limit that is too large is rejected' '
+	cat >powerman3.conf <<-EOT &&
+	include "$vpcdev"
+	connect_limit 99999999999
+	device "d0" "vpc" "$vpcd |&"
+	node "t0" "d0" "0"
+	EOT
+	test_must_fail $powermand -Y -c powerman3.conf 2>bad.err &&
+	grep "connect_limit" bad.err
+'
+test_done
+
+# vi: set ft=sh
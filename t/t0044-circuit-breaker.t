@@ -0,0 +1,144 @@
+#!/bin/sh
+
+test_description='Check that actions on a dead device fail fast'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+vpcd=$SHARNESS_BUILD_DIRECTORY/t/simulators/vpcd
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11044
+
+makeoutput() {
+	printf "on:      %s\n" $1
+	printf "off:     %s\n" $2
+	printf "unknown: %s\n" $3
+}
+
+# waitlog pattern [logfile]
+waitlog() {
+	log=${2:-powermand.err}
+	count=0
+	while ! grep -q "$1" $log && test $count -lt 300; do
+		sleep 0.1
+		count=$(($count + 1))
+	done
+	grep "$1" $log
+}
+
+# vpc.dev has a 5s timeout, so a query that has to wait for it
+# to expire on the dead device takes at least that long.
+test_expect_success 'create test powerman.conf' '
+	cat >powerman.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	circuit_breaker 2
+	device "test0" "vpc" "$vpcd |&"
+	device "test1" "vpc" "127.0.0.1:10944"
+	node "t[0-15]" "test0"
+	node "t[16-31]" "test1"
+	EOT
+'
+test_expect_success 'start device server' '
+	$vpcd -p 10944 &
+	echo $! >vpcd.pid
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -c powerman.conf 2>powermand.err &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'turn on t16' '
+	$powerman -h $testaddr -1 t16 &&
+	$powerman -h $testaddr -q >query.out &&
+	makeoutput "t16" "t[0-15,17-31]" "" >query.exp &&
+	test_cmp query.exp query.out
+'
+test_expect_success 'stop device server' '
+	kill $(cat vpcd.pid) &&
+	wait $(cat vpcd.pid) || true
+'
+test_expect_success 'circuit breaker opens after failed reconnects' '
+	waitlog "test1: circuit breaker open after 2 failures"
+'
+test_expect_success 'powerman -q returns last known state right away' '
+	start=$(date +%s) &&
+	test_must_fail $powerman -h $testaddr -q >query2.out &&
+	end=$(date +%s) &&
+	test $(($end - $start)) -lt 4 &&
+	echo "test1: device is down (circuit breaker open)" >query2.exp &&
+	makeoutput "t16" "t[0-15,17-31]" "" >>query2.exp &&
+	echo "Query completed with errors" >>query2.exp &&
+	test_cmp query2.exp query2.out
+'
+test_expect_success 'powerman -1 on dead device fails right away' '
+	start=$(date +%s) &&
+	test_must_fail $powerman -h $testaddr -1 t17 >on.out &&
+	end=$(date +%s) &&
+	test $(($end - $start)) -lt 4 &&
+	grep "test1: device is down (circuit breaker open)" on.out
+'
+test_expect_success 'healthy device is unaffected' '
+	$powerman -h $testaddr -q t[0-15] >query3.out &&
+	makeoutput "" "t[0-15]" "" >query3.exp &&
+	test_cmp query3.exp query3.out
+'
+test_expect_success 'restart device server' '
+	$vpcd -p 10944 &
+	echo $! >vpcd.pid
+'
+test_expect_success 'circuit breaker closes after background reconnect' '
+	waitlog "test1: circuit breaker closed"
+'
+test_expect_success 'powerman -q reports fresh state from device' '
+	$powerman -h $testaddr -q >query4.out &&
+	makeoutput "" "t[0-31]" "" >query4.exp &&
+	test_cmp query4.exp query4.out
+'
+# powermand will disconnect from device server, which will cause it to exit
+test_expect_success 'stop powerman daemon and device server' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+# A query on a dead device times out waiting for it to connect, which
+# must not count as a failure on top of the failed connects themselves.
+# The vpcfast timeout (0.3s) is shorter than the 0.5s minimum retry delay,
+# so the query times out between two failed connects.  Were it counted,
+# the breaker would open after only 3 of them.  Nothing listens on 10949.
+test_expect_success 'create powerman.conf with circuit_breaker 4' '
+	sed -e "s/\"vpc\"/\"vpcfast\"/" -e "s/timeout[ \t]*5.0/timeout 0.3/" \
+	    $vpcdev >vpcfast.dev &&
+	grep "timeout 0.3" vpcfast.dev &&
+	cat >powerman2.conf <<-EOT
+	include "vpcfast.dev"
+	listen "$testaddr"
+	circuit_breaker 4
+	device "test2" "vpcfast" "127.0.0.1:10949"
+	node "t[32-47]" "test2"
+	EOT
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -c powerman2.conf 2>powermand2.err &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'powerman -q on dead device times out' '
+	test_must_fail $powerman -h $testaddr -q t32 >query5.out &&
+	grep "test2: connect timeout" query5.out
+'
+test_expect_success 'circuit breaker opens after exactly 4 failed connects' '
+	waitlog "test2: circuit breaker open after 4 failures" powermand2.err &&
+	$powerman -h $testaddr -d t32 >device5.out &&
+	grep "^test2: .* connfails=004 " device5.out
+'
+test_expect_success 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_done
+
+# vi: set ft=sh
@@ -0,0 +1,89 @@
+#!/bin/sh
+
+test_description='Check powerman --metrics'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+vpcd=$SHARNESS_BUILD_DIRECTORY/t/simulators/vpcd
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11045
+
+# Device metrics for this many devices don't fit in the client output
+# buffer at once, so they have to be sent as the client reads them.
+ndevs=500
+
+test_expect_success 'create test powerman.conf' '
+	i=0 &&
+	{
+		echo "include \"$vpcdev\""
+		echo "listen \"$testaddr\""
+		while test $i -lt $ndevs; do
+			echo "device \"d$i\" \"vpc\" \"$vpcd |&\""
+			echo "node \"t$i-[0-15]\" \"d$i\" \"[0-15]\""
+			i=$(($i + 1))
+		done
+	} >powerman.conf
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -c powerman.conf &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'run some commands' '
+	$powerman -h $testaddr -q &&
+	$powerman -h $testaddr -1 t0-0 &&
+	$powerman -h $testaddr -0 t0-0
+'
+test_expect_success 'powerman --metrics works' '
+	$powerman -h $testaddr --metrics >metrics.out
+'
+test_expect_success 'metrics are in Prometheus text format' '
+	grep -v "^# \(HELP\|TYPE\) powerman_[a-z_]* " metrics.out \
+	    | grep -v "^powerman_[a-z_]*\({[^}]*}\)\? [0-9.]*$" >bad.out;
+	test_must_be_empty bad.out
+'
+test_expect_success 'each metric family appears once' '
+	grep "^# TYPE" metrics.out | sort | uniq -d >dup.out &&
+	test_must_be_empty dup.out
+'
+test_expect_success 'metrics include every device' '
+	test $(grep -c "^powerman_device_up{" metrics.out) -eq $ndevs &&
+	grep "^powerman_device_breaker_open{device=\"d$(($ndevs - 1))\"} 0" \
+	    metrics.out
+'
+test_expect_success 'metrics include per-script latency' '
+	grep "^powerman_device_action_seconds_count{device=\"d0\",script=\"on\"} 1" \
+	    metrics.out &&
+	grep "^powerman_device_action_seconds_count{device=\"d0\",script=\"login\"} 1" \
+	    metrics.out &&
+	grep "^powerman_device_action_seconds_bucket{device=\"d0\",script=\"off\",le=\"+Inf\"} 1" \
+	    metrics.out
+'
+test_expect_success 'metrics include client command latency' '
+	grep "^powerman_client_command_seconds_count{command=\"status\"} 1" \
+	    metrics.out &&
+	grep "^powerman_client_command_seconds_count{command=\"on\"} 1" \
+	    metrics.out
+'
+test_expect_success 'metrics include connects, bytes and queue depth' '
+	grep "^powerman_device_connect_seconds_count{device=\"d0\"} 1" \
+	    metrics.out &&
+	grep "^powerman_device_read_bytes_total{device=\"d0\"} [1-9]" \
+	    metrics.out &&
+	grep "^powerman_device_written_bytes_total{device=\"d0\"} [1-9]" \
+	    metrics.out &&
+	grep "^powerman_device_queue_depth{device=\"d0\"} 0" metrics.out &&
+	grep "^powerman_poll_loop_seconds_count [1-9]" metrics.out
+'
+test_expect_success 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_done
+
+# vi: set ft=sh
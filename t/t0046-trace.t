@@ -0,0 +1,112 @@
+#!/bin/sh
+
+test_description='Check powerman --trace and powermand --trace-file'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+vpcd=$SHARNESS_BUILD_DIRECTORY/t/simulators/vpcd
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11046
+
+command -v python3 >/dev/null && test_set_prereq PYTHON3
+
+test_expect_success 'create test powerman.conf' '
+	cat >powerman.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	device "d0" "vpc" "$vpcd |&"
+	device "d1" "vpc" "$vpcd |&"
+	node "t[0-15]" "d0" "[0-15]"
+	node "t[16-31]" "d1" "[0-15]"
+	EOT
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -c powerman.conf --trace-file=$(pwd)/trace.json &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'run some commands' '
+	$powerman -h $testaddr -q &&
+	$powerman -h $testaddr -1 t0 &&
+	$powerman -h $testaddr -0 t[0-1]
+'
+test_expect_success 'powerman --trace works' '
+	$powerman -h $testaddr --trace >trace.out
+'
+test_expect_success 'trace has the expected envelope' '
+	head -1 trace.out | grep "^{\"displayTimeUnit\":\"ms\",\"traceEvents\":\[" &&
+	test "$(tail -1 trace.out)" = "]}"
+'
+test_expect_success PYTHON3 'trace is valid JSON' '
+	python3 -m json.tool trace.out >/dev/null
+'
+test_expect_success 'each device has a named track' '
+	grep -c "\"name\":\"thread_name\".*\"args\":{\"name\":\"d[01]\"}" \
+	    trace.out >tracks.out &&
+	test $(cat tracks.out) -eq 2
+'
+test_expect_success 'device actions are traced from enqueue to completion' '
+	grep "\"ph\":\"i\".*\"name\":\"enqueue\".*\"detail\":\"login\"" \
+	    trace.out &&
+	grep "\"ph\":\"B\",\"name\":\"login\"" trace.out &&
+	grep "\"ph\":\"E\",\"name\":\"login\"" trace.out &&
+	grep "\"ph\":\"B\",\"name\":\"status_all\"" trace.out &&
+	grep "\"ph\":\"E\",\"name\":\"status_all\"" trace.out &&
+	grep "\"ph\":\"B\",\"name\":\"on\"" trace.out &&
+	grep "\"ph\":\"E\",\"name\":\"on\"" trace.out &&
+	grep "\"ph\":\"B\",\"name\":\"off_ranged\"" trace.out &&
+	grep "\"ph\":\"E\",\"name\":\"off_ranged\"" trace.out
+'
+test_expect_success 'script statements and connects are traced' '
+	grep "\"ph\":\"i\",\"s\":\"t\",\"name\":\"send\"" trace.out &&
+	grep "\"ph\":\"i\",\"s\":\"t\",\"name\":\"expect\"" trace.out &&
+	grep "\"ph\":\"i\",\"s\":\"t\",\"name\":\"connected\"" trace.out
+'
+test_expect_success 'client commands are traced as async spans' '
+	grep "\"ph\":\"b\",\"cat\":\"clients\",\"name\":\"status\"" trace.out &&
+	grep "\"ph\":\"e\",\"cat\":\"clients\",\"name\":\"status\"" trace.out &&
+	grep "\"ph\":\"b\",\"cat\":\"clients\",\"name\":\"on\"" trace.out &&
+	grep "\"ph\":\"e\",\"cat\":\"clients\",\"name\":\"off\"" trace.out
+'
+test_expect_success 'SIGUSR2 writes the trace file' '
+	kill -USR2 $(cat powermand.pid) &&
+	i=0 &&
+	while ! test "$(tail -1 trace.json 2>/dev/null)" = "]}"; do
+		test $i -lt 100 || return 1
+		sleep 0.1
+		i=$(($i + 1))
+	done &&
+	grep "\"ph\":\"E\",\"name\":\"on\"" trace.json
+'
+test_expect_success 'trace file is private' '
+	test "$(stat -c %a trace.json)" = 600
+'
+test_expect_success PYTHON3 'trace file is valid JSON' '
+	python3 -m json.tool trace.json >/dev/null
+'
+test_expect_success 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_expect_success 'SIGUSR2 without --trace-file is logged' '
+	$powermand -c powerman.conf 2>stderr.out &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d &&
+	kill -USR2 $(cat powermand.pid) &&
+	i=0 &&
+	while ! grep "no trace file" stderr.out; do
+		test $i -lt 100 || return 1
+		sleep 0.1
+		i=$(($i + 1))
+	done &&
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_done
+
+# vi: set ft=sh
@@ -0,0 +1,49 @@
+#!/bin/sh
+
+test_description='Check powermand benchmark harness'
+
+. `dirname $0`/sharness.sh
+
+bench=$SHARNESS_TEST_SRCDIR/scripts/powermand-bench.sh
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+port=11048
+
+test_expect_success 'powermand-bench runs with vpc devices' '
+	$bench -n 10 -k 4 -c 200 -p $port $SHARNESS_BUILD_DIRECTORY \
+	    >vpc.out &&
+	cat vpc.out &&
+	grep "^type=vpc farm=0 devices=10 plugs=16 clients=4 commands=200 errors=0 " \
+	    vpc.out
+'
+test_expect_success 'output has throughput, latency, CPU and memory' '
+	for key in seconds rate p50_ms p99_ms max_ms cpu_sec cpu_us_per_cmd \
+	    allocs_per_cmd rss_kb peak_rss_kb; do
+		grep " $key=[0-9][0-9.]*\( \|$\)" vpc.out || return 1
+	done
+'
+test_expect_success 'powermand-bench runs with baytech devices' '
+	$bench -t baytech -n 4 -m 4 -k 2 -c 50 -p $port \
+	    $SHARNESS_BUILD_DIRECTORY >baytech.out &&
+	grep "^type=baytech farm=0 devices=4 plugs=4 clients=2 commands=50 errors=0 " \
+	    baytech.out
+'
+test_expect_success 'powermand-bench runs with icebox devices' '
+	$bench -t icebox -n 4 -k 2 -c 50 -x status=1 -p $port \
+	    $SHARNESS_BUILD_DIRECTORY >icebox.out &&
+	grep "^type=icebox farm=0 devices=4 plugs=10 clients=2 commands=50 errors=0 " \
+	    icebox.out
+'
+test_expect_success 'powermand-bench runs with a simfarm' '
+	$bench -F -L uniform:0:2 -n 20 -k 4 -c 200 -p $port \
+	    $SHARNESS_BUILD_DIRECTORY >farm.out &&
+	grep "^type=vpc farm=1 devices=20 plugs=16 clients=4 commands=200 errors=0 " \
+	    farm.out
+'
+test_expect_success 'powermand-bench rejects too many plugs' '
+	test_must_fail $bench -t baytech -m 9 -p $port $SHARNESS_BUILD_DIRECTORY
+'
+test_done
+
+# vi: set ft=sh
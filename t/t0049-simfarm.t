@@ -0,0 +1,149 @@
+#!/bin/sh
+
+test_description='Check the simfarm multi-device simulator'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+simfarm=$SHARNESS_BUILD_DIRECTORY/t/simulators/simfarm
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+rpc3dev=$SHARNESS_TEST_SRCDIR/../etc/devices/baytech-rpc3-nc.dev
+iceboxdev=$SHARNESS_TEST_SRCDIR/../etc/devices/icebox3.dev
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11049
+
+# simfarm devices use ports 14900-14999
+vpcport=14900
+rpcport=14940
+iceport=14950
+faultport=14960
+
+makeoutput() {
+	printf "on:      %s\n" $1
+	printf "off:     %s\n" $2
+	printf "unknown: %s\n" $3
+}
+
+test_expect_success 'start vpc, baytech, and icebox farms' '
+	$simfarm -d vpc -p $vpcport -n 20 &
+	echo $! >vpc.pid &&
+	$simfarm -d baytech -p $rpcport -n 4 &
+	echo $! >rpc.pid &&
+	$simfarm -d icebox -p $iceport -n 4 &
+	echo $! >ice.pid
+'
+test_expect_success 'create powerman.conf for 28 farm devices' '
+	{
+		echo "include \"$vpcdev\""
+		echo "include \"$rpc3dev\""
+		echo "include \"$iceboxdev\""
+		echo "listen \"$testaddr\""
+		for i in $(seq 0 19); do
+			echo "device \"v$i\" \"vpc\" \"127.0.0.1:$(($vpcport + $i))\""
+			echo "node \"v[$(($i * 16))-$(($i * 16 + 15))]\" \"v$i\" \"[0-15]\""
+		done
+		for i in $(seq 0 3); do
+			echo "device \"b$i\" \"baytech-rpc3-nc\" \"127.0.0.1:$(($rpcport + $i))\""
+			echo "node \"b[$(($i * 8))-$(($i * 8 + 7))]\" \"b$i\" \"[1-8]\""
+			echo "device \"i$i\" \"icebox3\" \"127.0.0.1:$(($iceport + $i))\""
+			echo "node \"i[$(($i * 10))-$(($i * 10 + 9))]\" \"i$i\" \"[1-10]\""
+		done
+	} >powerman.conf
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -Y -c powerman.conf &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'all plugs are off' '
+	$powerman -h $testaddr -q >query.out &&
+	makeoutput "" "b[0-31],i[0-39],v[0-319]" "" \
+	    >query.exp &&
+	test_cmp query.exp query.out
+'
+test_expect_success 'turn on some plugs in each dialect' '
+	$powerman -h $testaddr -1 v[48-63,311],b[8-15],i23
+'
+test_expect_success 'query shows them on' '
+	$powerman -h $testaddr -q >query2.out &&
+	makeoutput "b[8-15],i23,v[48-63,311]" \
+	    "b[0-7,16-31],i[0-22,24-39],v[0-47,64-310,312-319]" "" \
+	    >query2.exp &&
+	test_cmp query2.exp query2.out
+'
+test_expect_success 'cycle and off work' '
+	$powerman -h $testaddr -c i23 &&
+	$powerman -h $testaddr -0 v[48-63,311],b[8-15],i23 &&
+	$powerman -h $testaddr -q >query3.out &&
+	test_cmp query.exp query3.out
+'
+test_expect_success 'stop powerman daemon and farms' '
+	kill -15 $(cat powermand.pid) &&
+	kill -15 $(cat vpc.pid) $(cat rpc.pid) $(cat ice.pid) &&
+	wait
+'
+
+test_expect_success 'start a vpc farm with per-device faults' '
+	cat >faults.conf <<-EOT &&
+	# device 0 never answers, device 1 hangs up, device 2 drips
+	0 hang=1
+	1 drop=1
+	2 drip=1 drip-interval=0.2
+	3 latency=fixed:300
+	[4-5] latency=uniform:1:20
+	EOT
+	$simfarm -d vpc -p $faultport -n 6 -f faults.conf &
+	echo $! >fault.pid
+'
+test_expect_success 'create powerman.conf with a short device timeout' '
+	sed -e "s/timeout.*/timeout 1.0/" $vpcdev >vpc-fast.dev &&
+	{
+		echo "include \"vpc-fast.dev\""
+		echo "listen \"$testaddr\""
+		for i in $(seq 0 5); do
+			echo "device \"f$i\" \"vpc\" \"127.0.0.1:$(($faultport + $i))\""
+			echo "node \"f[$(($i * 16))-$(($i * 16 + 15))]\" \"f$i\" \"[0-15]\""
+		done
+	} >powerman2.conf
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -Y -c powerman2.conf &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'hung and dropping devices time out, others work' '
+	test_must_fail $powerman -h $testaddr -q >query4.out 2>query4.err &&
+	cat query4.out &&
+	grep "^f0: login timeout$" query4.out &&
+	grep "^f1: \(connect\|login\) timeout$" query4.out &&
+	grep "^off: *f\[32-95\]$" query4.out &&
+	grep "^unknown: *f\[0-31\]$" query4.out
+'
+test_expect_success 'dripping device works' '
+	$powerman -h $testaddr -1 f[32-35] &&
+	$powerman -h $testaddr -q f[32-36] >query5.out &&
+	makeoutput "f[32-35]" "f36" "" >query5.exp &&
+	test_cmp query5.exp query5.out
+'
+test_expect_success 'slow device adds its latency' '
+	start=$(date +%s%N) &&
+	$powerman -h $testaddr -q f48 &&
+	end=$(date +%s%N) &&
+	test $((($end - $start) / 1000000)) -ge 300
+'
+test_expect_success 'stop powerman daemon and farm' '
+	kill -15 $(cat powermand.pid) &&
+	kill -15 $(cat fault.pid) &&
+	wait
+'
+test_expect_success 'simfarm rejects a bad fault setting' '
+	echo "0 drop=2" >bad.conf &&
+	test_must_fail $simfarm -p $faultport -f bad.conf 2>bad.err &&
+	grep "not a probability" bad.err
+'
+test_done
+
+# vi: set ft=sh
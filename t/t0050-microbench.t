@@ -0,0 +1,42 @@
+#!/bin/sh
+
+test_description='Check liblsd/libcommon microbenchmark'
+
+. `dirname $0`/sharness.sh
+
+microbench=$SHARNESS_BUILD_DIRECTORY/t/bench/microbench
+
+test_expect_success 'microbench runs at small scale' '
+	$microbench -n 1000 -l 100 -b 4096 >bench.out &&
+	cat bench.out
+'
+test_expect_success 'hostlist benchmarks ran for each naming scheme' '
+	for b in hostlist_create hostlist_sort hostlist_ranged_string \
+	    hostlist_find hash_insert hash_find; do
+		for n in sierra mcr sparse; do
+			grep "^bench=$b naming=$n n=1000 " bench.out || return 1
+		done
+	done
+'
+test_expect_success 'cbuf and xregex benchmarks ran' '
+	for b in cbuf_write_from_fd cbuf_peek xregex_exec_match \
+	    xregex_exec_nomatch; do
+		grep "^bench=$b n=4096 .* mb_per_sec=[0-9.]*$" bench.out \
+		    || return 1
+	done &&
+	grep "^bench=xregex_compile " bench.out
+'
+test_expect_success 'every line reports ns_per_op' '
+	test $(grep -c " ns_per_op=[0-9.]*" bench.out) -eq $(wc -l <bench.out)
+'
+test_expect_success '--filter selects benchmarks by name' '
+	$microbench -n 100 -l 10 -f cbuf >filter.out &&
+	test $(wc -l <filter.out) -eq 2 &&
+	grep "^bench=cbuf_peek n=65536 " filter.out
+'
+test_expect_success 'microbench rejects an oversized buffer' '
+	test_must_fail $microbench -b 1000000
+'
+test_done
+
+# vi: set ft=sh
@@ -0,0 +1,150 @@
+#!/bin/sh
+
+test_description='Check powermand --capture-dir and replay devices'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+vpcd=$SHARNESS_BUILD_DIRECTORY/t/simulators/vpcd
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11051
+
+test_expect_success 'create test powerman.conf' '
+	cat >powerman.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	device "d0" "vpc" "$vpcd |&"
+	node "t[0-15]" "d0" "[0-15]"
+	EOT
+'
+test_expect_success 'start powerman daemon with --capture-dir' '
+	mkdir cap &&
+	$powermand -c powerman.conf --capture-dir=$(pwd)/cap &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'run some commands' '
+	$powerman -h $testaddr -q >query1.exp &&
+	$powerman -h $testaddr -1 t[0-3] >on.exp &&
+	$powerman -h $testaddr -q >query2.exp &&
+	$powerman -h $testaddr -0 t1 >off.exp &&
+	$powerman -h $testaddr -q >query3.exp &&
+	grep "^on:.*t\[0-3\]" query2.exp &&
+	grep "^on:.*t\[0,2-3\]" query3.exp
+'
+test_expect_success 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) && wait
+'
+test_expect_success 'capture file was written' '
+	test -f cap/d0.cap &&
+	head -1 cap/d0.cap | grep "^powerman-capture 1 d0$"
+'
+test_expect_success 'capture has a connect, writes and reads' '
+	grep -a "^c [0-9]* 0$" cap/d0.cap &&
+	grep -a "^w [0-9]* [0-9]*$" cap/d0.cap &&
+	grep -a "^r [0-9]* [0-9]*$" cap/d0.cap &&
+	grep -a "^on \[0-3\]$" cap/d0.cap
+'
+test_expect_success 'create replay powerman.conf' '
+	cat >replay.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	device "d0" "vpc" "replay:$(pwd)/cap/d0.cap" "0"
+	node "t[0-15]" "d0" "[0-15]"
+	EOT
+'
+test_expect_success 'start powerman daemon with the replay device' '
+	$powermand -c replay.conf &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'replayed commands produce the captured results' '
+	$powerman -h $testaddr -q >query1.out &&
+	$powerman -h $testaddr -1 t[0-3] >on.out &&
+	$powerman -h $testaddr -q >query2.out &&
+	$powerman -h $testaddr -0 t1 >off.out &&
+	$powerman -h $testaddr -q >query3.out &&
+	test_cmp query1.exp query1.out &&
+	test_cmp on.exp on.out &&
+	test_cmp query2.exp query2.out &&
+	test_cmp off.exp off.out &&
+	test_cmp query3.exp query3.out
+'
+test_expect_success 'replay starts over when the capture runs out' '
+	$powerman -h $testaddr -q >query4.out &&
+	test_cmp query1.exp query4.out
+'
+test_expect_success 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) && wait
+'
+# A recorded write without a line ending must be matched by length, even
+# if its last byte also turns up earlier in it.
+test_expect_success 'create replay of a write with no line ending' '
+	cat >pin.dev <<-EOT &&
+	specification "pin" {
+		timeout 	5.0
+		plug name { "1" }
+		script login {
+			send "4224"
+			expect "OK\n"
+		}
+		script status_all {
+			send "stat\n"
+			expect "1: (on|off)\n"
+			setplugstate "1" \$1 on="on" off="off"
+		}
+	}
+	EOT
+	printf "powerman-capture 1 p0\nc 0 0\n\n" >pin.cap &&
+	printf "w 0 4\n4224\nr 0 3\nOK\n\n" >>pin.cap &&
+	printf "w 0 5\nstat\n\nr 0 7\n1: off\n\n" >>pin.cap &&
+	cat >pin.conf <<-EOT
+	include "pin.dev"
+	listen "$testaddr"
+	device "p0" "pin" "replay:$(pwd)/pin.cap" "0"
+	node "p1" "p0" "1"
+	EOT
+'
+test_expect_success 'start powerman daemon with the replay device' '
+	$powermand -d 0x1 -c pin.conf 2>pin.err &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success 'replayed query works' '
+	$powerman -h $testaddr -q >pin.out &&
+	grep "^off: *p1$" pin.out
+'
+test_expect_success 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) && wait
+'
+test_expect_success 'script writes matched the recorded ones exactly' '
+	grep "_replay_disconnect: p0 " pin.err &&
+	test_must_fail grep "_replay_disconnect: p0 .*([1-9][0-9]* bytes differed)" \
+	    pin.err
+'
+test_expect_success 'replay device with a bad speed is rejected' '
+	cat >badspeed.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	device "d0" "vpc" "replay:$(pwd)/cap/d0.cap" "fast"
+	EOT
+	test_must_fail $powermand -c badspeed.conf 2>badspeed.err &&
+	grep "speed must be a number" badspeed.err
+'
+test_expect_success 'replay device with a bad capture file is rejected' '
+	echo "not a capture" >bad.cap &&
+	cat >badcap.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	device "d0" "vpc" "replay:$(pwd)/bad.cap"
+	EOT
+	test_must_fail $powermand -c badcap.conf 2>badcap.err &&
+	grep "could not load replay capture" badcap.err
+'
+test_done
+
+# vi: set ft=sh
@@ -0,0 +1,89 @@
+#!/bin/sh
+
+test_description='Check powermand memory accounting and soak harness'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+vpcd=$SHARNESS_BUILD_DIRECTORY/t/simulators/vpcd
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+soak=$SHARNESS_TEST_SRCDIR/scripts/powermand-soak.sh
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11052
+port=11052
+
+test_expect_success 'create test powerman.conf' '
+	cat >powerman.conf <<-EOT
+	include "$vpcdev"
+	listen "$testaddr"
+	device "test0" "vpc" "$vpcd |&"
+	node "t[0-15]" "test0"
+	EOT
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	$powermand -Y -d 0x10 -c powerman.conf 2>powermand.log &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d >/dev/null
+'
+test_expect_success 'powerman --memory lists each subsystem and a total' '
+	$powerman -h $testaddr --memory >memory.out &&
+	cat memory.out &&
+	for tag in other client device action arglist hostlist cbuf regex \
+	    total; do
+		grep "^$tag *bytes=[0-9]* objects=[0-9]* allocs=[0-9]*$" memory.out || return 1
+	done
+'
+test_expect_success 'device memory is accounted' '
+	grep "^device *bytes=[1-9][0-9]* objects=[1-9]" memory.out &&
+	grep "^cbuf *bytes=[1-9][0-9]* objects=[1-9]" memory.out &&
+	grep "^regex *bytes=[1-9][0-9]* objects=[1-9]" memory.out
+'
+test_expect_success 'commands leave no live action memory behind' '
+	$powerman -h $testaddr -q >/dev/null &&
+	$powerman -h $testaddr -1 t[0-7] >/dev/null &&
+	$powerman -h $testaddr -c t[4-11] >/dev/null &&
+	$powerman -h $testaddr -m >memory2.out &&
+	grep "^action *bytes=0 objects=0 " memory2.out &&
+	grep "^arglist *bytes=0 objects=0 " memory2.out
+'
+test_expect_success 'live objects do not grow over repeated commands' '
+	for i in 1 2 3 4 5; do
+		$powerman -h $testaddr -q >/dev/null || return 1
+	done &&
+	$powerman -h $testaddr -m >memory3.out &&
+	grep "^total" memory2.out | sed -e "s/.*objects=//" -e "s/ .*//" >objs2 &&
+	grep "^total" memory3.out | sed -e "s/.*objects=//" -e "s/ .*//" >objs3 &&
+	test_cmp objs2 objs3
+'
+test_expect_success 'powerman --help mentions --memory' '
+	$powerman --help 2>&1 | grep -- "--memory"
+'
+test_expect_success 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) &&
+	wait
+'
+test_expect_success 'powermand frees device and client memory at exit' '
+	cat powermand.log &&
+	test_must_fail grep "\(client\|device\|action\|arglist\|cbuf\|regex\):.*not freed" \
+	    powermand.log
+'
+test_expect_success 'powermand-soak passes with vpc devices' '
+	$soak -n 4 -k 2 -c 200 -r 4 -w 2 -p $port \
+	    $SHARNESS_BUILD_DIRECTORY >soak.out &&
+	cat soak.out &&
+	grep "^round=4 .*errors=0 rss_kb=[0-9]* live_bytes=[0-9]* live_objects=[0-9]*$" \
+	    soak.out &&
+	grep "^result=pass rounds=4$" soak.out
+'
+test_expect_success 'powermand-soak reports drift beyond tolerance' '
+	test_must_fail $soak -n 2 -k 2 -c 50 -r 3 -w 1 -O -1 -p $port \
+	    $SHARNESS_BUILD_DIRECTORY >drift.out &&
+	cat drift.out &&
+	grep "^result=fail round=2 .* grew from" drift.out
+'
+test_done
+
+# vi: set ft=sh
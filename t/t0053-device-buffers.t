@@ -0,0 +1,104 @@
+#!/bin/sh
+
+test_description='Check that device buffers are allocated on demand'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+simfarm=$SHARNESS_BUILD_DIRECTORY/t/simulators/simfarm
+vpcdev=$SHARNESS_TEST_SRCDIR/etc/vpc.dev
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11053
+
+# simfarm devices use ports 15300-15339
+farmport=15300
+
+# makeconf count
+makeconf() {
+	echo "include \"$vpcdev\""
+	echo "listen \"$testaddr\""
+	echo "buffer_idle 1"
+	for i in $(seq 0 $(($1 - 1))); do
+		echo "device \"v$i\" \"vpc\" \"127.0.0.1:$(($farmport + $i))\""
+		echo "node \"v[$(($i * 16))-$(($i * 16 + 15))]\" \"v$i\" \"[0-15]\""
+	done
+}
+
+# objects tag file
+objects() {
+	sed -n "s/^$1 *bytes=[0-9]* objects=\([0-9]*\) .*/\1/p" $2
+}
+
+startpm() {
+	$powermand -Y -c $1 &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d >/dev/null
+}
+
+stoppm() {
+	kill -15 $(cat powermand.pid) &&
+	wait $(cat powermand.pid)
+}
+
+test_expect_success 'create configs for 1, 8, and 40 vpc devices' '
+	makeconf 1 >one.conf &&
+	makeconf 8 >eight.conf &&
+	makeconf 40 >farm.conf
+'
+test_expect_success 'measure powermand with 1 disconnected device' '
+	startpm one.conf &&
+	$powerman -h $testaddr -m >one.out &&
+	stoppm &&
+	cat one.out
+'
+test_expect_success 'measure powermand with 8 disconnected devices' '
+	startpm eight.conf &&
+	$powerman -h $testaddr -m >eight.out &&
+	stoppm &&
+	cat eight.out
+'
+test_expect_success 'disconnected devices have no I/O buffers' '
+	test $(objects cbuf one.out) -eq $(objects cbuf eight.out)
+'
+test_expect_success 'devices of one type share compiled scripts' '
+	test $(objects regex one.out) -eq $(objects regex eight.out)
+'
+test_expect_success 'start a farm of 40 vpc devices' '
+	$simfarm -d vpc -p $farmport -n 40 &
+	echo $! >farm.pid
+'
+test_expect_success 'start powerman daemon and wait for it to start' '
+	startpm farm.conf
+'
+test_expect_success 'powerman -q works' '
+	$powerman -h $testaddr -q >query.out &&
+	grep "^off: *v\[0-639\]$" query.out
+'
+test_expect_success 'connected devices have I/O buffers' '
+	$powerman -h $testaddr -m >busy.out &&
+	cat busy.out &&
+	test $(objects cbuf busy.out) -ge 80
+'
+test_expect_success 'idle devices give their buffers back' '
+	sleep 3 &&
+	$powerman -h $testaddr -m >idle.out &&
+	cat idle.out &&
+	test $(objects cbuf idle.out) -lt $(objects cbuf busy.out)
+'
+test_expect_success 'powerman -q works after buffers are released' '
+	$powerman -h $testaddr -q >query2.out &&
+	test_cmp query.out query2.out
+'
+test_expect_success 'stop powerman daemon' '
+	stoppm
+'
+test_expect_success 'stop the farm' '
+	kill -15 $(cat farm.pid) &&
+	wait
+'
+test_done
+
+# vi: set ft=sh
@@ -0,0 +1,301 @@
+#!/bin/sh
+
+test_description='Check snmppower against a simulated SNMP agent'
+
+. `dirname $0`/sharness.sh
+
+powermand=$SHARNESS_BUILD_DIRECTORY/src/powerman/powermand
+powerman=$SHARNESS_BUILD_DIRECTORY/src/powerman/powerman
+snmppower=$SHARNESS_BUILD_DIRECTORY/src/snmppower/snmppower
+agent=$SHARNESS_TEST_SRCDIR/scripts/snmp-agent.py
+devicesdir=$SHARNESS_TEST_SRCDIR/../etc/devices
+
+# Use port = 11000 + test number
+# That way there won't be port conflicts with make -j
+testaddr=localhost:11054
+
+# simulated PDUs use ports 15500-15503
+agentport=15500
+
+# snmppower is only built if net-snmp is found
+test -x $snmppower && test_set_prereq SNMPPOWER
+command -v python3 >/dev/null && test_set_prereq PYTHON3
+
+table=enterprises.534.6.6.6.1.2.2.1.3
+
+test_expect_success SNMPPOWER,PYTHON3 'start simulated SNMP agent' '
+	python3 $agent -p $agentport -n 4 -o 40 -d 3 agent.log &
+	echo $! >agent.pid &&
+	for i in $(seq 1 50); do \
+	    grep -q ready agent.log 2>/dev/null && break; \
+	    sleep 0.1; \
+	done &&
+	grep ready agent.log
+'
+test_expect_success SNMPPOWER,PYTHON3 'mget prints each oid in the order requested' '
+	: >agent.log &&
+	cat >mget.in <<-EOT &&
+	start_v2c private
+	mget $table.3 enterprises.99999.1.5.0 $table.0
+	finish
+	EOT
+	$snmppower -h localhost:$agentport <mget.in >mget.out &&
+	cat mget.out &&
+	cat >mget.exp <<-EOT &&
+	$table.3: 0
+	enterprises.99999.1.5.0: pdu0
+	$table.0: 1
+	EOT
+	sed "s/^\(snmppower> \)*//" mget.out | grep -v "^$" >mget.got &&
+	test_cmp mget.exp mget.got
+'
+test_expect_success SNMPPOWER,PYTHON3 'mget sends one GET' '
+	test $(grep -c "pdu=get " agent.log) -eq 1
+'
+test_expect_success SNMPPOWER,PYTHON3 'mget on v1 names the missing oid' '
+	cat >mget_v1.in <<-EOT &&
+	start_v1 private
+	mget $table.3 enterprises.99999.7
+	finish
+	EOT
+	$snmppower -h localhost:$agentport <mget_v1.in >mget_v1.out 2>&1 &&
+	cat mget_v1.out &&
+	grep "error in packet: .*noSuchName.*: enterprises.99999.7$" mget_v1.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'walk on v2c reads a 40 row table' '
+	: >agent.log &&
+	cat >walk.in <<-EOT &&
+	start_v2c private
+	walk $table
+	finish
+	EOT
+	$snmppower -h localhost:$agentport <walk.in >walk.out &&
+	cat walk.out &&
+	test $(grep -c "^\(snmppower> \)*$table\.[0-9]*: [01]$" walk.out) -eq 40 &&
+	grep "^\(snmppower> \)*$table\.0: 1$" walk.out &&
+	grep "^$table\.39: 0$" walk.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'walk on v2c uses GETBULK with 32 repetitions' '
+	cat agent.log &&
+	test $(grep -c "version=2c pdu=getbulk max-repetitions=32 " agent.log) -eq 2 &&
+	test_must_fail grep "pdu=getnext" agent.log
+'
+test_expect_success SNMPPOWER,PYTHON3 'walk on v1 falls back to GETNEXT' '
+	: >agent.log &&
+	cat >walk_v1.in <<-EOT &&
+	start_v1 private
+	walk $table
+	finish
+	EOT
+	$snmppower -h localhost:$agentport <walk_v1.in >walk_v1.out &&
+	test_cmp walk.out walk_v1.out &&
+	test $(grep -c "version=1 pdu=getnext " agent.log) -eq 41 &&
+	test_must_fail grep "pdu=getbulk" agent.log
+'
+test_expect_success SNMPPOWER,PYTHON3 'walk stops at the end of the MIB' '
+	cat >walk_end.in <<-EOT &&
+	start_v2c private
+	walk enterprises.99999
+	finish
+	start_v1 private
+	walk enterprises.99999
+	finish
+	EOT
+	$snmppower -h localhost:$agentport <walk_end.in >walk_end.out 2>&1 &&
+	cat walk_end.out &&
+	test $(grep -c "enterprises.99999.1.5.0: pdu0$" walk_end.out) -eq 2 &&
+	test_must_fail grep -i error walk_end.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'start_v3 refuses to replace a running session' '
+	cat >restart.in <<-EOT &&
+	start_v2c private
+	start_v3 someone longpassphrase
+	start_v1 private
+	hget all enterprises.99999.1.5.0
+	finish
+	EOT
+	$snmppower -H localhost:$agentport <restart.in >restart.out 2>&1 &&
+	cat restart.out &&
+	test $(grep -c "finish current session first" restart.out) -eq 2 &&
+	grep "localhost:$agentport: enterprises.99999.1.5.0: pdu0$" restart.out
+'
+
+#
+# host commands send to all PDUs at once, PDU 3 never answers
+#
+
+hosts="localhost:$(($agentport))"
+hosts="$hosts,localhost:$(($agentport + 1))"
+hosts="$hosts,localhost:$(($agentport + 2))"
+hosts="$hosts,localhost:$(($agentport + 3))"
+dead=localhost:$(($agentport + 3))
+
+test_expect_success SNMPPOWER,PYTHON3 'hget before start fails' '
+	cat >hget_nostart.in <<-EOT &&
+	hget all $table.0
+	EOT
+	$snmppower -H $hosts <hget_nostart.in >hget_nostart.out 2>&1 &&
+	grep "start session first" hget_nostart.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'snmppower rejects a bad --timeout' '
+	test_must_fail $snmppower -H $hosts --timeout=0 </dev/null
+'
+test_expect_success SNMPPOWER,PYTHON3 'hget gets oids from every host' '
+	: >agent.log &&
+	cat >hget.in <<-EOT &&
+	start_v2c private
+	hget all $table.1 enterprises.99999.1.5.0
+	finish
+	EOT
+	$snmppower -H $hosts --timeout=0.2 <hget.in >hget.out &&
+	cat hget.out &&
+	for i in 0 1 2; do \
+	    grep "localhost:$(($agentport + $i)): $table.1: $(($i % 2))$" hget.out && \
+	    grep "localhost:$(($agentport + $i)): enterprises.99999.1.5.0: pdu$i$" \
+	        hget.out || return 1; \
+	done
+'
+test_expect_success SNMPPOWER,PYTHON3 'hget reports a timeout for the host that does not answer' '
+	test $(grep -c "^\(snmppower> \)*$dead: " hget.out) -eq 1 &&
+	grep "$dead: Error: timeout$" hget.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'hget sends one GET per host' '
+	for i in 0 1 2; do \
+	    test $(grep -c "port=$(($agentport + $i)) .*pdu=get " agent.log) -eq 1 \
+	        || return 1; \
+	done
+'
+test_expect_success SNMPPOWER,PYTHON3 'hget of a host without a session fails' '
+	cat >hget_nosess.in <<-EOT &&
+	start_v2c private
+	hget localhost:$(($agentport + 9)) $table.0
+	finish
+	EOT
+	$snmppower -H $hosts <hget_nosess.in >hget_nosess.out &&
+	grep "localhost:$(($agentport + 9)): Error: no session" hget_nosess.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'hset sets an oid on some hosts' '
+	cat >hset.in <<-EOT &&
+	start_v2c private
+	hset localhost:$agentport,localhost:$(($agentport + 1)) $table.5 i 1
+	hget all $table.5
+	hset localhost:$agentport $table.5 i 0
+	finish
+	EOT
+	$snmppower -H $hosts --timeout=0.2 <hset.in >hset.out &&
+	cat hset.out &&
+	test $(grep -c "localhost:$agentport: $table.5: 1$" hset.out) -eq 2 &&
+	test $(grep -c "localhost:$(($agentport + 1)): $table.5: 1$" hset.out) -eq 2 &&
+	grep "localhost:$(($agentport + 2)): $table.5: 0$" hset.out &&
+	grep "localhost:$agentport: $table.5: 0$" hset.out &&
+	test_must_fail grep "localhost:$(($agentport + 2)): .*Error" hset.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'hset reports errors per host' '
+	cat >hset_bad.in <<-EOT &&
+	start_v2c private
+	hset localhost:$agentport enterprises.99999.1.5.0 i 1
+	hset localhost:$agentport $table.5 i 7
+	hget localhost:$agentport $table.0
+	finish
+	EOT
+	$snmppower -H $hosts <hset_bad.in >hset_bad.out &&
+	cat hset_bad.out &&
+	grep "localhost:$agentport: Error: .*notWritable" hset_bad.out &&
+	grep "localhost:$agentport: Error: .*badValue" hset_bad.out &&
+	grep "localhost:$agentport: $table.0: 1$" hset_bad.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'hwalk on v2c walks every host with GETBULK' '
+	: >agent.log &&
+	cat >hwalk.in <<-EOT &&
+	start_v2c private
+	hwalk all $table
+	finish
+	EOT
+	$snmppower -H $hosts --timeout=0.2 <hwalk.in >hwalk.out &&
+	for i in 0 1 2; do \
+	    host=localhost:$(($agentport + $i)) && \
+	    test $(grep -c "$host: $table\.[0-9]*: [01]$" hwalk.out) -eq 40 && \
+	    grep "$host: $table\.39: $(($i % 2))$" hwalk.out && \
+	    test $(grep -c "port=$(($agentport + $i)) version=2c pdu=getbulk max-repetitions=32 " \
+	        agent.log) -eq 2 || return 1; \
+	done &&
+	grep "$dead: Error: timeout$" hwalk.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'hwalk on v1 walks every host with GETNEXT' '
+	: >agent.log &&
+	cat >hwalk_v1.in <<-EOT &&
+	start_v1 private
+	hwalk localhost:$agentport,localhost:$(($agentport + 1)) $table
+	finish
+	EOT
+	$snmppower -H $hosts <hwalk_v1.in >hwalk_v1.out &&
+	for i in 0 1; do \
+	    host=localhost:$(($agentport + $i)) && \
+	    grep "$host: " hwalk.out | sed "s/^\(snmppower> \)*//" | sort \
+	        >hwalk.$i.exp && \
+	    grep "$host: " hwalk_v1.out | sed "s/^\(snmppower> \)*//" | sort \
+	        >hwalk_v1.$i.out && \
+	    test_cmp hwalk.$i.exp hwalk_v1.$i.out && \
+	    test $(grep -c "port=$(($agentport + $i)) version=1 pdu=getnext " \
+	        agent.log) -eq 41 || return 1; \
+	done &&
+	test_must_fail grep "pdu=getbulk" agent.log
+'
+
+#
+# eaton-revelation-snmp status_all uses walk
+#
+
+test_expect_success SNMPPOWER,PYTHON3 'create powerman.conf for eaton-revelation-snmp' '
+	cat >powerman.conf <<-EOT
+	listen "$testaddr"
+	include "$devicesdir/eaton-revelation-snmp.dev"
+	device "d0" "eaton-revelation-snmp" "$snmppower -h localhost:$agentport |&"
+	node "r[0-19]" "d0" "[0-19]"
+	EOT
+'
+test_expect_success SNMPPOWER,PYTHON3 'start powerman daemon and wait for it to start' '
+	$powermand -Y -c powerman.conf &
+	echo $! >powermand.pid &&
+	$powerman --retry-connect=100 --server-host=$testaddr -d
+'
+test_expect_success SNMPPOWER,PYTHON3 'powerman -q works' '
+	: >agent.log &&
+	$powerman -h $testaddr -q >query.out &&
+	cat >query.exp <<-EOT &&
+	on:      r[0,2,4,6,8,10,12,14,16,18]
+	off:     r[1,3,5,7,9,11,13,15,17,19]
+	unknown: 
+	EOT
+	test_cmp query.exp query.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'powerman -q walks the table instead of a GET per plug' '
+	cat agent.log &&
+	test $(grep -c "pdu=getbulk" agent.log) -eq 2 &&
+	test_must_fail grep "pdu=get " agent.log
+'
+test_expect_success SNMPPOWER,PYTHON3 'powerman -1 r1 works' '
+	$powerman -h $testaddr -1 r1 >on.out &&
+	echo Command completed successfully >on.exp &&
+	test_cmp on.exp on.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'powerman -q shows r1 on' '
+	$powerman -h $testaddr -q >query2.out &&
+	cat >query2.exp <<-EOT &&
+	on:      r[0-2,4,6,8,10,12,14,16,18]
+	off:     r[3,5,7,9,11,13,15,17,19]
+	unknown: 
+	EOT
+	test_cmp query2.exp query2.out
+'
+test_expect_success SNMPPOWER,PYTHON3 'stop powerman daemon' '
+	kill -15 $(cat powermand.pid) &&
+	wait $(cat powermand.pid)
+'
+test_expect_success SNMPPOWER,PYTHON3 'stop simulated SNMP agent' '
+	kill $(cat agent.pid) &&
+	wait
+'
+test_done
+
+# vi: set ft=sh
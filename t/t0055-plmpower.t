@@ -0,0 +1,127 @@
+#!/bin/sh
+
+test_description='Check plmpower group commands and status cache against a simulated PLM'
+
+. `dirname $0`/sharness.sh
+
+plmpower=$SHARNESS_BUILD_DIRECTORY/src/plmpower/plmpower
+plmsim=$SHARNESS_TEST_SRCDIR/scripts/plm-sim.py
+
+command -v python3 >/dev/null && test_set_prereq PYTHON3
+
+# strip the prompts, which have no newline
+prompts() {
+	sed "s/^\(plmpower> \)*//" $1
+}
+
+test_expect_success 'plmpower rejects a bad --cache-ttl' '
+	echo quit >quit.in &&
+	test_must_fail $plmpower -T --cache-ttl=10x <quit.in 2>ttl.err &&
+	grep "cache TTL must be" ttl.err &&
+	test_must_fail $plmpower -T --cache-ttl=-1 <quit.in &&
+	test_must_fail $plmpower -T --cache-ttl= <quit.in &&
+	test_must_fail $plmpower -T --cache-ttl=99999999999999999999 <quit.in &&
+	$plmpower -T --cache-ttl=0 <quit.in
+'
+test_expect_success PYTHON3 'start simulated PLM' '
+	python3 $plmsim -g 1:11.11.11,22.22.22,33.33.33 -f 33.33.33 \
+	    -c 44.44.44:11.11.11,22.22.22 plm sim.log &
+	echo $! >sim.pid &&
+	for i in $(seq 1 50); do \
+	    grep -q ready sim.log 2>/dev/null && break; \
+	    sleep 0.1; \
+	done &&
+	grep ready sim.log
+'
+test_expect_success PYTHON3 'status is answered from the cache within the ttl' '
+	: >sim.log &&
+	cat >cached.in <<-EOT &&
+	status 11.11.11
+	status 11.11.11
+	cache
+	EOT
+	$plmpower -d plm --cache-ttl=60 <cached.in >cached.out &&
+	prompts cached.out >cached.txt &&
+	test $(grep -c "^11.11.11: 00$" cached.txt) -eq 2 &&
+	grep "^11.11.11: 00 age=" cached.txt &&
+	test $(grep -c "send 11.11.11 19" sim.log) -eq 1
+'
+test_expect_success PYTHON3 'status is not cached without --cache-ttl' '
+	: >sim.log &&
+	$plmpower -d plm <cached.in >uncached.out &&
+	test $(grep -c "send 11.11.11 19" sim.log) -eq 2
+'
+test_expect_success PYTHON3 'groupon switches the group with one all-link command' '
+	: >sim.log &&
+	cat >groupon.in <<-EOT &&
+	status 11.11.11
+	status 22.22.22
+	groupon 1
+	status 11.11.11
+	status 22.22.22
+	EOT
+	$plmpower -d plm --cache-ttl=60 <groupon.in >groupon.out &&
+	prompts groupon.out >groupon.txt &&
+	test $(grep -c "^group " sim.log) -eq 1 &&
+	grep "^group 1 12$" sim.log &&
+	grep "^33.33.33: cleanup failed$" groupon.txt &&
+	grep "^group 1: complete$" groupon.txt
+'
+test_expect_success PYTHON3 'status after groupon is not served stale from the cache' '
+	cat >groupon.exp <<-EOT &&
+	11.11.11: 00
+	22.22.22: 00
+	11.11.11: FF
+	22.22.22: FF
+	EOT
+	grep "^[0-9.]*: [0-9A-F]*$" groupon.txt >groupon.status &&
+	test_cmp groupon.exp groupon.status &&
+	test $(grep -c "send 11.11.11 19" sim.log) -eq 2 &&
+	test $(grep -c "send 22.22.22 19" sim.log) -eq 2
+'
+test_expect_success PYTHON3 'status after groupoff is not served stale from the cache' '
+	: >sim.log &&
+	cat >groupoff.in <<-EOT &&
+	status 11.11.11
+	groupoff 1
+	status 11.11.11
+	EOT
+	$plmpower -d plm --cache-ttl=60 <groupoff.in >groupoff.out &&
+	prompts groupoff.out >groupoff.txt &&
+	grep "^group 1 14$" sim.log &&
+	cat >groupoff.exp <<-EOT &&
+	11.11.11: FF
+	11.11.11: 00
+	EOT
+	grep "^[0-9.]*: [0-9A-F]*$" groupoff.txt >groupoff.status &&
+	test_cmp groupoff.exp groupoff.status
+'
+test_expect_success PYTHON3 'a controller broadcast flushes its responders from the cache' '
+	: >sim.log &&
+	{ echo "status 11.11.11"; \
+	  echo "status 22.22.22"; \
+	  sleep 1; \
+	  kill -USR1 $(cat sim.pid); \
+	  sleep 1; \
+	  echo "status 44.44.44"; \
+	  echo "status 11.11.11"; \
+	  echo "status 22.22.22"; \
+	} | $plmpower -d plm --cache-ttl=60 >bcast.out &&
+	prompts bcast.out >bcast.txt &&
+	cat >bcast.exp <<-EOT &&
+	11.11.11: 00
+	22.22.22: 00
+	44.44.44: FF
+	11.11.11: FF
+	22.22.22: FF
+	EOT
+	grep "^[0-9.]*: [0-9A-F]*$" bcast.txt >bcast.status &&
+	test_cmp bcast.exp bcast.status &&
+	test_must_fail grep "send 44.44.44" sim.log &&
+	test $(grep -c "send 11.11.11 19" sim.log) -eq 2
+'
+test_expect_success PYTHON3 'stop simulated PLM' '
+	kill $(cat sim.pid) &&
+	wait
+'
+test_done